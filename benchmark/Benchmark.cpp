@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <Arduino.h>
+#include "Benchmark.h"
+
+//
+// Allocation counting. Replacing the global operator new catches every allocation made by
+// String, std::function, the standard containers and ArduinoJson's dynamic documents.
+//
+
+static std::atomic<uint64_t> allocationCount(0);
+
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc((size > 0) ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+uint64_t benchmarkAllocationCount(void)
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t benchmarkNanos(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()
+            ).count();
+}
+
+void reportBenchmark(const BenchmarkResult& result)
+{
+    printf("%-52s %10zu %14.1f %12.2f\n", result.name, result.iterations, result.nanosPerOp, result.allocsPerOp);
+}
+
+//
+// main
+//
+
+struct BenchmarkSuite {
+    const char* name;
+    void (*run)(void);
+};
+
+static const BenchmarkSuite SUITES[] = {
+    {"FrameDecoder", benchFrameDecoder},
+    {"Utilities", benchUtilities},
+    {"AirQualitySensor", benchAirQualitySensor},
+    {"SampleHistory", benchSampleHistory},
+    {"ColumnarHistory", benchColumnarHistory},
+    {"PageRenderer", benchPageRenderer},
+    {"Telemetry", benchTelemetry},
+    {"Metrics", benchMetrics},
+    {"Logger", benchLogger},
+};
+
+int main(int argc, char** argv)
+{
+    const char* filter = (argc > 1) ? argv[1] : nullptr;
+
+    // the libraries log to Serial, which would otherwise interleave with the results
+    Serial.setOutputEnabled(false);
+
+    printf("%-52s %10s %14s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+    for (size_t i = 0; i < sizeof(SUITES)/sizeof(SUITES[0]); i++) {
+        if ((filter != nullptr) && (strstr(SUITES[i].name, filter) == nullptr)) {
+            continue;
+        }
+        SUITES[i].run();
+    }
+    return 0;
+}
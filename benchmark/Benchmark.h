@@ -0,0 +1,76 @@
+#ifndef __Benchmark__
+#define __Benchmark__
+//
+// Host micro-benchmark harness.
+//
+// Each benchmark runs its body a fixed number of times and reports the mean wall clock time
+// and the mean number of heap allocations (calls to operator new) per iteration. The
+// allocation count is what matters most on the device, where every allocation is a chance to
+// fragment the heap, so a regression there is as significant as a regression in time.
+//
+// Build and run from the project root with:
+//   pio run -e native_benchmark && .pio/build/native_benchmark/program [suite name filter]
+//
+#include <stdint.h>
+#include <stddef.h>
+
+struct BenchmarkResult {
+    const char* name;
+    size_t      iterations;
+    double      nanosPerOp;
+    double      allocsPerOp;
+};
+
+// number of calls to operator new since the program started
+uint64_t benchmarkAllocationCount(void);
+
+// monotonic host time in nanoseconds
+uint64_t benchmarkNanos(void);
+
+void reportBenchmark(const BenchmarkResult& result);
+
+// Keeps the compiler from optimizing away a value that a benchmark computes but never uses.
+template <typename T>
+inline void benchmarkKeep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Runs body() iterations times after one warm up call, reports the result and returns it.
+template <typename Body>
+BenchmarkResult runBenchmark(const char* name, size_t iterations, Body body)
+{
+    body();
+
+    uint64_t start_allocs = benchmarkAllocationCount();
+    uint64_t start_nanos = benchmarkNanos();
+    for (size_t i = 0; i < iterations; i++) {
+        body();
+    }
+    uint64_t elapsed_nanos = benchmarkNanos() - start_nanos;
+    uint64_t allocs = benchmarkAllocationCount() - start_allocs;
+
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.nanosPerOp = (double)elapsed_nanos/iterations;
+    result.allocsPerOp = (double)allocs/iterations;
+    reportBenchmark(result);
+    return result;
+}
+
+// Fills frame with a valid SN-GCJA5 frame reporting the given PM2.5 mass density.
+void makeBenchmarkFrame(uint8_t* frame, uint16_t pm2p5);
+
+// benchmark suites
+void benchFrameDecoder(void);
+void benchUtilities(void);
+void benchAirQualitySensor(void);
+void benchSampleHistory(void);
+void benchColumnarHistory(void);
+void benchPageRenderer(void);
+void benchTelemetry(void);
+void benchMetrics(void);
+void benchLogger(void);
+
+#endif // __Benchmark__
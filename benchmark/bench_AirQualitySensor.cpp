@@ -0,0 +1,51 @@
+//
+// Cost of the AQI calculation and of taking one sample through the whole sensor pipeline:
+// decoding, queueing, and updating the history, its averages and the NowCast. Reading the
+// NowCast AQI should cost no more than reading any other AQI.
+//
+#include <AirQualitySensor.h>
+#include <SNGCJA5FrameDecoder.h>
+#include "Benchmark.h"
+
+void benchAirQualitySensor(void)
+{
+    const uint32_t REFRESH_SECONDS = 2;
+    UARTParticulateSensorDriver<SNGCJA5Protocol> driver(Serial1, 33, 32);
+    AirQualitySensor sensor(driver, REFRESH_SECONDS);
+    sensor.begin();
+
+    float pm2p5 = 0;
+    runBenchmark("AirQualitySensor/airQualityIndex", 1000000, [&]() {
+        float aqi = sensor.airQualityIndex(pm2p5);
+        benchmarkKeep(aqi);
+        pm2p5 += 0.7;
+        if (pm2p5 > 600) {
+            pm2p5 = 0;
+        }
+    });
+
+    // Each iteration delivers one frame on the sensor's UART, advances the clock to the next
+    // sample and consumes it. Allocations include the host Serial1 receive buffer.
+    uint8_t frame[SNGCJA5_FRAME_SIZE];
+    uint16_t value = 0;
+    runBenchmark("AirQualitySensor/updateSensorReading", 200000, [&]() {
+        makeBenchmarkFrame(frame, value++%500);
+        Serial1.injectReceivedBytes(frame, sizeof(frame));
+        delay(REFRESH_SECONDS*1000);
+        bool updated = sensor.updateSensorReading();
+        benchmarkKeep(updated);
+    });
+
+    runBenchmark("AirQualitySensor/averagesAndAQI", 1000000, [&]() {
+        float aqi = sensor.currentAirQualityIndex()
+                    + sensor.tenMinuteAirQualityIndex()
+                    + sensor.oneHourAirQualityIndex()
+                    + sensor.oneDayAirQualityIndex();
+        benchmarkKeep(aqi);
+    });
+
+    runBenchmark("AirQualitySensor/nowCastAQI", 1000000, [&]() {
+        float aqi = sensor.nowCastAirQualityIndex();
+        benchmarkKeep(aqi);
+    });
+}
@@ -0,0 +1,59 @@
+//
+// Cost of the compressed all-channel history: appending a row of every channel, scanning one
+// channel, and how many bytes a row takes. The rows are a random walk shaped like the sensor
+// readings, with noisy particle counts and slowly changing environment readings. The bytes
+// per row are reported in place of allocations, which the history never makes.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <ColumnarHistory.h>
+#include "Benchmark.h"
+
+static const uint8_t CHANNELS = 14;
+
+static void nextRow(int32_t* row)
+{
+    // PM1.0, PM2.5, PM10
+    for (uint8_t c = 0; c < 3; c++) {
+        row[c] += rand()%3 - 1;
+        if (row[c] < 0) {
+            row[c] = 0;
+        }
+    }
+    // particle counts, which are the noisiest
+    for (uint8_t c = 3; c < 9; c++) {
+        row[c] = 200/(c - 2) + rand()%(40/(c - 2) + 1);
+    }
+    // status, temperature, humidity, pressure, gas resistance
+    row[9] = 0;
+    row[10] += rand()%5 - 2;
+    row[11] += rand()%9 - 4;
+    row[12] += rand()%3 - 1;
+    row[13] += rand()%201 - 100;
+}
+
+void benchColumnarHistory(void)
+{
+    const size_t storage_bytes = 256*1024;
+    std::vector<uint32_t> storage(storage_bytes/sizeof(uint32_t));
+    ColumnarHistory history;
+    history.setStorage(storage.data(), storage_bytes, CHANNELS);
+
+    int32_t row[CHANNELS] = {10, 12, 15, 0, 0, 0, 0, 0, 0, 0, 2150, 4500, 10132, 150000};
+    runBenchmark("ColumnarHistory/push", 100000, [&]() {
+        nextRow(row);
+        history.push(row);
+    });
+
+    std::vector<int32_t> column(history.size());
+    runBenchmark("ColumnarHistory/scan/pm2p5", 100, [&]() {
+        size_t count = history.read(1, history.oldestRow(), column.data(), column.size());
+        benchmarkKeep(count);
+    });
+
+    // compare with the 2 bytes per sample of the uncompressed PM2.5 history
+    printf("ColumnarHistory: %u rows of %u channels in %u bytes, %.1f bytes per row, %.2f bytes per value\n",
+        (unsigned)history.size(), CHANNELS, (unsigned)history.bytesInUse(),
+        (double)history.bytesInUse()/history.size(), (double)history.bytesInUse()/history.size()/CHANNELS);
+}
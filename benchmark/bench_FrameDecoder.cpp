@@ -0,0 +1,157 @@
+//
+// Cost of decoding the particulate sensor UART streams, per frame, and of reading a frame's
+// measurement fields.
+//
+#include <string.h>
+#include <vector>
+#include <SNGCJA5FrameDecoder.h>
+#include <ParticulateFrameDecoder.h>
+#include <ParticulateProtocols.h>
+#include "Benchmark.h"
+
+void makeBenchmarkFrame(uint8_t* frame, uint16_t pm2p5)
+{
+    memset(frame, 0, SNGCJA5_FRAME_SIZE);
+    frame[0] = SNGCJA5_FRAME_STX;
+    frame[1] = (uint8_t)(pm2p5/2);
+    frame[5] = pm2p5 & 0xFF;
+    frame[6] = pm2p5 >> 8;
+    frame[9] = (uint8_t)(pm2p5*2);
+    frame[13] = 0x40;
+    frame[14] = 0x01;
+    uint8_t fcc = 0;
+    for (size_t i = 1; i < SNGCJA5_FRAME_FCC_IDX; i++) {
+        fcc ^= frame[i];
+    }
+    frame[SNGCJA5_FRAME_FCC_IDX] = fcc;
+    frame[SNGCJA5_FRAME_SIZE - 1] = SNGCJA5_FRAME_ETX;
+}
+
+static void makePMS5003Frame(uint8_t* frame, uint16_t pm2p5)
+{
+    memset(frame, 0, PMS5003Protocol::FRAME_SIZE);
+    frame[0] = 0x42;
+    frame[1] = 0x4D;
+    frame[3] = 28;
+    frame[12] = pm2p5 >> 8;
+    frame[13] = pm2p5 & 0xFF;
+    frame[19] = 0x40;
+    uint16_t sum = 0;
+    for (size_t i = 0; i < 30; i++) {
+        sum += frame[i];
+    }
+    frame[30] = sum >> 8;
+    frame[31] = sum & 0xFF;
+}
+
+// an SPS30 answer with PM2.5 of 0x41800000 + pm2p5 as a float bit pattern, and a 0x7E that
+// needs escaping in the typical particle size
+static size_t makeSPS30Stream(uint8_t* stream, uint16_t pm2p5)
+{
+    uint8_t frame[SPS30Protocol::FRAME_SIZE] = {0x7E, 0x00, 0x03, 0x00, 40};
+    frame[9] = 0x41;
+    frame[10] = 0x80;
+    frame[11] = pm2p5 >> 8;
+    frame[12] = pm2p5 & 0xFF;
+    frame[41] = 0x3F;
+    frame[42] = 0x7E;
+    uint8_t sum = 0;
+    for (size_t i = 1; i < 45; i++) {
+        sum += frame[i];
+    }
+    frame[45] = ~sum;
+    frame[46] = 0x7E;
+
+    size_t length = 0;
+    stream[length++] = frame[0];
+    for (size_t i = 1; i < SPS30Protocol::FRAME_SIZE - 1; i++) {
+        if ((frame[i] == 0x7E) || (frame[i] == 0x7D) || (frame[i] == 0x11) || (frame[i] == 0x13)) {
+            stream[length++] = 0x7D;
+            stream[length++] = frame[i] ^ 0x20;
+        } else {
+            stream[length++] = frame[i];
+        }
+    }
+    stream[length++] = frame[SPS30Protocol::FRAME_SIZE - 1];
+    return length;
+}
+
+void benchFrameDecoder(void)
+{
+    const size_t FRAME_COUNT = 64;
+    std::vector<uint8_t> stream(FRAME_COUNT*SNGCJA5_FRAME_SIZE);
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+        makeBenchmarkFrame(&stream[i*SNGCJA5_FRAME_SIZE], 10 + i);
+    }
+
+    // the same stream with one corrupted byte in every fourth frame, forcing resyncs
+    std::vector<uint8_t> corrupt_stream(stream);
+    for (size_t i = 0; i < FRAME_COUNT; i += 4) {
+        corrupt_stream[i*SNGCJA5_FRAME_SIZE + 7] ^= 0x5A;
+    }
+
+    SNGCJA5FrameDecoder decoder;
+    size_t frame_idx = 0;
+    SNGCJA5Frame frame;
+
+    runBenchmark("FrameDecoder/pushFrame", 1000000, [&]() {
+        decoder.push(&stream[frame_idx*SNGCJA5_FRAME_SIZE], SNGCJA5_FRAME_SIZE, 0);
+        decoder.takeFrame(frame);
+        benchmarkKeep(frame);
+        frame_idx = (frame_idx + 1)%FRAME_COUNT;
+    });
+
+    runBenchmark("FrameDecoder/pushBytewise", 1000000, [&]() {
+        const uint8_t* bytes = &stream[frame_idx*SNGCJA5_FRAME_SIZE];
+        for (size_t i = 0; i < SNGCJA5_FRAME_SIZE; i++) {
+            decoder.push(bytes[i], 0);
+        }
+        decoder.takeFrame(frame);
+        benchmarkKeep(frame);
+        frame_idx = (frame_idx + 1)%FRAME_COUNT;
+    });
+
+    runBenchmark("FrameDecoder/pushCorruptStream", 1000000, [&]() {
+        decoder.push(&corrupt_stream[frame_idx*SNGCJA5_FRAME_SIZE], SNGCJA5_FRAME_SIZE, 0);
+        decoder.takeFrame(frame);
+        benchmarkKeep(frame);
+        frame_idx = (frame_idx + 1)%FRAME_COUNT;
+    });
+
+    ParticulateMeasurement measurement;
+    runBenchmark("FrameDecoder/decodeSNGCJA5", 1000000, [&]() {
+        SNGCJA5FrameDecoder::decode(&stream[frame_idx*SNGCJA5_FRAME_SIZE], measurement);
+        benchmarkKeep(measurement);
+        frame_idx = (frame_idx + 1)%FRAME_COUNT;
+    });
+
+    std::vector<uint8_t> pms5003_stream(FRAME_COUNT*PMS5003Protocol::FRAME_SIZE);
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+        makePMS5003Frame(&pms5003_stream[i*PMS5003Protocol::FRAME_SIZE], 10 + i);
+    }
+    ParticulateFrameDecoder<PMS5003Protocol> pms5003_decoder;
+    ParticulateFrameDecoder<PMS5003Protocol>::Frame pms5003_frame;
+    runBenchmark("FrameDecoder/pushPMS5003", 1000000, [&]() {
+        pms5003_decoder.push(&pms5003_stream[frame_idx*PMS5003Protocol::FRAME_SIZE], PMS5003Protocol::FRAME_SIZE, 0);
+        pms5003_decoder.takeFrame(pms5003_frame);
+        ParticulateFrameDecoder<PMS5003Protocol>::decode(pms5003_frame.bytes, measurement);
+        benchmarkKeep(measurement);
+        frame_idx = (frame_idx + 1)%FRAME_COUNT;
+    });
+
+    const size_t SPS30_MAX_STREAM_BYTES = 2*SPS30Protocol::FRAME_SIZE;
+    std::vector<uint8_t> sps30_stream(FRAME_COUNT*SPS30_MAX_STREAM_BYTES);
+    std::vector<size_t> sps30_lengths(FRAME_COUNT);
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+        sps30_lengths[i] = makeSPS30Stream(&sps30_stream[i*SPS30_MAX_STREAM_BYTES], 10 + i);
+    }
+    ParticulateFrameDecoder<SPS30Protocol> sps30_decoder;
+    ParticulateFrameDecoder<SPS30Protocol>::Frame sps30_frame;
+    runBenchmark("FrameDecoder/pushSPS30", 1000000, [&]() {
+        sps30_decoder.push(&sps30_stream[frame_idx*SPS30_MAX_STREAM_BYTES], sps30_lengths[frame_idx], 0);
+        sps30_decoder.takeFrame(sps30_frame);
+        ParticulateFrameDecoder<SPS30Protocol>::decode(sps30_frame.bytes, measurement);
+        benchmarkKeep(measurement);
+        frame_idx = (frame_idx + 1)%FRAME_COUNT;
+    });
+}
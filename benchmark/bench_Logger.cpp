@@ -0,0 +1,37 @@
+//
+// Cost of a log to the task that makes it, when the record is queued for the log task, compared
+// with formatting and printing it right away, which is what every log cost before the log task.
+// On the device the printing itself then waits on the 9600 baud Serial port, which is not
+// counted here.
+//
+#include <Logger.h>
+#include "Benchmark.h"
+
+void benchLogger(void)
+{
+    MPSCQueue<LogRecord, LOG_QUEUE_RECORDS> queue;
+    LogRecord record;
+    uint32_t i = 0;
+    runBenchmark("Logger/queueRecord", 1000000, [&]() {
+        // what Logger::log() does with the task running, plus the pop that frees the slot
+        record.format = "WEB: %s - %s";
+        record.millis = i++;
+        record.level = LOG_LEVEL_INFO;
+        record.argCount = 0;
+        record.stringsLength = 0;
+        record.addArg("192.168.1.20");
+        record.addArg("/api/current");
+        queue.push(record);
+        queue.pop(record);
+    });
+
+    char line[LOG_LINE_MAX_LENGTH];
+    runBenchmark("Logger/formatRecord", 1000000, [&]() {
+        benchmarkKeep(Logger::format(record, line, sizeof(line)));
+    });
+
+    // with no task running, as on the host, a log is formatted and printed by its caller
+    runBenchmark("Logger/logSynchronously", 1000000, [&]() {
+        LOG_INFO("WEB: %s - %s", "192.168.1.20", "/api/current");
+    });
+}
@@ -0,0 +1,39 @@
+//
+// Cost of timing a hot path stage and recording it, which is paid on every stage of every
+// sample, and of writing the /metrics response. On the host the cycle counter is emulated
+// with the system clock, so stageTimer is far slower here than the register read on the device.
+//
+#include <string>
+#include <LatencyHistogram.h>
+#include <StageTimer.h>
+#include <PrometheusWriter.h>
+#include "Benchmark.h"
+
+// collects the output without allocating once it has grown to size
+class BenchmarkPrint : public Print {
+public:
+    std::string text;
+    size_t write(uint8_t c) override            { text.push_back((char)c); return 1; }
+};
+
+void benchMetrics(void)
+{
+    LatencyHistogram histogram;
+    uint32_t i = 0;
+    runBenchmark("Metrics/record", 1000000, [&]() {
+        histogram.record(i++ & 0xFFFF);
+    });
+
+    runBenchmark("Metrics/stageTimer", 1000000, [&]() {
+        StageTimer timer(histogram);
+    });
+
+    BenchmarkPrint out;
+    out.text.reserve(32768);
+    runBenchmark("Metrics/prometheusHistogram", 20000, [&]() {
+        out.text.clear();
+        PrometheusWriter writer(out);
+        writer.histogram("diyaqi_stage_latency_seconds", "stage", "sensor_read", histogram);
+        benchmarkKeep(out.text);
+    });
+}
@@ -0,0 +1,107 @@
+//
+// Cost of rendering the web pages from their SPIFFS templates, both the way ESPAsyncWebServer's
+// template processing does it and from a parsed PageTemplate, of serving a cached page, and
+// of encoding the update that is pushed to the live dashboards.
+// The templates are read from the data directory, so run the benchmarks from the project root.
+//
+#include <stdio.h>
+#include <string>
+#include <AirQualitySensor.h>
+#include <PageRenderer.h>
+#include <PageTemplate.h>
+#include "Benchmark.h"
+
+static bool readFile(const char* path, std::string& contents)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        printf("ERROR - could not open %s. Run the benchmarks from the project root.\n", path);
+        return false;
+    }
+    char buffer[1024];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, count);
+    }
+    fclose(file);
+    return true;
+}
+
+void benchPageRenderer(void)
+{
+    std::string index_html;
+    std::string stats_html;
+    if (!readFile("data/index.html", index_html) || !readFile("data/stats.html", stats_html)) {
+        return;
+    }
+
+    UARTParticulateSensorDriver<SNGCJA5Protocol> driver(Serial1, 33, 32);
+
+    AirQualitySensor sensor(driver, 2);
+    DeviceStatus status = DeviceStatus();
+    status.sensorName = "benchmark";
+    status.wifiSSID = "benchmark-ssid";
+    status.ipAddress = "192.168.1.2";
+    status.telemetryURL = "http://192.168.1.3:8080/telemetry";
+    status.bootTime = 1600000000;
+    status.lastUpdateTime = 1600003600;
+    status.lastTransmitTime = 1600003540;
+    status.measureSeconds = 2;
+    status.transmitSeconds = 60;
+    status.hasBME680 = true;
+    status.temperature = 21.5;
+    status.pressure = 1013.2;
+    status.humidity = 45.0;
+    status.rootPageViewCount = 42;
+    PageRenderer renderer(sensor, status);
+
+    TemplateVariableProcessor processor = std::bind(&PageRenderer::processTemplateVariable, &renderer, std::placeholders::_1);
+    TemplateValueFormatter formatter = std::bind(&PageRenderer::formatVariable, &renderer, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+
+    runBenchmark("PageRenderer/renderTemplate/index.html", 20000, [&]() {
+        String page = PageRenderer::renderTemplate(index_html.data(), index_html.size(), processor);
+        benchmarkKeep(page);
+    });
+
+    runBenchmark("PageRenderer/renderTemplate/stats.html", 20000, [&]() {
+        String page = PageRenderer::renderTemplate(stats_html.data(), stats_html.size(), processor);
+        benchmarkKeep(page);
+    });
+
+    const String aqi_variable("AQI-10MIN");
+    runBenchmark("PageRenderer/processTemplateVariable", 200000, [&]() {
+        String value = renderer.processTemplateVariable(aqi_variable);
+        benchmarkKeep(value);
+    });
+
+    PageTemplate index_template;
+    PageTemplate stats_template;
+    index_template.parse(index_html.data(), index_html.size());
+    stats_template.parse(stats_html.data(), stats_html.size());
+    uint32_t epoch = 0;
+
+    runBenchmark("PageTemplate/render/index.html", 20000, [&]() {
+        RenderedPagePtr page = index_template.render(++epoch, formatter);
+        benchmarkKeep(page);
+    });
+
+    runBenchmark("PageTemplate/render/stats.html", 20000, [&]() {
+        RenderedPagePtr page = stats_template.render(++epoch, formatter);
+        benchmarkKeep(page);
+    });
+
+    // a repeated hit within one sample epoch, copied out the way the web response does
+    std::string response(stats_template.maxRenderedLength(), '\0');
+    runBenchmark("PageTemplate/cached/stats.html", 200000, [&]() {
+        RenderedPagePtr page = stats_template.render(epoch, formatter);
+        memcpy(&response[0], page->data, page->length);
+        benchmarkKeep(response);
+    });
+
+    // what each sample costs the live dashboards instead, encoded once for all of them
+    char live_update[LIVE_UPDATE_MAX_LENGTH];
+    runBenchmark("PageRenderer/formatLiveUpdate", 200000, [&]() {
+        size_t length = renderer.formatLiveUpdate(live_update, sizeof(live_update));
+        benchmarkKeep(length);
+    });
+}
@@ -0,0 +1,185 @@
+//
+// Per-sample cost of maintaining the PM2.5 averages.
+//
+// Compares the incremental windows maintained by SampleHistory against rescanning the
+// history for each of the four standard windows (current, 10 min, 1 hour, 24 hours) on
+// every update, which is what AirQualitySensor::updateSensorReading() used to do. The
+// incremental cost should stay flat as the history grows while the rescan cost grows with
+// the length of the longest window that fits in the history. The incremental windows are
+// time weighted, so each push also stamps the sample and expires the windows by time.
+//
+// The spread variant also keeps the min, max and percentiles of the three longer windows.
+//
+// Also times restoring a day of 1 minute rollups from the flash archive, which happens at boot.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <SampleHistory.h>
+#include <SampleHistoryArchive.h>
+#include "Benchmark.h"
+
+static const size_t SAMPLE_SECONDS = 2;
+static const size_t WINDOW_SECONDS[] = {SAMPLE_SECONDS, 10*60, 60*60, 24*60*60};
+static const size_t WINDOW_COUNT = sizeof(WINDOW_SECONDS)/sizeof(WINDOW_SECONDS[0]);
+
+static float rescanAverage(const std::vector<uint16_t>& data, size_t size, size_t newest_idx, size_t number_of_values)
+{
+    size_t curr_idx = newest_idx;
+    size_t value_count = 0;
+    uint32_t running_sum = 0;
+    while ((value_count < number_of_values) && (value_count < size)) {
+        running_sum += data[curr_idx];
+        value_count++;
+        curr_idx = (curr_idx == 0) ? size - 1 : curr_idx - 1;
+    }
+    return (float)running_sum/(float)value_count;
+}
+
+static void benchIncremental(size_t history_size, size_t iterations, bool track_spread)
+{
+    std::vector<uint32_t> storage(SampleHistory::storageBytes(history_size, nullptr, 0)/sizeof(uint32_t) + 1);
+    SampleHistory history;
+    history.setStorage(storage.data(), history_size);
+    history.setSamplePeriod(SAMPLE_SECONDS*1000, 3*SAMPLE_SECONDS*1000);
+    SampleWindowID windows[WINDOW_COUNT];
+    for (size_t w = 0; w < WINDOW_COUNT; w++) {
+        windows[w] = history.registerWindow(WINDOW_SECONDS[w]*1000);
+    }
+    SampleDistribution distributions[WINDOW_COUNT];
+    std::vector<uint32_t> distribution_storage[WINDOW_COUNT];
+    for (size_t w = 1; track_spread && (w < WINDOW_COUNT); w++) {
+        size_t capacity = history.windowEntryCapacity(windows[w]);
+        distribution_storage[w].resize(SampleDistribution::storageBytes(capacity)/sizeof(uint32_t) + 1);
+        distributions[w].setStorage(distribution_storage[w].data(), capacity);
+        history.trackDistribution(windows[w], distributions[w]);
+    }
+    // fill the history so every window is at steady state
+    uint32_t time = 0;
+    for (size_t i = 0; i < history_size; i++) {
+        time += SAMPLE_SECONDS*1000;
+        history.push(rand()%500, time);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "SampleHistory/%s/%zu", track_spread ? "incrementalSpread" : "incremental", history_size);
+    size_t i = 0;
+    runBenchmark(name, iterations, [&]() {
+        time += SAMPLE_SECONDS*1000;
+        history.push(i++%500, time);
+        for (size_t w = 0; w < WINDOW_COUNT; w++) {
+            float avg = history.windowAverage(windows[w]);
+            benchmarkKeep(avg);
+            if (track_spread && (w > 0)) {
+                benchmarkKeep(history.windowSpread(windows[w]).p95);
+            }
+        }
+    });
+}
+
+static void benchRescan(size_t history_size, size_t iterations)
+{
+    std::vector<uint16_t> storage(history_size);
+    for (size_t i = 0; i < history_size; i++) {
+        storage[i] = rand()%500;
+    }
+    size_t newest_idx = history_size - 1;
+
+    char name[64];
+    snprintf(name, sizeof(name), "SampleHistory/rescan/%zu", history_size);
+    size_t i = 0;
+    runBenchmark(name, iterations, [&]() {
+        newest_idx = (newest_idx + 1)%history_size;
+        storage[newest_idx] = i++%500;
+        for (size_t w = 0; w < WINDOW_COUNT; w++) {
+            float avg = rescanAverage(storage, history_size, newest_idx, WINDOW_SECONDS[w]/SAMPLE_SECONDS);
+            benchmarkKeep(avg);
+        }
+    });
+}
+
+static void benchTiered(size_t iterations)
+{
+    // the RAM configuration used by AirQualitySensor: 1 hour of samples and 1 min/10 min/1 hour rollups
+    const SampleHistoryTier tiers[] = {
+        {60/SAMPLE_SECONDS, 24*60},
+        {600/SAMPLE_SECONDS, 7*24*6},
+        {3600/SAMPLE_SECONDS, 30*24},
+    };
+    const size_t sample_capacity = 3600/SAMPLE_SECONDS;
+    std::vector<uint32_t> storage(SampleHistory::storageBytes(sample_capacity, tiers, 3)/sizeof(uint32_t) + 1);
+    SampleHistory history;
+    history.setStorage(storage.data(), sample_capacity, tiers, 3);
+    history.setSamplePeriod(SAMPLE_SECONDS*1000, 3*SAMPLE_SECONDS*1000);
+    SampleWindowID windows[WINDOW_COUNT];
+    for (size_t w = 0; w < WINDOW_COUNT; w++) {
+        windows[w] = history.registerWindow(WINDOW_SECONDS[w]*1000);
+    }
+    uint32_t time = 0;
+    for (size_t i = 0; i < 86400/SAMPLE_SECONDS; i++) {
+        time += SAMPLE_SECONDS*1000;
+        history.push(rand()%500, time);
+    }
+
+    size_t i = 0;
+    runBenchmark("SampleHistory/tiered", iterations, [&]() {
+        time += SAMPLE_SECONDS*1000;
+        history.push(i++%500, time);
+        for (size_t w = 0; w < WINDOW_COUNT; w++) {
+            float avg = history.windowAverage(windows[w]);
+            benchmarkKeep(avg);
+        }
+    });
+}
+
+static void benchArchiveRestore(size_t iterations)
+{
+    const SampleHistoryTier tiers[] = {
+        {60/SAMPLE_SECONDS, 24*60},
+    };
+    const size_t sample_capacity = 3600/SAMPLE_SECONDS;
+    const uint32_t now = 1600000000;
+    std::vector<uint32_t> storage(SampleHistory::storageBytes(sample_capacity, tiers, 1)/sizeof(uint32_t) + 1);
+    fs::HostFS fs("/tmp/diyaqi_bench_fs");
+
+    // archive a day of rollups
+    {
+        SampleHistory history;
+        history.setStorage(storage.data(), sample_capacity, tiers, 1);
+        history.setSamplePeriod(SAMPLE_SECONDS*1000, 3*SAMPLE_SECONDS*1000);
+        SampleHistoryArchive archive;
+        archive.begin(fs, "/ha", history, SAMPLE_SECONDS, 5, 384);
+        for (size_t i = 0; i < 86400/SAMPLE_SECONDS; i++) {
+            history.push(rand()%500, (i + 1)*SAMPLE_SECONDS*1000);
+            if (i%(60/SAMPLE_SECONDS) == 0) {
+                archive.poll(now - 86400 + i*SAMPLE_SECONDS);
+            }
+        }
+        archive.poll(now);
+        archive.flush();
+    }
+
+    runBenchmark("SampleHistory/archiveRestoreDay", iterations, [&]() {
+        SampleHistory history;
+        history.setStorage(storage.data(), sample_capacity, tiers, 1);
+        history.setSamplePeriod(SAMPLE_SECONDS*1000, 3*SAMPLE_SECONDS*1000);
+        SampleWindowID window = history.registerWindow(86400*1000UL);
+        SampleHistoryArchive archive;
+        archive.begin(fs, "/ha", history, SAMPLE_SECONDS, 5, 384);
+        size_t restored = archive.restore(now, 86400);
+        benchmarkKeep(restored + history.windowAverage(window));
+    });
+}
+
+void benchSampleHistory(void)
+{
+    const size_t history_sizes[] = {300, 1800, 43200, 1048576};
+
+    for (size_t i = 0; i < sizeof(history_sizes)/sizeof(history_sizes[0]); i++) {
+        benchIncremental(history_sizes[i], 200000, false);
+        benchRescan(history_sizes[i], 2000);
+    }
+    benchIncremental(43200, 200000, true);
+    benchTiered(200000);
+    benchArchiveRestore(200);
+}
@@ -0,0 +1,64 @@
+//
+// Cost of building and serializing the telemetry JSON payload, with ArduinoJson and with the
+// fixed layout writer that replaced it.
+//
+#include <string.h>
+#include <Telemetry.h>
+#include <TelemetryBatch.h>
+#include "Benchmark.h"
+
+void benchTelemetry(void)
+{
+    TelemetryRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp = 1600000000;
+    record.uptime = 86400;
+    record.pm1p0 = 7;
+    record.pm2p5 = 12;
+    record.pm10 = 15;
+    record.particleCount0p5um = 320;
+    record.particleCount1p0um = 80;
+    record.averagePM2p5Current = 12.0;
+    record.averagePM2p5TenMinute = 11.4;
+    record.averagePM2p5OneHour = 10.9;
+    record.averagePM2p5OneDay = 9.2;
+    record.aqiCurrent = 50.0;
+    record.aqiTenMinute = 47.5;
+    record.aqiOneHour = 45.4;
+    record.aqiOneDay = 38.3;
+    record.temperature = 21.5;
+    record.pressure = 1013.2;
+    record.humidity = 45.0;
+    record.gasResistance = 120000;
+
+    char payload[1024];
+
+    runBenchmark("Telemetry/buildTelemetryJSON", 200000, [&]() {
+        DynamicJsonDocument doc(TELEMETRY_JSON_CAPACITY);
+        buildTelemetryJSON(record, "benchmark", doc);
+        benchmarkKeep(doc);
+    });
+
+    runBenchmark("Telemetry/buildAndSerialize", 200000, [&]() {
+        DynamicJsonDocument doc(TELEMETRY_JSON_CAPACITY);
+        buildTelemetryJSON(record, "benchmark", doc);
+        size_t length = serializeJson(doc, payload, sizeof(payload));
+        benchmarkKeep(length);
+    });
+
+    runBenchmark("Telemetry/writeTelemetryJSON", 200000, [&]() {
+        size_t length = writeTelemetryJSON(record, "benchmark", payload, sizeof(payload));
+        benchmarkKeep(length);
+    });
+
+    const size_t BATCH_SIZE = 30;
+    TelemetryBatch batch(BATCH_SIZE, 60, 1, strlen("benchmark"));
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+        record.timestamp++;
+        batch.offer(record);
+    }
+    runBenchmark("Telemetry/serializeBatch/30", 10000, [&]() {
+        size_t length = batch.serialize("benchmark");
+        benchmarkKeep(length);
+    });
+}
@@ -0,0 +1,45 @@
+//
+// Cost of the scanning average over a Vector, the way the PM2.5 averages were computed before
+// SampleHistory, and of the time formatting used on the stats page.
+//
+#include <stdlib.h>
+#include <vector>
+#include <Utilities.h>
+#include "Benchmark.h"
+
+void benchUtilities(void)
+{
+    // 24 hours of samples at the 2 second default refresh
+    const size_t HISTORY_SIZE = 43200;
+    std::vector<uint16_t> storage(HISTORY_SIZE);
+    for (size_t i = 0; i < HISTORY_SIZE; i++) {
+        storage[i] = rand()%500;
+    }
+    Vector<uint16_t> data;
+    data.setStorage(storage.data(), HISTORY_SIZE, HISTORY_SIZE);
+    size_t start_idx = 0;
+
+    runBenchmark("Utilities/calculatePartialOrderedAverage/10min", 200000, [&]() {
+        float avg = calculatePartialOrderedAverage(data, start_idx, 300);
+        benchmarkKeep(avg);
+        start_idx = (start_idx + 1)%HISTORY_SIZE;
+    });
+
+    runBenchmark("Utilities/calculatePartialOrderedAverage/1hour", 50000, [&]() {
+        float avg = calculatePartialOrderedAverage(data, start_idx, 1800);
+        benchmarkKeep(avg);
+        start_idx = (start_idx + 1)%HISTORY_SIZE;
+    });
+
+    runBenchmark("Utilities/calculatePartialOrderedAverage/24hour", 2000, [&]() {
+        float avg = calculatePartialOrderedAverage(data, start_idx, HISTORY_SIZE);
+        benchmarkKeep(avg);
+        start_idx = (start_idx + 1)%HISTORY_SIZE;
+    });
+
+    time_t epoch = 1600000000;
+    runBenchmark("Utilities/convertEpochToString", 200000, [&]() {
+        String str = convertEpochToString(epoch++);
+        benchmarkKeep(str);
+    });
+}
@@ -4,49 +4,155 @@
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <AirQualitySensor.h>
+#include <PageRenderer.h>
+#include <PageTemplate.h>
+#include <SampleHistoryStream.h>
+#include <SampleHistoryArchive.h>
+#include <ColumnarHistory.h>
+#include <StageTimer.h>
+#include <StaticAssetIndex.h>
+#include <StaticAssetHandler.h>
+#include <Telemetry.h>
+#include <TelemetryBatch.h>
+#include <TelemetryStore.h>
+#include <TelemetryUplink.h>
+#include <AsyncTelemetryClient.h>
 #include <Adafruit_BME680.h>
+#include <EnvironmentSensor.h>
+#include <BME680Device.h>
+#include <DutyCycleScheduler.h>
+#include <UARTCapture.h>
+#include <SPSCQueue.h>
 #include "Configuration.h"
 
 #if MCU_BOARD_TYPE == MCU_TINYPICO
 #include <TinyPICO.h>
 #endif
 
+// The channels of the compressed all-channel history, in column order. Values are stored as
+// integers: particulate matter in µg/m³, particle counts as is, the sensor status bits as
+// (particle detector << 4) | (laser << 2) | fan, temperature in 0.01 °C, humidity in 0.01 %,
+// pressure in 0.1 hPa and gas resistance in ohms.
+enum HistoryChannel : uint8_t {
+  HISTORY_CHANNEL_PM1P0,
+  HISTORY_CHANNEL_PM2P5,
+  HISTORY_CHANNEL_PM10,
+  HISTORY_CHANNEL_COUNT_0P5UM,
+  HISTORY_CHANNEL_COUNT_1P0UM,
+  HISTORY_CHANNEL_COUNT_2P5UM,
+  HISTORY_CHANNEL_COUNT_5P0UM,
+  HISTORY_CHANNEL_COUNT_7P5UM,
+  HISTORY_CHANNEL_COUNT_10UM,
+  HISTORY_CHANNEL_SENSOR_STATUS,
+  HISTORY_CHANNEL_TEMPERATURE,
+  HISTORY_CHANNEL_HUMIDITY,
+  HISTORY_CHANNEL_PRESSURE,
+  HISTORY_CHANNEL_GAS_RESISTANCE,
+
+  HISTORY_CHANNEL_COUNT
+};
 
 class Application {
 private:
     static Application* gApp;
 
-    time_t _boot_time;
-    time_t _last_update_time;
-    time_t _last_transmit_time;
+    // a connected live dashboard, and the updates it has been skipped for in a row
+    struct LiveClient {
+        uint32_t    id;
+        uint32_t    skipped;
+    };
+
+    // a live dashboard that connected or disconnected, passed from the web server's task
+    struct LiveClientEvent {
+        uint32_t    id;
+        bool        connected;
+    };
+
+    UARTParticulateSensorDriver<ParticulateProtocolForType<PARTICULATE_SENSOR_TYPE>::Type> _sensorDriver;
     AirQualitySensor _sensor;
+    UARTCapture _uartCapture;
+#if PARTICULATE_SENSOR2_TYPE != PARTICULATE_SENSOR_NONE
+    UARTParticulateSensorDriver<ParticulateProtocolForType<PARTICULATE_SENSOR2_TYPE>::Type> _sensor2Driver;
+    AirQualitySensor _sensor2;
+#endif
     Adafruit_BME680 _bme680;
+    BME680Device _bme680Device;
+    EnvironmentSensor _environment;
+    void* _environmentStorage;
     AsyncWebServer _server;
+    AsyncWebSocket _liveSocket;
+    // only used on the loop, which adopts the clients queued in _liveClientEvents
+    LiveClient _liveClients[LIVE_UPDATE_MAX_CLIENTS];
+    SPSCQueue<LiveClientEvent, LIVE_UPDATE_EVENT_QUEUE_SIZE> _liveClientEvents;
+    StaticAssetIndex _staticAssets;
+    StaticAssetHandler _staticAssetHandler;
 #if MCU_BOARD_TYPE == MCU_TINYPICO
     TinyPICO _tinyPICO;
 #endif
-    uint32_t _loopCounter;
-    uint32_t _rootPageViewCount;
+    DeviceStatus _status;
+    PageRenderer _pageRenderer;
+    TemplateValueFormatter _templateFormatter;
+    PageTemplate _rootTemplate;
+    PageTemplate _rootBME680Template;
+    PageTemplate _statsTemplate;
+    TelemetryBatch _telemetryBatch;
+    TelemetryStore _telemetryStore;
+    AsyncTelemetryClient _telemetryClient;
+    TelemetryUplink _telemetryUplink;
+    SampleHistoryArchive _historyArchive;
+    ColumnarHistory _channelHistory;
+    void* _channelHistoryStorage;
+    // sums of the samples taken since the last channel history row, and how many there were
+    int64_t _channelSums[HISTORY_CHANNEL_COUNT];
+    uint32_t _channelSampleCounts[HISTORY_CHANNEL_COUNT];
+    uint32_t _channelLastRowTime;
+    // when the device sleeps and its radio is on, and where its energy goes
+    DutyCycleScheduler _dutyCycle;
+    bool _radioEnabled;
+    // latencies of the main loop stages that the Application times itself
+    LatencyHistogram _loopLatency[LOOP_STAGE_COUNT];
     bool _appSetup;
-    bool _hasBME680;
-    float _latestTemperature;
-    float _latestPressure;
-    float _latestHumidity;
+    bool _wifiConnected;
+    uint32_t _lastReconnectMillis;
 
     void printLocalTime(void);
     void setupWebserver(void);
+    void stepBoot(void);
+    void restoreHistory(void);
+    void recordResponse(void);
+    void maintainWiFi(void);
+    void updateRadio(void);
+    void idle(void);
+    AirQualitySensor* particulateSensor(long index);
     
     void setupLED(void);
     void setLEDColorForAQI(float aqi_value);
+    void fillTelemetryRecord(time_t timestamp, TelemetryRecord& record);
+    void setupChannelHistory(void);
+    void setupEnvironmentHistory(void);
+    void updateEnvironment(void);
+    void recordChannelHistory(time_t timestamp);
+    bool postTelemetry(const char* payload, size_t length, uint8_t kind);
+    int postTelemetrySynchronously(const char* payload, size_t length);
+    void handleTelemetryResult(uint8_t kind, const TelemetryResult& result);
+    void updateTelemetryStatus(void);
+    void updateMemoryStatus(void);
+    void updatePowerStatus(void);
 
     // web handlers
-    float getAQIForHTMLTagTimeFragment(const String& fragment);
-    String getContentType(String filename);
-    String processRootPageHTML(const String& var);
-    String processStatsPageHTML(const String& var);
     bool showEnvironmentRootPage(void) const;
+    void sendTemplatePage(AsyncWebServerRequest *request, PageTemplate& page, const String& path);
     void handleRootPageRequest(AsyncWebServerRequest *request);
     void handleStatsPageRequest(AsyncWebServerRequest *request);
+    void handleCurrentAPIRequest(AsyncWebServerRequest *request);
+    void handleHistoryAPIRequest(AsyncWebServerRequest *request);
+    void handleMetricsRequest(AsyncWebServerRequest *request);
+    void handleCaptureRequest(AsyncWebServerRequest *request);
+    void handleCaptureStartRequest(AsyncWebServerRequest *request);
+    void handleCaptureStopRequest(AsyncWebServerRequest *request);
+    void handleLiveSocketEvent(AsyncWebSocket *socket, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t length);
+    void handleLiveClientEvents(void);
+    void broadcastLiveUpdate(void);
     void handleUnassignedPath(AsyncWebServerRequest *request);
 public:
     static Application* getInstance(void);
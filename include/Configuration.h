@@ -31,14 +31,238 @@
 #define AIR_QUALITY_SENSOR_UPDATE_SECONDS   2
 #endif
 
+// Defines the ESP32 core that the particulate sensor acquisition task is pinned to. The Arduino
+// loop() runs on core 1, so by default acquisition runs on core 0 where it is not held up by web
+// requests or telemetry transmissions.
+#ifndef SENSOR_ACQUISITION_CORE
+#define SENSOR_ACQUISITION_CORE   0
+#endif
+
+// Selects the particulate sensor on Serial1, and the ESP32 pins of its UART. The type is one of
+// PARTICULATE_SENSOR_SNGCJA5, PARTICULATE_SENSOR_PMS5003 or PARTICULATE_SENSOR_SPS30. The
+// SN-GCJA5 and PMS5003 only need the RX pin, but the SPS30 also needs TX to be asked for readings.
+// This sensor is the one shown on the pages, sent as telemetry and archived.
+#ifndef PARTICULATE_SENSOR_TYPE
+#define PARTICULATE_SENSOR_TYPE     PARTICULATE_SENSOR_SNGCJA5
+#endif
+
+#ifndef PARTICULATE_SENSOR_RX_PIN
+#define PARTICULATE_SENSOR_RX_PIN   33
+#endif
+
+#ifndef PARTICULATE_SENSOR_TX_PIN
+#define PARTICULATE_SENSOR_TX_PIN   32
+#endif
+
+// Selects a second particulate sensor on Serial2, or PARTICULATE_SENSOR_NONE. It is sampled every
+// AIR_QUALITY_SENSOR_UPDATE_SECONDS into its own PM2.5 history, which needs as much memory as the
+// first sensor's, and /api/history returns that history when given sensor=1.
+#ifndef PARTICULATE_SENSOR2_TYPE
+#define PARTICULATE_SENSOR2_TYPE    PARTICULATE_SENSOR_NONE
+#endif
+
+#ifndef PARTICULATE_SENSOR2_RX_PIN
+#define PARTICULATE_SENSOR2_RX_PIN  26
+#endif
+
+#ifndef PARTICULATE_SENSOR2_TX_PIN
+#define PARTICULATE_SENSOR2_TX_PIN  25
+#endif
+
 // Defines the number of AIR_QUALITY_SENSOR_UPDATE_SECONDS cycle that must occur between
 // each data transmission to the TELEMETRY_URL. Has no net effect if TELEMETRY_URL is
-// a nullptr. When transmitting data, only the measurement from the current cycle is
-// transmitted. Must be an integer.
+// a nullptr. This sets the defaults for the telemetry batch settings below. Must be an integer.
 #ifndef AIR_QUALITY_DATA_TRANSMIT_MULTIPLE
 #define AIR_QUALITY_DATA_TRANSMIT_MULTIPLE   30
 #endif
 
+// Measurements are collected into batches that are POSTed to the TELEMETRY_URL as a single
+// JSON array. A batch is sent once it holds TELEMETRY_BATCH_SIZE measurements or its oldest
+// measurement is TELEMETRY_BATCH_MAX_AGE_SECONDS old, whichever comes first. Only every
+// TELEMETRY_SAMPLE_INTERVAL-th measurement is added to the batch, so 1 sends every measurement.
+// Each batched measurement uses about 1 KB of RAM (or PSRAM, if the board has it).
+#ifndef TELEMETRY_BATCH_SIZE
+#define TELEMETRY_BATCH_SIZE    AIR_QUALITY_DATA_TRANSMIT_MULTIPLE
+#endif
+
+#ifndef TELEMETRY_BATCH_MAX_AGE_SECONDS
+#define TELEMETRY_BATCH_MAX_AGE_SECONDS     (AIR_QUALITY_SENSOR_UPDATE_SECONDS*AIR_QUALITY_DATA_TRANSMIT_MULTIPLE)
+#endif
+
+#ifndef TELEMETRY_SAMPLE_INTERVAL
+#define TELEMETRY_SAMPLE_INTERVAL   1
+#endif
+
+// Set to 1 to echo each telemetry payload to Serial as it is sent, for debugging.
+#ifndef TELEMETRY_ECHO_PAYLOAD
+#define TELEMETRY_ECHO_PAYLOAD  0
+#endif
+
+// Measurements that can not be sent, such as during a WiFi outage, are queued on the device
+// and sent once the connection is back. The queue holds TELEMETRY_STORE_CAPACITY_PSRAM
+// measurements on boards with PSRAM and TELEMETRY_STORE_CAPACITY_RAM on boards without. Each
+// queued measurement uses 88 bytes.
+#ifndef TELEMETRY_STORE_CAPACITY_PSRAM
+#define TELEMETRY_STORE_CAPACITY_PSRAM  20000
+#endif
+
+#ifndef TELEMETRY_STORE_CAPACITY_RAM
+#define TELEMETRY_STORE_CAPACITY_RAM    500
+#endif
+
+// When TELEMETRY_STORE_SPILL_SEGMENTS is greater than 0, measurements that overflow the queue
+// are moved to SPIFFS in up to that many files of TELEMETRY_STORE_SPILL_SEGMENT_RECORDS
+// measurements each, rather than being dropped. Queued measurements on SPIFFS survive a
+// restart. Make sure the SPIFFS partition has room for them. At most 32 segments.
+#ifndef TELEMETRY_STORE_SPILL_SEGMENTS
+#define TELEMETRY_STORE_SPILL_SEGMENTS  0
+#endif
+
+#ifndef TELEMETRY_STORE_SPILL_SEGMENT_RECORDS
+#define TELEMETRY_STORE_SPILL_SEGMENT_RECORDS   500
+#endif
+
+// Queued measurements are sent in batches of TELEMETRY_DRAIN_BATCH_SIZE, one batch at a time
+// and at most one every TELEMETRY_DRAIN_INTERVAL_MILLIS, and never ahead of new measurements.
+// When a batch fails the interval doubles, up to TELEMETRY_DRAIN_MAX_BACKOFF_MILLIS.
+#ifndef TELEMETRY_DRAIN_BATCH_SIZE
+#define TELEMETRY_DRAIN_BATCH_SIZE  TELEMETRY_BATCH_SIZE
+#endif
+
+#ifndef TELEMETRY_DRAIN_INTERVAL_MILLIS
+#define TELEMETRY_DRAIN_INTERVAL_MILLIS     1000
+#endif
+
+#ifndef TELEMETRY_DRAIN_MAX_BACKOFF_MILLIS
+#define TELEMETRY_DRAIN_MAX_BACKOFF_MILLIS  300000
+#endif
+
+// How often to ask the WiFi to reconnect while it is disconnected.
+#ifndef WIFI_RECONNECT_INTERVAL_MILLIS
+#define WIFI_RECONNECT_INTERVAL_MILLIS  30000
+#endif
+
+// The most entries /api/history returns for a query. Longer spans are returned from a coarser
+// level of the history. Queries may ask for fewer with the max parameter.
+#ifndef API_HISTORY_MAX_ENTRIES
+#define API_HISTORY_MAX_ENTRIES     1440
+#endif
+
+// The /metrics response is written into a buffer of this size, which grows if it is not enough.
+// A scrape with every stage latency histogram is about 18 KB.
+#ifndef METRICS_RESPONSE_BUFFER_BYTES
+#define METRICS_RESPONSE_BUFFER_BYTES   20480
+#endif
+
+// Besides the PM2.5 history, every channel of both sensors is kept in a compressed history, one
+// row per CHANNEL_HISTORY_INTERVAL_SECONDS holding the mean of the samples taken in that time.
+// The history is given CHANNEL_HISTORY_BYTES_PSRAM of PSRAM, or CHANNEL_HISTORY_BYTES_RAM of RAM
+// on boards without PSRAM, and keeps as many of the newest rows as fit.
+#ifndef CHANNEL_HISTORY_INTERVAL_SECONDS
+#define CHANNEL_HISTORY_INTERVAL_SECONDS    30
+#endif
+
+#ifndef CHANNEL_HISTORY_BYTES_PSRAM
+#define CHANNEL_HISTORY_BYTES_PSRAM     (256*1024)
+#endif
+
+#ifndef CHANNEL_HISTORY_BYTES_RAM
+#define CHANNEL_HISTORY_BYTES_RAM       (16*1024)
+#endif
+
+// The 1 minute rollups of the PM2.5 history are saved to SPIFFS in up to HISTORY_ARCHIVE_SEGMENTS
+// files of HISTORY_ARCHIVE_SEGMENT_RECORDS rollups each, and the last
+// HISTORY_ARCHIVE_RESTORE_SECONDS of them are restored at boot so that the 24 hour average is
+// valid right away. Each rollup uses 16 bytes of flash. New rollups are collected every
+// HISTORY_ARCHIVE_POLL_SECONDS and written 16 at a time by a low priority task on core
+// HISTORY_ARCHIVE_CORE, so HISTORY_ARCHIVE_SEGMENT_RECORDS should be a multiple of 16. The
+// oldest segment is removed to make room for a new one, so all but one of the segments together
+// must hold HISTORY_ARCHIVE_RESTORE_SECONDS of rollups. Set HISTORY_ARCHIVE_SEGMENTS to 0 to disable. At most 16 segments.
+#ifndef HISTORY_ARCHIVE_SEGMENTS
+#define HISTORY_ARCHIVE_SEGMENTS        5
+#endif
+
+#ifndef HISTORY_ARCHIVE_SEGMENT_RECORDS
+#define HISTORY_ARCHIVE_SEGMENT_RECORDS 384
+#endif
+
+#ifndef HISTORY_ARCHIVE_RESTORE_SECONDS
+#define HISTORY_ARCHIVE_RESTORE_SECONDS (24*60*60)
+#endif
+
+// The restore waits for the time from NTP, as the archived rollups can only be placed relative
+// to it. Once the sensor has warmed up it waits at most until HISTORY_ARCHIVE_TIME_WAIT_SECONDS
+// after boot, and then starts without the restored history. Samples taken meanwhile wait in the
+// sensor's sample queue, which holds 16 samples, and any beyond those are dropped.
+#ifndef HISTORY_ARCHIVE_TIME_WAIT_SECONDS
+#define HISTORY_ARCHIVE_TIME_WAIT_SECONDS   60
+#endif
+
+#ifndef HISTORY_ARCHIVE_POLL_SECONDS
+#define HISTORY_ARCHIVE_POLL_SECONDS    10
+#endif
+
+#ifndef HISTORY_ARCHIVE_CORE
+#define HISTORY_ARCHIVE_CORE            0
+#endif
+
+// The static files in SPIFFS (everything but the page templates) are indexed at boot. Files of
+// up to STATIC_ASSET_CACHE_MAX_FILE_BYTES are then served from memory, up to a total of
+// STATIC_ASSET_CACHE_BYTES, which is in PSRAM on boards that have it. Browsers may reuse a
+// file for STATIC_ASSET_MAX_AGE_SECONDS before checking that it is still current.
+#ifndef STATIC_ASSET_CACHE_BYTES
+#if defined(BOARD_HAS_PSRAM)
+#define STATIC_ASSET_CACHE_BYTES    65536
+#else
+#define STATIC_ASSET_CACHE_BYTES    8192
+#endif
+#endif
+
+#ifndef STATIC_ASSET_CACHE_MAX_FILE_BYTES
+#define STATIC_ASSET_CACHE_MAX_FILE_BYTES   16384
+#endif
+
+#ifndef STATIC_ASSET_MAX_AGE_SECONDS
+#define STATIC_ASSET_MAX_AGE_SECONDS    600
+#endif
+
+// Live dashboards connect to the /live WebSocket, which pushes the readings after each sample.
+// At most LIVE_UPDATE_MAX_CLIENTS may be connected at once.
+// A client that has LIVE_UPDATE_MAX_QUEUED updates waiting to be sent is skipped, since each
+// update supersedes the last, and a client that is skipped LIVE_UPDATE_MAX_SKIPPED times in a
+// row is disconnected.
+#ifndef LIVE_UPDATE_MAX_CLIENTS
+#define LIVE_UPDATE_MAX_CLIENTS     8
+#endif
+
+#ifndef LIVE_UPDATE_MAX_QUEUED
+#define LIVE_UPDATE_MAX_QUEUED      2
+#endif
+
+#ifndef LIVE_UPDATE_MAX_SKIPPED
+#define LIVE_UPDATE_MAX_SKIPPED     30
+#endif
+
+// number of live dashboard connects and disconnects that can be waiting for the loop. Must be a
+// power of two.
+#ifndef LIVE_UPDATE_EVENT_QUEUE_SIZE
+#define LIVE_UPDATE_EVENT_QUEUE_SIZE    16
+#endif
+
+// Logs are queued and printed to Serial by a low priority task on core LOG_TASK_CORE, which
+// wakes every LOG_TASK_POLL_MILLIS, so that the 9600 baud Serial port does not hold up the
+// tasks that log. If more than LOG_QUEUE_RECORDS logs (set in lib/Logger) are waiting, the
+// newest are dropped and the number dropped is printed. Logs above LOG_LEVEL, which defaults to
+// LOG_LEVEL_INFO, are compiled out. Add -DLOG_LEVEL=LOG_LEVEL_DEBUG to the build_flags to also
+// print each sample.
+#ifndef LOG_TASK_CORE
+#define LOG_TASK_CORE           0
+#endif
+
+#ifndef LOG_TASK_POLL_MILLIS
+#define LOG_TASK_POLL_MILLIS    50
+#endif
+
 // Sets the brightness level of the on-board RGB LED. Should be a integer between 0 (off) and
 // 255 (full brightness). Hex values are fine.
 #ifndef STATUS_LED_BRIGHTNESS
@@ -52,6 +276,87 @@
 #define BME680_SENSOR_I2C_ADDRESS   0x77
 #endif
 
+// How often the BME680 is read, independent of AIR_QUALITY_SENSOR_UPDATE_SECONDS. Each reading runs the gas heater
+// at 320 °C for 150 ms, so reading it much more often than every few seconds warms the sensor and skews the
+// temperature. The readings are kept in a history of their own with 10 minute and 1 hour averages.
+#ifndef ENVIRONMENT_SAMPLE_SECONDS
+#define ENVIRONMENT_SAMPLE_SECONDS  10
+#endif
+
+// How long a BME680 reading may take before it is counted as failed. A reading normally takes about 200 ms.
+#ifndef ENVIRONMENT_READING_TIMEOUT_MILLIS
+#define ENVIRONMENT_READING_TIMEOUT_MILLIS  1000
+#endif
+
+// Selects the power profile. POWER_PROFILE_ALWAYS_ON keeps the CPU, the WiFi radio and the status LED on all the time,
+// which suits mains powered units. POWER_PROFILE_LOW_POWER is for battery and solar units: the CPU light sleeps between
+// samples, the status LED is off, and WiFi is only turned on every POWER_RADIO_INTERVAL_SECONDS, in modem sleep, to
+// send the telemetry queued since. The web pages can only be reached while the radio is on. The UART does not receive
+// while the CPU sleeps, so the CPU wakes POWER_SAMPLE_WAKE_LEAD_MILLIS before each sample for the sensor to send a
+// frame. Sleeping only pays off with a sample period well over that, so set AIR_QUALITY_SENSOR_UPDATE_SECONDS to 30 or
+// more with this profile.
+#ifndef POWER_PROFILE
+#define POWER_PROFILE   POWER_PROFILE_ALWAYS_ON
+#endif
+
+// How often the radio is turned on in the low power profile, and the longest it stays on each time. It is turned off
+// sooner once the queued telemetry has been sent.
+#ifndef POWER_RADIO_INTERVAL_SECONDS
+#define POWER_RADIO_INTERVAL_SECONDS    TELEMETRY_BATCH_MAX_AGE_SECONDS
+#endif
+
+#ifndef POWER_RADIO_WINDOW_SECONDS
+#define POWER_RADIO_WINDOW_SECONDS  30
+#endif
+
+#ifndef POWER_SAMPLE_WAKE_LEAD_MILLIS
+#define POWER_SAMPLE_WAKE_LEAD_MILLIS   1500
+#endif
+
+// The shortest light sleep worth waking up from.
+#ifndef POWER_MIN_SLEEP_MILLIS
+#define POWER_MIN_SLEEP_MILLIS  50
+#endif
+
+// The average current the device draws, for the duty cycle and energy per sample estimates on the stats page. The base
+// current is drawn all the time, mostly by the particulate sensor's fan and laser. The others are added while the CPU
+// is awake, while it light sleeps, and while the WiFi radio is on in modem sleep.
+#ifndef POWER_BASE_MILLIAMPS
+#define POWER_BASE_MILLIAMPS    70.0
+#endif
+
+#ifndef POWER_ACTIVE_MILLIAMPS
+#define POWER_ACTIVE_MILLIAMPS  40.0
+#endif
+
+#ifndef POWER_SLEEP_MILLIAMPS
+#define POWER_SLEEP_MILLIAMPS   0.8
+#endif
+
+#ifndef POWER_RADIO_MILLIAMPS
+#define POWER_RADIO_MILLIAMPS   30.0
+#endif
+
+#ifndef POWER_SUPPLY_VOLTS
+#define POWER_SUPPLY_VOLTS      3.3
+#endif
+
+// The raw byte stream of the first particulate sensor can be captured to UART_CAPTURE_PATH on SPIFFS, by POSTing to
+// /capture/start?seconds=N, and downloaded from /capture once it has finished. A capture stops after N seconds, which
+// defaults to UART_CAPTURE_DEFAULT_SECONDS, or once the file reaches UART_CAPTURE_MAX_BYTES. An SN-GCJA5 sends about
+// 40 bytes a second including the capture's overhead, so the default size holds nearly an hour.
+#ifndef UART_CAPTURE_PATH
+#define UART_CAPTURE_PATH           "/uart.ucap"
+#endif
+
+#ifndef UART_CAPTURE_MAX_BYTES
+#define UART_CAPTURE_MAX_BYTES      (128*1024)
+#endif
+
+#ifndef UART_CAPTURE_DEFAULT_SECONDS
+#define UART_CAPTURE_DEFAULT_SECONDS    600
+#endif
+
 // Selects which ESP32 microcontroller is being used. Note that for boards that do not have PSRAM, it is recommended to
 // set the AIR_QUALITY_SENSOR_UPDATE_SECONDS value to at least 5.
 #define MCU_TINYPICO 1
@@ -0,0 +1,123 @@
+#ifndef __AQIScale__
+#define __AQIScale__
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// Air quality index scales as compile time breakpoint tables.
+//
+// A scale maps a pollutant concentration to an index by linear interpolation between its
+// breakpoints, each of which is the concentration at the top of a category and the index at
+// the top of that category. Concentrations beyond the last breakpoint are extrapolated from
+// the last segment. A scale's categories are numbered from 0 (the best) and map onto the
+// AQIStatusColor values in order.
+//
+// The PM2.5 and PM10 scales used by AirQualitySensor are chosen at compile time with the
+// AQI_PM2P5_SCALE and AQI_PM10_SCALE build flags.
+//
+
+#define AQI_SCALE_EPA_2012          1   // US EPA PM2.5, 2012 revision
+#define AQI_SCALE_EPA_2024          2   // US EPA PM2.5, 2024 revision
+#define AQI_SCALE_EPA_PM10          3   // US EPA PM10
+#define AQI_SCALE_INDIA_NAQI_PM2P5  4   // India National AQI, PM2.5
+#define AQI_SCALE_INDIA_NAQI_PM10   5   // India National AQI, PM10
+
+#ifndef AQI_PM2P5_SCALE
+#define AQI_PM2P5_SCALE     AQI_SCALE_EPA_2012
+#endif
+
+#ifndef AQI_PM10_SCALE
+#define AQI_PM10_SCALE      AQI_SCALE_EPA_PM10
+#endif
+
+struct AQIBreakpoint {
+    float   concentration;
+    float   index;
+};
+
+struct AQIScale {
+    const AQIBreakpoint*    breakpoints;    // starting with {0, 0}
+    uint8_t                 breakpointCount;
+    const float*            categoryLimits; // highest index of each category but the last
+    uint8_t                 categoryCount;
+};
+
+//
+// Breakpoint tables. Concentrations are in µg/m³.
+//
+// https://www.epa.gov/sites/production/files/2016-04/documents/2012_aqi_factsheet.pdf
+constexpr AQIBreakpoint AQI_BREAKPOINTS_EPA_2012[] = {
+    {0, 0}, {12.0, 50}, {35.4, 100}, {55.4, 150}, {150.4, 200}, {250.4, 300}, {350.4, 400}, {500.0, 500}
+};
+
+// https://www.epa.gov/system/files/documents/2024-02/pm-naaqs-air-quality-index-fact-sheet.pdf
+constexpr AQIBreakpoint AQI_BREAKPOINTS_EPA_2024[] = {
+    {0, 0}, {9.0, 50}, {35.4, 100}, {55.4, 150}, {125.4, 200}, {225.4, 300}, {325.4, 500}
+};
+
+constexpr AQIBreakpoint AQI_BREAKPOINTS_EPA_PM10[] = {
+    {0, 0}, {54, 50}, {154, 100}, {254, 150}, {354, 200}, {424, 300}, {504, 400}, {604, 500}
+};
+
+// https://cpcb.nic.in/National-Air-Quality-Index/
+constexpr AQIBreakpoint AQI_BREAKPOINTS_INDIA_NAQI_PM2P5[] = {
+    {0, 0}, {30, 50}, {60, 100}, {90, 200}, {120, 300}, {250, 400}, {380, 500}
+};
+
+constexpr AQIBreakpoint AQI_BREAKPOINTS_INDIA_NAQI_PM10[] = {
+    {0, 0}, {50, 50}, {100, 100}, {250, 200}, {350, 300}, {430, 400}, {510, 500}
+};
+
+// Good, Moderate, Unhealthy for Sensitive Groups, Unhealthy, Very Unhealthy, Hazardous
+constexpr float AQI_CATEGORIES_EPA[] = {50, 100, 150, 200, 300};
+
+// Good, Satisfactory, Moderate, Poor, Very Poor, Severe
+constexpr float AQI_CATEGORIES_INDIA_NAQI[] = {50, 100, 200, 300, 400};
+
+#define AQI_TABLE_SIZE(table)   (sizeof(table)/sizeof(table[0]))
+
+constexpr AQIScale AQI_SCALES[] = {
+    {nullptr, 0, nullptr, 0},
+    {AQI_BREAKPOINTS_EPA_2012, AQI_TABLE_SIZE(AQI_BREAKPOINTS_EPA_2012), AQI_CATEGORIES_EPA, AQI_TABLE_SIZE(AQI_CATEGORIES_EPA) + 1},
+    {AQI_BREAKPOINTS_EPA_2024, AQI_TABLE_SIZE(AQI_BREAKPOINTS_EPA_2024), AQI_CATEGORIES_EPA, AQI_TABLE_SIZE(AQI_CATEGORIES_EPA) + 1},
+    {AQI_BREAKPOINTS_EPA_PM10, AQI_TABLE_SIZE(AQI_BREAKPOINTS_EPA_PM10), AQI_CATEGORIES_EPA, AQI_TABLE_SIZE(AQI_CATEGORIES_EPA) + 1},
+    {AQI_BREAKPOINTS_INDIA_NAQI_PM2P5, AQI_TABLE_SIZE(AQI_BREAKPOINTS_INDIA_NAQI_PM2P5), AQI_CATEGORIES_INDIA_NAQI, AQI_TABLE_SIZE(AQI_CATEGORIES_INDIA_NAQI) + 1},
+    {AQI_BREAKPOINTS_INDIA_NAQI_PM10, AQI_TABLE_SIZE(AQI_BREAKPOINTS_INDIA_NAQI_PM10), AQI_CATEGORIES_INDIA_NAQI, AQI_TABLE_SIZE(AQI_CATEGORIES_INDIA_NAQI) + 1},
+};
+
+//
+// Evaluation. These are constexpr, so a scale can be checked with static_assert, and compile to
+// a short loop over the table.
+//
+constexpr float aqiInterpolate(const AQIBreakpoint& low, const AQIBreakpoint& high, float concentration)
+{
+    return low.index + (high.index - low.index)*(concentration - low.concentration)/(high.concentration - low.concentration);
+}
+
+constexpr float aqiFromBreakpoints(const AQIBreakpoint* breakpoints, size_t count, float concentration, size_t i = 1)
+{
+    return ((i + 1 >= count) || (concentration <= breakpoints[i].concentration))
+            ? aqiInterpolate(breakpoints[i - 1], breakpoints[i], concentration)
+            : aqiFromBreakpoints(breakpoints, count, concentration, i + 1);
+}
+
+// Returns the index for a concentration on the scale.
+constexpr float aqiFromConcentration(const AQIScale& scale, float concentration)
+{
+    return aqiFromBreakpoints(scale.breakpoints, scale.breakpointCount, concentration);
+}
+
+// Returns the category of an index on the scale, from 0 to categoryCount - 1.
+constexpr uint8_t aqiCategory(const AQIScale& scale, float index, uint8_t i = 0)
+{
+    return ((i + 1 >= scale.categoryCount) || (index <= scale.categoryLimits[i])) ? i : aqiCategory(scale, index, i + 1);
+}
+
+static constexpr const AQIScale& PM2P5_AQI_SCALE = AQI_SCALES[AQI_PM2P5_SCALE];
+static constexpr const AQIScale& PM10_AQI_SCALE = AQI_SCALES[AQI_PM10_SCALE];
+
+static_assert(aqiFromConcentration(AQI_SCALES[AQI_SCALE_EPA_2012], 12.0) == 50, "EPA 2012 scale");
+static_assert(aqiFromConcentration(AQI_SCALES[AQI_SCALE_EPA_2024], 35.4) == 100, "EPA 2024 scale");
+static_assert(aqiCategory(AQI_SCALES[AQI_SCALE_EPA_PM10], 301) == 5, "EPA categories");
+
+#endif // __AQIScale__
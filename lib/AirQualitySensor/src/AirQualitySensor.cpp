@@ -1,18 +1,36 @@
 #include <Utilities.h>
+#include <Logger.h>
+#include <StageTimer.h>
 #include "AirQualitySensor.h"
 
+// The acquisition task polls the sensor UART at this period. It must be well under the time the
+// 256 byte UART buffer takes to fill, which is 8 seconds of SN-GCJA5 or PMS5003 frames.
+#define AQM_ACQUISITION_POLL_MILLIS     100
+#define AQM_ACQUISITION_TASK_STACK      4096
+#define AQM_ACQUISITION_TASK_PRIORITY   5
+
 //
-// Sensor Type = Panasonic SN-GCJA5
-//   https://na.industrial.panasonic.com/products/sensors/air-quality-gas-flow-sensors/lineup/laser-type-pm-sensor/series/123557/model/123559
+// History retention. The most recent PM2.5 samples are kept at full resolution, and older
+// samples are retained as min/max/mean rollups at progressively coarser resolutions. Boards
+// without PSRAM use the much smaller RAM retention.
 //
+#define HISTORY_FULL_RESOLUTION_SECONDS_PSRAM   (2*60*60)
+#define HISTORY_FULL_RESOLUTION_SECONDS_RAM     (60*60)
 
-#define AQM_BUFFER_SIZE 32
-#define AQMSerial Serial1
-#ifdef SERIAL_BUFFER_SIZE
-#endif
+static const struct {
+    uint32_t resolution_seconds;
+    uint32_t retention_seconds_psram;
+    uint32_t retention_seconds_ram;
+} HISTORY_TIERS[] = {
+    { 60,       7*24*60*60,     24*60*60 },     // 1 minute rollups
+    { 10*60,    30*24*60*60,    7*24*60*60 },   // 10 minute rollups
+    { 60*60,    365*24*60*60,   30*24*60*60 },  // 1 hour rollups
+};
+#define HISTORY_TIER_COUNT (sizeof(HISTORY_TIERS)/sizeof(HISTORY_TIERS[0]))
 
-AirQualitySensor::AirQualitySensor(uint32_t sensor_refresh_seconds)
-    :   _sensor_refresh_seconds(sensor_refresh_seconds),
+AirQualitySensor::AirQualitySensor(ParticulateSensorDriver& driver, uint32_t sensor_refresh_seconds)
+    :   _driver(driver),
+        _sensor_refresh_seconds(sensor_refresh_seconds),
         _pm1p0(0),
         _pm2p5(0),
         _pm10(0),
@@ -23,178 +41,289 @@ AirQualitySensor::AirQualitySensor(uint32_t sensor_refresh_seconds)
         _particleCount7p5um(0),
         _particleCount10um(0),
         _sensorStatus(0),
-        _avgPM2p5_Current(0),
-        _avgPM2p5_10Min(0),
-        _avgPM2p5_1Hour(0),
-        _avgPM2p5_24Hour(0),
-        _vectorStorage(nullptr),
+        _nextSampleMillis(0),
+        _warmupEndMillis(0),
+        _missedSampleCount(0),
+        _receivedByteCount(0),
+        _readLatency(),
+        _decodeLatency(),
+        _acquisitionTask(nullptr),
+        _sampleQueue(),
+        _lastFrameMillis(0),
+        _queueLatency(),
+        _applyLatency(),
+        _windowCurrent(INVALID_SAMPLE_WINDOW),
+        _window10Min(INVALID_SAMPLE_WINDOW),
+        _window1Hour(INVALID_SAMPLE_WINDOW),
+        _window24Hour(INVALID_SAMPLE_WINDOW),
+        _historyStorage(nullptr),
+        _distributionStorage(nullptr),
         _pm2p5_history(),
-        _pm2p5_history_insertion_idx(0)
+        _pm2p5_nowcast()
 {
-    uint32_t sensor_history_size = 0;
+    // Determine the history layout. Full resolution samples are kept for the recent window and
+    // older data is retained as rollups. Tier bucket sizes are rounded down to a multiple of the
+    // prior tier's bucket size so that each bucket is made up of whole finer buckets.
+    bool use_psram = (ESP.getPsramSize() > 0);
+    size_t sample_capacity = (use_psram ? HISTORY_FULL_RESOLUTION_SECONDS_PSRAM : HISTORY_FULL_RESOLUTION_SECONDS_RAM)/_sensor_refresh_seconds;
+    SampleHistoryTier tiers[HISTORY_TIER_COUNT];
+    uint8_t tier_count = 0;
+    uint32_t prior_samples_per_bucket = 1;
+    for (uint8_t i = 0; i < HISTORY_TIER_COUNT; i++) {
+        uint32_t samples_per_bucket = HISTORY_TIERS[i].resolution_seconds/_sensor_refresh_seconds;
+        samples_per_bucket -= samples_per_bucket%prior_samples_per_bucket;
+        if (samples_per_bucket <= prior_samples_per_bucket) {
+            continue;
+        }
+        tiers[tier_count].samples_per_bucket = samples_per_bucket;
+        tiers[tier_count].capacity = (use_psram ? HISTORY_TIERS[i].retention_seconds_psram : HISTORY_TIERS[i].retention_seconds_ram)
+                                        /(samples_per_bucket*_sensor_refresh_seconds);
+        prior_samples_per_bucket = samples_per_bucket;
+        tier_count++;
+    }
+    size_t history_bytes = SampleHistory::storageBytes(sample_capacity, tiers, tier_count);
+
     // first attempt to allocate history storage in PSRAM (if attached)
-    if (ESP.getPsramSize() > 0) {
-        Serial.printf("PSRAM is install with a size of %d. Allocating history storage in PSRAM.\n", ESP.getPsramSize());
-        // use half of PSRAM to store measurement history
-        sensor_history_size = ESP.getMaxAllocPsram()/2/sizeof(uint16_t);
-        _vectorStorage = (uint16_t*)ps_malloc(sensor_history_size*sizeof(uint16_t));
-        if (_vectorStorage) {
-            Serial.printf(
-                "Used PSRAM = %d out of total PSRAM = %d, number of sensor history entries = %d for a history period of %f hours\n", 
-                ESP.getPsramSize() - ESP.getFreePsram(), ESP.getPsramSize(), sensor_history_size, sensor_history_size*_sensor_refresh_seconds/3600.0
+    if (use_psram) {
+        LOG_INFO("PSRAM is install with a size of %d. Allocating history storage in PSRAM.", ESP.getPsramSize());
+        _historyStorage = ps_malloc(history_bytes);
+        if (_historyStorage) {
+            LOG_INFO(
+                "Used PSRAM = %d out of total PSRAM = %d, history storage = %d bytes",
+                ESP.getPsramSize() - ESP.getFreePsram(), ESP.getPsramSize(), history_bytes
             );
         } else {
-            Serial.print(F("ERROR - failed to allocate history storage in PSRAM"));
-
+            LOG_ERROR("ERROR - failed to allocate history storage in PSRAM");
         }
     }
-    if (!_vectorStorage) {
+    if (!_historyStorage) {
         // either the board does not have PSRAM or the PSAM malloc failed. Attempt to create history storage in RAM
-        Serial.println(F("Allocating history storage in RAM."));
-        sensor_history_size = ESP.getMaxAllocHeap()/2/sizeof(uint16_t);
-        _vectorStorage = (uint16_t*)malloc(sensor_history_size*sizeof(uint16_t));
-        if (_vectorStorage) {
-            Serial.printf(
-                "Used RAM = %d out of total RAM = %d, number 0f sensor history entries = %d for a history period of %f hours\n", 
-                ESP.getHeapSize() - ESP.getFreeHeap(), ESP.getHeapSize(), sensor_history_size, sensor_history_size*_sensor_refresh_seconds/3600.0
+        LOG_INFO("Allocating history storage in RAM.");
+        _historyStorage = malloc(history_bytes);
+        if (_historyStorage) {
+            LOG_INFO(
+                "Used RAM = %d out of total RAM = %d, history storage = %d bytes",
+                ESP.getHeapSize() - ESP.getFreeHeap(), ESP.getHeapSize(), history_bytes
             );
         } else {
-            Serial.println(F("ERROR - Could not allocate sensor history vector in device RAM. This will prevent sensor history from being maintained."));
+            LOG_ERROR("ERROR - Could not allocate sensor history in device RAM. This will prevent sensor history from being maintained.");
+            sample_capacity = 0;
+        }
+    }
+    if (!_pm2p5_history.setStorage(_historyStorage, sample_capacity, tiers, tier_count)) {
+        LOG_ERROR("ERROR - Invalid history tier configuration. Only full resolution samples will be retained.");
+    }
+    LOG_INFO(
+        "Sensor history retains %d full resolution samples (%f hours)",
+        sample_capacity, sample_capacity*_sensor_refresh_seconds/3600.0
+    );
+    for (uint8_t i = 0; i < _pm2p5_history.tierCount(); i++) {
+        LOG_INFO(
+            "    and %d x %d second rollups (%f days)",
+            tiers[i].capacity, tiers[i].samples_per_bucket*_sensor_refresh_seconds,
+            tiers[i].capacity*tiers[i].samples_per_bucket*_sensor_refresh_seconds/86400.0
+        );
+    }
+
+    // Samples more than AQM_GAP_SAMPLE_PERIODS apart are on either side of a gap, such as the
+    // sensor being unplugged or the device being off, which the averages do not span.
+    _pm2p5_history.setSamplePeriod(_sensor_refresh_seconds*1000, AQM_GAP_SAMPLE_PERIODS*_sensor_refresh_seconds*1000);
+
+    // register the standard averaging windows so they are maintained incrementally
+    _windowCurrent = _pm2p5_history.registerWindow(_sensor_refresh_seconds*1000);
+    _window10Min = _pm2p5_history.registerWindow(10*60*1000UL);
+    _window1Hour = _pm2p5_history.registerWindow(60*60*1000UL);
+    _window24Hour = _pm2p5_history.registerWindow(24*60*60*1000UL);
+
+    // Track the min, max and percentiles of the 10 minute, 1 hour and 24 hour windows. The
+    // histograms are part of this object, and the min/max deques are allocated like the history.
+    const SampleWindowID spread_windows[AQM_SPREAD_WINDOW_COUNT] = {_window10Min, _window1Hour, _window24Hour};
+    size_t spread_capacity[AQM_SPREAD_WINDOW_COUNT];
+    size_t spread_bytes = 0;
+    for (uint8_t i = 0; i < AQM_SPREAD_WINDOW_COUNT; i++) {
+        spread_capacity[i] = _pm2p5_history.windowEntryCapacity(spread_windows[i]);
+        spread_bytes += SampleDistribution::storageBytes(spread_capacity[i]);
+    }
+    if (use_psram) {
+        _distributionStorage = ps_malloc(spread_bytes);
+    }
+    if (!_distributionStorage) {
+        _distributionStorage = malloc(spread_bytes);
+    }
+    if (!_distributionStorage) {
+        LOG_ERROR("ERROR - Could not allocate %d bytes for the PM2.5 min and max. Only percentiles will be kept.", spread_bytes);
+    }
+    uint8_t* next_storage = (uint8_t*)_distributionStorage;
+    for (uint8_t i = 0; i < AQM_SPREAD_WINDOW_COUNT; i++) {
+        if (next_storage != nullptr) {
+            _pm2p5_distributions[i].setStorage(next_storage, spread_capacity[i]);
+            next_storage += SampleDistribution::storageBytes(spread_capacity[i]);
         }
+        _pm2p5_history.trackDistribution(spread_windows[i], _pm2p5_distributions[i]);
     }
-    _pm2p5_history.setStorage(_vectorStorage, sensor_history_size, 0);
 }
 
 AirQualitySensor::~AirQualitySensor()
 {
-    free(_vectorStorage);
+    free(_historyStorage);
+    free(_distributionStorage);
 }
 
 void AirQualitySensor::begin(void)
 {
-    // start hardware serial. RX is pin 33 on TinyPico. Don't really need TX.
-    // TODO: The default RX buffer size is 256, is FIFO, and drops new data when full.
-    // We recieve 32 bytes at a time.  We read from the buffer every AIR_QUALITY_SENSOR_UPDATE_SECONDS,
-    // but the sensor sends bytes every 1 second. This all adds up to we are not getting the
-    // most recent measurement  by not reading every 1 second AND we are dropping 
-    // the most recent measurement if we wait too long.  The TODO here is the rectify that situation, likely
-    // by fetching measurements every second, but only uploading them every 15-30 seconds.
-    // Note we do drain the serial buffer after taking each measurement. So our "current" meausrment
-    // is AIR_QUALITY_SENSOR_UPDATE_SECONDS old when we read it since the first thing in the queue after
-    // we drain it is the measurement that occurs immediately after. Until this TODO is addressed, keep 
-    // AIR_QUALITY_SENSOR_UPDATE_SECONDS a smallish value.
-    AQMSerial.begin(9600, SERIAL_8E1, 33, 32 );
-
-    // The Panasonic SN-GCJA5 takes 28 seconds to get power up and normalize.
-    // we will wait 28 seconds here.
-    Serial.println(F("Waiting 28 seconds for particulate sensor to power up and initialize"));
-    delay(28000);
+    // The sensors send a frame about every second. The default RX buffer size is 256 bytes, which
+    // holds several frames, so as long as acquire() is called often enough no bytes are lost.
+    // Every byte read is fed to the frame decoder, and the newest valid frame is used for each
+    // sample.
+    _driver.begin();
+
+    // Rather than waiting here for the sensor to power up, no samples are taken until it has.
+    // Frames received meanwhile are decoded and discarded.
+    LOG_INFO("Particulate sensor %s is warming up. The first sample will be taken in %u seconds.", _driver.name(), _driver.warmupMillis()/1000);
+    _warmupEndMillis = millis() + _driver.warmupMillis();
+    _nextSampleMillis = _warmupEndMillis + _sensor_refresh_seconds*1000;
 }
 
-bool AirQualitySensor::updateSensorReading(void)
+bool AirQualitySensor::isWarmingUp(void) const
+{
+    return (int32_t)(millis() - _warmupEndMillis) < 0;
+}
+
+bool AirQualitySensor::startAcquisitionTask(int core)
+{
+#if defined(ESP32)
+    TaskHandle_t task = nullptr;
+    BaseType_t result = xTaskCreatePinnedToCore(
+        AirQualitySensor::acquisitionTask,
+        "AQMAcquire",
+        AQM_ACQUISITION_TASK_STACK,
+        this,
+        AQM_ACQUISITION_TASK_PRIORITY,
+        &task,
+        core
+    );
+    if (result != pdPASS) {
+        LOG_ERROR("ERROR - Could not start the sensor acquisition task. Sensor will be polled from the main loop.");
+        return false;
+    }
+    _acquisitionTask = task;
+    LOG_INFO("Started sensor acquisition task on core %d", core);
+    return true;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+void AirQualitySensor::acquisitionTask(void* parameter)
 {
-    uint8_t buffer[AQM_BUFFER_SIZE];
-    int recieveCount = 0;
-    while( AQMSerial.available() && (recieveCount < AQM_BUFFER_SIZE) ) {
-        buffer[recieveCount] = AQMSerial.read();
-        recieveCount++; 
+#if defined(ESP32)
+    AirQualitySensor* sensor = static_cast<AirQualitySensor*>(parameter);
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;) {
+        // Waking on a fixed period keeps sampling on schedule no matter what the consumer is doing.
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(AQM_ACQUISITION_POLL_MILLIS));
+        sensor->acquire();
     }
-    if (recieveCount != AQM_BUFFER_SIZE) {
-        Serial.print(F("ERROR: did not receive full data set from sensor. Bytes recieved = "));
-        Serial.print(recieveCount);
-        Serial.print(F("\n"));
+#else
+    (void)parameter;
+#endif
+}
+
+bool AirQualitySensor::acquire(void)
+{
+    // feed everything the sensor has sent since the last poll to the decoder
+    uint32_t read_start = stageTimerStart();
+    uint32_t receive_millis = millis();
+    uint32_t received = _driver.poll(receive_millis);
+    if (received > 0) {
+        _receivedByteCount += received;
+        _readLatency.record(stageTimerElapsedMicros(read_start));
+    }
+
+    if ((int32_t)(receive_millis - _nextSampleMillis) < 0) {
         return false;
     }
+    _nextSampleMillis += _sensor_refresh_seconds*1000;
+    if ((int32_t)(receive_millis - _nextSampleMillis) >= 0) {
+        // fell more than a full period behind, so restart the schedule from now
+        _nextSampleMillis = receive_millis + _sensor_refresh_seconds*1000;
+    }
 
-    if ((buffer[0] != 0x02) || (buffer[AQM_BUFFER_SIZE-1] != 0x03)) {
-        Serial.println(F("ERROR: data received from sensor did not have proper start or stop byte."));
-        Serial.print(F("    Stary byte = 0x"));
-        Serial.print(buffer[0], HEX);
-        Serial.print(F(", stop byte = 0x"));
-        Serial.print(buffer[AQM_BUFFER_SIZE-1], HEX);
-        Serial.print(F("\n    Flushing input buffer "));
-        // This error likely occurs because we got out of synch with the sensor's internal update cycle.
-        // We will read more bytes in order to slowly get into the right phase with the sensor.
-        while (AQMSerial.available()) {
-            AQMSerial.read();
-            Serial.print(F("."));
-        }
-        Serial.print(F("\n"));
+    uint32_t decode_start = stageTimerStart();
+    AirQualitySample sample;
+    if (!_driver.takeMeasurement(sample.measurement, sample.frameMillis)) {
+        _missedSampleCount++;
         return false;
     }
 
-    // TODO confirm the XOR byte to ensure no transmission errors.
-    
-    Serial.print(F("    Received data = "));
-    print_buffer(buffer, recieveCount);
+    sample.queuedMicros = micros();
+    bool queued = _sampleQueue.push(sample);
+    _decodeLatency.record(stageTimerElapsedMicros(decode_start));
+    return queued;
+}
 
-    // drain the rest of the Serial buffer
-    uint16_t drainedBytes = 0;
-    while(AQMSerial.available()) {
-        AQMSerial.read();
-        drainedBytes++;
-    }
-    Serial.printf("    Drained %d bytes from sensor serial buffer.\n", drainedBytes);
-
-    // calculate values
-    //
-    // The English documentation for sensor communications is foound here:
-    //      https://b2b-api.panasonic.eu/file_stream/pids/fileversion/8814
-    // it is very confusing and clearly not written by someone who speaks  English. What is unclear
-    // is that the I2C and UART interfaces actually provide numbers that are formatted differently.
-    // Using Google translate on the Japanse version of the document yields a much better translation.
-    //      https://industrial.panasonic.com/content/data/PPL/PDF/JA5-SSP-COMM-v10_Communication-Spec_j.pdf
-    // In that translation, it becomes clearer that the mass density measurements are scaled by 
-    // 1000 in the I2C interface, and NOT sclaed by 1000 in the UART interface. Furthermore, despite
-    // the UART interface providing 4 bytes for the mass densities, the number provided is in fact a
-    // 16 bit integer. I realize that the English document says something to that extent, but the sentence
-    // was extremely confusing. Triangulating between the Google translated Japanese document and the 
-    // official English document yielded better insights into what is actually happening.
-    //
-    // Despite the mass densities only being uint16_t integers in the UART interface, I still calculate them
-    // as if they are uint32_t since 4 bytes are provided.
-    _pm1p0 = ((uint32_t)buffer[4])*256*256*256 + ((uint32_t)buffer[3])*256*256 + ((uint32_t)buffer[2])*256 + buffer[1];
-    _pm2p5 = ((uint32_t)buffer[8])*256*256*256 + ((uint32_t)buffer[7])*256*256 + ((uint32_t)buffer[6])*256 + buffer[5];
-    _pm10 = ((uint32_t)buffer[12])*256*256*256 + ((uint32_t)buffer[11])*256*256 + ((uint32_t)buffer[10])*256 + buffer[9];
-    _particleCount0p5um = (uint16_t)buffer[14]*256 + buffer[13];
-    _particleCount1p0um = (uint16_t)buffer[16]*256 + buffer[15];
-    _particleCount2p5um = (uint16_t)buffer[18]*256 + buffer[17];
-    _particleCount5p0um = (uint16_t)buffer[22]*256 + buffer[21];
-    _particleCount7p5um = (uint16_t)buffer[24]*256 + buffer[23];
-    _particleCount10um = (uint16_t)buffer[26]*256 + buffer[25];
-
-    _sensorStatus = buffer[29];
-
-    if (_pm2p5_history.size() < _pm2p5_history.max_size()) {
-        _pm2p5_history.push_back(_pm2p5);
-        _pm2p5_history_insertion_idx = _pm2p5_history.size() - 1;
-    } else {
-        // make _pm2p5_history behave like a FIFO stack, but
-        // we really don't care about the stack order, so do 
-        // so in a compute optimized manner.
-        _pm2p5_history_insertion_idx++;
-        if (_pm2p5_history_insertion_idx >= _pm2p5_history.size()) {
-            _pm2p5_history_insertion_idx = 0;
-        }
-        _pm2p5_history[_pm2p5_history_insertion_idx] = _pm2p5;
+bool AirQualitySensor::updateSensorReading(void)
+{
+    if (_acquisitionTask == nullptr) {
+        acquire();
     }
 
-    Serial.print(F("    PM1.0 = "));
-    Serial.print(_pm1p0);
-    Serial.print(F(", PM2.5 = "));
-    Serial.print(_pm2p5);
-    Serial.print(F(", PM10 = "));
-    Serial.print(_pm10);
-    Serial.print(F("\n"));
+    AirQualitySample sample;
+    if (!_sampleQueue.pop(sample)) {
+        return false;
+    }
+    // the sample was queued on another task, and so possibly another core, so the wait is
+    // measured with micros() rather than the cycle counter
+    _queueLatency.record(micros() - sample.queuedMicros);
+    {
+        StageTimer timer(_applyLatency);
+        applySample(sample);
+    }
 
-    _avgPM2p5_Current = averagePM2p5(_sensor_refresh_seconds);
-    _avgPM2p5_10Min = averagePM2p5(10*60);
-    _avgPM2p5_1Hour = averagePM2p5(60*60);
-    _avgPM2p5_24Hour = averagePM2p5(24*60*60);
+    LOG_DEBUG("    PM1.0 = %u, PM2.5 = %u, PM10 = %u", _pm1p0, _pm2p5, _pm10);
 
     return true;
 }
 
+void AirQualitySensor::applySample(const AirQualitySample& sample)
+{
+    const ParticulateMeasurement& measurement = sample.measurement;
+    _lastFrameMillis = sample.frameMillis;
+    _pm1p0 = measurement.pm1p0;
+    _pm2p5 = measurement.pm2p5;
+    _pm10 = measurement.pm10;
+    _particleCount0p5um = measurement.particleCount0p5um;
+    _particleCount1p0um = measurement.particleCount1p0um;
+    _particleCount2p5um = measurement.particleCount2p5um;
+    _particleCount5p0um = measurement.particleCount5p0um;
+    _particleCount7p5um = measurement.particleCount7p5um;
+    _particleCount10um = measurement.particleCount10um;
+    _sensorStatus = measurement.sensorStatus;
+
+    // the history updates the running sums of all registered averaging windows as it goes
+    _pm2p5_history.push(_pm2p5, sample.frameMillis);
+    _pm2p5_nowcast.push(_pm2p5, sample.frameMillis);
+}
+
+size_t AirQualitySensor::restoreNowCast(void)
+{
+    _pm2p5_nowcast.reset();
+    if (_pm2p5_history.tierCount() == 0) {
+        return 0;
+    }
+    size_t restored = 0;
+    uint32_t pushed = _pm2p5_history.levelPushCount(1);
+    for (uint32_t number = pushed - _pm2p5_history.levelSize(1); number != pushed; number++) {
+        SampleAggregate bucket;
+        if (_pm2p5_history.readEntry(1, number, bucket)) {
+            _pm2p5_nowcast.restore(bucket.sum, bucket.count, _pm2p5_history.entryTime(1, number));
+            restored++;
+        }
+    }
+    return restored;
+}
+
 uint8_t AirQualitySensor::statusParticleDetector(void) const
 {
     return (_sensorStatus&0x30) >> 4;
@@ -212,64 +341,37 @@ uint8_t AirQualitySensor::statusFan(void) const
 
 float AirQualitySensor::averagePM2p5( int32_t window_size_seconds ) const
 {
-    // this averaging makes the grand assumption that all measurements succeed. That is, it 
-    // does not account for measurement holes caused by intermittent sensor failures. For the
-    // purposes of what this value is used for, which is to determine when the AQI is based on 
-    // a 24 hour average, this caveat isn't really that important. Just acknowledging it exists.
+    return averageWindowStats(window_size_seconds).average;
+}
+
+SampleWindowStats AirQualitySensor::averageWindowStats( int32_t window_size_seconds ) const
+{
+    // the averages are weighted by the time each sample covers, and do not span gaps
+    uint32_t window_millis = (window_size_seconds > 0) ? window_size_seconds*1000UL : _sensor_refresh_seconds*1000;
+    SampleWindowID window_id = _pm2p5_history.findWindow(window_millis);
+    if (window_id != INVALID_SAMPLE_WINDOW) {
+        return _pm2p5_history.windowStats(window_id);
+    }
+
+    // not a registered window, so fall back to scanning the history
+    return _pm2p5_history.scanWindow(window_millis);
+}
 
-    return calculatePartialOrderedAverage(_pm2p5_history, _pm2p5_history_insertion_idx, window_size_seconds/_sensor_refresh_seconds);
+bool AirQualitySensor::registerAverageWindow( int32_t window_size_seconds )
+{
+    uint32_t window_millis = (window_size_seconds > 0) ? window_size_seconds*1000UL : _sensor_refresh_seconds*1000;
+    return (_pm2p5_history.registerWindow(window_millis) != INVALID_SAMPLE_WINDOW);
 }
 
 float AirQualitySensor::airQualityIndex( float avgPM2p5 ) const
 {
-    // 
-    // Calculate the AQI. Got this formula from:
-    //   https://www.epa.gov/sites/production/files/2016-04/documents/2012_aqi_factsheet.pdf
-    //
-
-    float lowPM2p5, highPM2p5, lowAQI, highAQI;
-
-    if (avgPM2p5 <= 12.0) {
-        lowPM2p5 = 0;
-        highPM2p5 = 12;
-        lowAQI = 0;
-        highAQI = 50;
-    } else if (avgPM2p5 <= 35.4) {
-        lowPM2p5 = 12;
-        highPM2p5 = 35.4;
-        lowAQI = 50;
-        highAQI = 100;
-    } else if (avgPM2p5 <= 55.4) {
-        lowPM2p5 = 35.4;
-        highPM2p5 = 55.4;
-        lowAQI = 100;
-        highAQI = 150;
-    } else if (avgPM2p5 <= 150.4) {
-        lowPM2p5 = 55.4;
-        highPM2p5 = 150.4;
-        lowAQI = 150;
-        highAQI = 200;
-    } else if (avgPM2p5 <= 250.4) {
-        lowPM2p5 = 150.4;
-        highPM2p5 = 250.4;
-        lowAQI = 200;
-        highAQI = 300;
-    } else if (avgPM2p5 <= 350.4) {
-        lowPM2p5 = 250.4;
-        highPM2p5 = 350.4;
-        lowAQI = 300;
-        highAQI = 400;
-    } else {
-        // the provided formula has an upper bound of PM2.5 = 500 for a max
-        // AQI of 500. This approach allows for extrapolation beyond an
-        // AQI of 500.
-        lowPM2p5 = 350.4;
-        highPM2p5 = 500;
-        lowAQI = 400;
-        highAQI = 500;
-    }
+    // the breakpoints of the scale selected by AQI_PM2P5_SCALE are in AQIScale.h
+    return aqiFromConcentration(PM2P5_AQI_SCALE, avgPM2p5);
+}
 
-    return lowAQI + (highAQI - lowAQI)*(avgPM2p5 - lowPM2p5)/(highPM2p5 - lowPM2p5);
+float AirQualitySensor::pm10AirQualityIndex( float avgPM10 ) const
+{
+    return aqiFromConcentration(PM10_AQI_SCALE, avgPM10);
 }
 
 //
@@ -278,17 +380,5 @@ float AirQualitySensor::airQualityIndex( float avgPM2p5 ) const
 
 AQIStatusColor AirQualitySensor::getAQIStatusColor(float aqi_value)
 {
-  if (aqi_value <= 50) {
-    return AQI_GREEN;
-  } else if (aqi_value <= 100) {
-    return AQI_YELLOW;
-  } else if (aqi_value <= 150) {
-    return AQI_ORANGE;
-  } else if (aqi_value <= 200) {
-    return AQI_RED;
-  } else if (aqi_value <= 300) {
-    return AQI_PURPLE;
-  } else {
-    return AQI_MAROON;
-  }
+  return (AQIStatusColor)aqiCategory(PM2P5_AQI_SCALE, aqi_value);
 }
\ No newline at end of file
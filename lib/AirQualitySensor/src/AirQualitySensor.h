@@ -1,7 +1,26 @@
 #ifndef __AirQualitySensor__
 #define __AirQualitySensor__
 #include <Arduino.h>
-#include <Vector.h>
+#include <SampleHistory.h>
+#include <ParticulateFrameDecoder.h>
+#include <SPSCQueue.h>
+#include <LatencyHistogram.h>
+#include "AQIScale.h"
+#include "ParticulateSensorDriver.h"
+#include "NowCast.h"
+
+// number of decoded samples that can be waiting between the acquisition task and the consumer
+#ifndef AQM_SAMPLE_QUEUE_SIZE
+#define AQM_SAMPLE_QUEUE_SIZE   16
+#endif
+
+// number of standard averaging windows that track the min, max and percentiles of PM2.5
+#define AQM_SPREAD_WINDOW_COUNT 3
+
+// sample periods without a sample after which the averages treat the time as a gap
+#ifndef AQM_GAP_SAMPLE_PERIODS
+#define AQM_GAP_SAMPLE_PERIODS  3
+#endif
 
 typedef enum {
     AQI_GREEN,
@@ -12,8 +31,24 @@ typedef enum {
     AQI_MAROON
 } AQIStatusColor;
 
+//
+// A decoded particulate measurement as handed from the acquisition task to the consumer.
+//
+struct AirQualitySample {
+    uint32_t                frameMillis;    // millis() time the sensor frame was received
+    uint32_t                queuedMicros;   // micros() time the sample was queued
+    ParticulateMeasurement  measurement;
+};
+
+//
+// AirQualitySensor
+//
+// Samples one particulate sensor through its driver into the current readings and a PM2.5
+// history with its averages. Each sensor attached to the device has its own AirQualitySensor.
+//
 class AirQualitySensor {
 private:
+    ParticulateSensorDriver&    _driver;
     uint32_t    _sensor_refresh_seconds;
 
     uint32_t    _pm1p0; // PM1.0
@@ -27,21 +62,63 @@ private:
     uint16_t    _particleCount10um;
     uint8_t     _sensorStatus;
 
-    float   _avgPM2p5_Current;
-    float   _avgPM2p5_10Min;
-    float   _avgPM2p5_1Hour;
-    float   _avgPM2p5_24Hour;
-  
-    uint16_t*           _vectorStorage;
-    Vector<uint16_t>    _pm2p5_history;
-    size_t              _pm2p5_history_insertion_idx;
+    // acquisition side. Only touched by the acquisition task once it is started.
+    uint32_t            _nextSampleMillis;
+    uint32_t            _warmupEndMillis;
+    uint32_t            _missedSampleCount;
+    uint32_t            _receivedByteCount;
+    LatencyHistogram    _readLatency;
+    LatencyHistogram    _decodeLatency;
+    void*               _acquisitionTask;
+
+    SPSCQueue<AirQualitySample, AQM_SAMPLE_QUEUE_SIZE> _sampleQueue;
+
+    // consumer side
+    uint32_t            _lastFrameMillis;
+    LatencyHistogram    _queueLatency;
+    LatencyHistogram    _applyLatency;
+
+    SampleWindowID  _windowCurrent;
+    SampleWindowID  _window10Min;
+    SampleWindowID  _window1Hour;
+    SampleWindowID  _window24Hour;
+
+    void*               _historyStorage;
+    void*               _distributionStorage;
+    SampleHistory       _pm2p5_history;
+    SampleDistribution  _pm2p5_distributions[AQM_SPREAD_WINDOW_COUNT];  // 10 min, 1 hour and 24 hours
+    NowCast             _pm2p5_nowcast;
+
+    static void acquisitionTask(void* parameter);
+    void applySample(const AirQualitySample& sample);
 public:
-    AirQualitySensor(uint32_t sensor_refresh_seconds);
+    // The driver must outlive the sensor.
+    AirQualitySensor(ParticulateSensorDriver& driver, uint32_t sensor_refresh_seconds);
     virtual ~AirQualitySensor();
 
+    // Starts the sensor UART. Returns right away; samples are only taken once the sensor has
+    // warmed up.
     void begin(void);
+    bool isWarmingUp(void) const;
+    // the millis() time the next sample is due. Read from another task, it may be a period behind.
+    uint32_t nextSampleMillis(void) const     { return _nextSampleMillis; }
+    const char* name(void) const              { return _driver.name(); }
     size_t getHistoryCount(void) const        { return _pm2p5_history.size(); }
+    uint32_t getHistorySeconds(void) const    { return _pm2p5_history.retainedSamples()*_sensor_refresh_seconds; }
+    const SampleHistory& history(void) const  { return _pm2p5_history; }
+    SampleHistory& history(void)              { return _pm2p5_history; }
+
+    // Starts a FreeRTOS task pinned to the given core that reads the sensor UART and queues
+    // a decoded sample every sensor refresh period. Returns false if the task could not be
+    // started, in which case acquire() must be called periodically instead.
+    bool startAcquisitionTask(int core);
 
+    // Performs one acquisition step: feeds all bytes the sensor has sent to the driver's frame decoder
+    // and, if a sample is due, queues the newest frame as a sample. Returns true if a sample
+    // was queued. Called by the acquisition task; only call it directly if the task is not running.
+    bool acquire(void);
+
+    // Consumes the next queued sample, if any, into the current readings and the history.
     // returns true if new data was fetched
     bool updateSensorReading(void);
 
@@ -57,21 +134,79 @@ public:
     uint16_t particalCount7p5(void) const   { return _particleCount7p5um; }
     uint16_t particalCount10(void) const    { return _particleCount10um; }
 
+    // frame decoder statistics
+    uint32_t validFrameCount(void) const        { return _driver.frameCounters().valid; }
+    uint32_t corruptFrameCount(void) const      { return _driver.frameCounters().corrupt; }
+    uint32_t droppedFrameCount(void) const      { return _driver.frameCounters().dropped; }
+    uint32_t discardedByteCount(void) const     { return _driver.frameCounters().discarded; }
+
+    // the millis() time at which the frame for the current readings was received
+    uint32_t lastFrameMillis(void) const        { return _lastFrameMillis; }
+
+    // sample pipeline statistics
+    uint32_t missedSampleCount(void) const          { return _missedSampleCount; }
+    size_t sampleQueueDepth(void) const             { return _sampleQueue.size(); }
+    uint32_t sampleQueueHighWaterMark(void) const   { return _sampleQueue.highWaterMark(); }
+    uint32_t sampleQueueOverflowCount(void) const   { return _sampleQueue.overflowCount(); }
+    uint32_t receivedByteCount(void) const          { return _receivedByteCount; }
+
+    // Latencies of the pipeline stages: draining the UART through the frame decoder on each
+    // poll that received bytes, decoding a frame into a sample and queueing it, the time the
+    // sample waited in the queue, and applying it to the averages and history.
+    const LatencyHistogram& readLatency(void) const     { return _readLatency; }
+    const LatencyHistogram& decodeLatency(void) const   { return _decodeLatency; }
+    const LatencyHistogram& queueLatency(void) const    { return _queueLatency; }
+    const LatencyHistogram& applyLatency(void) const    { return _applyLatency; }
+
     uint8_t statusParticleDetector(void) const;
     uint8_t statusLaser(void) const;
     uint8_t statusFan(void) const;
 
+   // Registers an additional averaging window so that averagePM2p5() for that window length
+   // is computed incrementally rather than by rescanning the history. Returns false if the window
+   // could not be registered.
+   bool registerAverageWindow( int32_t window_size_seconds );
+
    // returns PM2.5 average value for the prior window_size_seconds seconds
    float averagePM2p5( int32_t window_size_seconds ) const;
 
-   // return AQI for the given average PM2.5
+   // returns the PM2.5 average for the prior window_size_seconds seconds along with how much
+   // of that time the samples cover and how much fell in gaps
+   SampleWindowStats averageWindowStats( int32_t window_size_seconds ) const;
+
+   // return AQI for the given average PM2.5, on the scale selected by AQI_PM2P5_SCALE
    float airQualityIndex( float avg_pm2p5 ) const;
 
+   // return AQI for the given average PM10, on the scale selected by AQI_PM10_SCALE
+   float pm10AirQualityIndex( float avg_pm10 ) const;
+
    // convenience functions
-   float currentAirQualityIndex(void) const         { return airQualityIndex(_avgPM2p5_Current); }
-   float tenMinuteAirQualityIndex(void) const       { return airQualityIndex(_avgPM2p5_10Min); }
-   float oneHourAirQualityIndex(void) const         { return airQualityIndex(_avgPM2p5_1Hour); }
-   float oneDayAirQualityIndex(void) const          { return airQualityIndex(_avgPM2p5_24Hour); }
+   float currentAveragePM2p5(void) const            { return _pm2p5_history.windowAverage(_windowCurrent); }
+   float tenMinuteAveragePM2p5(void) const          { return _pm2p5_history.windowAverage(_window10Min); }
+   float oneHourAveragePM2p5(void) const            { return _pm2p5_history.windowAverage(_window1Hour); }
+   float oneDayAveragePM2p5(void) const             { return _pm2p5_history.windowAverage(_window24Hour); }
+   SampleWindowStats tenMinuteAverageStats(void) const  { return _pm2p5_history.windowStats(_window10Min); }
+   SampleWindowStats oneHourAverageStats(void) const    { return _pm2p5_history.windowStats(_window1Hour); }
+   SampleWindowStats oneDayAverageStats(void) const     { return _pm2p5_history.windowStats(_window24Hour); }
+
+   // PM2.5 min, max and 50th, 95th and 99th percentiles
+   SampleWindowSpread tenMinuteSpreadPM2p5(void) const  { return _pm2p5_history.windowSpread(_window10Min); }
+   SampleWindowSpread oneHourSpreadPM2p5(void) const    { return _pm2p5_history.windowSpread(_window1Hour); }
+   SampleWindowSpread oneDaySpreadPM2p5(void) const     { return _pm2p5_history.windowSpread(_window24Hour); }
+   float currentAirQualityIndex(void) const         { return airQualityIndex(currentAveragePM2p5()); }
+   float tenMinuteAirQualityIndex(void) const       { return airQualityIndex(tenMinuteAveragePM2p5()); }
+   float oneHourAirQualityIndex(void) const         { return airQualityIndex(oneHourAveragePM2p5()); }
+   float oneDayAirQualityIndex(void) const          { return airQualityIndex(oneDayAveragePM2p5()); }
+
+   // PM2.5 NowCast, updated once an hour. It is 0 until two of the last three hours have samples.
+   bool nowCastValid(void) const                    { return _pm2p5_nowcast.valid(); }
+   float nowCastPM2p5(void) const                   { return _pm2p5_nowcast.value(); }
+   float nowCastAirQualityIndex(void) const         { return airQualityIndex(nowCastPM2p5()); }
+
+   // Restarts the NowCast from the finest rollup tier of the history, which must be called once
+   // the tier has been restored from flash and before any sample is taken. Returns the number of
+   // buckets the NowCast was restored from.
+   size_t restoreNowCast(void);
 
    // 
    // static utilty functions
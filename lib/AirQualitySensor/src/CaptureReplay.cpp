@@ -0,0 +1,116 @@
+#include <ParticulateProtocols.h>
+#include "CaptureReplay.h"
+
+//
+// A ParticulateSensorDriver that decodes the chunks of a capture as the replay feeds them,
+// rather than reading a UART.
+//
+template <typename Protocol>
+class ReplayParticulateSensorDriver : public ParticulateSensorDriver {
+private:
+    ParticulateFrameDecoder<Protocol>   _decoder;
+    uint32_t                            _fedCount;  // bytes fed since the last poll
+
+public:
+    ReplayParticulateSensorDriver() : _decoder(), _fedCount(0) {}
+
+    const char* name(void) const override               { return Protocol::name(); }
+    // the capture was taken from a sensor that was already running
+    uint32_t warmupMillis(void) const override          { return 0; }
+    void begin(void) override                           { _decoder.reset(); }
+
+    void feed(const uint8_t* bytes, size_t length, uint32_t receive_millis)
+    {
+        for (size_t i = 0; i < length; i++) {
+            _decoder.push(bytes[i], receive_millis);
+        }
+        _fedCount += length;
+    }
+
+    uint32_t poll(uint32_t /*now_millis*/) override
+    {
+        uint32_t received = _fedCount;
+        _fedCount = 0;
+        return received;
+    }
+
+    bool takeMeasurement(ParticulateMeasurement& measurement, uint32_t& receive_millis) override
+    {
+        typename ParticulateFrameDecoder<Protocol>::Frame frame;
+        if (!_decoder.takeFrame(frame)) {
+            return false;
+        }
+        ParticulateFrameDecoder<Protocol>::decode(frame.bytes, measurement);
+        receive_millis = frame.receive_millis;
+        return true;
+    }
+
+    const ParticulateFrameCounters& frameCounters(void) const override  { return _decoder.counters(); }
+};
+
+static void advanceClock(uint32_t to_millis)
+{
+    int32_t ahead = (int32_t)(to_millis - millis());
+    if (ahead > 0) {
+        delay(ahead);
+    }
+}
+
+template <typename Protocol>
+static void replay(UARTCaptureReader& capture, uint32_t sample_seconds, const CaptureReplaySampleFunction& on_sample, CaptureReplayResult& result)
+{
+    ReplayParticulateSensorDriver<Protocol> driver;
+    AirQualitySensor sensor(driver, sample_seconds);
+    sensor.begin();
+
+    // The capture's times are moved onto the host clock so that the first sample is due one
+    // period after the capture starts. Everything after is relative to the sample schedule,
+    // which only advances by whole periods, so the host time the replay takes does not matter.
+    uint32_t origin = sensor.nextSampleMillis() - sample_seconds*1000;
+
+    UARTCaptureChunk chunk;
+    bool has_chunk = capture.next(chunk);
+    bool finished = false;
+    while (!finished) {
+        uint32_t due_millis = sensor.nextSampleMillis();
+        uint32_t chunk_millis = has_chunk ? origin + (chunk.receiveMillis - capture.startMillis()) : 0;
+        if (has_chunk && ((int32_t)(chunk_millis - due_millis) <= 0)) {
+            advanceClock(chunk_millis);
+            driver.feed(chunk.bytes, chunk.length, chunk_millis);
+            result.chunkCount++;
+            result.byteCount += chunk.length;
+            result.captureMillis = chunk.receiveMillis - capture.startMillis();
+            has_chunk = capture.next(chunk);
+        } else {
+            // the sample after the last chunk takes its frame
+            advanceClock(due_millis);
+            finished = !has_chunk;
+        }
+        if (sensor.updateSensorReading()) {
+            result.sampleCount++;
+            on_sample(sensor, sensor.lastFrameMillis() - origin + capture.startMillis());
+        }
+    }
+    result.missedSampleCount = sensor.missedSampleCount();
+    result.frames = driver.frameCounters();
+}
+
+bool replayCapture(UARTCaptureReader& capture, uint32_t sample_seconds, const CaptureReplaySampleFunction& on_sample, CaptureReplayResult& result)
+{
+    memset(&result, 0, sizeof(result));
+    if (!capture.isValid() || (sample_seconds == 0)) {
+        return false;
+    }
+    capture.rewind();
+    const char* sensor_name = capture.sensorName();
+    if (strcmp(sensor_name, SNGCJA5Protocol::name()) == 0) {
+        replay<SNGCJA5Protocol>(capture, sample_seconds, on_sample, result);
+    } else if (strcmp(sensor_name, PMS5003Protocol::name()) == 0) {
+        replay<PMS5003Protocol>(capture, sample_seconds, on_sample, result);
+    } else if (strcmp(sensor_name, SPS30Protocol::name()) == 0) {
+        replay<SPS30Protocol>(capture, sample_seconds, on_sample, result);
+    } else {
+        return false;
+    }
+    return true;
+}
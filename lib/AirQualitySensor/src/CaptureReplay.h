@@ -0,0 +1,35 @@
+#ifndef __CaptureReplay__
+#define __CaptureReplay__
+#include <functional>
+#include <UARTCaptureReader.h>
+#include "AirQualitySensor.h"
+
+//
+// What a replay of a capture went through.
+//
+struct CaptureReplayResult {
+    uint32_t                    chunkCount;
+    uint64_t                    byteCount;
+    uint32_t                    sampleCount;
+    uint32_t                    missedSampleCount;  // sample periods without a new frame
+    uint32_t                    captureMillis;      // time from the start of the capture to its last chunk
+    ParticulateFrameCounters    frames;
+};
+
+// Called with the sensor after each sample is applied, and the millis() time of the sample's
+// frame on the capture's clock.
+typedef std::function<void(const AirQualitySensor& sensor, uint32_t capture_millis)> CaptureReplaySampleFunction;
+
+// Replays a UART capture through the frame decoder of the protocol the capture names and an
+// AirQualitySensor sampling every sample_seconds, so the samples, the history and its averages
+// come out as they did on the device. Each chunk is decoded at its receive time, and a sample
+// is taken at each sample period, after any chunk received at the same time. The sensor is
+// not warmed up, so the first sample is one period after the capture starts.
+//
+// The host clock is advanced with delay() rather than waited on, so a capture replays as fast
+// as the host can decode it. On the device delay() really waits, so this is only for the host.
+// The samples do not depend on how long the replay takes, so a replay gives the same results
+// every time. Returns false if the capture is not valid or is of a sensor without a protocol.
+bool replayCapture(UARTCaptureReader& capture, uint32_t sample_seconds, const CaptureReplaySampleFunction& on_sample, CaptureReplayResult& result);
+
+#endif // __CaptureReplay__
@@ -0,0 +1,143 @@
+#include "NowCast.h"
+
+// the least weight given to the hour before each hour, per the EPA NowCast for particulates
+#define NOWCAST_MIN_WEIGHT      0.5f
+
+// of the NOWCAST_RECENT_HOURS most recent hours, NOWCAST_MIN_HOURS must have data for a valid NowCast
+#define NOWCAST_RECENT_HOURS    3
+#define NOWCAST_MIN_HOURS       2
+
+NowCast::NowCast()
+{
+    reset();
+}
+
+void NowCast::reset(void)
+{
+    for (size_t i = 0; i < NOWCAST_HOURS; i++) {
+        _hourly[i] = 0;
+        _has_data[i] = false;
+    }
+    _hour_count = 0;
+    _newest_idx = NOWCAST_HOURS - 1;
+    _hour_start_millis = 0;
+    _started = false;
+    _pending_samples = 0;
+    _pending_sum = 0;
+    _value = 0;
+    _valid = false;
+}
+
+void NowCast::push(uint32_t value, uint32_t frame_millis)
+{
+    add(value, 1, frame_millis);
+}
+
+void NowCast::restore(uint64_t sum, uint32_t count, uint32_t frame_millis)
+{
+    if (count > 0) {
+        add(sum, count, frame_millis);
+    }
+}
+
+void NowCast::add(uint64_t sum, uint32_t count, uint32_t frame_millis)
+{
+    if (!_started) {
+        _hour_start_millis = frame_millis;
+        _started = true;
+    }
+    uint32_t elapsed_hours = (uint32_t)(frame_millis - _hour_start_millis)/NOWCAST_HOUR_MILLIS;
+    if ((int32_t)(frame_millis - _hour_start_millis) < 0) {
+        // a frame from before the hour being filled belongs to it
+        elapsed_hours = 0;
+    }
+    if (elapsed_hours > 0) {
+        completeHour(_pending_samples > 0, (_pending_samples > 0) ? (float)_pending_sum/(float)_pending_samples : 0);
+        // once the whole ring has gone by without data there is nothing more to record
+        for (uint32_t i = 1; (i < elapsed_hours) && (i <= NOWCAST_HOURS); i++) {
+            completeHour(false, 0);
+        }
+        _hour_start_millis += elapsed_hours*NOWCAST_HOUR_MILLIS;
+        _pending_samples = 0;
+        _pending_sum = 0;
+        update();
+    }
+    _pending_sum += sum;
+    _pending_samples += count;
+}
+
+void NowCast::completeHour(bool has_data, float average)
+{
+    _newest_idx = (_newest_idx + 1)%NOWCAST_HOURS;
+    _hourly[_newest_idx] = average;
+    _has_data[_newest_idx] = has_data;
+    if (_hour_count < NOWCAST_HOURS) {
+        _hour_count++;
+    }
+}
+
+bool NowCast::hasData(size_t hours_ago) const
+{
+    if (hours_ago >= _hour_count) {
+        return false;
+    }
+    return _has_data[(_newest_idx + NOWCAST_HOURS - hours_ago)%NOWCAST_HOURS];
+}
+
+float NowCast::hourlyAverage(size_t hours_ago) const
+{
+    if (hours_ago >= _hour_count) {
+        return 0;
+    }
+    return _hourly[(_newest_idx + NOWCAST_HOURS - hours_ago)%NOWCAST_HOURS];
+}
+
+void NowCast::update(void)
+{
+    size_t recent_hours = 0;
+    for (size_t i = 0; i < NOWCAST_RECENT_HOURS; i++) {
+        if (hasData(i)) {
+            recent_hours++;
+        }
+    }
+    if (recent_hours < NOWCAST_MIN_HOURS) {
+        _value = 0;
+        _valid = false;
+        return;
+    }
+
+    float min_hour = 0;
+    float max_hour = 0;
+    bool first = true;
+    for (size_t i = 0; i < _hour_count; i++) {
+        if (!hasData(i)) {
+            continue;
+        }
+        float hour = hourlyAverage(i);
+        if (first || (hour < min_hour)) {
+            min_hour = hour;
+        }
+        if (first || (hour > max_hour)) {
+            max_hour = hour;
+        }
+        first = false;
+    }
+    float weight = (max_hour > 0) ? min_hour/max_hour : 1.0f;
+    if (weight < NOWCAST_MIN_WEIGHT) {
+        weight = NOWCAST_MIN_WEIGHT;
+    }
+
+    // hours without data still count towards the age of the hours before them
+    float weighted_sum = 0;
+    float weight_sum = 0;
+    float hour_weight = 1;
+    for (size_t i = 0; i < _hour_count; i++) {
+        if (hasData(i)) {
+            weighted_sum += hour_weight*hourlyAverage(i);
+            weight_sum += hour_weight;
+        }
+        hour_weight *= weight;
+    }
+    _value = weighted_sum/weight_sum;
+    _valid = true;
+}
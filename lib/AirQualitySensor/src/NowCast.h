@@ -0,0 +1,78 @@
+#ifndef __NowCast__
+#define __NowCast__
+#include <stdint.h>
+#include <stddef.h>
+
+// number of hourly averages the NowCast is weighted over
+#define NOWCAST_HOURS   12
+
+#ifndef NOWCAST_HOUR_MILLIS
+#define NOWCAST_HOUR_MILLIS     (60*60*1000UL)
+#endif
+
+//
+// NowCast
+//
+// The EPA NowCast for particulates, computed incrementally. Samples are summed into the hour
+// currently being filled, and when an hour completes its average is added to a ring of the
+// last NOWCAST_HOURS hourly averages and the NowCast is recomputed from the ring. Reading the
+// NowCast returns the cached value, so it costs the same no matter how often it is served.
+//
+// Hours are NOWCAST_HOUR_MILLIS long and follow each other from the frame time of the first
+// sample, so an hour in which the sensor sent nothing goes into the ring as an hour without
+// data rather than being skipped.
+//
+// The NowCast weights each hour by w^(hours ago), where w is the ratio of the lowest to the
+// highest hourly average in the ring, but no less than 0.5. Hours without data are left out of
+// both. Per the EPA it is only valid when at least two of the three most recent hours have data.
+//
+// This class does not allocate memory and has no Arduino dependencies.
+//
+class NowCast {
+private:
+    float       _hourly[NOWCAST_HOURS];
+    bool        _has_data[NOWCAST_HOURS];
+    size_t      _hour_count;
+    size_t      _newest_idx;
+    uint32_t    _hour_start_millis;     // frame time the hour being filled started at
+    bool        _started;
+    uint32_t    _pending_samples;
+    uint64_t    _pending_sum;
+    float       _value;
+    bool        _valid;
+
+    void add(uint64_t sum, uint32_t count, uint32_t frame_millis);
+    void completeHour(bool has_data, float average);
+    void update(void);
+
+public:
+    NowCast();
+
+    // Discards all hours.
+    void reset(void);
+
+    // Adds a sample taken from a frame received at frame_millis to its hour, first completing
+    // the hours before it and updating the NowCast if there are any.
+    void push(uint32_t value, uint32_t frame_millis);
+
+    // Adds count samples that sum to sum, the newest of them taken at frame_millis, as restored
+    // from a saved history, so that the NowCast does not start over after a restart. Buckets must
+    // be restored oldest first and before any sample is pushed.
+    void restore(uint64_t sum, uint32_t count, uint32_t frame_millis);
+
+    // true once enough recent hours have data for the NowCast to be valid
+    bool valid(void) const                  { return _valid; }
+
+    // The NowCast concentration as of the last completed hour, or 0 if it is not valid.
+    float value(void) const                 { return _value; }
+
+    // number of completed hours the NowCast is computed over, including those without data
+    size_t hourCount(void) const            { return _hour_count; }
+
+    // returns whether a completed hour has data, 0 being the most recently completed one, and
+    // its average, which is 0 for an hour without data.
+    bool hasData(size_t hours_ago) const;
+    float hourlyAverage(size_t hours_ago) const;
+};
+
+#endif // __NowCast__
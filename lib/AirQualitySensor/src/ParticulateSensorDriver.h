@@ -0,0 +1,132 @@
+#ifndef __ParticulateSensorDriver__
+#define __ParticulateSensorDriver__
+#include <Arduino.h>
+#include <ParticulateFrameDecoder.h>
+#include <ParticulateProtocols.h>
+#include <UARTCapture.h>
+
+//
+// ParticulateSensorDriver
+//
+// The interface AirQualitySensor uses to talk to a particulate sensor. It is called once per
+// acquisition poll, not per byte: poll() drains everything the sensor has sent through the
+// driver's frame decoder, and takeMeasurement() decodes the newest frame.
+//
+class ParticulateSensorDriver {
+public:
+    virtual ~ParticulateSensorDriver() {}
+
+    // the sensor model, for logs
+    virtual const char* name(void) const = 0;
+
+    // how long after begin() the sensor's readings are not yet usable
+    virtual uint32_t warmupMillis(void) const = 0;
+
+    // Starts the UART, and tells the sensor to start measuring if it needs to be told.
+    virtual void begin(void) = 0;
+
+    // Feeds every byte the sensor has sent to the frame decoder, and asks the sensor for a
+    // reading if it only answers requests and one is due. Returns the number of bytes received.
+    virtual uint32_t poll(uint32_t now_millis) = 0;
+
+    // Decodes the newest valid frame that has not been taken. Returns false if there is none.
+    virtual bool takeMeasurement(ParticulateMeasurement& measurement, uint32_t& receive_millis) = 0;
+
+    virtual const ParticulateFrameCounters& frameCounters(void) const = 0;
+
+    // Hands every byte received to the capture as well as the frame decoder. Must be set
+    // before the acquisition task is started. Drivers that do not read a UART ignore it.
+    virtual void setCapture(UARTCapture* /*capture*/) {}
+};
+
+//
+// UARTParticulateSensorDriver
+//
+// A ParticulateSensorDriver for a sensor on a UART, specialized at compile time for the
+// sensor's protocol (see ParticulateProtocols.h). The byte loop in poll() calls the protocol's
+// frame decoder directly, so there is no virtual call per byte.
+//
+template <typename Protocol>
+class UARTParticulateSensorDriver : public ParticulateSensorDriver {
+private:
+    HardwareSerial&                     _serial;
+    int8_t                              _rxPin;
+    int8_t                              _txPin;
+    uint32_t                            _nextPollMillis;
+    ParticulateFrameDecoder<Protocol>   _decoder;
+    UARTCapture*                        _capture;
+
+    template <typename Command>
+    void send(void)
+    {
+        if (Command::SIZE > 0) {
+            _serial.write(Command::bytes(), Command::SIZE);
+        }
+    }
+
+public:
+    UARTParticulateSensorDriver(HardwareSerial& serial, int8_t rx_pin, int8_t tx_pin)
+        :   _serial(serial),
+            _rxPin(rx_pin),
+            _txPin(tx_pin),
+            _nextPollMillis(0),
+            _decoder(),
+            _capture(nullptr)
+    {
+    }
+
+    const char* name(void) const override               { return Protocol::name(); }
+    uint32_t warmupMillis(void) const override          { return Protocol::WARMUP_MILLIS; }
+
+    void begin(void) override
+    {
+        _serial.begin(Protocol::BAUD_RATE, Protocol::EVEN_PARITY ? SERIAL_8E1 : SERIAL_8N1, _rxPin, _txPin);
+        _decoder.reset();
+        send<typename Protocol::StartCommand>();
+        _nextPollMillis = millis();
+    }
+
+    uint32_t poll(uint32_t now_millis) override
+    {
+        uint32_t received = 0;
+        uint8_t captured[UART_CAPTURE_CHUNK_BYTES];
+        size_t captured_count = 0;
+        while (_serial.available()) {
+            uint8_t byte = _serial.read();
+            _decoder.push(byte, now_millis);
+            received++;
+            if (_capture != nullptr) {
+                captured[captured_count++] = byte;
+                if (captured_count == sizeof(captured)) {
+                    _capture->record(captured, captured_count, now_millis);
+                    captured_count = 0;
+                }
+            }
+        }
+        if (captured_count > 0) {
+            _capture->record(captured, captured_count, now_millis);
+        }
+        if ((Protocol::POLL_MILLIS > 0) && ((int32_t)(now_millis - _nextPollMillis) >= 0)) {
+            // the answer is decoded on a later poll
+            send<typename Protocol::PollCommand>();
+            _nextPollMillis = now_millis + Protocol::POLL_MILLIS;
+        }
+        return received;
+    }
+
+    bool takeMeasurement(ParticulateMeasurement& measurement, uint32_t& receive_millis) override
+    {
+        typename ParticulateFrameDecoder<Protocol>::Frame frame;
+        if (!_decoder.takeFrame(frame)) {
+            return false;
+        }
+        ParticulateFrameDecoder<Protocol>::decode(frame.bytes, measurement);
+        receive_millis = frame.receive_millis;
+        return true;
+    }
+
+    const ParticulateFrameCounters& frameCounters(void) const override  { return _decoder.counters(); }
+    void setCapture(UARTCapture* capture) override                      { _capture = capture; }
+};
+
+#endif // __ParticulateSensorDriver__
@@ -0,0 +1,177 @@
+#include <string.h>
+#include "ColumnarHistory.h"
+
+ColumnarHistory::ColumnarHistory()
+    :   _blocks(nullptr),
+        _blockCount(0),
+        _freeList(NO_BLOCK),
+        _freeCount(0),
+        _columnCount(0),
+        _oldestRow(0),
+        _nextRow(0)
+{
+    memset(_columns, 0, sizeof(_columns));
+}
+
+bool ColumnarHistory::setStorage(void* storage, size_t bytes, uint8_t column_count)
+{
+    size_t block_count = (storage != nullptr) ? bytes/sizeof(Block) : 0;
+    if (block_count >= NO_BLOCK) {
+        block_count = NO_BLOCK - 1;
+    }
+    if ((column_count > COLUMNAR_HISTORY_MAX_COLUMNS) || (block_count < 2*(size_t)column_count)) {
+        _blocks = nullptr;
+        _blockCount = 0;
+        _columnCount = 0;
+        block_count = 0;
+    } else {
+        _blocks = (Block*)storage;
+        _blockCount = block_count;
+        _columnCount = column_count;
+    }
+
+    // all blocks start out on the free list
+    _freeList = (block_count > 0) ? 0 : NO_BLOCK;
+    for (size_t i = 0; i < block_count; i++) {
+        _blocks[i].next = (i + 1 < block_count) ? i + 1 : NO_BLOCK;
+    }
+    _freeCount = block_count;
+    for (uint8_t c = 0; c < COLUMNAR_HISTORY_MAX_COLUMNS; c++) {
+        _columns[c].head = NO_BLOCK;
+        _columns[c].tail = NO_BLOCK;
+        _columns[c].block_count = 0;
+    }
+    _oldestRow = 0;
+    _nextRow = 0;
+    return (_blocks != nullptr) || (column_count == 0);
+}
+
+// Returns the blocks that hold only rows older than _oldestRow to the free list.
+void ColumnarHistory::freeOldBlocks(void)
+{
+    for (uint8_t c = 0; c < _columnCount; c++) {
+        Column& column = _columns[c];
+        while ((column.head != NO_BLOCK) && (column.head != column.tail)) {
+            Block& block = _blocks[column.head];
+            if (block.first_row + block.count > _oldestRow) {
+                break;
+            }
+            uint16_t freed = column.head;
+            column.head = block.next;
+            column.block_count--;
+            block.next = _freeList;
+            _freeList = freed;
+            _freeCount++;
+        }
+    }
+}
+
+// Drops the rows up to the end of the column block that ends earliest.
+void ColumnarHistory::evictOldestRows(void)
+{
+    uint32_t end_row = _nextRow;
+    for (uint8_t c = 0; c < _columnCount; c++) {
+        const Column& column = _columns[c];
+        if ((column.head != NO_BLOCK) && (column.head != column.tail)) {
+            const Block& block = _blocks[column.head];
+            if (block.first_row + block.count < end_row) {
+                end_row = block.first_row + block.count;
+            }
+        }
+    }
+    _oldestRow = end_row;
+    freeOldBlocks();
+}
+
+uint16_t ColumnarHistory::allocateBlock(void)
+{
+    if (_freeList == NO_BLOCK) {
+        evictOldestRows();
+    }
+    uint16_t idx = _freeList;
+    if (idx != NO_BLOCK) {
+        _freeList = _blocks[idx].next;
+        _freeCount--;
+    }
+    return idx;
+}
+
+void ColumnarHistory::push(const int32_t* values)
+{
+    for (uint8_t c = 0; c < _columnCount; c++) {
+        Column& column = _columns[c];
+        int32_t value = values[c];
+        Block* block = (column.tail != NO_BLOCK) ? &_blocks[column.tail] : nullptr;
+        if (block != nullptr) {
+            // deltas wrap, so any two int32_t values have a delta
+            int32_t delta = (int32_t)((uint32_t)value - (uint32_t)block->last_value);
+            uint8_t encoded[5];
+            size_t length = varintEncode(zigzagEncode(delta), encoded);
+            if (block->used + length <= PAYLOAD_BYTES) {
+                memcpy(block->payload + block->used, encoded, length);
+                block->used += length;
+                block->count++;
+                block->last_value = value;
+                continue;
+            }
+        }
+
+        // start a new block with the value as is
+        uint16_t idx = allocateBlock();
+        if (idx == NO_BLOCK) {
+            continue;
+        }
+        Block& new_block = _blocks[idx];
+        new_block.first_row = _nextRow;
+        new_block.first_value = value;
+        new_block.last_value = value;
+        new_block.count = 1;
+        new_block.used = 0;
+        new_block.next = NO_BLOCK;
+        if (column.tail != NO_BLOCK) {
+            _blocks[column.tail].next = idx;
+        } else {
+            column.head = idx;
+        }
+        column.tail = idx;
+        column.block_count++;
+    }
+    _nextRow++;
+}
+
+size_t ColumnarHistory::read(uint8_t column, uint32_t first_row, int32_t* out, size_t max_count) const
+{
+    if ((column >= _columnCount) || (first_row < _oldestRow) || (first_row >= _nextRow)) {
+        return 0;
+    }
+    // skip the blocks that end before first_row
+    uint16_t idx = _columns[column].head;
+    while ((idx != NO_BLOCK) && (_blocks[idx].first_row + _blocks[idx].count <= first_row)) {
+        idx = _blocks[idx].next;
+    }
+
+    size_t count = 0;
+    while ((idx != NO_BLOCK) && (count < max_count)) {
+        const Block& block = _blocks[idx];
+        uint32_t row = block.first_row;
+        int32_t value = block.first_value;
+        size_t offset = 0;
+        for (uint16_t i = 0; (i < block.count) && (count < max_count); i++, row++) {
+            if (i > 0) {
+                uint32_t encoded;
+                offset += varintDecode(block.payload + offset, encoded);
+                value = (int32_t)((uint32_t)value + (uint32_t)zigzagDecode(encoded));
+            }
+            if (row >= first_row) {
+                out[count++] = value;
+            }
+        }
+        idx = block.next;
+    }
+    return count;
+}
+
+size_t ColumnarHistory::columnBlocks(uint8_t column) const
+{
+    return (column < _columnCount) ? _columns[column].block_count : 0;
+}
@@ -0,0 +1,142 @@
+#ifndef __ColumnarHistory__
+#define __ColumnarHistory__
+#include <stdint.h>
+#include <stddef.h>
+
+// Maximum number of columns a history can have.
+#ifndef COLUMNAR_HISTORY_MAX_COLUMNS
+#define COLUMNAR_HISTORY_MAX_COLUMNS    16
+#endif
+
+// Size of each compressed block, including its header.
+#define COLUMNAR_HISTORY_BLOCK_BYTES    128
+
+// Value to record for a channel that has no reading.
+#define COLUMNAR_HISTORY_MISSING        INT32_MIN
+
+//
+// Delta + zig-zag varint codec used by the column blocks. Consecutive readings of a channel
+// are close to each other, so most deltas fit in one byte.
+//
+inline uint32_t zigzagEncode(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+inline int32_t zigzagDecode(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Writes value as a varint of 1 to 5 bytes, and returns the number of bytes written.
+inline size_t varintEncode(uint32_t value, uint8_t* out)
+{
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+// Reads a varint from in, and returns the number of bytes read.
+inline size_t varintDecode(const uint8_t* in, uint32_t& value)
+{
+    size_t length = 0;
+    uint32_t shift = 0;
+    value = 0;
+    uint8_t byte;
+    do {
+        byte = in[length++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && (shift < 35));
+    return length;
+}
+
+//
+// ColumnarHistory
+//
+// A time series of rows of int32_t values, stored as one compressed column per channel so that
+// a long history of many channels fits in the memory a single uncompressed channel would take.
+// Each column is a chain of fixed size blocks. A block holds its first value as is and the
+// rest as delta + zig-zag varints, so any block can be decoded on its own, and reading one
+// channel only touches that channel's blocks.
+//
+// The blocks come from one pool shared by all columns, so channels that compress well leave
+// room for those that don't. When the pool is used up, the oldest rows are dropped: the
+// retained rows start at the end of the column block that ends earliest, and the blocks that
+// hold only older rows are freed.
+//
+// Rows are numbered from 0 for the first row ever pushed. Channels that are not integers are
+// stored as fixed point values, scaled by the owner.
+//
+// This class does not allocate memory. The storage is provided by the owner through
+// setStorage(). It has no Arduino dependencies so that it can be benchmarked on the host. It
+// is not thread safe.
+//
+class ColumnarHistory {
+private:
+    static const uint16_t NO_BLOCK = 0xFFFF;
+    static const size_t PAYLOAD_BYTES = COLUMNAR_HISTORY_BLOCK_BYTES - 18;
+
+    struct Block {
+        uint32_t    first_row;
+        int32_t     first_value;
+        int32_t     last_value;     // so a value can be appended without decoding the block
+        uint16_t    count;
+        uint16_t    used;           // payload bytes
+        uint16_t    next;           // the column's next newer block, or NO_BLOCK
+        uint8_t     payload[PAYLOAD_BYTES];
+    };
+
+    struct Column {
+        uint16_t    head;           // oldest block
+        uint16_t    tail;           // newest block
+        uint32_t    block_count;
+    };
+
+    Block*      _blocks;
+    size_t      _blockCount;
+    uint16_t    _freeList;
+    size_t      _freeCount;
+    Column      _columns[COLUMNAR_HISTORY_MAX_COLUMNS];
+    uint8_t     _columnCount;
+    uint32_t    _oldestRow;
+    uint32_t    _nextRow;
+
+    uint16_t allocateBlock(void);
+    void freeOldBlocks(void);
+    void evictOldestRows(void);
+
+public:
+    ColumnarHistory();
+
+    // Sets the backing storage, which should be aligned for uint32_t, and the number of
+    // columns. Clears the history. Returns false if the storage does not hold at least two
+    // blocks per column.
+    bool setStorage(void* storage, size_t bytes, uint8_t column_count);
+
+    // Appends a row of columnCount() values.
+    void push(const int32_t* values);
+
+    uint8_t columnCount(void) const         { return _columnCount; }
+
+    // The retained rows are numbered from oldestRow() to nextRow() - 1.
+    uint32_t oldestRow(void) const          { return _oldestRow; }
+    uint32_t nextRow(void) const            { return _nextRow; }
+    size_t size(void) const                 { return _nextRow - _oldestRow; }
+
+    // Decodes up to max_count values of a column, starting from first_row, into out. Returns
+    // the number of values read, which is 0 if first_row is not retained.
+    size_t read(uint8_t column, uint32_t first_row, int32_t* out, size_t max_count) const;
+
+    // storage use
+    size_t blockCount(void) const           { return _blockCount; }
+    size_t blocksInUse(void) const          { return _blockCount - _freeCount; }
+    size_t columnBlocks(uint8_t column) const;
+    size_t bytesInUse(void) const           { return blocksInUse()*sizeof(Block); }
+};
+
+#endif // __ColumnarHistory__
@@ -0,0 +1,113 @@
+#include "DutyCycleScheduler.h"
+
+DutyCycleScheduler::DutyCycleScheduler(uint32_t radio_interval_millis, uint32_t radio_window_millis, uint32_t min_sleep_millis, const PowerModel& model)
+    :   _radioIntervalMillis(radio_interval_millis),
+        _radioWindowMillis(radio_window_millis),
+        _minSleepMillis(min_sleep_millis),
+        _model(model),
+        _startMillis(0),
+        _wakeMillis(0),
+        _hasWake(false),
+        _radioOn(false),
+        _radioOnMillis(0),
+        _nextRadioMillis(0),
+        _sleepMillis(0),
+        _radioMillis(0),
+        _wakeCount(0),
+        _radioWakeCount(0),
+        _sampleCount(0)
+{
+}
+
+void DutyCycleScheduler::begin(uint32_t now_millis)
+{
+    _startMillis = now_millis;
+    _hasWake = false;
+    _radioOn = true;
+    _radioOnMillis = now_millis;
+    _nextRadioMillis = now_millis + _radioIntervalMillis;
+    _sleepMillis = 0;
+    _radioMillis = 0;
+    _wakeCount = 0;
+    _radioWakeCount = 1;
+    _sampleCount = 0;
+}
+
+void DutyCycleScheduler::wakeAt(uint32_t due_millis)
+{
+    if (!_hasWake || ((int32_t)(due_millis - _wakeMillis) < 0)) {
+        _wakeMillis = due_millis;
+        _hasWake = true;
+    }
+}
+
+uint32_t DutyCycleScheduler::sleepMillis(uint32_t now_millis)
+{
+    bool has_wake = _hasWake;
+    _hasWake = false;
+    if (_radioOn || !has_wake) {
+        // with nothing scheduled there is no telling what the loop is waiting for
+        return 0;
+    }
+    uint32_t wake_millis = _wakeMillis;
+    if ((int32_t)(_nextRadioMillis - wake_millis) < 0) {
+        wake_millis = _nextRadioMillis;
+    }
+    int32_t sleep_millis = (int32_t)(wake_millis - now_millis);
+    if ((sleep_millis <= 0) || ((uint32_t)sleep_millis < _minSleepMillis)) {
+        return 0;
+    }
+    return sleep_millis;
+}
+
+void DutyCycleScheduler::slept(uint32_t sleep_millis, uint32_t wake_millis)
+{
+    _sleepMillis += wake_millis - sleep_millis;
+    _wakeCount++;
+}
+
+bool DutyCycleScheduler::updateRadio(uint32_t now_millis, bool busy)
+{
+    if (!_radioOn) {
+        if ((int32_t)(now_millis - _nextRadioMillis) >= 0) {
+            _radioOn = true;
+            _radioOnMillis = now_millis;
+            _radioWakeCount++;
+        }
+        return _radioOn;
+    }
+    if (busy && (now_millis - _radioOnMillis < _radioWindowMillis)) {
+        return true;
+    }
+    _radioOn = false;
+    _radioMillis += now_millis - _radioOnMillis;
+    // windows keep to their interval, unless this one ran past the start of the next
+    _nextRadioMillis = _radioOnMillis + _radioIntervalMillis;
+    if ((int32_t)(now_millis - _nextRadioMillis) >= 0) {
+        _nextRadioMillis = now_millis + _radioIntervalMillis;
+    }
+    return false;
+}
+
+DutyCycleStats DutyCycleScheduler::stats(uint32_t now_millis) const
+{
+    DutyCycleStats stats;
+    uint64_t elapsed = now_millis - _startMillis;
+    stats.sleepMillis = (_sleepMillis < elapsed) ? _sleepMillis : elapsed;
+    stats.awakeMillis = elapsed - stats.sleepMillis;
+    stats.radioMillis = _radioMillis + (_radioOn ? now_millis - _radioOnMillis : 0);
+    stats.wakeCount = _wakeCount;
+    stats.radioWakeCount = _radioWakeCount;
+    stats.sampleCount = _sampleCount;
+    stats.dutyCycle = (elapsed > 0) ? (float)stats.awakeMillis/(float)elapsed : 1;
+
+    // mA times ms times V is uJ
+    double milliamp_millis = (double)_model.baseMilliamps*elapsed
+                            + _model.activeMilliamps*stats.awakeMillis
+                            + _model.sleepMilliamps*stats.sleepMillis
+                            + _model.radioMilliamps*stats.radioMillis;
+    stats.averageMilliamps = (elapsed > 0) ? milliamp_millis/elapsed : 0;
+    stats.energyMillijoules = milliamp_millis*_model.supplyVolts/1000;
+    stats.energyPerSampleMillijoules = (_sampleCount > 0) ? stats.energyMillijoules/_sampleCount : 0;
+    return stats;
+}
@@ -0,0 +1,109 @@
+#ifndef __DutyCycleScheduler__
+#define __DutyCycleScheduler__
+#include <stdint.h>
+#include <stddef.h>
+
+// The power profiles the device can run in, for choosing one in the build configuration.
+#define POWER_PROFILE_ALWAYS_ON     0
+#define POWER_PROFILE_LOW_POWER     1
+
+//
+// Average current drawn by the device in each state, used to estimate its energy use.
+//
+struct PowerModel {
+    float   baseMilliamps;      // drawn all the time, such as by the sensors and regulator
+    float   activeMilliamps;    // added while the CPU is awake
+    float   sleepMilliamps;     // added while the CPU is in light sleep
+    float   radioMilliamps;     // added while the WiFi radio is on
+    float   supplyVolts;
+};
+
+//
+// Where the device's time and energy have gone since the scheduler was started.
+//
+struct DutyCycleStats {
+    uint64_t    awakeMillis;
+    uint64_t    sleepMillis;
+    uint64_t    radioMillis;        // time the radio was on
+    uint32_t    wakeCount;          // light sleeps woken from
+    uint32_t    radioWakeCount;     // times the radio was turned on
+    uint32_t    sampleCount;
+    float       dutyCycle;          // share of the time the CPU was awake, 0 to 1
+    float       averageMilliamps;
+    float       energyMillijoules;
+    float       energyPerSampleMillijoules;     // 0 until a sample has been taken
+};
+
+//
+// DutyCycleScheduler
+//
+// Decides when a battery powered device can light sleep and when its radio should be on.
+//
+// Each pass of the main loop, the subsystems report the earliest time they next need the CPU
+// with wakeAt(), and sleepMillis() then says how long the device can sleep. Sleeps shorter
+// than min_sleep_millis are not worth the wakeup and are skipped.
+//
+// The radio is turned on in windows, every radio_interval_millis, so that its wakeups are
+// batched around telemetry transmissions rather than spread across every sample. A window
+// stays open while the owner reports the radio is busy, such as while it connects or has
+// telemetry to send, for at most radio_window_millis. The device does not sleep while the
+// radio is on.
+//
+// The scheduler also keeps the time spent awake, asleep and with the radio on, from which it
+// estimates the duty cycle and the energy used per sample with a PowerModel. A device that
+// never sleeps still gets its energy estimates by never calling sleepMillis().
+//
+// Times are millis() values passed in by the owner, so the scheduling can be tested on the host
+// against a simulated clock. It is not thread safe.
+//
+class DutyCycleScheduler {
+private:
+    uint32_t    _radioIntervalMillis;
+    uint32_t    _radioWindowMillis;
+    uint32_t    _minSleepMillis;
+    PowerModel  _model;
+
+    uint32_t    _startMillis;
+    uint32_t    _wakeMillis;        // earliest time needed this pass
+    bool        _hasWake;
+
+    bool        _radioOn;
+    uint32_t    _radioOnMillis;     // time the radio was last turned on
+    uint32_t    _nextRadioMillis;
+
+    uint64_t    _sleepMillis;
+    uint64_t    _radioMillis;       // for radio windows that have closed
+    uint32_t    _wakeCount;
+    uint32_t    _radioWakeCount;
+    uint32_t    _sampleCount;
+
+public:
+    DutyCycleScheduler(uint32_t radio_interval_millis, uint32_t radio_window_millis, uint32_t min_sleep_millis, const PowerModel& model);
+
+    // Starts the scheduler and its accounting at now_millis with the radio on, as it is when the
+    // device boots. The first radio window closes once the radio is no longer busy.
+    void begin(uint32_t now_millis);
+
+    // Notes that something needs the CPU at due_millis. Cleared by sleepMillis().
+    void wakeAt(uint32_t due_millis);
+
+    // Returns how long the device can light sleep from now_millis, or 0 if it should stay
+    // awake, and clears the wake times for the next pass. Also wakes for the next radio window.
+    uint32_t sleepMillis(uint32_t now_millis);
+
+    // Accounts for a light sleep from sleep_millis that was woken from at wake_millis.
+    void slept(uint32_t sleep_millis, uint32_t wake_millis);
+
+    // Opens a radio window when one is due, and closes the open one once the radio is not busy
+    // or the window has run its length. Returns true if the radio should be on.
+    bool updateRadio(uint32_t now_millis, bool busy);
+    bool isRadioOn(void) const              { return _radioOn; }
+    uint32_t nextRadioMillis(void) const    { return _nextRadioMillis; }
+
+    // Counts a sample taken, for the energy per sample.
+    void countSample(void)                  { _sampleCount++; }
+
+    DutyCycleStats stats(uint32_t now_millis) const;
+};
+
+#endif // __DutyCycleScheduler__
@@ -0,0 +1,47 @@
+#ifndef __BME680Device__
+#define __BME680Device__
+#include <Adafruit_BME680.h>
+#include "EnvironmentSensor.h"
+
+//
+// BME680Device
+//
+// An EnvironmentSensorDevice for a BME680 on the Adafruit driver. The measurement, including the
+// gas heater cycle, runs between beginReading() and the driver reporting no remaining time, so
+// endReading() only reads the results out and does not wait. The sensor must already be set up
+// with Adafruit_BME680::begin() and its oversampling and heater settings.
+//
+class BME680Device : public EnvironmentSensorDevice {
+private:
+    Adafruit_BME680&    _bme680;
+
+public:
+    explicit BME680Device(Adafruit_BME680& bme680)
+        :   _bme680(bme680)
+    {
+    }
+
+    bool startReading(void) override
+    {
+        return (_bme680.beginReading() != 0);
+    }
+
+    int32_t remainingReadingMillis(void) override
+    {
+        return _bme680.remainingReadingMillis();
+    }
+
+    bool finishReading(EnvironmentReading& reading) override
+    {
+        if (!_bme680.endReading()) {
+            return false;
+        }
+        reading.temperature = _bme680.temperature;          // °C
+        reading.pressure = _bme680.pressure / 100.0;        // hPa
+        reading.humidity = _bme680.humidity;                // %
+        reading.gasResistance = _bme680.gas_resistance;     // ohms
+        return true;
+    }
+};
+
+#endif // __BME680Device__
@@ -0,0 +1,212 @@
+#include <math.h>
+#include <Logger.h>
+#include "EnvironmentSensor.h"
+
+// lengths of the EnvironmentWindow windows
+static const uint32_t ENVIRONMENT_WINDOW_MILLIS[ENVIRONMENT_WINDOW_COUNT] = {
+    10*60*1000UL,
+    60*60*1000UL
+};
+
+// A channel's history sample is (value + offset)*scale.
+struct EnvironmentChannelEncoding {
+    float   scale;
+    float   offset;
+};
+
+static const EnvironmentChannelEncoding ENVIRONMENT_CHANNEL_ENCODINGS[ENVIRONMENT_CHANNEL_COUNT] = {
+    {100, 40},      // temperature, 0.01 °C from -40 °C
+    {100, 0},       // humidity, 0.01 %
+    {10, 0},        // pressure, 0.1 hPa
+    {0.01, 0}       // gas resistance, 100 ohms
+};
+
+uint16_t EnvironmentSensor::encodeSample(EnvironmentChannel channel, float value)
+{
+    const EnvironmentChannelEncoding& encoding = ENVIRONMENT_CHANNEL_ENCODINGS[channel];
+    float sample = (value + encoding.offset)*encoding.scale;
+    if (!(sample > 0)) {
+        return 0;
+    }
+    if (sample >= UINT16_MAX) {
+        return UINT16_MAX;
+    }
+    return (uint16_t)lroundf(sample);
+}
+
+float EnvironmentSensor::decodeSample(EnvironmentChannel channel, float sample)
+{
+    const EnvironmentChannelEncoding& encoding = ENVIRONMENT_CHANNEL_ENCODINGS[channel];
+    return sample/encoding.scale - encoding.offset;
+}
+
+EnvironmentSensor::EnvironmentSensor(EnvironmentSensorDevice& device, uint32_t period_millis, uint32_t timeout_millis)
+    :   _device(device),
+        _periodMillis((period_millis > 0) ? period_millis : 1),
+        _timeoutMillis(timeout_millis),
+        _state(STATE_IDLE),
+        _started(false),
+        _nextStartMillis(0),
+        _measureStartMillis(0),
+        _latest(),
+        _hasReading(false),
+        _readingCount(0),
+        _failureCount(0),
+        _timeoutCount(0),
+        _histories()
+{
+    for (uint8_t c = 0; c < ENVIRONMENT_CHANNEL_COUNT; c++) {
+        for (uint8_t w = 0; w < ENVIRONMENT_WINDOW_COUNT; w++) {
+            _windows[c][w] = INVALID_SAMPLE_WINDOW;
+        }
+    }
+}
+
+size_t EnvironmentSensor::sampleCapacity(uint32_t period_millis)
+{
+    if (period_millis == 0) {
+        period_millis = 1;
+    }
+    return ENVIRONMENT_WINDOW_MILLIS[ENVIRONMENT_WINDOW_COUNT - 1]/period_millis + 1;
+}
+
+// each channel's storage is rounded up to keep the next one aligned for uint32_t
+static size_t channelStorageBytes(size_t sample_capacity)
+{
+    return (SampleHistory::storageBytes(sample_capacity, nullptr, 0) + 3) & ~(size_t)3;
+}
+
+size_t EnvironmentSensor::storageBytes(size_t sample_capacity)
+{
+    return ENVIRONMENT_CHANNEL_COUNT*channelStorageBytes(sample_capacity);
+}
+
+void EnvironmentSensor::setStorage(void* storage, size_t sample_capacity)
+{
+    uint8_t* next_storage = (uint8_t*)storage;
+    for (uint8_t c = 0; c < ENVIRONMENT_CHANNEL_COUNT; c++) {
+        SampleHistory& history = _histories[c];
+        if (next_storage != nullptr) {
+            history.setStorage(next_storage, sample_capacity);
+            next_storage += channelStorageBytes(sample_capacity);
+        } else {
+            history.setStorage(nullptr, 0);
+        }
+        // Readings more than ENVIRONMENT_GAP_SAMPLE_PERIODS apart are on either side of a gap,
+        // such as a run of failed readings, which the averages do not span.
+        history.setSamplePeriod(_periodMillis, ENVIRONMENT_GAP_SAMPLE_PERIODS*_periodMillis);
+        for (uint8_t w = 0; w < ENVIRONMENT_WINDOW_COUNT; w++) {
+            _windows[c][w] = history.registerWindow(ENVIRONMENT_WINDOW_MILLIS[w]);
+        }
+    }
+}
+
+void EnvironmentSensor::begin(uint32_t now_millis)
+{
+    _state = STATE_IDLE;
+    _started = true;
+    _nextStartMillis = now_millis;
+}
+
+bool EnvironmentSensor::isDue(uint32_t now_millis) const
+{
+    if (_state == STATE_IDLE) {
+        return _started && ((int32_t)(now_millis - _nextStartMillis) >= 0);
+    }
+    return (_device.remainingReadingMillis() <= 0) || (now_millis - _measureStartMillis >= _timeoutMillis);
+}
+
+uint32_t EnvironmentSensor::nextDueMillis(uint32_t now_millis) const
+{
+    if (isDue(now_millis)) {
+        return now_millis;
+    }
+    if (_state == STATE_IDLE) {
+        return _nextStartMillis;
+    }
+    uint32_t remaining = _device.remainingReadingMillis();
+    uint32_t timeout = _measureStartMillis + _timeoutMillis - now_millis;
+    return now_millis + ((remaining < timeout) ? remaining : timeout);
+}
+
+bool EnvironmentSensor::poll(uint32_t now_millis)
+{
+    if (_state == STATE_IDLE) {
+        if (!_started || ((int32_t)(now_millis - _nextStartMillis) < 0)) {
+            return false;
+        }
+        // keep to the cadence, unless the loop fell a whole period behind it
+        _nextStartMillis += _periodMillis;
+        if ((int32_t)(now_millis - _nextStartMillis) >= 0) {
+            _nextStartMillis = now_millis + _periodMillis;
+        }
+        if (!_device.startReading()) {
+            LOG_ERROR("ERROR - Failed to begin environment sensor reading");
+            failReading();
+            return false;
+        }
+        _state = STATE_MEASURING;
+        _measureStartMillis = now_millis;
+        return false;
+    }
+
+    int32_t remaining = _device.remainingReadingMillis();
+    if (remaining > 0) {
+        if (now_millis - _measureStartMillis < _timeoutMillis) {
+            return false;
+        }
+        LOG_ERROR("ERROR - Environment sensor reading did not finish within %u ms", _timeoutMillis);
+        _timeoutCount++;
+    }
+    _state = STATE_IDLE;
+
+    EnvironmentReading reading;
+    if ((remaining != 0) || !_device.finishReading(reading)) {
+        if (remaining <= 0) {
+            LOG_ERROR("ERROR - Could not finish environment sensor reading");
+        }
+        failReading();
+        return false;
+    }
+    reading.readingMillis = now_millis;
+    recordReading(reading);
+    return true;
+}
+
+void EnvironmentSensor::failReading(void)
+{
+    _failureCount++;
+    _hasReading = false;
+}
+
+void EnvironmentSensor::recordReading(const EnvironmentReading& reading)
+{
+    _latest = reading;
+    _hasReading = true;
+    _readingCount++;
+
+    uint32_t time = reading.readingMillis;
+    _histories[ENVIRONMENT_CHANNEL_TEMPERATURE].push(encodeSample(ENVIRONMENT_CHANNEL_TEMPERATURE, reading.temperature), time);
+    _histories[ENVIRONMENT_CHANNEL_HUMIDITY].push(encodeSample(ENVIRONMENT_CHANNEL_HUMIDITY, reading.humidity), time);
+    _histories[ENVIRONMENT_CHANNEL_PRESSURE].push(encodeSample(ENVIRONMENT_CHANNEL_PRESSURE, reading.pressure), time);
+    if (reading.gasResistance > 0) {
+        _histories[ENVIRONMENT_CHANNEL_GAS_RESISTANCE].push(encodeSample(ENVIRONMENT_CHANNEL_GAS_RESISTANCE, reading.gasResistance), time);
+    }
+}
+
+bool EnvironmentSensor::windowAverage(EnvironmentChannel channel, EnvironmentWindow window, float& average) const
+{
+    // a window ends at its history's newest sample, so one whose channel stopped being read,
+    // such as gas resistance while the heater is failing, would keep its stale average
+    SampleWindowStats stats = windowStats(channel, window);
+    if ((stats.samples == 0) || (_latest.readingMillis - _histories[channel].newestTime() >= ENVIRONMENT_WINDOW_MILLIS[window])) {
+        return false;
+    }
+    average = decodeSample(channel, stats.average);
+    return true;
+}
+
+SampleWindowStats EnvironmentSensor::windowStats(EnvironmentChannel channel, EnvironmentWindow window) const
+{
+    return _histories[channel].windowStats(_windows[channel][window]);
+}
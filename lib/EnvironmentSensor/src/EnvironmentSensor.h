@@ -0,0 +1,164 @@
+#ifndef __EnvironmentSensor__
+#define __EnvironmentSensor__
+#include <stdint.h>
+#include <stddef.h>
+#include <SampleHistory.h>
+
+// sample periods without a reading after which the averages treat the time as a gap
+#ifndef ENVIRONMENT_GAP_SAMPLE_PERIODS
+#define ENVIRONMENT_GAP_SAMPLE_PERIODS  3
+#endif
+
+//
+// One reading of an environment sensor.
+//
+struct EnvironmentReading {
+    float       temperature;    // °C
+    float       pressure;       // hPa
+    float       humidity;       // %
+    uint32_t    gasResistance;  // ohms, or 0 if the gas heater did not reach its temperature
+    uint32_t    readingMillis;  // millis() time the reading was finished
+};
+
+// The channels that have a history, as indexes of EnvironmentSensor's histories.
+enum EnvironmentChannel : uint8_t {
+    ENVIRONMENT_CHANNEL_TEMPERATURE,
+    ENVIRONMENT_CHANNEL_HUMIDITY,
+    ENVIRONMENT_CHANNEL_PRESSURE,
+    ENVIRONMENT_CHANNEL_GAS_RESISTANCE,
+
+    ENVIRONMENT_CHANNEL_COUNT
+};
+
+// The averaging windows registered on each channel's history.
+enum EnvironmentWindow : uint8_t {
+    ENVIRONMENT_WINDOW_10MIN,
+    ENVIRONMENT_WINDOW_1HOUR,
+
+    ENVIRONMENT_WINDOW_COUNT
+};
+
+//
+// EnvironmentSensorDevice
+//
+// The interface EnvironmentSensor uses to talk to the sensor. A reading is split into starting
+// the measurement, which returns right away, and reading it out once the sensor is done, so
+// nothing waits on the sensor.
+//
+class EnvironmentSensorDevice {
+public:
+    virtual ~EnvironmentSensorDevice() {}
+
+    // Starts a measurement. Returns false if it could not be started.
+    virtual bool startReading(void) = 0;
+
+    // Returns the milliseconds until the started measurement is done, 0 if it is done, or -1 if
+    // no measurement was started.
+    virtual int32_t remainingReadingMillis(void) = 0;
+
+    // Reads out the finished measurement. Returns false if it could not be read.
+    virtual bool finishReading(EnvironmentReading& reading) = 0;
+};
+
+//
+// EnvironmentSensor
+//
+// Samples an environment sensor on its own cadence without blocking. poll() is called from the
+// main loop as often as it runs: when a reading is due it starts the measurement, and on later
+// polls it checks whether the measurement is done and reads it out, so the loop never waits
+// out the sensor's measurement time. A measurement that is not done within the timeout counts
+// as a failed reading.
+//
+// Each successful reading goes into a SampleHistory per channel with 10 minute and 1 hour
+// averaging windows. The histories hold uint16_t samples, so the channels are stored as fixed
+// point values: temperature in 0.01 °C above -40 °C, humidity in 0.01 %, pressure in 0.1 hPa
+// and gas resistance in 100 ohms, which clamps at 6.5 Mohm. A reading without a valid gas
+// resistance only leaves a gap in the gas resistance history.
+//
+// This class does not allocate memory. The history storage is provided by the owner through
+// setStorage(). It has no Arduino dependencies so that it can be tested on the host.
+//
+class EnvironmentSensor {
+private:
+    enum State : uint8_t {
+        STATE_IDLE,
+        STATE_MEASURING
+    };
+
+    EnvironmentSensorDevice&    _device;
+    uint32_t        _periodMillis;
+    uint32_t        _timeoutMillis;
+
+    State           _state;
+    bool            _started;
+    uint32_t        _nextStartMillis;
+    uint32_t        _measureStartMillis;
+
+    EnvironmentReading  _latest;
+    bool            _hasReading;
+
+    uint32_t        _readingCount;
+    uint32_t        _failureCount;
+    uint32_t        _timeoutCount;
+
+    SampleHistory   _histories[ENVIRONMENT_CHANNEL_COUNT];
+    SampleWindowID  _windows[ENVIRONMENT_CHANNEL_COUNT][ENVIRONMENT_WINDOW_COUNT];
+
+    void recordReading(const EnvironmentReading& reading);
+    void failReading(void);
+
+public:
+    // The device must outlive the sensor.
+    EnvironmentSensor(EnvironmentSensorDevice& device, uint32_t period_millis, uint32_t timeout_millis);
+
+    // Returns the number of full resolution samples each channel needs to hold its longest window.
+    static size_t sampleCapacity(uint32_t period_millis);
+
+    // Returns the number of bytes of storage needed for the channel histories.
+    static size_t storageBytes(size_t sample_capacity);
+
+    // Sets the backing storage for the channel histories, which must be at least storageBytes()
+    // in size and aligned for uint32_t, and registers the averaging windows. Clears the histories.
+    void setStorage(void* storage, size_t sample_capacity);
+
+    // Starts the cadence. The first reading is started by the first poll at or after now_millis.
+    void begin(uint32_t now_millis);
+
+    // true if poll() would talk to the device: a reading is due, or the measurement in progress
+    // is done or has timed out.
+    bool isDue(uint32_t now_millis) const;
+
+    // Returns the next time poll() needs to be called, which is now_millis if it is due. Only
+    // meaningful once begin() has been called.
+    uint32_t nextDueMillis(uint32_t now_millis) const;
+
+    // Starts a reading if one is due, or finishes the one in progress if the device is done with
+    // it. Returns true if a reading was finished successfully.
+    bool poll(uint32_t now_millis);
+
+    uint32_t periodMillis(void) const                   { return _periodMillis; }
+    bool isMeasuring(void) const                        { return _state == STATE_MEASURING; }
+
+    // true if the most recent reading succeeded, in which case it is latestReading()
+    bool hasReading(void) const                         { return _hasReading; }
+
+    // the most recent successful reading. Only meaningful once a reading has succeeded.
+    const EnvironmentReading& latestReading(void) const { return _latest; }
+
+    // readings finished successfully, and readings that failed, including those that timed out
+    uint32_t readingCount(void) const                   { return _readingCount; }
+    uint32_t failureCount(void) const                   { return _failureCount; }
+    uint32_t timeoutCount(void) const                   { return _timeoutCount; }
+
+    // Returns the window's average of the channel in the channel's units. Returns false if the
+    // window is empty, or the channel has had no samples for the window's length.
+    bool windowAverage(EnvironmentChannel channel, EnvironmentWindow window, float& average) const;
+    SampleWindowStats windowStats(EnvironmentChannel channel, EnvironmentWindow window) const;
+    const SampleHistory& history(EnvironmentChannel channel) const  { return _histories[channel]; }
+
+    // conversions between channel values and their history samples
+    static uint16_t encodeSample(EnvironmentChannel channel, float value);
+    static float decodeSample(EnvironmentChannel channel, float sample);
+};
+
+#endif // __EnvironmentSensor__
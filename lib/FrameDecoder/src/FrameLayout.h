@@ -0,0 +1,192 @@
+#ifndef __FrameLayout__
+#define __FrameLayout__
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+//
+// Compile-time descriptions of the parts of a fixed size sensor frame: fixed bytes, checksums,
+// measurement fields, and the commands sent to the sensor. A sensor protocol is a struct of
+// typedefs built from these (see ParticulateProtocols.h), and ParticulateFrameDecoder reads
+// frames through them. Offsets and sizes are template arguments, so each protocol's checks
+// and field reads compile to straight-line code.
+//
+// These have no Arduino dependencies so that they can be tested on the host.
+//
+
+enum FrameByteOrder : uint8_t {
+    FRAME_LITTLE_ENDIAN,
+    FRAME_BIG_ENDIAN
+};
+
+//
+// Fixed bytes starting at OFFSET, such as a start byte, a header or an end byte.
+//
+template <uint8_t OFFSET, uint8_t... BYTES>
+struct FrameConstant;
+
+template <uint8_t OFFSET>
+struct FrameConstant<OFFSET> {
+    static const uint8_t END = OFFSET;      // the offset after the last fixed byte
+
+    static bool matches(const uint8_t* /*frame*/)       { return true; }
+    static bool matchesByte(uint8_t /*idx*/, uint8_t /*byte*/)  { return true; }
+};
+
+template <uint8_t OFFSET, uint8_t FIRST, uint8_t... REST>
+struct FrameConstant<OFFSET, FIRST, REST...> {
+    static const uint8_t FIRST_BYTE = FIRST;
+    static const uint8_t END = FrameConstant<OFFSET + 1, REST...>::END;
+
+    static bool matches(const uint8_t* frame)
+    {
+        return (frame[OFFSET] == FIRST) && FrameConstant<OFFSET + 1, REST...>::matches(frame);
+    }
+
+    // false if idx is one of the fixed bytes and byte is not the byte expected there
+    static bool matchesByte(uint8_t idx, uint8_t byte)
+    {
+        return (idx == OFFSET) ? (byte == FIRST) : FrameConstant<OFFSET + 1, REST...>::matchesByte(idx, byte);
+    }
+};
+
+//
+// A frame is valid only if all of CHECKS match.
+//
+template <typename... CHECKS>
+struct FrameChecks;
+
+template <>
+struct FrameChecks<> {
+    static bool matches(const uint8_t* /*frame*/)       { return true; }
+};
+
+template <typename FIRST, typename... REST>
+struct FrameChecks<FIRST, REST...> {
+    static bool matches(const uint8_t* frame)           { return FIRST::matches(frame) && FrameChecks<REST...>::matches(frame); }
+};
+
+//
+// Checksums over the bytes FIRST through LAST, stored at AT.
+//
+
+// the XOR of the bytes
+template <uint8_t FIRST, uint8_t LAST, uint8_t AT>
+struct XorChecksum {
+    static bool matches(const uint8_t* frame)
+    {
+        uint8_t fcc = 0;
+        for (uint8_t i = FIRST; i <= LAST; i++) {
+            fcc ^= frame[i];
+        }
+        return (fcc == frame[AT]);
+    }
+};
+
+// the 16 bit sum of the bytes, stored big endian
+template <uint8_t FIRST, uint8_t LAST, uint8_t AT>
+struct SumChecksum16 {
+    static bool matches(const uint8_t* frame)
+    {
+        uint16_t sum = 0;
+        for (uint8_t i = FIRST; i <= LAST; i++) {
+            sum += frame[i];
+        }
+        return (sum == (((uint16_t)frame[AT] << 8) | frame[AT + 1]));
+    }
+};
+
+// the low byte of the sum of the bytes, inverted
+template <uint8_t FIRST, uint8_t LAST, uint8_t AT>
+struct InvertedSumChecksum8 {
+    static bool matches(const uint8_t* frame)
+    {
+        uint8_t sum = 0;
+        for (uint8_t i = FIRST; i <= LAST; i++) {
+            sum += frame[i];
+        }
+        return ((uint8_t)~sum == frame[AT]);
+    }
+};
+
+//
+// Byte stuffing. With FrameEscape, a byte in the stream equal to the frame's first byte only
+// ever starts or ends a frame. Inside a frame that value, ESCAPE itself and any other bytes
+// the protocol reserves are sent as ESCAPE followed by the byte XORed with MASK.
+//
+struct FrameNoEscape {
+    static const bool ENABLED = false;
+    static const uint8_t ESCAPE = 0;
+    static const uint8_t MASK = 0;
+};
+
+template <uint8_t ESCAPE_BYTE, uint8_t MASK_BYTE>
+struct FrameEscape {
+    static const bool ENABLED = true;
+    static const uint8_t ESCAPE = ESCAPE_BYTE;
+    static const uint8_t MASK = MASK_BYTE;
+};
+
+//
+// Measurement fields. Each reads as an unsigned 32 bit value.
+//
+
+// an unsigned integer of SIZE bytes at OFFSET
+template <uint8_t OFFSET, uint8_t SIZE, FrameByteOrder ORDER>
+struct FrameInteger {
+    static uint32_t read(const uint8_t* frame)
+    {
+        uint32_t value = 0;
+        for (uint8_t i = 0; i < SIZE; i++) {
+            value = (value << 8) | frame[(ORDER == FRAME_BIG_ENDIAN) ? (OFFSET + i) : (OFFSET + SIZE - 1 - i)];
+        }
+        return value;
+    }
+};
+
+// a big endian IEEE 754 float at OFFSET, multiplied by SCALE and rounded. Negative values read as 0.
+template <uint8_t OFFSET, uint32_t SCALE>
+struct FrameFloat {
+    static uint32_t read(const uint8_t* frame)
+    {
+        uint32_t bits = FrameInteger<OFFSET, 4, FRAME_BIG_ENDIAN>::read(frame);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        value *= SCALE;
+        if (!(value > 0)) {
+            return 0;
+        }
+        if (value >= 4294967040.0f) {
+            return UINT32_MAX;
+        }
+        return (uint32_t)(value + 0.5f);
+    }
+};
+
+// a field the sensor does not report
+struct FrameAbsent {
+    static uint32_t read(const uint8_t* /*frame*/)      { return 0; }
+};
+
+//
+// Bytes sent to the sensor, such as a command to start measuring.
+//
+template <uint8_t... BYTES>
+struct FrameCommand {
+    static const size_t SIZE = sizeof...(BYTES);
+
+    static const uint8_t* bytes(void)
+    {
+        static const uint8_t COMMAND[] = {BYTES...};
+        return COMMAND;
+    }
+};
+
+template <>
+struct FrameCommand<> {
+    static const size_t SIZE = 0;
+
+    static const uint8_t* bytes(void)                   { return nullptr; }
+};
+
+#endif // __FrameLayout__
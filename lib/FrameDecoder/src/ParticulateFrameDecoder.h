@@ -0,0 +1,228 @@
+#ifndef __ParticulateFrameDecoder__
+#define __ParticulateFrameDecoder__
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "FrameLayout.h"
+
+//
+// A decoded particulate measurement. Mass densities are in ug/m^3.
+//
+struct ParticulateMeasurement {
+    uint32_t    pm1p0;
+    uint32_t    pm2p5;
+    uint32_t    pm10;
+    uint16_t    particleCount0p5um;
+    uint16_t    particleCount1p0um;
+    uint16_t    particleCount2p5um;
+    uint16_t    particleCount5p0um;
+    uint16_t    particleCount7p5um;
+    uint16_t    particleCount10um;
+    uint8_t     sensorStatus;
+};
+
+template <uint8_t SIZE>
+struct ParticulateFrame {
+    uint8_t     bytes[SIZE];
+    uint32_t    receive_millis;     // time the last byte of the frame was received
+};
+
+struct ParticulateFrameCounters {
+    uint32_t    valid;          // valid frames
+    uint32_t    corrupt;        // complete candidate frames that failed validation
+    uint32_t    dropped;        // valid frames superseded before being taken
+    uint32_t    discarded;      // bytes skipped while searching for a frame start
+};
+
+//
+// ParticulateFrameDecoder
+//
+// Incremental decoder for a particulate sensor's UART stream, specialized at compile time for
+// one sensor protocol (see ParticulateProtocols.h). Bytes are pushed as they arrive, and the
+// decoder finds frame boundaries by looking for the first byte of the protocol's header. The
+// rest of the header is checked as it arrives, and the trailer and checksum once the frame is
+// complete. When a candidate frame fails, decoding resumes at the next possible frame start
+// within the candidate, so the decoder resynchronizes to the stream at the byte level without
+// discarding good data. For protocols with byte stuffing, escaped bytes are restored as they
+// are pushed, and an unescaped start byte always starts a new frame.
+//
+// Only the newest valid frame is retained. Counters track valid frames, corrupt candidate
+// frames, valid frames that were superseded before being taken, and bytes skipped while
+// searching for a frame start.
+//
+// This class has no Arduino dependencies so that it can be tested on the host.
+//
+template <typename Protocol>
+class ParticulateFrameDecoder {
+public:
+    typedef ParticulateFrame<Protocol::FRAME_SIZE> Frame;
+
+private:
+    static const uint8_t FRAME_SIZE = Protocol::FRAME_SIZE;
+    static const uint8_t START_BYTE = Protocol::Header::FIRST_BYTE;
+
+    uint8_t         _buffer[FRAME_SIZE];
+    uint8_t         _length;
+    bool            _escaped;
+
+    Frame           _latest;
+    bool            _hasLatest;
+    bool            _latestIsNew;
+
+    ParticulateFrameCounters _counters;
+
+    void resync(void)
+    {
+        // The candidate frame is bad. The real frame start may be anywhere inside it, so
+        // restart at the next start byte rather than dropping the whole candidate.
+        uint8_t next_start = 1;
+        while ((next_start < _length) && (_buffer[next_start] != START_BYTE)) {
+            next_start++;
+        }
+        _counters.discarded += next_start;
+        _length -= next_start;
+        memmove(_buffer, _buffer + next_start, _length);
+    }
+
+    static uint16_t clampCount(uint32_t count)
+    {
+        return (count > UINT16_MAX) ? UINT16_MAX : count;
+    }
+
+public:
+    ParticulateFrameDecoder()
+        :   _length(0),
+            _escaped(false),
+            _hasLatest(false),
+            _latestIsNew(false)
+    {
+        memset(&_counters, 0, sizeof(_counters));
+    }
+
+    // clears any partial frame and the latched frame. Counters are retained.
+    void reset(void)
+    {
+        _length = 0;
+        _escaped = false;
+        _hasLatest = false;
+        _latestIsNew = false;
+    }
+
+    // Pushes one received byte. Returns true if the byte completed a valid frame.
+    bool push(uint8_t byte, uint32_t receive_millis)
+    {
+        bool is_start = (byte == START_BYTE);
+        if (Protocol::Escape::ENABLED) {
+            if (is_start) {
+                _escaped = false;
+                if ((_length > 0) && (_length < FRAME_SIZE - 1)) {
+                    // an unescaped start byte can only start or end a frame, so this one was cut short
+                    _counters.discarded += _length;
+                    _length = 0;
+                }
+            } else if (byte == Protocol::Escape::ESCAPE) {
+                if (_length == 0) {
+                    _counters.discarded++;
+                } else {
+                    _escaped = true;
+                }
+                return false;
+            } else if (_escaped) {
+                byte ^= Protocol::Escape::MASK;
+                _escaped = false;
+            }
+        }
+        if ((_length == 0) && !is_start) {
+            _counters.discarded++;
+            return false;
+        }
+
+        _buffer[_length++] = byte;
+        if ((_length <= Protocol::Header::END) && !Protocol::Header::matchesByte(_length - 1, byte)) {
+            resync();
+            return false;
+        }
+        if (_length < FRAME_SIZE) {
+            return false;
+        }
+
+        if (!isValidFrame(_buffer)) {
+            _counters.corrupt++;
+            resync();
+            return false;
+        }
+
+        if (_latestIsNew) {
+            _counters.dropped++;
+        }
+        memcpy(_latest.bytes, _buffer, FRAME_SIZE);
+        _latest.receive_millis = receive_millis;
+        _hasLatest = true;
+        _latestIsNew = true;
+        _counters.valid++;
+        _length = 0;
+        return true;
+    }
+
+    // Pushes a run of received bytes. Returns the number of valid frames completed.
+    size_t push(const uint8_t* bytes, size_t count, uint32_t receive_millis)
+    {
+        size_t frames = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (push(bytes[i], receive_millis)) {
+                frames++;
+            }
+        }
+        return frames;
+    }
+
+    // true if a valid frame has been decoded that has not yet been taken
+    bool hasNewFrame(void) const                { return _latestIsNew; }
+
+    // true if any valid frame has been decoded
+    bool hasFrame(void) const                   { return _hasLatest; }
+
+    // the newest valid frame. Only meaningful if hasFrame() is true.
+    const Frame& latestFrame(void) const        { return _latest; }
+
+    // Copies the newest valid frame into frame and marks it as taken. Returns false if
+    // there is no frame that has not already been taken.
+    bool takeFrame(Frame& frame)
+    {
+        if (!_latestIsNew) {
+            return false;
+        }
+        frame = _latest;
+        _latestIsNew = false;
+        return true;
+    }
+
+    const ParticulateFrameCounters& counters(void) const    { return _counters; }
+    uint32_t validFrameCount(void) const        { return _counters.valid; }
+    uint32_t corruptFrameCount(void) const      { return _counters.corrupt; }
+    uint32_t droppedFrameCount(void) const      { return _counters.dropped; }
+    uint32_t discardedByteCount(void) const     { return _counters.discarded; }
+
+    // returns true if the FRAME_SIZE bytes at frame, with any byte stuffing removed, are a valid frame
+    static bool isValidFrame(const uint8_t* frame)
+    {
+        return Protocol::Header::matches(frame) && Protocol::Trailer::matches(frame) && Protocol::Checksum::matches(frame);
+    }
+
+    // Reads the measurement fields of a valid frame.
+    static void decode(const uint8_t* frame, ParticulateMeasurement& measurement)
+    {
+        measurement.pm1p0 = Protocol::PM1p0::read(frame);
+        measurement.pm2p5 = Protocol::PM2p5::read(frame);
+        measurement.pm10 = Protocol::PM10::read(frame);
+        measurement.particleCount0p5um = clampCount(Protocol::Count0p5um::read(frame));
+        measurement.particleCount1p0um = clampCount(Protocol::Count1p0um::read(frame));
+        measurement.particleCount2p5um = clampCount(Protocol::Count2p5um::read(frame));
+        measurement.particleCount5p0um = clampCount(Protocol::Count5p0um::read(frame));
+        measurement.particleCount7p5um = clampCount(Protocol::Count7p5um::read(frame));
+        measurement.particleCount10um = clampCount(Protocol::Count10um::read(frame));
+        measurement.sensorStatus = Protocol::Status::read(frame);
+    }
+};
+
+#endif // __ParticulateFrameDecoder__
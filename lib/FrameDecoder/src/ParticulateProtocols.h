@@ -0,0 +1,204 @@
+#ifndef __ParticulateProtocols__
+#define __ParticulateProtocols__
+#include "FrameLayout.h"
+
+//
+// Descriptions of the UART protocols of the supported particulate sensors, for
+// ParticulateFrameDecoder and the sensor drivers. Each protocol gives:
+//
+//   name()             the sensor model
+//   FRAME_SIZE         the size of a measurement frame, after any byte stuffing is removed
+//   Escape             FrameNoEscape or FrameEscape
+//   Header             the fixed bytes that start a frame. Its first byte is what the decoder
+//                      looks for to find a frame, and the rest are checked as they arrive.
+//   Trailer            fixed bytes checked once the frame is complete
+//   Checksum           the frame's checksum
+//   PM1p0 ... Status   the measurement fields, in ug/m^3 for the mass densities. Particle counts
+//                      are as the sensor reports them. Sensors that do not report the status
+//                      read as 0, which means normal.
+//   BAUD_RATE, EVEN_PARITY
+//                      the UART settings, always 8 data bits and 1 stop bit
+//   WARMUP_MILLIS      how long after power up the readings are not yet usable
+//   StartCommand       sent once when the UART is started
+//   PollCommand, POLL_MILLIS
+//                      sent every POLL_MILLIS for sensors that only answer requests. 0 for
+//                      sensors that send frames on their own.
+//
+
+#define PARTICULATE_SENSOR_NONE     0
+#define PARTICULATE_SENSOR_SNGCJA5  1
+#define PARTICULATE_SENSOR_PMS5003  2
+#define PARTICULATE_SENSOR_SPS30    3
+
+//
+// Panasonic SN-GCJA5 UART frame layout. Each frame is 32 bytes:
+//   byte 0         STX (0x02)
+//   bytes 1-28     measurement data
+//   byte 29        sensor status
+//   byte 30        FCC, the XOR of bytes 1 through 29
+//   byte 31        ETX (0x03)
+//
+// The English documentation for sensor communications is foound here:
+//      https://b2b-api.panasonic.eu/file_stream/pids/fileversion/8814
+// it is very confusing and clearly not written by someone who speaks  English. What is unclear
+// is that the I2C and UART interfaces actually provide numbers that are formatted differently.
+// Using Google translate on the Japanse version of the document yields a much better translation.
+//      https://industrial.panasonic.com/content/data/PPL/PDF/JA5-SSP-COMM-v10_Communication-Spec_j.pdf
+// In that translation, it becomes clearer that the mass density measurements are scaled by
+// 1000 in the I2C interface, and NOT sclaed by 1000 in the UART interface. Furthermore, despite
+// the UART interface providing 4 bytes for the mass densities, the number provided is in fact a
+// 16 bit integer. I realize that the English document says something to that extent, but the sentence
+// was extremely confusing. Triangulating between the Google translated Japanese document and the
+// official English document yielded better insights into what is actually happening.
+//
+// Despite the mass densities only being uint16_t integers in the UART interface, I still read them
+// as uint32_t since 4 bytes are provided.
+//
+#define SNGCJA5_FRAME_SIZE      32
+#define SNGCJA5_FRAME_STX       0x02
+#define SNGCJA5_FRAME_ETX       0x03
+#define SNGCJA5_FRAME_FCC_IDX   30
+
+struct SNGCJA5Protocol {
+    static const char* name(void)           { return "SN-GCJA5"; }
+
+    static const uint8_t FRAME_SIZE = SNGCJA5_FRAME_SIZE;
+    typedef FrameNoEscape                                           Escape;
+    typedef FrameConstant<0, SNGCJA5_FRAME_STX>                     Header;
+    typedef FrameConstant<SNGCJA5_FRAME_SIZE - 1, SNGCJA5_FRAME_ETX> Trailer;
+    typedef XorChecksum<1, SNGCJA5_FRAME_FCC_IDX - 1, SNGCJA5_FRAME_FCC_IDX> Checksum;
+
+    typedef FrameInteger<1, 4, FRAME_LITTLE_ENDIAN>     PM1p0;
+    typedef FrameInteger<5, 4, FRAME_LITTLE_ENDIAN>     PM2p5;
+    typedef FrameInteger<9, 4, FRAME_LITTLE_ENDIAN>     PM10;
+    typedef FrameInteger<13, 2, FRAME_LITTLE_ENDIAN>    Count0p5um;
+    typedef FrameInteger<15, 2, FRAME_LITTLE_ENDIAN>    Count1p0um;
+    typedef FrameInteger<17, 2, FRAME_LITTLE_ENDIAN>    Count2p5um;
+    typedef FrameInteger<21, 2, FRAME_LITTLE_ENDIAN>    Count5p0um;
+    typedef FrameInteger<23, 2, FRAME_LITTLE_ENDIAN>    Count7p5um;
+    typedef FrameInteger<25, 2, FRAME_LITTLE_ENDIAN>    Count10um;
+    typedef FrameInteger<29, 1, FRAME_LITTLE_ENDIAN>    Status;
+
+    static const uint32_t BAUD_RATE = 9600;
+    static const bool EVEN_PARITY = true;
+    // takes 28 seconds to power up and normalize
+    static const uint32_t WARMUP_MILLIS = 28000;
+    typedef FrameCommand<>  StartCommand;
+    typedef FrameCommand<>  PollCommand;
+    static const uint32_t POLL_MILLIS = 0;
+};
+
+//
+// Plantower PMS5003 frame layout, in its default active mode. Each frame is 32 bytes, with
+// big endian 16 bit values:
+//   bytes 0-1      0x42 0x4D
+//   bytes 2-3      frame length after these bytes, always 28
+//   bytes 4-9      PM1.0, PM2.5 and PM10 for standard particles (CF=1)
+//   bytes 10-15    PM1.0, PM2.5 and PM10 under atmospheric environment
+//   bytes 16-27    particles over 0.3, 0.5, 1.0, 2.5, 5.0 and 10 um in 0.1 L of air
+//   bytes 28-29    reserved
+//   bytes 30-31    the sum of bytes 0 through 29
+//
+// The atmospheric environment mass densities are the ones meant for ambient air. The counts are
+// cumulative, so the 0.5 um count includes all larger particles.
+//
+struct PMS5003Protocol {
+    static const char* name(void)           { return "PMS5003"; }
+
+    static const uint8_t FRAME_SIZE = 32;
+    typedef FrameNoEscape                           Escape;
+    typedef FrameConstant<0, 0x42, 0x4D, 0x00, 28>  Header;
+    typedef FrameChecks<>                           Trailer;
+    typedef SumChecksum16<0, 29, 30>                Checksum;
+
+    typedef FrameInteger<10, 2, FRAME_BIG_ENDIAN>   PM1p0;
+    typedef FrameInteger<12, 2, FRAME_BIG_ENDIAN>   PM2p5;
+    typedef FrameInteger<14, 2, FRAME_BIG_ENDIAN>   PM10;
+    typedef FrameInteger<18, 2, FRAME_BIG_ENDIAN>   Count0p5um;
+    typedef FrameInteger<20, 2, FRAME_BIG_ENDIAN>   Count1p0um;
+    typedef FrameInteger<22, 2, FRAME_BIG_ENDIAN>   Count2p5um;
+    typedef FrameInteger<24, 2, FRAME_BIG_ENDIAN>   Count5p0um;
+    typedef FrameAbsent                             Count7p5um;
+    typedef FrameInteger<26, 2, FRAME_BIG_ENDIAN>   Count10um;
+    typedef FrameAbsent                             Status;
+
+    static const uint32_t BAUD_RATE = 9600;
+    static const bool EVEN_PARITY = false;
+    // the fan needs 30 seconds after waking for the readings to be stable
+    static const uint32_t WARMUP_MILLIS = 30000;
+    typedef FrameCommand<>  StartCommand;
+    typedef FrameCommand<>  PollCommand;
+    static const uint32_t POLL_MILLIS = 0;
+};
+
+//
+// Sensirion SPS30 SHDLC frame layout for the answer to a Read Measured Values request, with the
+// measurements as big endian floats. Once the byte stuffing is removed each frame is 47 bytes:
+//   byte 0         start (0x7E)
+//   byte 1         address, always 0
+//   byte 2         command, 0x03 for Read Measured Values
+//   byte 3         state, non-zero if the command failed
+//   byte 4         data length, 40
+//   bytes 5-20     PM1.0, PM2.5, PM4.0 and PM10 in ug/m^3
+//   bytes 21-40    particles up to 0.5, 1.0, 2.5, 4.0 and 10 um per cm^3
+//   bytes 41-44    typical particle size in um
+//   byte 45        the inverted low byte of the sum of bytes 1 through 44
+//   byte 46        stop (0x7E)
+//
+// The sensor only answers requests, so measuring is started with a Start Measurement command
+// and a reading is requested every second, which is how often the sensor updates it. The
+// counts are scaled to particles per 0.1 L, like the PMS5003's. Answers to other commands have
+// a different length and are skipped.
+//
+struct SPS30Protocol {
+    static const char* name(void)           { return "SPS30"; }
+
+    static const uint8_t FRAME_SIZE = 47;
+    typedef FrameEscape<0x7D, 0x20>                 Escape;
+    typedef FrameConstant<0, 0x7E, 0x00, 0x03>      Header;
+    typedef FrameChecks<FrameConstant<4, 40>, FrameConstant<46, 0x7E> > Trailer;
+    typedef InvertedSumChecksum8<1, 44, 45>         Checksum;
+
+    typedef FrameFloat<5, 1>                        PM1p0;
+    typedef FrameFloat<9, 1>                        PM2p5;
+    typedef FrameFloat<17, 1>                       PM10;
+    typedef FrameFloat<21, 100>                     Count0p5um;
+    typedef FrameFloat<25, 100>                     Count1p0um;
+    typedef FrameFloat<29, 100>                     Count2p5um;
+    typedef FrameAbsent                             Count5p0um;
+    typedef FrameAbsent                             Count7p5um;
+    typedef FrameFloat<37, 100>                     Count10um;
+    typedef FrameAbsent                             Status;
+
+    static const uint32_t BAUD_RATE = 115200;
+    static const bool EVEN_PARITY = false;
+    static const uint32_t WARMUP_MILLIS = 16000;
+    // Start Measurement with float output, and Read Measured Values
+    typedef FrameCommand<0x7E, 0x00, 0x00, 0x02, 0x01, 0x03, 0xF9, 0x7E>   StartCommand;
+    typedef FrameCommand<0x7E, 0x00, 0x03, 0x00, 0xFC, 0x7E>               PollCommand;
+    static const uint32_t POLL_MILLIS = 1000;
+};
+
+//
+// Selects a protocol by its PARTICULATE_SENSOR_* number, for choosing sensors in the build
+// configuration.
+//
+template <int SENSOR_TYPE>
+struct ParticulateProtocolForType;
+
+template <>
+struct ParticulateProtocolForType<PARTICULATE_SENSOR_SNGCJA5> {
+    typedef SNGCJA5Protocol Type;
+};
+
+template <>
+struct ParticulateProtocolForType<PARTICULATE_SENSOR_PMS5003> {
+    typedef PMS5003Protocol Type;
+};
+
+template <>
+struct ParticulateProtocolForType<PARTICULATE_SENSOR_SPS30> {
+    typedef SPS30Protocol Type;
+};
+
+#endif // __ParticulateProtocols__
@@ -0,0 +1,12 @@
+#ifndef __SNGCJA5FrameDecoder__
+#define __SNGCJA5FrameDecoder__
+#include "ParticulateFrameDecoder.h"
+#include "ParticulateProtocols.h"
+
+//
+// The frame decoder for the Panasonic SN-GCJA5. See SNGCJA5Protocol for the frame layout.
+//
+typedef ParticulateFrameDecoder<SNGCJA5Protocol> SNGCJA5FrameDecoder;
+typedef SNGCJA5FrameDecoder::Frame SNGCJA5Frame;
+
+#endif // __SNGCJA5FrameDecoder__
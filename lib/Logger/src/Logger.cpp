@@ -0,0 +1,242 @@
+#include <stdarg.h>
+#include "Logger.h"
+
+#define LOG_TASK_STACK      4096
+#define LOG_TASK_PRIORITY   1
+
+Logger Log;
+
+void LogRecord::addArg(const char* value)
+{
+    if (argCount >= LOG_MAX_ARGS) {
+        return;
+    }
+    if (value == nullptr) {
+        value = "(null)";
+    }
+    argTypes[argCount] = LOG_ARG_STRING;
+    args[argCount++].u = stringsLength;
+    if (stringsLength >= LOG_STRING_BYTES) {
+        // out of room, so the argument prints as an empty string
+        return;
+    }
+    size_t room = LOG_STRING_BYTES - stringsLength - 1;
+    size_t length = strlen(value);
+    if (length > room) {
+        length = room;
+    }
+    memcpy(strings + stringsLength, value, length);
+    strings[stringsLength + length] = '\0';
+    stringsLength += length + 1;
+}
+
+Logger::Logger()
+    :   _queue(),
+        _out(&Serial),
+        _task(nullptr),
+        _pollMillis(0),
+        _reportedDropCount(0)
+{
+}
+
+void Logger::write(const LogRecord& record)
+{
+    if (_task == nullptr) {
+        print(record);
+        return;
+    }
+    // a full queue counts the record as dropped
+    _queue.push(record);
+}
+
+void Logger::print(const LogRecord& record)
+{
+    char line[LOG_LINE_MAX_LENGTH];
+    size_t length = format(record, line, sizeof(line) - 1);
+    line[length++] = '\n';
+    _out->write((const uint8_t*)line, length);
+}
+
+size_t Logger::drain(void)
+{
+    size_t printed = 0;
+    LogRecord record;
+    while (_queue.pop(record)) {
+        print(record);
+        printed++;
+    }
+    uint32_t dropped = _queue.overflowCount();
+    if (dropped != _reportedDropCount) {
+        char line[80];
+        int length = snprintf(line, sizeof(line), "NOTE - %u log records were dropped because the log queue was full\n",
+                                dropped - _reportedDropCount);
+        _out->write((const uint8_t*)line, length);
+        _reportedDropCount = dropped;
+    }
+    return printed;
+}
+
+// snprintf into the line, returning the number of bytes actually written
+static size_t appendFormatted(char* out, size_t capacity, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(out, capacity, format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    return ((size_t)length < capacity) ? length : capacity - 1;
+}
+
+// Formats one argument with the flags, width and precision of its conversion. The length
+// modifier comes from the type the argument was captured as rather than from the format.
+static size_t formatArg(const LogRecord& record, uint8_t arg, char* spec, size_t spec_length, char conversion,
+                        char* out, size_t capacity)
+{
+    uint8_t type = record.argTypes[arg];
+    bool wide = (type == LOG_ARG_INT64) || (type == LOG_ARG_UINT64);
+    switch (conversion) {
+        case 'd':
+        case 'i': {
+            int64_t value = (type == LOG_ARG_INT) ? record.args[arg].i
+                            : (type == LOG_ARG_UINT) ? record.args[arg].u
+                            : (type == LOG_ARG_DOUBLE) ? (int64_t)record.args[arg].d
+                            : (type == LOG_ARG_STRING) ? 0 : record.args[arg].i64;
+            if (!wide) {
+                strcpy(spec + spec_length, "d");
+                return appendFormatted(out, capacity, spec, (int)value);
+            }
+            strcpy(spec + spec_length, "lld");
+            return appendFormatted(out, capacity, spec, (long long)value);
+        }
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c': {
+            uint64_t value = (type == LOG_ARG_INT) ? (uint32_t)record.args[arg].i
+                            : (type == LOG_ARG_UINT) ? record.args[arg].u
+                            : (type == LOG_ARG_DOUBLE) ? (uint64_t)record.args[arg].d
+                            : (type == LOG_ARG_STRING) ? 0 : record.args[arg].u64;
+            if (!wide || (conversion == 'c')) {
+                spec[spec_length] = conversion;
+                spec[spec_length + 1] = '\0';
+                return appendFormatted(out, capacity, spec, (unsigned int)value);
+            }
+            spec[spec_length] = 'l';
+            spec[spec_length + 1] = 'l';
+            spec[spec_length + 2] = conversion;
+            spec[spec_length + 3] = '\0';
+            return appendFormatted(out, capacity, spec, (unsigned long long)value);
+        }
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G': {
+            double value = (type == LOG_ARG_INT) ? record.args[arg].i
+                            : (type == LOG_ARG_UINT) ? record.args[arg].u
+                            : (type == LOG_ARG_INT64) ? record.args[arg].i64
+                            : (type == LOG_ARG_UINT64) ? record.args[arg].u64
+                            : (type == LOG_ARG_STRING) ? 0 : record.args[arg].d;
+            spec[spec_length] = conversion;
+            spec[spec_length + 1] = '\0';
+            return appendFormatted(out, capacity, spec, value);
+        }
+        case 's': {
+            const char* value = "?";
+            if (type == LOG_ARG_STRING) {
+                value = (record.args[arg].u < LOG_STRING_BYTES) ? record.strings + record.args[arg].u : "";
+            }
+            strcpy(spec + spec_length, "s");
+            return appendFormatted(out, capacity, spec, value);
+        }
+        default:
+            return appendFormatted(out, capacity, "?");
+    }
+}
+
+size_t Logger::format(const LogRecord& record, char* out, size_t capacity)
+{
+    if (capacity == 0) {
+        return 0;
+    }
+    size_t length = 0;
+    uint8_t arg = 0;
+    const char* p = record.format;
+    while ((*p != '\0') && (length + 1 < capacity)) {
+        if (*p != '%') {
+            out[length++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[length++] = '%';
+            p += 2;
+            continue;
+        }
+        // keep the flags, width and precision, and drop the length modifiers
+        char spec[16];
+        size_t spec_length = 0;
+        spec[spec_length++] = *p++;
+        while ((*p != '\0') && (strchr("-+ #0123456789.", *p) != nullptr) && (spec_length < sizeof(spec) - 4)) {
+            spec[spec_length++] = *p++;
+        }
+        while ((*p != '\0') && (strchr("hljztL", *p) != nullptr)) {
+            p++;
+        }
+        char conversion = *p;
+        if (conversion == '\0') {
+            break;
+        }
+        p++;
+        if (arg >= record.argCount) {
+            length += appendFormatted(out + length, capacity - length, "?");
+            continue;
+        }
+        length += formatArg(record, arg++, spec, spec_length, conversion, out + length, capacity - length);
+    }
+    out[length] = '\0';
+    return length;
+}
+
+bool Logger::startTask(int core, uint32_t poll_millis)
+{
+#if defined(ESP32)
+    _pollMillis = (poll_millis > 0) ? poll_millis : 1;
+    TaskHandle_t task = nullptr;
+    BaseType_t result = xTaskCreatePinnedToCore(
+        Logger::drainTask,
+        "Logger",
+        LOG_TASK_STACK,
+        this,
+        LOG_TASK_PRIORITY,
+        &task,
+        core
+    );
+    if (result != pdPASS) {
+        LOG_ERROR("ERROR - Could not start the log task. Logs will be printed as they are made.");
+        return false;
+    }
+    _task = task;
+    return true;
+#else
+    (void)core;
+    (void)poll_millis;
+    return false;
+#endif
+}
+
+void Logger::drainTask(void* parameter)
+{
+#if defined(ESP32)
+    Logger* logger = static_cast<Logger*>(parameter);
+    for (;;) {
+        logger->drain();
+        vTaskDelay(pdMS_TO_TICKS(logger->_pollMillis));
+    }
+#else
+    (void)parameter;
+#endif
+}
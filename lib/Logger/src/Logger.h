@@ -0,0 +1,169 @@
+#ifndef __Logger__
+#define __Logger__
+#include <Arduino.h>
+#include <atomic>
+#include <MPSCQueue.h>
+
+#define LOG_LEVEL_NONE      0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_INFO      3
+#define LOG_LEVEL_DEBUG     4
+
+// Logs above this level are compiled out. Normally set by the build flags.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL           LOG_LEVEL_INFO
+#endif
+
+// Records that can wait to be printed. Must be a power of two.
+#ifndef LOG_QUEUE_RECORDS
+#define LOG_QUEUE_RECORDS   32
+#endif
+
+// Most arguments a log can have, and the space in a record for copies of its string arguments.
+#define LOG_MAX_ARGS            6
+#define LOG_STRING_BYTES        96
+
+// Longest line a record is formatted to, including the newline.
+#define LOG_LINE_MAX_LENGTH     192
+
+enum LogArgType : uint8_t {
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_INT64,
+    LOG_ARG_UINT64,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STRING      // value.u is the offset of the copy in LogRecord::strings
+};
+
+//
+// A log as it waits in the queue: the format string, which must be a literal, and copies of
+// the arguments. Formatting is left to the task that prints the record.
+//
+struct LogRecord {
+    const char* format;
+    uint32_t    millis;
+    uint8_t     level;
+    uint8_t     argCount;
+    uint8_t     stringsLength;
+    uint8_t     argTypes[LOG_MAX_ARGS];
+    union {
+        int32_t     i;
+        uint32_t    u;
+        int64_t     i64;
+        uint64_t    u64;
+        double      d;
+    }           args[LOG_MAX_ARGS];
+    char        strings[LOG_STRING_BYTES];
+
+    void addArg(int value)                  { if (argCount < LOG_MAX_ARGS) { argTypes[argCount] = LOG_ARG_INT; args[argCount++].i = value; } }
+    void addArg(unsigned int value)         { if (argCount < LOG_MAX_ARGS) { argTypes[argCount] = LOG_ARG_UINT; args[argCount++].u = value; } }
+    void addArg(long value)                 { if (sizeof(long) == sizeof(int)) addArg((int)value); else addArg((long long)value); }
+    void addArg(unsigned long value)        { if (sizeof(long) == sizeof(int)) addArg((unsigned int)value); else addArg((unsigned long long)value); }
+    void addArg(long long value)            { if (argCount < LOG_MAX_ARGS) { argTypes[argCount] = LOG_ARG_INT64; args[argCount++].i64 = value; } }
+    void addArg(unsigned long long value)   { if (argCount < LOG_MAX_ARGS) { argTypes[argCount] = LOG_ARG_UINT64; args[argCount++].u64 = value; } }
+    void addArg(double value)               { if (argCount < LOG_MAX_ARGS) { argTypes[argCount] = LOG_ARG_DOUBLE; args[argCount++].d = value; } }
+    void addArg(const char* value);
+    void addArg(const String& value)        { addArg(value.c_str()); }
+};
+
+//
+// Logger
+//
+// Takes logging off the tasks that do the work. A log copies its arguments into a LogRecord,
+// which is pushed into a lock-free queue that any task can write to, and a low priority task
+// formats and prints the records. Logging never blocks: if the queue is full the record is
+// dropped and counted, and the number dropped is printed once there is room again.
+//
+// Until the task is started, and on the host, records are formatted and printed as they are
+// logged, the same as printing to Serial directly.
+//
+// Logs are written with the LOG_ERROR(), LOG_WARN(), LOG_INFO() and LOG_DEBUG() macros, which
+// take a printf() format literal and its arguments. A line break is added to each log. Levels
+// above LOG_LEVEL are compiled out, so their arguments are not even evaluated. The format is
+// applied to the copied arguments, so %s prints a copy of the string as it was when logged
+// (truncated to what fits in LOG_STRING_BYTES), and integer length modifiers are not needed.
+//
+class Logger {
+private:
+    MPSCQueue<LogRecord, LOG_QUEUE_RECORDS> _queue;
+    Print*          _out;
+    void*           _task;
+    uint32_t        _pollMillis;
+    uint32_t        _reportedDropCount;
+
+    void addArgs(LogRecord& /*record*/) {}
+    template <typename T, typename... Rest>
+    void addArgs(LogRecord& record, const T& value, const Rest&... rest)
+    {
+        record.addArg(value);
+        addArgs(record, rest...);
+    }
+
+    void print(const LogRecord& record);
+    static void drainTask(void* parameter);
+
+public:
+    Logger();
+
+    // Logs to out rather than Serial.
+    void setOutput(Print& out)              { _out = &out; }
+
+    // Starts a FreeRTOS task pinned to the given core that prints the queued records every
+    // poll_millis. Returns false if the task could not be started, in which case records are
+    // printed as they are logged.
+    bool startTask(int core, uint32_t poll_millis);
+    bool isTaskRunning(void) const          { return _task != nullptr; }
+
+    template <typename... Args>
+    void log(uint8_t level, const char* format, const Args&... args)
+    {
+        LogRecord record;
+        record.format = format;
+        record.millis = millis();
+        record.level = level;
+        record.argCount = 0;
+        record.stringsLength = 0;
+        addArgs(record, args...);
+        write(record);
+    }
+    void write(const LogRecord& record);
+
+    // Prints the queued records. Called by the task, or by the owner if there is no task.
+    // Returns the number of records printed.
+    size_t drain(void);
+
+    // Formats a record into out as the line it is printed as, and returns its length.
+    static size_t format(const LogRecord& record, char* out, size_t capacity);
+
+    size_t queuedCount(void) const          { return _queue.size(); }
+    uint32_t droppedCount(void) const       { return _queue.overflowCount(); }
+};
+
+extern Logger Log;
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...)  Log.log(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...)  do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...)   Log.log(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...)   do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...)   Log.log(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...)   do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...)  Log.log(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...)  do {} while (0)
+#endif
+
+#endif // __Logger__
@@ -0,0 +1,78 @@
+#include <string.h>
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+void LatencyHistogram::clear(void)
+{
+    memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _minMicros = 0;
+    _maxMicros = 0;
+    _totalMicros = 0;
+}
+
+uint8_t LatencyHistogram::bucketForMicros(uint32_t micros)
+{
+    if (micros == 0) {
+        return 0;
+    }
+    return 32 - __builtin_clz(micros);
+}
+
+uint32_t LatencyHistogram::bucketUpperBoundMicros(uint8_t bucket)
+{
+    if (bucket == 0) {
+        return 0;
+    }
+    if (bucket >= 32) {
+        return UINT32_MAX;
+    }
+    return (1UL << bucket) - 1;
+}
+
+void LatencyHistogram::record(uint32_t micros)
+{
+    _buckets[bucketForMicros(micros)]++;
+    if ((_count == 0) || (micros < _minMicros)) {
+        _minMicros = micros;
+    }
+    if (micros > _maxMicros) {
+        _maxMicros = micros;
+    }
+    _totalMicros += micros;
+    _count++;
+}
+
+uint32_t LatencyHistogram::percentileMicros(float percentile) const
+{
+    if (_count == 0) {
+        return 0;
+    }
+    // the rank of the requested percentile, counting from 1
+    uint32_t rank = (uint32_t)(percentile/100.0*_count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > _count) {
+        rank = _count;
+    }
+
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += _buckets[i];
+        if (seen >= rank) {
+            uint32_t bound = bucketUpperBoundMicros(i);
+            if (bound > _maxMicros) {
+                bound = _maxMicros;
+            }
+            if (bound < _minMicros) {
+                bound = _minMicros;
+            }
+            return bound;
+        }
+    }
+    return _maxMicros;
+}
@@ -0,0 +1,48 @@
+#ifndef __LatencyHistogram__
+#define __LatencyHistogram__
+#include <stdint.h>
+#include <stddef.h>
+
+// bucket 0 holds 0 us, and bucket i holds [2^(i-1), 2^i) us, so 33 buckets cover all of uint32_t
+#define LATENCY_HISTOGRAM_BUCKETS   33
+
+//
+// LatencyHistogram
+//
+// Distribution of latencies in microseconds in power of two buckets. Recording is O(1) and
+// allocation free, and the whole histogram is a few hundred bytes, so one can be kept for
+// every operation worth watching. Percentiles are reported as the upper bound of the bucket
+// they fall in (clamped to the largest recorded value), so they are accurate to within 2x.
+//
+// Recording and reading from different tasks is safe in the sense that nothing breaks, but a
+// reader may see a histogram that is partially updated.
+//
+class LatencyHistogram {
+private:
+    uint32_t    _buckets[LATENCY_HISTOGRAM_BUCKETS];
+    uint32_t    _count;
+    uint32_t    _minMicros;
+    uint32_t    _maxMicros;
+    uint64_t    _totalMicros;
+
+public:
+    LatencyHistogram();
+
+    void record(uint32_t micros);
+    void clear(void);
+
+    uint32_t count(void) const                  { return _count; }
+    uint32_t minMicros(void) const              { return _minMicros; }
+    uint32_t maxMicros(void) const              { return _maxMicros; }
+    uint64_t totalMicros(void) const            { return _totalMicros; }
+    float averageMicros(void) const             { return (_count > 0) ? (float)_totalMicros/(float)_count : 0; }
+
+    // percentile is in the range 0 to 100. Returns 0 if nothing has been recorded.
+    uint32_t percentileMicros(float percentile) const;
+
+    uint32_t bucketCount(uint8_t bucket) const  { return (bucket < LATENCY_HISTOGRAM_BUCKETS) ? _buckets[bucket] : 0; }
+    static uint8_t bucketForMicros(uint32_t micros);
+    static uint32_t bucketUpperBoundMicros(uint8_t bucket);
+};
+
+#endif // __LatencyHistogram__
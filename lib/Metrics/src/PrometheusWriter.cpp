@@ -0,0 +1,45 @@
+#include "PrometheusWriter.h"
+
+PrometheusWriter::PrometheusWriter(Print& out)
+    :   _out(out)
+{
+}
+
+void PrometheusWriter::family(const char* name, const char* type, const char* help)
+{
+    _out.printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void PrometheusWriter::counter(const char* name, const char* help, uint64_t value)
+{
+    family(name, "counter", help);
+    _out.printf("%s %llu\n", name, (unsigned long long)value);
+}
+
+void PrometheusWriter::gauge(const char* name, const char* help, double value)
+{
+    family(name, "gauge", help);
+    _out.printf("%s %g\n", name, value);
+}
+
+void PrometheusWriter::histogram(const char* name, const char* label_name, const char* label_value, const LatencyHistogram& histogram)
+{
+    // the bounds are whole microseconds, so they are written as seconds without going through a float
+    uint32_t cumulative = 0;
+    uint8_t next_bucket = 0;
+    for (uint8_t i = 0; i <= PROMETHEUS_HISTOGRAM_MAX_BUCKET; i++) {
+        cumulative += histogram.bucketCount(i);
+        if (i != next_bucket) {
+            continue;
+        }
+        next_bucket += PROMETHEUS_HISTOGRAM_BUCKET_STRIDE;
+        uint32_t bound = LatencyHistogram::bucketUpperBoundMicros(i);
+        _out.printf("%s_bucket{%s=\"%s\",le=\"%u.%06u\"} %u\n",
+            name, label_name, label_value, bound/1000000, bound%1000000, cumulative);
+    }
+    uint64_t total = histogram.totalMicros();
+    _out.printf("%s_bucket{%s=\"%s\",le=\"+Inf\"} %u\n", name, label_name, label_value, histogram.count());
+    _out.printf("%s_sum{%s=\"%s\"} %llu.%06u\n", name, label_name, label_value,
+        (unsigned long long)(total/1000000), (uint32_t)(total%1000000));
+    _out.printf("%s_count{%s=\"%s\"} %u\n", name, label_name, label_value, histogram.count());
+}
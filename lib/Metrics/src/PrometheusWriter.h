@@ -0,0 +1,48 @@
+#ifndef __PrometheusWriter__
+#define __PrometheusWriter__
+#include <Arduino.h>
+#include "LatencyHistogram.h"
+
+// Histograms are exported with the LatencyHistogram bucket boundaries from bucket 0 up to this
+// bucket, every PROMETHEUS_HISTOGRAM_BUCKET_STRIDE buckets. The defaults give boundaries at
+// powers of 4 microseconds up to 16.8 seconds, which keeps a scrape of a dozen histograms
+// small while still separating sub-microsecond stages from ones that take seconds.
+#ifndef PROMETHEUS_HISTOGRAM_MAX_BUCKET
+#define PROMETHEUS_HISTOGRAM_MAX_BUCKET     24
+#endif
+#ifndef PROMETHEUS_HISTOGRAM_BUCKET_STRIDE
+#define PROMETHEUS_HISTOGRAM_BUCKET_STRIDE  2
+#endif
+
+//
+// PrometheusWriter
+//
+// Writes metrics in the Prometheus text exposition format (version 0.0.4) to a Print, so the
+// output can go straight into a web server's response stream without being assembled in a
+// String first. Each metric family is started with its # HELP and # TYPE lines, followed by
+// its samples.
+//
+// LatencyHistograms are exported in seconds, with a cumulative _bucket sample for each
+// exported bucket boundary and for +Inf, followed by _sum and _count. The boundaries fall on
+// the LatencyHistogram's own bucket boundaries, so the counts are exact.
+//
+class PrometheusWriter {
+private:
+    Print&  _out;
+
+public:
+    explicit PrometheusWriter(Print& out);
+
+    // Starts a metric family. type is "counter", "gauge" or "histogram".
+    void family(const char* name, const char* type, const char* help);
+
+    // Writes a family with a single unlabelled sample.
+    void counter(const char* name, const char* help, uint64_t value);
+    void gauge(const char* name, const char* help, double value);
+
+    // Writes the samples of one histogram of a family started with family(), labelled with
+    // label_name="label_value".
+    void histogram(const char* name, const char* label_name, const char* label_value, const LatencyHistogram& histogram);
+};
+
+#endif // __PrometheusWriter__
@@ -0,0 +1,59 @@
+#ifndef __StageTimer__
+#define __StageTimer__
+#include <Arduino.h>
+#include "LatencyHistogram.h"
+
+// CPU cycles per microsecond. The ESP32 builds define F_CPU, and the host shim's cycle counter
+// pretends to be a 240 MHz core.
+#ifndef STAGE_TIMER_CYCLES_PER_MICRO
+#if defined(F_CPU)
+#define STAGE_TIMER_CYCLES_PER_MICRO    (F_CPU/1000000)
+#else
+#define STAGE_TIMER_CYCLES_PER_MICRO    240
+#endif
+#endif
+
+//
+// Stage timing
+//
+// Times a stage of the hot path with the CPU cycle counter, which is a single register read
+// rather than the call into the system timer that micros() makes, so timing a stage and
+// recording it into a LatencyHistogram costs a few tens of cycles.
+//
+// The cycle counter belongs to the core that reads it and wraps about every 17 seconds at
+// 240 MHz, so a stage must start and end on the same task, and stages that can take longer
+// than that should be timed with micros() instead. Latencies between tasks, such as the time
+// a sample waits in a queue, must also use micros().
+//
+
+inline uint32_t stageTimerStart(void)
+{
+    return ESP.getCycleCount();
+}
+
+inline uint32_t stageTimerElapsedMicros(uint32_t start_cycles)
+{
+    return (ESP.getCycleCount() - start_cycles)/STAGE_TIMER_CYCLES_PER_MICRO;
+}
+
+//
+// Records the time from its construction to the end of its scope into a histogram.
+//
+class StageTimer {
+private:
+    LatencyHistogram&   _histogram;
+    uint32_t            _startCycles;
+
+public:
+    explicit StageTimer(LatencyHistogram& histogram)
+        :   _histogram(histogram),
+            _startCycles(stageTimerStart())
+    {
+    }
+    ~StageTimer()
+    {
+        _histogram.record(stageTimerElapsedMicros(_startCycles));
+    }
+};
+
+#endif // __StageTimer__
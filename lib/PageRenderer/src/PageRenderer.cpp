@@ -0,0 +1,462 @@
+#include <stdarg.h>
+#include <Utilities.h>
+#include <PrometheusWriter.h>
+#include <Logger.h>
+#include "PageRenderer.h"
+
+// Arduino's String has no public way to append a span of characters, so copy it in
+// NUL terminated chunks.
+static void appendSpan(String& str, const char* span, size_t length)
+{
+    char chunk[65];
+    while (length > 0) {
+        size_t chunk_length = (length < sizeof(chunk) - 1) ? length : sizeof(chunk) - 1;
+        memcpy(chunk, span, chunk_length);
+        chunk[chunk_length] = '\0';
+        str.concat(chunk);
+        span += chunk_length;
+        length -= chunk_length;
+    }
+}
+
+const char* const LOOP_STAGE_NAMES[LOOP_STAGE_COUNT] = {
+    "bme680",
+    "led",
+    "channel_history",
+    "live_update",
+    "telemetry_json",
+    "telemetry_post"
+};
+
+PageRenderer::PageRenderer(const AirQualitySensor& sensor, const DeviceStatus& status)
+    :   _sensor(sensor),
+        _status(status)
+{
+}
+
+// snprintf into a template value buffer, returning the number of bytes actually written
+static size_t formatValue(char* out, size_t capacity, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(out, capacity, format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    return ((size_t)length < capacity) ? length : capacity - 1;
+}
+
+static size_t formatTime(char* out, size_t capacity, time_t time)
+{
+    if (time == 0) {
+        return formatValue(out, capacity, "None");
+    }
+    return formatValue(out, capacity, "%s", convertEpochToString(time).c_str());
+}
+
+static const char* aqiColorClass(float aqi_value)
+{
+    switch (AirQualitySensor::getAQIStatusColor(aqi_value)) {
+        case AQI_GREEN:
+            return "aqi-green";
+        case AQI_YELLOW:
+            return "aqi-yellow";
+        case AQI_ORANGE:
+            return "aqi-orange";
+        case AQI_RED:
+            return "aqi-red";
+        case AQI_PURPLE:
+            return "aqi-purple";
+        default:
+        case AQI_MAROON:
+            return "aqi-maroon";
+    }
+}
+
+// Lists the subsystems that are still starting up, such as "Starting up: WiFi, sensor warm-up".
+// Writes nothing once they are all up.
+size_t PageRenderer::formatBootPending(uint8_t pending, char* out, size_t capacity)
+{
+    static const struct {
+        uint8_t     bit;
+        const char* name;
+    } SUBSYSTEMS[] = {
+        {BOOT_WIFI, "WiFi"},
+        {BOOT_TIME, "clock"},
+        {BOOT_SENSOR, "sensor warm-up"},
+        {BOOT_HISTORY, "history"},
+    };
+    if ((pending == 0) || (capacity == 0)) {
+        return 0;
+    }
+    size_t length = formatValue(out, capacity, "Starting up:");
+    const char* separator = " ";
+    for (size_t i = 0; i < sizeof(SUBSYSTEMS)/sizeof(SUBSYSTEMS[0]); i++) {
+        if (pending & SUBSYSTEMS[i].bit) {
+            length += formatValue(out + length, capacity - length, "%s%s", separator, SUBSYSTEMS[i].name);
+            separator = ", ";
+        }
+    }
+    return length;
+}
+
+size_t PageRenderer::formatVariable(TemplateVariableID id, char* out, size_t capacity) const
+{
+    switch (id) {
+        // root pages
+        case TEMPLATE_VARIABLE_AQI_CURRENT:
+            return formatValue(out, capacity, "%.1f", _sensor.currentAirQualityIndex());
+        case TEMPLATE_VARIABLE_AQI_10MIN:
+            return formatValue(out, capacity, "%.1f", _sensor.tenMinuteAirQualityIndex());
+        case TEMPLATE_VARIABLE_AQI_1HOUR:
+            return formatValue(out, capacity, "%.1f", _sensor.oneHourAirQualityIndex());
+        case TEMPLATE_VARIABLE_AQI_24HOUR:
+            return formatValue(out, capacity, "%.1f", _sensor.oneDayAirQualityIndex());
+        case TEMPLATE_VARIABLE_COLOR_CURRENT:
+            return formatValue(out, capacity, "%s", aqiColorClass(_sensor.currentAirQualityIndex()));
+        case TEMPLATE_VARIABLE_COLOR_10MIN:
+            return formatValue(out, capacity, "%s", aqiColorClass(_sensor.tenMinuteAirQualityIndex()));
+        case TEMPLATE_VARIABLE_COLOR_1HOUR:
+            return formatValue(out, capacity, "%s", aqiColorClass(_sensor.oneHourAirQualityIndex()));
+        case TEMPLATE_VARIABLE_COLOR_24HOUR:
+            return formatValue(out, capacity, "%s", aqiColorClass(_sensor.oneDayAirQualityIndex()));
+        case TEMPLATE_VARIABLE_SENSORNAME:
+            return formatValue(out, capacity, "%s", _status.sensorName);
+        case TEMPLATE_VARIABLE_TEMPERATURE:
+            return formatValue(out, capacity, "%.1f", _status.temperature*9.0/5.0 + 32.0);
+        case TEMPLATE_VARIABLE_PRESSURE:
+            return formatValue(out, capacity, "%.1f", _status.pressure);
+        case TEMPLATE_VARIABLE_HUMIDITY:
+            return formatValue(out, capacity, "%.1f", _status.humidity);
+        case TEMPLATE_VARIABLE_BOOTSTATUS:
+            return formatBootPending(_status.bootPending, out, capacity);
+
+        // stats page
+        case TEMPLATE_VARIABLE_PERCENT:
+            return formatValue(out, capacity, "%%");
+        case TEMPLATE_VARIABLE_WIFISSID:
+            return formatValue(out, capacity, "%s", _status.wifiSSID);
+        case TEMPLATE_VARIABLE_IPADDRESS:
+            return formatValue(out, capacity, "%s", _status.ipAddress.c_str());
+        case TEMPLATE_VARIABLE_BOOTTIME:
+            return formatTime(out, capacity, _status.bootTime);
+        case TEMPLATE_VARIABLE_LASTMEASURETIME:
+            return formatTime(out, capacity, _status.lastUpdateTime);
+        case TEMPLATE_VARIABLE_LASTTRANSMIT:
+            return formatTime(out, capacity, _status.lastTransmitTime);
+        case TEMPLATE_VARIABLE_HISTORYSIZE:
+            return formatValue(out, capacity, "%u", _sensor.getHistoryCount());
+        case TEMPLATE_VARIABLE_HISTORYRETENTION:
+            return formatValue(out, capacity, "%.1f hours", _sensor.getHistorySeconds()/3600.0);
+        case TEMPLATE_VARIABLE_HASBME680:
+            return formatValue(out, capacity, "%s", _status.hasBME680 ? "True" : "False");
+        case TEMPLATE_VARIABLE_MEASURERATE:
+            return formatValue(out, capacity, "%u seconds", _status.measureSeconds);
+        case TEMPLATE_VARIABLE_TRANSMITRATE:
+            return formatValue(out, capacity, "%u seconds", _status.transmitSeconds);
+        case TEMPLATE_VARIABLE_TELEMETRYBATCH:
+            return formatValue(out, capacity, "%u of %u samples, every %u sample(s)",
+                _status.telemetryBatchSize, _status.telemetryBatchCapacity, _status.telemetrySampleInterval);
+        case TEMPLATE_VARIABLE_TELEMETRYREQUESTS:
+            return formatValue(out, capacity, "%u / %u / %u",
+                _status.telemetryRequestCount, _status.telemetryFailureCount, _status.telemetryConnectionCount);
+        case TEMPLATE_VARIABLE_TELEMETRYQUEUE:
+            return formatValue(out, capacity, "%u / %u / %u",
+                _status.telemetryQueuedCount, _status.telemetrySpilledCount, _status.telemetryDroppedCount);
+        case TEMPLATE_VARIABLE_TELEMETRYCONNECTLATENCY:
+            return formatLatencyHistogram(_status.telemetryConnectLatency, out, capacity);
+        case TEMPLATE_VARIABLE_TELEMETRYSENDLATENCY:
+            return formatLatencyHistogram(_status.telemetrySendLatency, out, capacity);
+        case TEMPLATE_VARIABLE_TELEMETRYRESPONSELATENCY:
+            return formatLatencyHistogram(_status.telemetryResponseLatency, out, capacity);
+        case TEMPLATE_VARIABLE_TRANSMITURL:
+            return formatValue(out, capacity, "%s", (_status.telemetryURL != nullptr) ? _status.telemetryURL : "None");
+        case TEMPLATE_VARIABLE_PDSTATUS:
+            return formatValue(out, capacity, "%u", _sensor.statusParticleDetector());
+        case TEMPLATE_VARIABLE_LASERSTATUS:
+            return formatValue(out, capacity, "%u", _sensor.statusLaser());
+        case TEMPLATE_VARIABLE_FANSTATUS:
+            return formatValue(out, capacity, "%u", _sensor.statusFan());
+        case TEMPLATE_VARIABLE_ROOTVIEWCOUNT:
+            return formatValue(out, capacity, "%u", _status.rootPageViewCount);
+        case TEMPLATE_VARIABLE_SENSORFRAMES:
+            return formatValue(out, capacity, "%u / %u / %u",
+                _sensor.validFrameCount(), _sensor.corruptFrameCount(), _sensor.droppedFrameCount());
+        case TEMPLATE_VARIABLE_SENSORBYTES:
+            return formatValue(out, capacity, "%u / %u", _sensor.receivedByteCount(), _sensor.discardedByteCount());
+        case TEMPLATE_VARIABLE_SAMPLEQUEUE:
+            return formatValue(out, capacity, "%u / %u / %u / %u",
+                _sensor.sampleQueueDepth(), _sensor.sampleQueueHighWaterMark(), _sensor.sampleQueueOverflowCount(), _sensor.missedSampleCount());
+        case TEMPLATE_VARIABLE_READLATENCY:
+            return formatStageLatency(_sensor.readLatency(), out, capacity);
+        case TEMPLATE_VARIABLE_DECODELATENCY:
+            return formatStageLatency(_sensor.decodeLatency(), out, capacity);
+        case TEMPLATE_VARIABLE_QUEUELATENCY:
+            return formatStageLatency(_sensor.queueLatency(), out, capacity);
+        case TEMPLATE_VARIABLE_APPLYLATENCY:
+            return formatStageLatency(_sensor.applyLatency(), out, capacity);
+        case TEMPLATE_VARIABLE_LIVEUPDATES:
+            return formatValue(out, capacity, "%u / %u / %u / %u",
+                _status.liveClientCount, _status.liveUpdateCount, _status.liveSkippedCount, _status.liveDroppedCount);
+        case TEMPLATE_VARIABLE_STATICFILES:
+            return formatValue(out, capacity, "%u / %u / %u",
+                _status.staticServedCount, _status.staticNotModifiedCount, _status.staticFlashReadCount);
+        case TEMPLATE_VARIABLE_CHANNELHISTORY:
+            return formatValue(out, capacity, "%u rows, %.1f hours, %.1f bytes per row",
+                _status.channelHistoryRows, _status.channelHistorySeconds/3600.0,
+                (_status.channelHistoryRows > 0) ? (float)_status.channelHistoryBytes/_status.channelHistoryRows : 0.0);
+        case TEMPLATE_VARIABLE_NOWCAST:
+            if (!_sensor.nowCastValid()) {
+                return formatValue(out, capacity, "Pending");
+            }
+            return formatValue(out, capacity, "%.1f (PM2.5 %.1f ug/m3)",
+                _sensor.nowCastAirQualityIndex(), _sensor.nowCastPM2p5());
+        case TEMPLATE_VARIABLE_HISTORYARCHIVE:
+            if (_status.historyRestoreSkipped) {
+                return formatValue(out, capacity, "Skipped, no time / %u / %u / %u",
+                    _status.historyArchivedCount, _status.historyArchiveWriteCount, _status.historyArchiveFailedCount);
+            }
+            return formatValue(out, capacity, "%u in %u ms / %u / %u / %u",
+                _status.historyRestoredCount, _status.historyRestoreMillis, _status.historyArchivedCount,
+                _status.historyArchiveWriteCount, _status.historyArchiveFailedCount);
+        case TEMPLATE_VARIABLE_STARTUP: {
+            size_t length = (_status.bootPending != 0)
+                                ? formatBootPending(_status.bootPending, out, capacity)
+                                : formatValue(out, capacity, "Up in %.1f s", _status.bootCompleteMillis/1000.0);
+            if (_status.firstResponseMillis != 0) {
+                length += formatValue(out + length, capacity - length, ", first response in %.1f s", _status.firstResponseMillis/1000.0);
+            }
+            return length;
+        }
+        case TEMPLATE_VARIABLE_LOOPLATENCY: {
+            size_t length = 0;
+            for (uint8_t i = 0; i < LOOP_STAGE_COUNT; i++) {
+                const LatencyHistogram* histogram = _status.loopLatency[i];
+                length += (histogram != nullptr)
+                            ? formatValue(out + length, capacity - length, "%s%u", (i > 0) ? " / " : "", histogram->percentileMicros(90))
+                            : formatValue(out + length, capacity - length, "%s-", (i > 0) ? " / " : "");
+            }
+            return length + formatValue(out + length, capacity - length, " &micro;s");
+        }
+        case TEMPLATE_VARIABLE_MEMORY:
+            if (_status.psramSize == 0) {
+                return formatValue(out, capacity, "%.1f of %.1f KB / No PSRAM",
+                    _status.heapMinFree/1024.0, _status.heapSize/1024.0);
+            }
+            return formatValue(out, capacity, "%.1f of %.1f KB / %.1f of %.1f KB",
+                _status.heapMinFree/1024.0, _status.heapSize/1024.0, _status.psramMinFree/1024.0, _status.psramSize/1024.0);
+        case TEMPLATE_VARIABLE_AVERAGECOVERAGE: {
+            // the share of each window that its samples cover. The rest is gaps, or not yet sampled.
+            SampleWindowStats stats[] = {
+                _sensor.tenMinuteAverageStats(),
+                _sensor.oneHourAverageStats(),
+                _sensor.oneDayAverageStats()
+            };
+            const uint32_t window_seconds[] = {10*60, 60*60, 24*60*60};
+            const char* labels[] = {"10 min", "1 hr", "24 hr"};
+            size_t length = 0;
+            for (uint8_t i = 0; i < 3; i++) {
+                length += formatValue(out + length, capacity - length, "%s%s %.0f%%",
+                            (i > 0) ? " / " : "", labels[i], stats[i].coveredMillis/(window_seconds[i]*10.0));
+            }
+            if (stats[2].gapMillis > 0) {
+                length += formatValue(out + length, capacity - length, " (%.1f hr of gaps)", stats[2].gapMillis/3600000.0);
+            }
+            return length;
+        }
+        case TEMPLATE_VARIABLE_PM2P5SPREAD10MIN:
+        case TEMPLATE_VARIABLE_PM2P5SPREAD1HOUR:
+        case TEMPLATE_VARIABLE_PM2P5SPREAD24HOUR: {
+            SampleWindowSpread spread = (id == TEMPLATE_VARIABLE_PM2P5SPREAD10MIN) ? _sensor.tenMinuteSpreadPM2p5()
+                                        : (id == TEMPLATE_VARIABLE_PM2P5SPREAD1HOUR) ? _sensor.oneHourSpreadPM2p5()
+                                        : _sensor.oneDaySpreadPM2p5();
+            if (spread.samples == 0) {
+                return formatValue(out, capacity, "-");
+            }
+            return formatValue(out, capacity, "%u / %u / %u / %u / %u ug/m3",
+                spread.min, spread.p50, spread.p95, spread.p99, spread.max);
+        }
+        case TEMPLATE_VARIABLE_ENVREADINGS:
+            if (_status.environment == nullptr) {
+                return formatValue(out, capacity, "-");
+            }
+            return formatValue(out, capacity, "%u / %u / %u every %u seconds",
+                _status.environment->readingCount(), _status.environment->failureCount(),
+                _status.environment->timeoutCount(), _status.environment->periodMillis()/1000);
+        case TEMPLATE_VARIABLE_ENVAVERAGE10MIN:
+            return formatEnvironmentAverages(ENVIRONMENT_WINDOW_10MIN, out, capacity);
+        case TEMPLATE_VARIABLE_ENVAVERAGE1HOUR:
+            return formatEnvironmentAverages(ENVIRONMENT_WINDOW_1HOUR, out, capacity);
+        case TEMPLATE_VARIABLE_POWER:
+            return formatValue(out, capacity, "%s / %.1f%% awake / %u / %u / %.1f mA / %.1f mJ",
+                (_status.powerProfile == POWER_PROFILE_LOW_POWER) ? "Low Power" : "Always On",
+                _status.dutyCycle*100, _status.wakeCount, _status.radioWakeCount,
+                _status.averageMilliamps, _status.energyPerSampleMillijoules);
+
+        default:
+            return 0;
+    }
+}
+
+size_t PageRenderer::formatLiveUpdate(char* out, size_t capacity) const
+{
+    float aqi[] = {
+        _sensor.currentAirQualityIndex(),
+        _sensor.tenMinuteAirQualityIndex(),
+        _sensor.oneHourAirQualityIndex(),
+        _sensor.oneDayAirQualityIndex()
+    };
+    size_t length = formatValue(out, capacity,
+        "{\"t\":%ld,\"aqi\":[%.1f,%.1f,%.1f,%.1f],\"color\":[%d,%d,%d,%d]",
+        (long)_status.lastUpdateTime, aqi[0], aqi[1], aqi[2], aqi[3],
+        AirQualitySensor::getAQIStatusColor(aqi[0]), AirQualitySensor::getAQIStatusColor(aqi[1]),
+        AirQualitySensor::getAQIStatusColor(aqi[2]), AirQualitySensor::getAQIStatusColor(aqi[3])
+    );
+    if (_status.hasBME680 && (_status.temperature != UNSET_ENVIRONMENT_VALUE)) {
+        length += formatValue(out + length, capacity - length, ",\"env\":[%.1f,%.1f,%.1f]",
+            _status.temperature*9.0/5.0 + 32.0, _status.pressure, _status.humidity);
+    }
+    length += formatValue(out + length, capacity - length, "}");
+    return length;
+}
+
+void PageRenderer::writeMetrics(Print& out) const
+{
+    PrometheusWriter metrics(out);
+
+    metrics.counter("diyaqi_sensor_frames_valid_total", "Sensor frames that passed their checks.", _sensor.validFrameCount());
+    metrics.counter("diyaqi_sensor_frames_corrupt_total", "Sensor frames that failed their checks.", _sensor.corruptFrameCount());
+    metrics.counter("diyaqi_sensor_frames_dropped_total", "Sensor frames superseded before they were sampled.", _sensor.droppedFrameCount());
+    metrics.counter("diyaqi_sensor_bytes_received_total", "Bytes drained from the sensor UART.", _sensor.receivedByteCount());
+    metrics.counter("diyaqi_sensor_bytes_discarded_total", "Sensor bytes discarded while finding a frame.", _sensor.discardedByteCount());
+    metrics.counter("diyaqi_samples_missed_total", "Sample periods without a new sensor frame.", _sensor.missedSampleCount());
+    metrics.counter("diyaqi_sample_queue_overflows_total", "Samples lost to a full sample queue.", _sensor.sampleQueueOverflowCount());
+    metrics.gauge("diyaqi_sample_queue_high_water", "Most samples ever waiting in the sample queue.", _sensor.sampleQueueHighWaterMark());
+    metrics.counter("diyaqi_telemetry_requests_total", "Telemetry posts made.", _status.telemetryRequestCount);
+    metrics.counter("diyaqi_telemetry_failures_total", "Telemetry posts that failed.", _status.telemetryFailureCount);
+    metrics.gauge("diyaqi_telemetry_queued_records", "Telemetry records waiting to be sent.", _status.telemetryQueuedCount);
+    metrics.counter("diyaqi_telemetry_dropped_records_total", "Telemetry records dropped from a full queue.", _status.telemetryDroppedCount);
+    metrics.counter("diyaqi_live_updates_total", "Updates pushed to live dashboards.", _status.liveUpdateCount);
+    metrics.counter("diyaqi_live_updates_skipped_total", "Live dashboard updates skipped for slow clients.", _status.liveSkippedCount);
+    metrics.gauge("diyaqi_heap_size_bytes", "Size of the heap.", _status.heapSize);
+    metrics.gauge("diyaqi_heap_min_free_bytes", "Least free heap since boot.", _status.heapMinFree);
+    metrics.gauge("diyaqi_psram_size_bytes", "Size of the PSRAM heap, 0 without PSRAM.", _status.psramSize);
+    metrics.gauge("diyaqi_psram_min_free_bytes", "Least free PSRAM since boot.", _status.psramMinFree);
+    metrics.counter("diyaqi_log_dropped_total", "Logs dropped from a full log queue.", Log.droppedCount());
+    metrics.gauge("diyaqi_duty_cycle_ratio", "Estimated share of the time the CPU has been awake.", _status.dutyCycle);
+    metrics.counter("diyaqi_sleep_wakes_total", "Light sleeps woken from.", _status.wakeCount);
+    metrics.counter("diyaqi_radio_wakes_total", "Times the WiFi radio was turned on.", _status.radioWakeCount);
+    metrics.gauge("diyaqi_energy_per_sample_joules", "Estimated energy used per sample.", _status.energyPerSampleMillijoules/1000);
+    if (_status.environment != nullptr) {
+        metrics.counter("diyaqi_environment_readings_total", "BME680 readings taken.", _status.environment->readingCount());
+        metrics.counter("diyaqi_environment_failures_total", "BME680 readings that failed or timed out.", _status.environment->failureCount());
+    }
+    if (_status.uartCapture != nullptr) {
+        metrics.gauge("diyaqi_uart_capture_recording", "1 while the sensor UART is being captured.", _status.uartCapture->isRecording() ? 1 : 0);
+        metrics.counter("diyaqi_uart_capture_bytes_total", "Sensor UART bytes captured.", _status.uartCapture->capturedByteCount());
+        metrics.counter("diyaqi_uart_capture_dropped_bytes_total", "Sensor UART bytes lost to a full capture queue.", _status.uartCapture->droppedByteCount());
+    }
+
+    const char* latency = "diyaqi_stage_latency_seconds";
+    metrics.family(latency, "histogram", "Time taken by each stage of the sample pipeline and main loop.");
+    metrics.histogram(latency, "stage", "sensor_read", _sensor.readLatency());
+    metrics.histogram(latency, "stage", "sensor_decode", _sensor.decodeLatency());
+    metrics.histogram(latency, "stage", "sensor_queue", _sensor.queueLatency());
+    metrics.histogram(latency, "stage", "sensor_apply", _sensor.applyLatency());
+    for (uint8_t i = 0; i < LOOP_STAGE_COUNT; i++) {
+        if (_status.loopLatency[i] != nullptr) {
+            metrics.histogram(latency, "stage", LOOP_STAGE_NAMES[i], *_status.loopLatency[i]);
+        }
+    }
+    if (_status.telemetryConnectLatency != nullptr) {
+        metrics.histogram(latency, "stage", "telemetry_connect", *_status.telemetryConnectLatency);
+    }
+    if (_status.telemetrySendLatency != nullptr) {
+        metrics.histogram(latency, "stage", "telemetry_send", *_status.telemetrySendLatency);
+    }
+    if (_status.telemetryResponseLatency != nullptr) {
+        metrics.histogram(latency, "stage", "telemetry_response", *_status.telemetryResponseLatency);
+    }
+}
+
+String PageRenderer::processTemplateVariable(const String& var) const
+{
+    char value[TEMPLATE_VALUE_MAX_LENGTH];
+    size_t length = formatVariable(lookupTemplateVariable(var.c_str(), var.length()), value, sizeof(value));
+    value[length] = '\0';
+    return String(value);
+}
+
+// temperature, humidity, pressure and gas resistance averages, as the root page shows them
+size_t PageRenderer::formatEnvironmentAverages(EnvironmentWindow window, char* out, size_t capacity) const
+{
+    float temperature, humidity, pressure, gas_resistance;
+    if ((_status.environment == nullptr)
+            || !_status.environment->windowAverage(ENVIRONMENT_CHANNEL_TEMPERATURE, window, temperature)
+            || !_status.environment->windowAverage(ENVIRONMENT_CHANNEL_HUMIDITY, window, humidity)
+            || !_status.environment->windowAverage(ENVIRONMENT_CHANNEL_PRESSURE, window, pressure)) {
+        return formatValue(out, capacity, "-");
+    }
+    size_t length = formatValue(out, capacity, "%.1f &deg;F / %.1f%% / %.1f hPa",
+                        temperature*9.0/5.0 + 32.0, humidity, pressure);
+    if (_status.environment->windowAverage(ENVIRONMENT_CHANNEL_GAS_RESISTANCE, window, gas_resistance)) {
+        length += formatValue(out + length, capacity - length, " / %.1f kohm", gas_resistance/1000.0);
+    }
+    return length;
+}
+
+size_t PageRenderer::formatStageLatency(const LatencyHistogram& histogram, char* out, size_t capacity)
+{
+    return formatValue(out, capacity, "%.1f / %u / %u &micro;s",
+        histogram.averageMicros(), histogram.percentileMicros(90), histogram.maxMicros());
+}
+
+size_t PageRenderer::formatLatencyHistogram(const LatencyHistogram* histogram, char* out, size_t capacity)
+{
+    if ((histogram == nullptr) || (histogram->count() == 0)) {
+        return formatValue(out, capacity, "None");
+    }
+    return formatValue(out, capacity, "%u / %u / %u ms (%u)",
+        (histogram->percentileMicros(50) + 500)/1000, (histogram->percentileMicros(90) + 500)/1000,
+        (histogram->maxMicros() + 500)/1000, histogram->count());
+}
+
+String PageRenderer::renderTemplate(const char* html, size_t length, const TemplateVariableProcessor& processor)
+{
+    String rendered;
+    rendered.reserve(length);
+
+    size_t i = 0;
+    while (i < length) {
+        const char* start = (const char*)memchr(html + i, TEMPLATE_PLACEHOLDER, length - i);
+        if (start == nullptr) {
+            appendSpan(rendered, html + i, length - i);
+            break;
+        }
+        size_t placeholder_idx = start - html;
+        appendSpan(rendered, html + i, placeholder_idx - i);
+
+        // find the closing placeholder within the longest allowed variable name
+        size_t end_idx = placeholder_idx + 1;
+        while ((end_idx < length) && (end_idx - placeholder_idx <= TEMPLATE_VARIABLE_MAX_LENGTH)
+                && (html[end_idx] != TEMPLATE_PLACEHOLDER)) {
+            end_idx++;
+        }
+        if ((end_idx >= length) || (html[end_idx] != TEMPLATE_PLACEHOLDER)) {
+            // not a variable, so emit the placeholder character as is
+            rendered.concat((char)TEMPLATE_PLACEHOLDER);
+            i = placeholder_idx + 1;
+        } else if (end_idx == placeholder_idx + 1) {
+            // an escaped placeholder character
+            rendered.concat((char)TEMPLATE_PLACEHOLDER);
+            i = end_idx + 1;
+        } else {
+            String var;
+            appendSpan(var, html + placeholder_idx + 1, end_idx - placeholder_idx - 1);
+            rendered.concat(processor(var));
+            i = end_idx + 1;
+        }
+    }
+    return rendered;
+}
@@ -0,0 +1,180 @@
+#ifndef __PageRenderer__
+#define __PageRenderer__
+#include <Arduino.h>
+#include <functional>
+#include <AirQualitySensor.h>
+#include <EnvironmentSensor.h>
+#include <DutyCycleScheduler.h>
+#include <UARTCapture.h>
+#include <LatencyHistogram.h>
+#include "PageTemplate.h"
+
+// The character that delimits template variables in the HTML files. Normally set by the build flags.
+#ifndef TEMPLATE_PLACEHOLDER
+#define TEMPLATE_PLACEHOLDER '%'
+#endif
+
+// Longest template variable name, matching ESPAsyncWebServer's TEMPLATE_PARAM_NAME_LENGTH.
+#define TEMPLATE_VARIABLE_MAX_LENGTH    32
+
+#define UNSET_ENVIRONMENT_VALUE -301.0
+
+// Longest record that PageRenderer::formatLiveUpdate() writes.
+#define LIVE_UPDATE_MAX_LENGTH  160
+
+// Subsystems that are brought up after the web server is started, as bits of DeviceStatus::bootPending.
+enum BootSubsystem : uint8_t {
+    BOOT_WIFI       = 0x01,     // connecting to the WiFi network
+    BOOT_TIME       = 0x02,     // waiting for the time from NTP
+    BOOT_SENSOR     = 0x04,     // particulate sensor warming up
+    BOOT_HISTORY    = 0x08,     // history to be restored from flash
+
+    BOOT_ALL        = 0x0F
+};
+
+// Stages of handling a sample in the main loop that are timed, as indexes of DeviceStatus::loopLatency.
+enum LoopStage : uint8_t {
+    LOOP_STAGE_BME680,      // reading the BME680
+    LOOP_STAGE_LED,         // setting the status LED
+    LOOP_STAGE_HISTORY,     // adding the sample to the all-channel history
+    LOOP_STAGE_LIVE,        // pushing the sample to the live dashboards
+    LOOP_STAGE_JSON,        // serializing a telemetry batch
+    LOOP_STAGE_POST,        // posting a telemetry batch, or handing it to the asynchronous client
+
+    LOOP_STAGE_COUNT
+};
+
+// The names of the loop stages as they appear in the /metrics stage labels.
+extern const char* const LOOP_STAGE_NAMES[LOOP_STAGE_COUNT];
+
+//
+// Device state shown on the web pages that does not come from the particulate sensor.
+// The Application keeps this up to date.
+//
+struct DeviceStatus {
+    const char* sensorName;
+    const char* wifiSSID;
+    String      ipAddress;
+    const char* telemetryURL;
+    time_t      bootTime;
+    time_t      lastUpdateTime;
+    time_t      lastTransmitTime;
+    uint32_t    measureSeconds;
+    uint32_t    transmitSeconds;
+    uint32_t    telemetryBatchSize;
+    uint32_t    telemetryBatchCapacity;
+    uint32_t    telemetrySampleInterval;
+    // telemetry client statistics. The histograms are nullptr when the client is not in use.
+    uint32_t    telemetryRequestCount;
+    uint32_t    telemetryFailureCount;
+    uint32_t    telemetryConnectionCount;
+    // records queued to be sent later, how many of them are on flash, and how many were dropped
+    uint32_t    telemetryQueuedCount;
+    uint32_t    telemetrySpilledCount;
+    uint32_t    telemetryDroppedCount;
+    const LatencyHistogram* telemetryConnectLatency;
+    const LatencyHistogram* telemetrySendLatency;
+    const LatencyHistogram* telemetryResponseLatency;
+    bool        hasBME680;
+    float       temperature;
+    float       pressure;
+    float       humidity;
+    // the BME680's readings and their averages, or nullptr when there is no BME680
+    const EnvironmentSensor* environment;
+    // the capture of the first particulate sensor's UART, or nullptr if there is none
+    const UARTCapture* uartCapture;
+    uint32_t    rootPageViewCount;
+    // live dashboard clients, the updates pushed to them, updates skipped for slow clients, and
+    // clients disconnected for falling behind
+    uint32_t    liveClientCount;
+    uint32_t    liveUpdateCount;
+    uint32_t    liveSkippedCount;
+    uint32_t    liveDroppedCount;
+    // static file responses, how many were 304s, and how many were read from flash
+    uint32_t    staticServedCount;
+    uint32_t    staticNotModifiedCount;
+    uint32_t    staticFlashReadCount;
+    // rows retained by the compressed all-channel history, the time they span, and their size
+    uint32_t    channelHistoryRows;
+    uint32_t    channelHistorySeconds;
+    uint32_t    channelHistoryBytes;
+    // rollups restored from flash at boot and how long that took, whether the restore was skipped
+    // because the time was not set in time, and rollups saved to flash since, the batch writes
+    // that took, and the writes that failed
+    uint32_t    historyRestoredCount;
+    uint32_t    historyRestoreMillis;
+    bool        historyRestoreSkipped;
+    uint32_t    historyArchivedCount;
+    uint32_t    historyArchiveWriteCount;
+    uint32_t    historyArchiveFailedCount;
+    // subsystems still starting up as BootSubsystem bits, and the millis() time at which all of
+    // them were up and at which the first page or API response was sent, or 0 if not yet
+    uint8_t     bootPending;
+    uint32_t    bootCompleteMillis;
+    uint32_t    firstResponseMillis;
+    // latencies of the main loop stages. An entry is nullptr if the stage is not timed.
+    const LatencyHistogram* loopLatency[LOOP_STAGE_COUNT];
+    // heap and PSRAM sizes, and the least that has been free since boot
+    uint32_t    heapSize;
+    uint32_t    heapMinFree;
+    uint32_t    psramSize;
+    uint32_t    psramMinFree;
+    // the POWER_PROFILE_* the device runs in, the share of the time it has been awake, the light
+    // sleeps it has woken from and the times its radio was turned on, and its estimated current
+    // and energy used per sample
+    uint8_t     powerProfile;
+    float       dutyCycle;
+    uint32_t    wakeCount;
+    uint32_t    radioWakeCount;
+    float       averageMilliamps;
+    float       energyPerSampleMillijoules;
+    // changes whenever a new sensor sample has been applied, so rendered pages can be cached until then
+    uint32_t    sampleEpoch;
+};
+
+typedef std::function<String(const String&)> TemplateVariableProcessor;
+
+//
+// PageRenderer
+//
+// Produces the values of the template variables in the root and stats pages. This is kept
+// apart from the Application so that page rendering can be tested and benchmarked on the host.
+// formatVariable() is meant to be used as the TemplateValueFormatter for a PageTemplate.
+//
+class PageRenderer {
+private:
+    const AirQualitySensor& _sensor;
+    const DeviceStatus&     _status;
+
+    static size_t formatStageLatency(const LatencyHistogram& histogram, char* out, size_t capacity);
+    static size_t formatLatencyHistogram(const LatencyHistogram* histogram, char* out, size_t capacity);
+    static size_t formatBootPending(uint8_t pending, char* out, size_t capacity);
+    size_t formatEnvironmentAverages(EnvironmentWindow window, char* out, size_t capacity) const;
+
+public:
+    PageRenderer(const AirQualitySensor& sensor, const DeviceStatus& status);
+
+    // Writes the value of the template variable into out, and returns the number of bytes written.
+    size_t formatVariable(TemplateVariableID id, char* out, size_t capacity) const;
+
+    // Writes the record pushed to the live dashboards after each sample, and returns its length.
+    // The record is JSON with the values as the root page shows them:
+    //   {"t":<sample time>,"aqi":[<current>,<10 min>,<1 hour>,<24 hour>],"color":[<AQIStatusColor>,...],
+    //    "env":[<temperature °F>,<pressure hPa>,<humidity %>]}
+    // env is only present when there is a BME680 reading.
+    size_t formatLiveUpdate(char* out, size_t capacity) const;
+
+    // Writes the counters, memory figures and stage latency histograms in the Prometheus text
+    // format, for the /metrics endpoint.
+    void writeMetrics(Print& out) const;
+
+    // Returns the value of the named template variable, for ESPAsyncWebServer's template processing.
+    String processTemplateVariable(const String& var) const;
+
+    // Renders an HTML template the same way ESPAsyncWebServer's template processing does: each
+    // TEMPLATE_PLACEHOLDER delimited variable is replaced with the processor's value for it, and a
+    // doubled TEMPLATE_PLACEHOLDER is replaced with a single one.
+    static String renderTemplate(const char* html, size_t length, const TemplateVariableProcessor& processor);
+};
+
+#endif // __PageRenderer__
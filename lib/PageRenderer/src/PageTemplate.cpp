@@ -0,0 +1,303 @@
+#include <Logger.h>
+#include "PageTemplate.h"
+#include "PageRenderer.h"
+
+//
+// Template variable lookup
+//
+
+// FNV-1a hash, evaluated at compile time for the case labels below. A collision between two
+// variable names shows up as a duplicate case label.
+static constexpr uint32_t templateVariableHash(const char* name, size_t length, uint32_t hash = 2166136261u)
+{
+    return (length == 0) ? hash : templateVariableHash(name + 1, length - 1, (hash ^ (uint8_t)name[0])*16777619u);
+}
+
+#define TEMPLATE_VARIABLE_CASE(name, id) \
+    case templateVariableHash(name, sizeof(name) - 1): \
+        return ((length == sizeof(name) - 1) && (memcmp(name, var, length) == 0)) ? id : TEMPLATE_VARIABLE_UNKNOWN
+
+TemplateVariableID lookupTemplateVariable(const char* var, size_t length)
+{
+    switch (templateVariableHash(var, length)) {
+        TEMPLATE_VARIABLE_CASE("AQI-CURRENT", TEMPLATE_VARIABLE_AQI_CURRENT);
+        TEMPLATE_VARIABLE_CASE("AQI-10MIN", TEMPLATE_VARIABLE_AQI_10MIN);
+        TEMPLATE_VARIABLE_CASE("AQI-1HOUR", TEMPLATE_VARIABLE_AQI_1HOUR);
+        TEMPLATE_VARIABLE_CASE("AQI-24HOUR", TEMPLATE_VARIABLE_AQI_24HOUR);
+        TEMPLATE_VARIABLE_CASE("COLOR-CURRENT", TEMPLATE_VARIABLE_COLOR_CURRENT);
+        TEMPLATE_VARIABLE_CASE("COLOR-10MIN", TEMPLATE_VARIABLE_COLOR_10MIN);
+        TEMPLATE_VARIABLE_CASE("COLOR-1HOUR", TEMPLATE_VARIABLE_COLOR_1HOUR);
+        TEMPLATE_VARIABLE_CASE("COLOR-24HOUR", TEMPLATE_VARIABLE_COLOR_24HOUR);
+        TEMPLATE_VARIABLE_CASE("SENSORNAME", TEMPLATE_VARIABLE_SENSORNAME);
+        TEMPLATE_VARIABLE_CASE("TEMPERATURE", TEMPLATE_VARIABLE_TEMPERATURE);
+        TEMPLATE_VARIABLE_CASE("PRESSURE", TEMPLATE_VARIABLE_PRESSURE);
+        TEMPLATE_VARIABLE_CASE("HUMIDITY", TEMPLATE_VARIABLE_HUMIDITY);
+        TEMPLATE_VARIABLE_CASE("PERCENT", TEMPLATE_VARIABLE_PERCENT);
+        TEMPLATE_VARIABLE_CASE("WIFISSID", TEMPLATE_VARIABLE_WIFISSID);
+        TEMPLATE_VARIABLE_CASE("IPADDRESS", TEMPLATE_VARIABLE_IPADDRESS);
+        TEMPLATE_VARIABLE_CASE("BOOTTIME", TEMPLATE_VARIABLE_BOOTTIME);
+        TEMPLATE_VARIABLE_CASE("LASTMEASURETIME", TEMPLATE_VARIABLE_LASTMEASURETIME);
+        TEMPLATE_VARIABLE_CASE("LASTTRANSMIT", TEMPLATE_VARIABLE_LASTTRANSMIT);
+        TEMPLATE_VARIABLE_CASE("HISTORYSIZE", TEMPLATE_VARIABLE_HISTORYSIZE);
+        TEMPLATE_VARIABLE_CASE("HISTORYRETENTION", TEMPLATE_VARIABLE_HISTORYRETENTION);
+        TEMPLATE_VARIABLE_CASE("HASBME680", TEMPLATE_VARIABLE_HASBME680);
+        TEMPLATE_VARIABLE_CASE("MEASURERATE", TEMPLATE_VARIABLE_MEASURERATE);
+        TEMPLATE_VARIABLE_CASE("TRANSMITRATE", TEMPLATE_VARIABLE_TRANSMITRATE);
+        TEMPLATE_VARIABLE_CASE("TELEMETRYBATCH", TEMPLATE_VARIABLE_TELEMETRYBATCH);
+        TEMPLATE_VARIABLE_CASE("TELEMETRYREQUESTS", TEMPLATE_VARIABLE_TELEMETRYREQUESTS);
+        TEMPLATE_VARIABLE_CASE("TELEMETRYQUEUE", TEMPLATE_VARIABLE_TELEMETRYQUEUE);
+        TEMPLATE_VARIABLE_CASE("TELEMETRYCONNECTLATENCY", TEMPLATE_VARIABLE_TELEMETRYCONNECTLATENCY);
+        TEMPLATE_VARIABLE_CASE("TELEMETRYSENDLATENCY", TEMPLATE_VARIABLE_TELEMETRYSENDLATENCY);
+        TEMPLATE_VARIABLE_CASE("TELEMETRYRESPONSELATENCY", TEMPLATE_VARIABLE_TELEMETRYRESPONSELATENCY);
+        TEMPLATE_VARIABLE_CASE("TRANSMITURL", TEMPLATE_VARIABLE_TRANSMITURL);
+        TEMPLATE_VARIABLE_CASE("PDSTATUS", TEMPLATE_VARIABLE_PDSTATUS);
+        TEMPLATE_VARIABLE_CASE("LASERSTATUS", TEMPLATE_VARIABLE_LASERSTATUS);
+        TEMPLATE_VARIABLE_CASE("FANSTATUS", TEMPLATE_VARIABLE_FANSTATUS);
+        TEMPLATE_VARIABLE_CASE("ROOTVIEWCOUNT", TEMPLATE_VARIABLE_ROOTVIEWCOUNT);
+        TEMPLATE_VARIABLE_CASE("SENSORFRAMES", TEMPLATE_VARIABLE_SENSORFRAMES);
+        TEMPLATE_VARIABLE_CASE("SENSORBYTES", TEMPLATE_VARIABLE_SENSORBYTES);
+        TEMPLATE_VARIABLE_CASE("SAMPLEQUEUE", TEMPLATE_VARIABLE_SAMPLEQUEUE);
+        TEMPLATE_VARIABLE_CASE("READLATENCY", TEMPLATE_VARIABLE_READLATENCY);
+        TEMPLATE_VARIABLE_CASE("DECODELATENCY", TEMPLATE_VARIABLE_DECODELATENCY);
+        TEMPLATE_VARIABLE_CASE("QUEUELATENCY", TEMPLATE_VARIABLE_QUEUELATENCY);
+        TEMPLATE_VARIABLE_CASE("APPLYLATENCY", TEMPLATE_VARIABLE_APPLYLATENCY);
+        TEMPLATE_VARIABLE_CASE("LIVEUPDATES", TEMPLATE_VARIABLE_LIVEUPDATES);
+        TEMPLATE_VARIABLE_CASE("STATICFILES", TEMPLATE_VARIABLE_STATICFILES);
+        TEMPLATE_VARIABLE_CASE("CHANNELHISTORY", TEMPLATE_VARIABLE_CHANNELHISTORY);
+        TEMPLATE_VARIABLE_CASE("NOWCAST", TEMPLATE_VARIABLE_NOWCAST);
+        TEMPLATE_VARIABLE_CASE("HISTORYARCHIVE", TEMPLATE_VARIABLE_HISTORYARCHIVE);
+        TEMPLATE_VARIABLE_CASE("STARTUP", TEMPLATE_VARIABLE_STARTUP);
+        TEMPLATE_VARIABLE_CASE("BOOTSTATUS", TEMPLATE_VARIABLE_BOOTSTATUS);
+        TEMPLATE_VARIABLE_CASE("LOOPLATENCY", TEMPLATE_VARIABLE_LOOPLATENCY);
+        TEMPLATE_VARIABLE_CASE("MEMORY", TEMPLATE_VARIABLE_MEMORY);
+        TEMPLATE_VARIABLE_CASE("AVERAGECOVERAGE", TEMPLATE_VARIABLE_AVERAGECOVERAGE);
+        TEMPLATE_VARIABLE_CASE("PM2P5SPREAD10MIN", TEMPLATE_VARIABLE_PM2P5SPREAD10MIN);
+        TEMPLATE_VARIABLE_CASE("PM2P5SPREAD1HOUR", TEMPLATE_VARIABLE_PM2P5SPREAD1HOUR);
+        TEMPLATE_VARIABLE_CASE("PM2P5SPREAD24HOUR", TEMPLATE_VARIABLE_PM2P5SPREAD24HOUR);
+        TEMPLATE_VARIABLE_CASE("ENVREADINGS", TEMPLATE_VARIABLE_ENVREADINGS);
+        TEMPLATE_VARIABLE_CASE("ENVAVERAGE10MIN", TEMPLATE_VARIABLE_ENVAVERAGE10MIN);
+        TEMPLATE_VARIABLE_CASE("ENVAVERAGE1HOUR", TEMPLATE_VARIABLE_ENVAVERAGE1HOUR);
+        TEMPLATE_VARIABLE_CASE("POWER", TEMPLATE_VARIABLE_POWER);
+        default:
+            return TEMPLATE_VARIABLE_UNKNOWN;
+    }
+}
+
+//
+// PageTemplate
+//
+
+static void* allocateBuffer(size_t bytes)
+{
+    void* buffer = nullptr;
+    if (ESP.getPsramSize() > 0) {
+        buffer = ps_malloc(bytes);
+    }
+    if (buffer == nullptr) {
+        buffer = malloc(bytes);
+    }
+    return buffer;
+}
+
+PageTemplate::PageTemplate()
+    :   _text(nullptr),
+        _textLength(0),
+        _tokens(nullptr),
+        _tokenCount(0),
+        _maxRenderedLength(0),
+        _cached(),
+        _renderCount(0)
+{
+}
+
+PageTemplate::~PageTemplate()
+{
+    clear();
+}
+
+void PageTemplate::clear(void)
+{
+    free(_text);
+    free(_tokens);
+    _text = nullptr;
+    _textLength = 0;
+    _tokens = nullptr;
+    _tokenCount = 0;
+    _maxRenderedLength = 0;
+    _cached.reset();
+}
+
+bool PageTemplate::addLiteral(size_t offset, size_t length, size_t& capacity)
+{
+    _maxRenderedLength += length;
+    // extend the previous literal if this one follows on from it
+    if ((_tokenCount > 0) && (_tokens[_tokenCount - 1].length > 0)) {
+        Token& last = _tokens[_tokenCount - 1];
+        if ((last.offset + last.length == offset) && (last.length + length <= UINT16_MAX)) {
+            last.length += length;
+            return true;
+        }
+    }
+    while (length > 0) {
+        if (!appendToken(capacity)) {
+            return false;
+        }
+        Token& token = _tokens[_tokenCount - 1];
+        token.offset = offset;
+        token.length = (length > UINT16_MAX) ? UINT16_MAX : length;
+        token.variable = TEMPLATE_VARIABLE_UNKNOWN;
+        offset += token.length;
+        length -= token.length;
+    }
+    return true;
+}
+
+bool PageTemplate::addVariable(TemplateVariableID variable, size_t& capacity)
+{
+    if (!appendToken(capacity)) {
+        return false;
+    }
+    Token& token = _tokens[_tokenCount - 1];
+    token.offset = 0;
+    token.length = 0;
+    token.variable = variable;
+    _maxRenderedLength += TEMPLATE_VALUE_MAX_LENGTH - 1;
+    return true;
+}
+
+bool PageTemplate::appendToken(size_t& capacity)
+{
+    if (_tokenCount == capacity) {
+        size_t new_capacity = (capacity > 0) ? 2*capacity : 32;
+        Token* tokens = (Token*)realloc(_tokens, new_capacity*sizeof(Token));
+        if (tokens == nullptr) {
+            return false;
+        }
+        _tokens = tokens;
+        capacity = new_capacity;
+    }
+    _tokenCount++;
+    return true;
+}
+
+bool PageTemplate::parse(const char* html, size_t length)
+{
+    clear();
+    _text = (char*)allocateBuffer(length + 1);
+    if (_text == nullptr) {
+        return false;
+    }
+    memcpy(_text, html, length);
+    _text[length] = '\0';
+    _textLength = length;
+
+    size_t capacity = 0;
+    size_t i = 0;
+    bool ok = true;
+    while (ok && (i < length)) {
+        const char* start = (const char*)memchr(_text + i, TEMPLATE_PLACEHOLDER, length - i);
+        if (start == nullptr) {
+            ok = addLiteral(i, length - i, capacity);
+            break;
+        }
+        size_t placeholder_idx = start - _text;
+        ok = addLiteral(i, placeholder_idx - i, capacity);
+
+        // find the closing placeholder within the longest allowed variable name
+        size_t end_idx = placeholder_idx + 1;
+        while ((end_idx < length) && (end_idx - placeholder_idx <= TEMPLATE_VARIABLE_MAX_LENGTH)
+                && (_text[end_idx] != TEMPLATE_PLACEHOLDER)) {
+            end_idx++;
+        }
+        if ((end_idx >= length) || (_text[end_idx] != TEMPLATE_PLACEHOLDER)) {
+            // not a variable, so the placeholder character is literal
+            ok = ok && addLiteral(placeholder_idx, 1, capacity);
+            i = placeholder_idx + 1;
+        } else if (end_idx == placeholder_idx + 1) {
+            // an escaped placeholder character
+            ok = ok && addLiteral(placeholder_idx, 1, capacity);
+            i = end_idx + 1;
+        } else {
+            TemplateVariableID variable = lookupTemplateVariable(_text + placeholder_idx + 1, end_idx - placeholder_idx - 1);
+            if (variable != TEMPLATE_VARIABLE_UNKNOWN) {
+                ok = ok && addVariable(variable, capacity);
+            }
+            i = end_idx + 1;
+        }
+    }
+    if (!ok) {
+        clear();
+    }
+    return ok;
+}
+
+bool PageTemplate::load(fs::FS& fs, const char* path)
+{
+    File file = fs.open(path, FILE_READ);
+    if (!file) {
+        LOG_ERROR("ERROR - Could not open page template %s", path);
+        return false;
+    }
+    size_t length = file.size();
+    char* html = (char*)allocateBuffer(length);
+    if (html == nullptr) {
+        file.close();
+        LOG_ERROR("ERROR - Could not allocate memory for page template %s", path);
+        return false;
+    }
+    size_t read_length = file.read((uint8_t*)html, length);
+    file.close();
+    bool ok = (read_length == length) && parse(html, length);
+    free(html);
+    if (!ok) {
+        LOG_ERROR("ERROR - Could not load page template %s", path);
+    }
+    return ok;
+}
+
+size_t PageTemplate::renderTo(const TemplateValueFormatter& formatter, char* out) const
+{
+    size_t length = 0;
+    for (size_t i = 0; i < _tokenCount; i++) {
+        const Token& token = _tokens[i];
+        if (token.length > 0) {
+            memcpy(out + length, _text + token.offset, token.length);
+            length += token.length;
+        } else {
+            size_t value_length = formatter(token.variable, out + length, TEMPLATE_VALUE_MAX_LENGTH);
+            length += (value_length < TEMPLATE_VALUE_MAX_LENGTH) ? value_length : TEMPLATE_VALUE_MAX_LENGTH - 1;
+        }
+    }
+    return length;
+}
+
+RenderedPagePtr PageTemplate::render(uint32_t epoch, const TemplateValueFormatter& formatter)
+{
+    if (!isLoaded()) {
+        return RenderedPagePtr();
+    }
+    if (_cached && (_cached->epoch == epoch)) {
+        return _cached;
+    }
+
+    // the last page's buffer can be reused once no response is still sending it
+    RenderedPagePtr page = _cached;
+    if (!page || (page.use_count() > 2)) {
+        page = std::make_shared<RenderedPage>();
+    }
+    // the formatter writes snprintf terminators, so a byte is needed past the longest value
+    if (page->capacity < _maxRenderedLength + 1) {
+        free(page->data);
+        page->data = (char*)allocateBuffer(_maxRenderedLength + 1);
+        page->capacity = (page->data != nullptr) ? _maxRenderedLength + 1 : 0;
+        if (page->data == nullptr) {
+            _cached.reset();
+            return RenderedPagePtr();
+        }
+    }
+    page->length = renderTo(formatter, page->data);
+    page->epoch = epoch;
+    _cached = page;
+    _renderCount++;
+    return _cached;
+}
@@ -0,0 +1,165 @@
+#ifndef __PageTemplate__
+#define __PageTemplate__
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <memory>
+
+// Longest value a template variable can render to, including room for snprintf's terminator.
+#define TEMPLATE_VALUE_MAX_LENGTH   96
+
+//
+// The variables the page templates can use. Each has a fixed ID so that rendering a variable
+// is a switch on its ID rather than a comparison of its name against every known name.
+//
+enum TemplateVariableID : uint8_t {
+    TEMPLATE_VARIABLE_UNKNOWN = 0,
+    // root pages
+    TEMPLATE_VARIABLE_AQI_CURRENT,
+    TEMPLATE_VARIABLE_AQI_10MIN,
+    TEMPLATE_VARIABLE_AQI_1HOUR,
+    TEMPLATE_VARIABLE_AQI_24HOUR,
+    TEMPLATE_VARIABLE_COLOR_CURRENT,
+    TEMPLATE_VARIABLE_COLOR_10MIN,
+    TEMPLATE_VARIABLE_COLOR_1HOUR,
+    TEMPLATE_VARIABLE_COLOR_24HOUR,
+    TEMPLATE_VARIABLE_SENSORNAME,
+    TEMPLATE_VARIABLE_TEMPERATURE,
+    TEMPLATE_VARIABLE_PRESSURE,
+    TEMPLATE_VARIABLE_HUMIDITY,
+    // stats page
+    TEMPLATE_VARIABLE_PERCENT,
+    TEMPLATE_VARIABLE_WIFISSID,
+    TEMPLATE_VARIABLE_IPADDRESS,
+    TEMPLATE_VARIABLE_BOOTTIME,
+    TEMPLATE_VARIABLE_LASTMEASURETIME,
+    TEMPLATE_VARIABLE_LASTTRANSMIT,
+    TEMPLATE_VARIABLE_HISTORYSIZE,
+    TEMPLATE_VARIABLE_HISTORYRETENTION,
+    TEMPLATE_VARIABLE_HASBME680,
+    TEMPLATE_VARIABLE_MEASURERATE,
+    TEMPLATE_VARIABLE_TRANSMITRATE,
+    TEMPLATE_VARIABLE_TELEMETRYBATCH,
+    TEMPLATE_VARIABLE_TELEMETRYREQUESTS,
+    TEMPLATE_VARIABLE_TELEMETRYQUEUE,
+    TEMPLATE_VARIABLE_TELEMETRYCONNECTLATENCY,
+    TEMPLATE_VARIABLE_TELEMETRYSENDLATENCY,
+    TEMPLATE_VARIABLE_TELEMETRYRESPONSELATENCY,
+    TEMPLATE_VARIABLE_TRANSMITURL,
+    TEMPLATE_VARIABLE_PDSTATUS,
+    TEMPLATE_VARIABLE_LASERSTATUS,
+    TEMPLATE_VARIABLE_FANSTATUS,
+    TEMPLATE_VARIABLE_ROOTVIEWCOUNT,
+    TEMPLATE_VARIABLE_SENSORFRAMES,
+    TEMPLATE_VARIABLE_SENSORBYTES,
+    TEMPLATE_VARIABLE_SAMPLEQUEUE,
+    TEMPLATE_VARIABLE_READLATENCY,
+    TEMPLATE_VARIABLE_DECODELATENCY,
+    TEMPLATE_VARIABLE_QUEUELATENCY,
+    TEMPLATE_VARIABLE_APPLYLATENCY,
+    TEMPLATE_VARIABLE_LIVEUPDATES,
+    TEMPLATE_VARIABLE_STATICFILES,
+    TEMPLATE_VARIABLE_CHANNELHISTORY,
+    TEMPLATE_VARIABLE_NOWCAST,
+    TEMPLATE_VARIABLE_HISTORYARCHIVE,
+    TEMPLATE_VARIABLE_STARTUP,
+    TEMPLATE_VARIABLE_BOOTSTATUS,
+    TEMPLATE_VARIABLE_LOOPLATENCY,
+    TEMPLATE_VARIABLE_MEMORY,
+    TEMPLATE_VARIABLE_AVERAGECOVERAGE,
+    TEMPLATE_VARIABLE_PM2P5SPREAD10MIN,
+    TEMPLATE_VARIABLE_PM2P5SPREAD1HOUR,
+    TEMPLATE_VARIABLE_PM2P5SPREAD24HOUR,
+    TEMPLATE_VARIABLE_ENVREADINGS,
+    TEMPLATE_VARIABLE_ENVAVERAGE10MIN,
+    TEMPLATE_VARIABLE_ENVAVERAGE1HOUR,
+    TEMPLATE_VARIABLE_POWER,
+
+    TEMPLATE_VARIABLE_COUNT
+};
+
+// Returns the ID of the named template variable, or TEMPLATE_VARIABLE_UNKNOWN.
+TemplateVariableID lookupTemplateVariable(const char* name, size_t length);
+
+// Writes the value of a template variable into out, which has room for capacity bytes, and
+// returns the number of bytes written.
+typedef std::function<size_t(TemplateVariableID id, char* out, size_t capacity)> TemplateValueFormatter;
+
+//
+// A page rendered from a PageTemplate. It is shared by every response that serves it, so it
+// stays valid until the last of them is done.
+//
+struct RenderedPage {
+    char*       data;
+    size_t      length;
+    size_t      capacity;
+    uint32_t    epoch;
+
+    RenderedPage() : data(nullptr), length(0), capacity(0), epoch(0) {}
+    ~RenderedPage()                         { free(data); }
+};
+
+typedef std::shared_ptr<RenderedPage> RenderedPagePtr;
+
+//
+// PageTemplate
+//
+// An HTML template that is parsed once into a list of literal spans and variable IDs, so
+// rendering it is a series of copies and switch dispatched variable lookups. Variables are
+// delimited by TEMPLATE_PLACEHOLDER and follow the same rules as
+// PageRenderer::renderTemplate(). Unknown variables render as nothing.
+//
+// The rendered page is cached along with the epoch it was rendered for, and is reused until
+// render() is called with a different epoch. The owner picks the epoch, normally one that
+// changes whenever the values the page shows do.
+//
+// This class is not thread safe. render() should always be called from the same task.
+//
+class PageTemplate {
+private:
+    struct Token {
+        uint32_t            offset;     // of a literal span in the template text
+        uint16_t            length;     // of a literal span, or 0 for a variable
+        TemplateVariableID  variable;
+    };
+
+    char*               _text;
+    size_t              _textLength;
+    Token*              _tokens;
+    size_t              _tokenCount;
+    size_t              _maxRenderedLength;
+    RenderedPagePtr     _cached;
+    uint32_t            _renderCount;
+
+    void clear(void);
+    bool appendToken(size_t& capacity);
+    bool addLiteral(size_t offset, size_t length, size_t& capacity);
+    bool addVariable(TemplateVariableID variable, size_t& capacity);
+
+public:
+    PageTemplate();
+    virtual ~PageTemplate();
+
+    // Parses the template, copying its text. Returns false if memory could not be allocated.
+    bool parse(const char* html, size_t length);
+
+    // Reads and parses a template file. Returns false if it could not be read.
+    bool load(fs::FS& fs, const char* path);
+
+    bool isLoaded(void) const               { return _text != nullptr; }
+    size_t tokenCount(void) const           { return _tokenCount; }
+    size_t maxRenderedLength(void) const    { return _maxRenderedLength; }
+
+    // Renders the template into out and returns the rendered length, which is at most
+    // maxRenderedLength().
+    size_t renderTo(const TemplateValueFormatter& formatter, char* out) const;
+
+    // Returns the page rendered for epoch, rendering it if the cached page is for another
+    // epoch. Returns an empty pointer if the template is not loaded or memory runs out.
+    RenderedPagePtr render(uint32_t epoch, const TemplateValueFormatter& formatter);
+
+    // number of times the page was actually rendered rather than served from the cache
+    uint32_t renderCount(void) const        { return _renderCount; }
+};
+
+#endif // __PageTemplate__
@@ -0,0 +1,104 @@
+#ifndef __MPSCQueue__
+#define __MPSCQueue__
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+//
+// MPSCQueue
+//
+// A lock-free, fixed capacity, multiple-producer/single-consumer ring buffer. Any number of
+// tasks may call push() concurrently, and exactly one task may call pop(). CAPACITY must be a
+// power of two. Items are copied in and out, so T should be a plain struct.
+//
+// Each slot carries a sequence number that tells whether it is free to be written in the
+// current lap of the ring, or holds an item that is ready to be read. Producers claim a slot by
+// advancing the head with a compare-and-swap, copy their item in, and then publish it by
+// advancing the slot's sequence. A producer never waits on another: if the slot it would claim
+// still holds an unread item, the queue is full and push() fails at once. The consumer reads
+// items in the order their slots were claimed, so an item that is still being copied in holds
+// back the ones claimed after it until it is published.
+//
+// push() must not be called from an interrupt handler.
+//
+template <typename T, size_t CAPACITY>
+class MPSCQueue {
+private:
+    static_assert((CAPACITY > 0) && ((CAPACITY & (CAPACITY - 1)) == 0), "MPSCQueue CAPACITY must be a power of two");
+
+    struct Slot {
+        std::atomic<uint32_t>   sequence;
+        T                       item;
+    };
+
+    Slot                    _slots[CAPACITY];
+    std::atomic<uint32_t>   _head;      // next slot to claim. Advanced by the producers.
+    std::atomic<uint32_t>   _tail;      // next slot to read. Only modified by the consumer.
+    std::atomic<uint32_t>   _overflowCount;
+
+public:
+    MPSCQueue()
+        :   _head(0),
+            _tail(0),
+            _overflowCount(0)
+    {
+        for (uint32_t i = 0; i < CAPACITY; i++) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Any producer. Returns false, and counts an overflow, if the queue is full.
+    bool push(const T& item)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &_slots[head & (CAPACITY - 1)];
+            int32_t lap = (int32_t)(slot->sequence.load(std::memory_order_acquire) - head);
+            if (lap == 0) {
+                // the slot is free in this lap, so try to claim it. On failure head is reloaded.
+                if (_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (lap < 0) {
+                // the slot still holds the item from the last lap
+                _overflowCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                // another producer claimed the slot first
+                head = _head.load(std::memory_order_relaxed);
+            }
+        }
+        slot->item = item;
+        slot->sequence.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty, or the next item is not yet published.
+    bool pop(T& item)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        Slot& slot = _slots[tail & (CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+            return false;
+        }
+        item = slot.item;
+        // free the slot for the next lap
+        slot.sequence.store(tail + CAPACITY, std::memory_order_release);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Number of slots claimed and not yet read. A snapshot when called while producers are active.
+    size_t size(void) const
+    {
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        return _head.load(std::memory_order_acquire) - tail;
+    }
+
+    bool empty(void) const                  { return size() == 0; }
+    size_t capacity(void) const             { return CAPACITY; }
+    uint32_t overflowCount(void) const      { return _overflowCount.load(std::memory_order_relaxed); }
+};
+
+#endif // __MPSCQueue__
@@ -0,0 +1,80 @@
+#ifndef __SPSCQueue__
+#define __SPSCQueue__
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+//
+// SPSCQueue
+//
+// A lock-free, fixed capacity, single-producer/single-consumer ring buffer. Exactly one task
+// may call push() and exactly one task may call pop(). The two tasks may run on different cores.
+// CAPACITY must be a power of two. Items are copied in and out, so T should be a small plain
+// struct.
+//
+// The queue also keeps a high water mark of its depth and a count of items that could not
+// be pushed because the queue was full, so the owner can tell if the consumer is keeping up.
+//
+template <typename T, size_t CAPACITY>
+class SPSCQueue {
+private:
+    static_assert((CAPACITY > 0) && ((CAPACITY & (CAPACITY - 1)) == 0), "SPSCQueue CAPACITY must be a power of two");
+
+    T                       _items[CAPACITY];
+    std::atomic<uint32_t>   _head;      // next slot to write. Only modified by the producer.
+    std::atomic<uint32_t>   _tail;      // next slot to read. Only modified by the consumer.
+    std::atomic<uint32_t>   _highWaterMark;
+    std::atomic<uint32_t>   _overflowCount;
+
+public:
+    SPSCQueue()
+        :   _head(0),
+            _tail(0),
+            _highWaterMark(0),
+            _overflowCount(0)
+    {}
+
+    // Producer only. Returns false, and counts an overflow, if the queue is full.
+    bool push(const T& item)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t depth = head - _tail.load(std::memory_order_acquire);
+        if (depth >= CAPACITY) {
+            _overflowCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _items[head & (CAPACITY - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        if (depth + 1 > _highWaterMark.load(std::memory_order_relaxed)) {
+            _highWaterMark.store(depth + 1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty.
+    bool pop(T& item)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = _items[tail & (CAPACITY - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Number of items waiting. Exact when called from the producer or consumer, and a snapshot otherwise.
+    size_t size(void) const
+    {
+        // read the tail first so that a concurrent pop can never make the depth negative
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        return _head.load(std::memory_order_acquire) - tail;
+    }
+
+    bool empty(void) const                  { return size() == 0; }
+    size_t capacity(void) const             { return CAPACITY; }
+    uint32_t highWaterMark(void) const      { return _highWaterMark.load(std::memory_order_relaxed); }
+    uint32_t overflowCount(void) const      { return _overflowCount.load(std::memory_order_relaxed); }
+};
+
+#endif // __SPSCQueue__
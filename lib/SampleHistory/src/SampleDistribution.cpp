@@ -0,0 +1,159 @@
+#include <string.h>
+#include "SampleDistribution.h"
+
+SampleDistribution::SampleDistribution()
+{
+    _min.entries = nullptr;
+    _min.capacity = 0;
+    _max.entries = nullptr;
+    _max.capacity = 0;
+    clear();
+}
+
+size_t SampleDistribution::storageBytes(size_t max_entries)
+{
+    return 2*max_entries*sizeof(Extreme);
+}
+
+void SampleDistribution::setStorage(void* storage, size_t max_entries)
+{
+    if ((storage == nullptr) || (max_entries == 0)) {
+        _min.entries = nullptr;
+        _max.entries = nullptr;
+        max_entries = 0;
+    } else {
+        _min.entries = (Extreme*)storage;
+        _max.entries = _min.entries + max_entries;
+    }
+    _min.capacity = max_entries;
+    _max.capacity = max_entries;
+    clear();
+}
+
+void SampleDistribution::clear(void)
+{
+    memset(_bins, 0, sizeof(_bins));
+    _count = 0;
+    _min.head = 0;
+    _min.size = 0;
+    _max.head = 0;
+    _max.size = 0;
+}
+
+uint16_t SampleDistribution::binForValue(uint16_t value)
+{
+    if (value < 100) {
+        return value;
+    }
+    if (value < 500) {
+        return 100 + (value - 100)/5;
+    }
+    if (value < 1000) {
+        return 180 + (value - 500)/25;
+    }
+    return SAMPLE_DISTRIBUTION_BINS - 1;
+}
+
+uint16_t SampleDistribution::binUpperBound(uint16_t bin)
+{
+    if (bin < 100) {
+        return bin;
+    }
+    if (bin < 180) {
+        return 100 + (bin - 100)*5 + 4;
+    }
+    if (bin < SAMPLE_DISTRIBUTION_BINS - 1) {
+        return 500 + (bin - 180)*25 + 24;
+    }
+    return UINT16_MAX;
+}
+
+void SampleDistribution::pushExtreme(Deque& deque, uint32_t number, uint16_t value, bool is_max)
+{
+    if (deque.capacity == 0) {
+        return;
+    }
+    // entries at the back that the new one beats can never be the extreme again
+    while (deque.size > 0) {
+        const Extreme& back = deque.entries[(deque.head + deque.size - 1)%deque.capacity];
+        if (is_max ? (back.value > value) : (back.value < value)) {
+            break;
+        }
+        deque.size--;
+    }
+    if (deque.size == deque.capacity) {
+        deque.head = (deque.head + 1)%deque.capacity;
+        deque.size--;
+    }
+    Extreme& entry = deque.entries[(deque.head + deque.size)%deque.capacity];
+    entry.number = number;
+    entry.value = value;
+    deque.size++;
+}
+
+void SampleDistribution::expireExtremes(Deque& deque, uint32_t oldest_number)
+{
+    while ((deque.size > 0) && ((int32_t)(deque.entries[deque.head].number - oldest_number) < 0)) {
+        deque.head = (deque.head + 1)%deque.capacity;
+        deque.size--;
+    }
+}
+
+void SampleDistribution::add(uint32_t number, uint16_t min, uint16_t max, uint16_t value, uint32_t count)
+{
+    pushExtreme(_min, number, min, false);
+    pushExtreme(_max, number, max, true);
+    _bins[binForValue(value)] += count;
+    _count += count;
+}
+
+void SampleDistribution::remove(uint16_t value, uint32_t count, uint32_t oldest_number)
+{
+    uint32_t& bin = _bins[binForValue(value)];
+    count = (count < bin) ? count : bin;
+    bin -= count;
+    _count -= count;
+    expireExtremes(_min, oldest_number);
+    expireExtremes(_max, oldest_number);
+}
+
+uint16_t SampleDistribution::percentile(float percentile) const
+{
+    uint16_t value;
+    percentiles(&percentile, &value, 1);
+    return value;
+}
+
+void SampleDistribution::percentiles(const float* percentiles, uint16_t* values, uint8_t count) const
+{
+    uint8_t found = 0;
+    uint32_t seen = 0;
+    for (uint16_t i = 0; (i < SAMPLE_DISTRIBUTION_BINS) && (found < count) && (_count > 0); i++) {
+        seen += _bins[i];
+        while (found < count) {
+            // the rank of the requested percentile, counting from 1
+            uint32_t rank = (uint32_t)(percentiles[found]/100.0*_count + 0.5);
+            if (rank < 1) {
+                rank = 1;
+            } else if (rank > _count) {
+                rank = _count;
+            }
+            if (seen < rank) {
+                break;
+            }
+            values[found++] = binUpperBound(i);
+        }
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (_count == 0) {
+            values[i] = 0;
+        } else if (hasExtremes()) {
+            if (values[i] > max()) {
+                values[i] = max();
+            }
+            if (values[i] < min()) {
+                values[i] = min();
+            }
+        }
+    }
+}
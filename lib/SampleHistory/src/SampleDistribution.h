@@ -0,0 +1,87 @@
+#ifndef __SampleDistribution__
+#define __SampleDistribution__
+#include <stdint.h>
+#include <stddef.h>
+
+// Values below 100 each have their own bin, values to 500 are binned by 5 and values to 1000
+// by 25, which covers the 0 to 1000 ug/m^3 range of the particulate sensor. Larger values all
+// go in the last bin.
+#define SAMPLE_DISTRIBUTION_BINS    201
+
+//
+// SampleDistribution
+//
+// The spread of the samples in a sliding window: the smallest and largest sample, and a
+// histogram that percentiles are read from. Entries are added in order as they enter the
+// window and leave it in the same order, so both are kept incrementally.
+//
+// The min and max are kept with monotonic deques. Each deque holds the numbers of the entries
+// that can still become the window's extreme, in order, so the front is always the extreme
+// and each entry is pushed and popped at most once. The deques need storage for as many
+// entries as the window can hold. If a deque does fill up, its oldest entry is dropped, and
+// the extreme can be understated until that entry would have left the window anyway.
+//
+// Percentiles are reported as the upper bound of the bin they fall in, clamped to the min and
+// max, so they are accurate to the bin width. They count samples, not the time each covers.
+//
+// This class does not allocate memory and has no Arduino dependencies.
+//
+class SampleDistribution {
+private:
+    struct Extreme {
+        uint32_t    number;
+        uint16_t    value;
+    };
+
+    struct Deque {
+        Extreme*    entries;
+        size_t      capacity;
+        size_t      head;
+        size_t      size;
+    };
+
+    uint32_t    _bins[SAMPLE_DISTRIBUTION_BINS];
+    uint32_t    _count;
+    Deque       _min;
+    Deque       _max;
+
+    static void pushExtreme(Deque& deque, uint32_t number, uint16_t value, bool is_max);
+    static void expireExtremes(Deque& deque, uint32_t oldest_number);
+
+public:
+    SampleDistribution();
+
+    // Returns the number of bytes of storage needed for a window of up to max_entries entries.
+    static size_t storageBytes(size_t max_entries);
+
+    // Sets the storage for the min and max deques, which must be at least storageBytes() in
+    // size and 4 byte aligned, and clears the distribution.
+    void setStorage(void* storage, size_t max_entries);
+    void clear(void);
+
+    // Adds the entry with the given number, whose samples range from min to max, to the
+    // extremes, and count samples of value to the histogram. Entries must be added in order.
+    void add(uint32_t number, uint16_t min, uint16_t max, uint16_t value, uint32_t count);
+
+    // Removes count samples of value that were added to the histogram, and drops the extremes
+    // of entries numbered before oldest_number.
+    void remove(uint16_t value, uint32_t count, uint32_t oldest_number);
+
+    // number of samples in the histogram
+    uint32_t count(void) const                  { return _count; }
+    bool hasExtremes(void) const                { return _min.size > 0; }
+    uint16_t min(void) const                    { return (_min.size > 0) ? _min.entries[_min.head].value : 0; }
+    uint16_t max(void) const                    { return (_max.size > 0) ? _max.entries[_max.head].value : 0; }
+
+    // percentile is in the range 0 to 100. Returns 0 if the histogram is empty.
+    uint16_t percentile(float percentile) const;
+
+    // Reads several percentiles, given in ascending order, in one pass over the bins.
+    void percentiles(const float* percentiles, uint16_t* values, uint8_t count) const;
+
+    uint32_t binCount(uint16_t bin) const       { return (bin < SAMPLE_DISTRIBUTION_BINS) ? _bins[bin] : 0; }
+    static uint16_t binForValue(uint16_t value);
+    static uint16_t binUpperBound(uint16_t bin);
+};
+
+#endif // __SampleDistribution__
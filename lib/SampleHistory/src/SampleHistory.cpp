@@ -0,0 +1,708 @@
+#include "SampleHistory.h"
+
+//
+// SampleAggregate
+//
+
+void SampleAggregate::clear(void)
+{
+    sum = 0;
+    min = 0;
+    max = 0;
+    count = 0;
+}
+
+void SampleAggregate::add(uint16_t value)
+{
+    if ((count == 0) || (value < min)) {
+        min = value;
+    }
+    if ((count == 0) || (value > max)) {
+        max = value;
+    }
+    sum += value;
+    count++;
+}
+
+void SampleAggregate::merge(const SampleAggregate& other)
+{
+    if (other.count == 0) {
+        return;
+    }
+    if ((count == 0) || (other.min < min)) {
+        min = other.min;
+    }
+    if ((count == 0) || (other.max > max)) {
+        max = other.max;
+    }
+    sum += other.sum;
+    count += other.count;
+}
+
+//
+// SampleHistory
+//
+
+SampleHistory::SampleHistory()
+    :   _storage(nullptr),
+        _capacity(0),
+        _size(0),
+        _insertion_idx(0),
+        _pushed(0),
+        _tier_count(0),
+        _timelineVersion(0),
+        _newestTime(0),
+        _periodMillis(1000),
+        _maxIntervalMillis(3000),
+        _window_count(0)
+{
+}
+
+size_t SampleHistory::storageBytes(size_t sample_capacity, const SampleHistoryTier* tiers, uint8_t tier_count)
+{
+    size_t bytes = sample_capacity*sizeof(uint16_t) + SampleTimeline::storageBytes(sample_capacity);
+    for (uint8_t i = 0; (tiers != nullptr) && (i < tier_count); i++) {
+        bytes += tiers[i].capacity*sizeof(SampleAggregate) + SampleTimeline::storageBytes(tiers[i].capacity);
+    }
+    return bytes;
+}
+
+bool SampleHistory::setStorage(void* storage, size_t sample_capacity, const SampleHistoryTier* tiers, uint8_t tier_count)
+{
+    _size = 0;
+    _insertion_idx = 0;
+    _pushed = 0;
+    _tier_count = 0;
+    _newestTime = 0;
+    _window_count = 0;
+
+    if (storage == nullptr) {
+        _storage = nullptr;
+        _capacity = 0;
+        return (sample_capacity == 0);
+    }
+
+    bool valid_tiers = (tier_count <= SAMPLE_HISTORY_MAX_TIERS) && ((tier_count == 0) || (tiers != nullptr));
+    uint32_t prior_samples_per_bucket = 1;
+    for (uint8_t i = 0; valid_tiers && (i < tier_count); i++) {
+        valid_tiers = (tiers[i].capacity > 0)
+                        && (tiers[i].samples_per_bucket > prior_samples_per_bucket)
+                        && (tiers[i].samples_per_bucket <= UINT16_MAX)
+                        && (tiers[i].samples_per_bucket%prior_samples_per_bucket == 0);
+        prior_samples_per_bucket = tiers[i].samples_per_bucket;
+    }
+
+    // the rollup tiers are placed first so that the SampleAggregates are aligned, then the
+    // timelines, which are all a multiple of 4 bytes, and then the samples
+    uint8_t* next_storage = (uint8_t*)storage;
+    if (valid_tiers) {
+        prior_samples_per_bucket = 1;
+        for (uint8_t i = 0; i < tier_count; i++) {
+            Tier& t = _tiers[i];
+            t.storage = (SampleAggregate*)next_storage;
+            t.capacity = tiers[i].capacity;
+            t.size = 0;
+            t.insertion_idx = 0;
+            t.samples_per_bucket = tiers[i].samples_per_bucket;
+            t.inputs_per_bucket = tiers[i].samples_per_bucket/prior_samples_per_bucket;
+            t.pending.clear();
+            t.pending_inputs = 0;
+            t.pushed = 0;
+            next_storage += t.capacity*sizeof(SampleAggregate);
+            prior_samples_per_bucket = t.samples_per_bucket;
+        }
+        _tier_count = tier_count;
+    }
+    _timelines[0].setStorage(next_storage, sample_capacity);
+    next_storage += SampleTimeline::storageBytes(sample_capacity);
+    for (uint8_t i = 0; i < _tier_count; i++) {
+        _timelines[i + 1].setStorage(next_storage, _tiers[i].capacity);
+        next_storage += SampleTimeline::storageBytes(_tiers[i].capacity);
+    }
+
+    _storage = (uint16_t*)next_storage;
+    _capacity = sample_capacity;
+    return valid_tiers;
+}
+
+void SampleHistory::setSamplePeriod(uint32_t period_millis, uint32_t max_interval_millis)
+{
+    _periodMillis = (period_millis > 0) ? period_millis : 1;
+    _maxIntervalMillis = (max_interval_millis > _periodMillis) ? max_interval_millis : _periodMillis;
+}
+
+size_t SampleHistory::levelCapacity(uint8_t level) const
+{
+    return (level == 0) ? _capacity : _tiers[level-1].capacity;
+}
+
+size_t SampleHistory::levelSize(uint8_t level) const
+{
+    if (level > _tier_count) {
+        return 0;
+    }
+    return (level == 0) ? _size : _tiers[level-1].size;
+}
+
+uint32_t SampleHistory::levelSamplesPerEntry(uint8_t level) const
+{
+    if ((level == 0) || (level > _tier_count)) {
+        return 1;
+    }
+    return _tiers[level-1].samples_per_bucket;
+}
+
+uint64_t SampleHistory::entrySum(uint8_t level, size_t idx) const
+{
+    return (level == 0) ? _storage[idx] : _tiers[level-1].storage[idx].sum;
+}
+
+uint64_t SampleHistory::entrySamples(uint8_t level, size_t idx) const
+{
+    return (level == 0) ? 1 : _tiers[level-1].storage[idx].count;
+}
+
+uint32_t SampleHistory::entryTime(uint8_t level, uint32_t number) const
+{
+    return _timelines[level].get(number%levelCapacity(level));
+}
+
+void SampleHistory::setEntryTime(uint8_t level, size_t idx, uint32_t time)
+{
+    uint32_t version = _timelineVersion.load(std::memory_order_relaxed);
+    _timelineVersion.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _timelines[level].set(idx, time);
+    _timelineVersion.store(version + 2, std::memory_order_release);
+}
+
+SampleHistory::EntryWeight SampleHistory::entryWeight(uint8_t level, uint32_t number, uint32_t prev_time) const
+{
+    size_t idx = number%levelCapacity(level);
+    int32_t signed_interval = (int32_t)(_timelines[level].get(idx) - prev_time);
+    uint32_t interval = (signed_interval > 0) ? signed_interval : 0;
+
+    EntryWeight entry;
+    entry.samples = entrySamples(level, idx);
+    if (level == 0) {
+        // a sample stands for the time since the sample before it, unless that was a gap
+        if (interval <= _maxIntervalMillis) {
+            entry.covered = interval;
+            entry.gap = 0;
+        } else {
+            entry.covered = _periodMillis;
+            entry.gap = interval - _periodMillis;
+        }
+        entry.sum = entrySum(level, idx)*entry.covered;
+    } else {
+        // a bucket stands for its samples' periods, and only time beyond that can be a gap
+        entry.covered = entry.samples*_periodMillis;
+        uint32_t excess = (interval > entry.covered) ? interval - entry.covered : 0;
+        entry.gap = (excess > _maxIntervalMillis) ? excess : 0;
+        entry.sum = entrySum(level, idx)*_periodMillis;
+    }
+    return entry;
+}
+
+void SampleHistory::pendingTotals(uint8_t level, uint64_t& sum, uint64_t& samples) const
+{
+    // Samples that are newer than the newest bucket of a level are waiting in the pending
+    // buckets of that level and every finer tier.
+    sum = 0;
+    samples = 0;
+    for (uint8_t i = 0; i < level; i++) {
+        sum += _tiers[i].pending.sum;
+        samples += _tiers[i].pending.count;
+    }
+}
+
+uint16_t SampleHistory::sample(size_t i) const
+{
+    size_t oldest_idx = (_size < _capacity) ? 0 : _insertion_idx + 1;
+    return _storage[(oldest_idx + i)%_capacity];
+}
+
+const SampleAggregate& SampleHistory::aggregate(uint8_t level, size_t i) const
+{
+    const Tier& t = _tiers[level-1];
+    size_t oldest_idx = (t.size < t.capacity) ? 0 : t.insertion_idx + 1;
+    return t.storage[(oldest_idx + i)%t.capacity];
+}
+
+uint8_t SampleHistory::levelForSpan(size_t span_samples, size_t max_entries) const
+{
+    for (uint8_t level = 0; level <= _tier_count; level++) {
+        uint32_t samples_per_entry = levelSamplesPerEntry(level);
+        bool covers_span = (levelSize(level) < levelCapacity(level))
+                            || (levelSize(level)*samples_per_entry >= span_samples);
+        if (covers_span && (span_samples/samples_per_entry <= max_entries)) {
+            return level;
+        }
+    }
+    return _tier_count;
+}
+
+size_t SampleHistory::retainedSamples(void) const
+{
+    size_t retained = 0;
+    for (uint8_t level = 0; level <= _tier_count; level++) {
+        size_t level_retained = levelSize(level)*levelSamplesPerEntry(level);
+        if (level_retained > retained) {
+            retained = level_retained;
+        }
+    }
+    return retained;
+}
+
+uint32_t SampleHistory::levelPushCount(uint8_t level) const
+{
+    if (level > _tier_count) {
+        return 0;
+    }
+    return (level == 0) ? _pushed.load(std::memory_order_acquire) : _tiers[level-1].pushed.load(std::memory_order_acquire);
+}
+
+bool SampleHistory::readEntry(uint8_t level, uint32_t number, SampleAggregate& entry) const
+{
+    size_t capacity = (level <= _tier_count) ? levelCapacity(level) : 0;
+    if (capacity == 0) {
+        return false;
+    }
+    // Entries are written to the levels' ring buffers in order starting from the first slot,
+    // so entry n is always in slot n%capacity. The slot is next written by the push of entry
+    // n + capacity, which may already be under way once entry n + capacity - 1 is pushed, so
+    // the oldest entry of a full level is treated as gone.
+    uint32_t pushed = levelPushCount(level);
+    if ((number >= pushed) || (pushed - number >= capacity)) {
+        return false;
+    }
+    size_t idx = number%capacity;
+    if (level == 0) {
+        entry.clear();
+        entry.add(_storage[idx]);
+    } else {
+        entry = _tiers[level-1].storage[idx];
+    }
+    // check that the slot was not overwritten while it was being copied
+    pushed = levelPushCount(level);
+    return (pushed - number < capacity);
+}
+
+bool SampleHistory::readEntryTime(uint8_t level, uint32_t number, uint32_t& time) const
+{
+    size_t capacity = (level <= _tier_count) ? levelCapacity(level) : 0;
+    if (capacity == 0) {
+        return false;
+    }
+    uint32_t pushed = levelPushCount(level);
+    if ((number >= pushed) || (pushed - number >= capacity)) {
+        return false;
+    }
+    // a timeline write takes a few microseconds, so a read rarely has to be retried
+    bool consistent = false;
+    for (uint8_t attempt = 0; (attempt < 4) && !consistent; attempt++) {
+        uint32_t version = _timelineVersion.load(std::memory_order_acquire);
+        time = _timelines[level].get(number%capacity);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        consistent = ((version & 1) == 0) && (_timelineVersion.load(std::memory_order_relaxed) == version);
+    }
+    pushed = levelPushCount(level);
+    return consistent && (pushed - number < capacity);
+}
+
+void SampleHistory::addToWindow(Window& w, const EntryWeight& entry, uint32_t number, uint32_t prev_time)
+{
+    if (w.count == 0) {
+        w.tail = number;
+        w.tailPrevTime = prev_time;
+    }
+    w.count++;
+    w.sum += entry.sum;
+    w.covered += entry.covered;
+    w.gap += entry.gap;
+    w.samples += entry.samples;
+    addToDistribution(w, number);
+}
+
+void SampleHistory::addToDistribution(Window& w, uint32_t number) const
+{
+    if (w.distribution == nullptr) {
+        return;
+    }
+    size_t idx = number%levelCapacity(w.level);
+    if (w.level == 0) {
+        uint16_t value = _storage[idx];
+        w.distribution->add(number, value, value, value, 1);
+    } else {
+        const SampleAggregate& bucket = _tiers[w.level-1].storage[idx];
+        w.distribution->add(number, bucket.min, bucket.max, (uint16_t)(bucket.mean() + 0.5f), bucket.count);
+    }
+}
+
+void SampleHistory::evictFromWindow(Window& w)
+{
+    EntryWeight entry = entryWeight(w.level, w.tail, w.tailPrevTime);
+    w.sum -= entry.sum;
+    w.covered -= entry.covered;
+    w.gap -= entry.gap;
+    w.samples -= entry.samples;
+    w.tailPrevTime = entryTime(w.level, w.tail);
+    if (w.distribution != nullptr) {
+        size_t idx = w.tail%levelCapacity(w.level);
+        uint16_t value = (w.level == 0) ? _storage[idx] : (uint16_t)(_tiers[w.level-1].storage[idx].mean() + 0.5f);
+        w.distribution->remove(value, entry.samples, w.tail + 1);
+    }
+    w.tail++;
+    w.count--;
+}
+
+void SampleHistory::beginEntry(uint8_t level, uint32_t number)
+{
+    // The slot of the new entry holds the entry from a lap ago, which windows that span the
+    // full level still hold. It is evicted before it is overwritten.
+    size_t capacity = levelCapacity(level);
+    if (number < capacity) {
+        return;
+    }
+    for (uint8_t i = 0; i < _window_count; i++) {
+        Window& w = _windows[i];
+        if ((w.level == level) && (w.count > 0) && (w.tail == number - capacity)) {
+            evictFromWindow(w);
+        }
+    }
+}
+
+void SampleHistory::endEntry(uint8_t level, uint32_t number, uint32_t prev_time)
+{
+    EntryWeight entry = entryWeight(level, number, prev_time);
+    for (uint8_t i = 0; i < _window_count; i++) {
+        if (_windows[i].level == level) {
+            addToWindow(_windows[i], entry, number, prev_time);
+        }
+    }
+}
+
+void SampleHistory::expireWindows(void)
+{
+    for (uint8_t i = 0; i < _window_count; i++) {
+        Window& w = _windows[i];
+        uint32_t start_time = _newestTime - w.lengthMillis;
+        while ((w.count > 0) && ((int32_t)(entryTime(w.level, w.tail) - start_time) <= 0)) {
+            evictFromWindow(w);
+        }
+    }
+}
+
+void SampleHistory::push(uint16_t value, uint32_t time)
+{
+    if (_capacity == 0) {
+        return;
+    }
+
+    size_t idx;
+    if (_size < _capacity) {
+        idx = _size;
+        _size++;
+    } else {
+        idx = _insertion_idx + 1;
+        if (idx >= _capacity) {
+            idx = 0;
+        }
+    }
+    uint32_t number = _pushed.load(std::memory_order_relaxed);
+    // the first sample stands for one sample period
+    uint32_t prev_time = (number > 0) ? _timelines[0].get(_insertion_idx) : time - _periodMillis;
+    beginEntry(0, number);
+    _storage[idx] = value;
+    setEntryTime(0, idx, time);
+    _insertion_idx = idx;
+    _pushed.fetch_add(1, std::memory_order_release);
+    endEntry(0, number, prev_time);
+
+    if (_tier_count > 0) {
+        Tier& t = _tiers[0];
+        t.pending.add(value);
+        t.pending_inputs++;
+        if (t.pending_inputs >= t.inputs_per_bucket) {
+            SampleAggregate bucket = t.pending;
+            t.pending.clear();
+            t.pending_inputs = 0;
+            pushAggregate(0, bucket, time);
+        }
+    }
+    _newestTime = time;
+    expireWindows();
+}
+
+void SampleHistory::pushAggregate(uint8_t tier_idx, const SampleAggregate& bucket, uint32_t time)
+{
+    Tier& t = _tiers[tier_idx];
+    size_t idx;
+    if (t.size < t.capacity) {
+        idx = t.size;
+        t.size++;
+    } else {
+        idx = t.insertion_idx + 1;
+        if (idx >= t.capacity) {
+            idx = 0;
+        }
+    }
+    uint32_t number = t.pushed.load(std::memory_order_relaxed);
+    uint32_t prev_time = (number > 0) ? _timelines[tier_idx + 1].get(t.insertion_idx) : time - bucket.count*_periodMillis;
+    beginEntry(tier_idx + 1, number);
+    t.storage[idx] = bucket;
+    setEntryTime(tier_idx + 1, idx, time);
+    t.insertion_idx = idx;
+    t.pushed.fetch_add(1, std::memory_order_release);
+    endEntry(tier_idx + 1, number, prev_time);
+
+    if (tier_idx + 1 < _tier_count) {
+        Tier& next = _tiers[tier_idx + 1];
+        next.pending.merge(bucket);
+        next.pending_inputs++;
+        if (next.pending_inputs >= next.inputs_per_bucket) {
+            SampleAggregate next_bucket = next.pending;
+            next.pending.clear();
+            next.pending_inputs = 0;
+            pushAggregate(tier_idx + 1, next_bucket, time);
+        }
+    }
+}
+
+bool SampleHistory::restoreAggregate(const SampleAggregate& bucket, uint32_t time)
+{
+    if ((_tier_count == 0) || (_pushed.load(std::memory_order_relaxed) > 0)
+            || (bucket.count != _tiers[0].samples_per_bucket)) {
+        return false;
+    }
+    pushAggregate(0, bucket, time);
+    _newestTime = time;
+    expireWindows();
+    return true;
+}
+
+bool SampleHistory::resolveWindow(uint32_t window_millis, uint8_t& level) const
+{
+    if ((window_millis == 0) || (_capacity == 0)) {
+        return false;
+    }
+    // A window holds the entries newer than its start, and the one it starts part way through,
+    // so it needs a level that spans its length plus an entry.
+    for (level = 0; level < _tier_count; level++) {
+        uint64_t level_millis = (uint64_t)(levelCapacity(level) - 1)*levelSamplesPerEntry(level)*_periodMillis;
+        if (level_millis >= window_millis) {
+            return true;
+        }
+    }
+    // at most what the coarsest level holds
+    level = _tier_count;
+    return true;
+}
+
+void SampleHistory::seedWindow(Window& w) const
+{
+    w.count = 0;
+    w.sum = 0;
+    w.covered = 0;
+    w.gap = 0;
+    w.samples = 0;
+    size_t size = levelSize(w.level);
+    if (size == 0) {
+        return;
+    }
+
+    // find the oldest entry that is still in the window's span
+    uint32_t pushed = levelPushCount(w.level);
+    uint32_t oldest = pushed - size;
+    uint32_t start_time = _newestTime - w.lengthMillis;
+    uint32_t tail = pushed;
+    while ((tail > oldest) && ((int32_t)(entryTime(w.level, tail - 1) - start_time) > 0)) {
+        tail--;
+    }
+    if (tail == pushed) {
+        return;
+    }
+
+    // the entry before the oldest retained one is gone, so the oldest stands for its sample periods
+    uint32_t prev_time = (tail > oldest) ? entryTime(w.level, tail - 1)
+                            : entryTime(w.level, tail) - entrySamples(w.level, tail%levelCapacity(w.level))*_periodMillis;
+    w.tail = tail;
+    w.tailPrevTime = prev_time;
+    for (uint32_t number = tail; number != pushed; number++) {
+        EntryWeight entry = entryWeight(w.level, number, prev_time);
+        w.count++;
+        w.sum += entry.sum;
+        w.covered += entry.covered;
+        w.gap += entry.gap;
+        w.samples += entry.samples;
+        prev_time = entryTime(w.level, number);
+    }
+}
+
+SampleWindowID SampleHistory::registerWindow(uint32_t window_millis)
+{
+    if (window_millis > SAMPLE_HISTORY_MAX_WINDOW_MILLIS) {
+        window_millis = SAMPLE_HISTORY_MAX_WINDOW_MILLIS;
+    }
+    uint8_t level;
+    if (!resolveWindow(window_millis, level)) {
+        return INVALID_SAMPLE_WINDOW;
+    }
+
+    SampleWindowID existing = findWindow(window_millis);
+    if (existing != INVALID_SAMPLE_WINDOW) {
+        return existing;
+    }
+    if (_window_count >= SAMPLE_HISTORY_MAX_WINDOWS) {
+        return INVALID_SAMPLE_WINDOW;
+    }
+
+    Window& w = _windows[_window_count];
+    w.level = level;
+    w.lengthMillis = window_millis;
+    w.distribution = nullptr;
+    // seed the window from the entries already in its level
+    seedWindow(w);
+    return _window_count++;
+}
+
+SampleWindowID SampleHistory::findWindow(uint32_t window_millis) const
+{
+    if (window_millis > SAMPLE_HISTORY_MAX_WINDOW_MILLIS) {
+        window_millis = SAMPLE_HISTORY_MAX_WINDOW_MILLIS;
+    }
+    for (uint8_t i = 0; i < _window_count; i++) {
+        if (_windows[i].lengthMillis == window_millis) {
+            return i;
+        }
+    }
+    return INVALID_SAMPLE_WINDOW;
+}
+
+void SampleHistory::windowStats(const Window& w, SampleWindowStats& stats) const
+{
+    uint64_t pending_sum, pending_samples;
+    pendingTotals(w.level, pending_sum, pending_samples);
+    double sum = (double)w.sum + (double)(pending_sum*_periodMillis);
+    uint64_t covered = w.covered + pending_samples*_periodMillis;
+    uint64_t gap = w.gap;
+
+    if (w.count > 0) {
+        // The oldest entry covers the time back to the entry before it, and the gap before
+        // that. Only the part of that which is inside the window counts.
+        EntryWeight oldest = entryWeight(w.level, w.tail, w.tailPrevTime);
+        uint32_t start_time = _newestTime - w.lengthMillis;
+        uint32_t covered_start = entryTime(w.level, w.tail) - oldest.covered;
+        int32_t covered_excess = (int32_t)(start_time - covered_start);
+        if ((covered_excess > 0) && (oldest.covered > 0)) {
+            sum -= (double)oldest.sum*covered_excess/oldest.covered;
+            covered -= covered_excess;
+        }
+        int32_t gap_excess = (int32_t)(start_time - (covered_start - oldest.gap));
+        if (gap_excess > 0) {
+            gap -= ((uint32_t)gap_excess < oldest.gap) ? gap_excess : oldest.gap;
+        }
+    }
+
+    stats.average = (covered > 0) ? sum/covered : 0;
+    stats.coveredMillis = covered;
+    stats.gapMillis = gap;
+    stats.samples = w.samples + pending_samples;
+}
+
+float SampleHistory::windowAverage(SampleWindowID window_id) const
+{
+    return windowStats(window_id).average;
+}
+
+size_t SampleHistory::windowSampleCount(SampleWindowID window_id) const
+{
+    return windowStats(window_id).samples;
+}
+
+SampleWindowStats SampleHistory::windowStats(SampleWindowID window_id) const
+{
+    SampleWindowStats stats = {0, 0, 0, 0};
+    if ((window_id >= 0) && (window_id < _window_count)) {
+        windowStats(_windows[window_id], stats);
+    }
+    return stats;
+}
+
+SampleWindowStats SampleHistory::scanWindow(uint32_t window_millis) const
+{
+    SampleWindowStats stats = {0, 0, 0, 0};
+    if (window_millis > SAMPLE_HISTORY_MAX_WINDOW_MILLIS) {
+        window_millis = SAMPLE_HISTORY_MAX_WINDOW_MILLIS;
+    }
+    Window w;
+    if (!resolveWindow(window_millis, w.level)) {
+        return stats;
+    }
+    w.lengthMillis = window_millis;
+    w.distribution = nullptr;
+    seedWindow(w);
+    windowStats(w, stats);
+    return stats;
+}
+
+size_t SampleHistory::windowEntryCapacity(SampleWindowID window_id) const
+{
+    if ((window_id < 0) || (window_id >= _window_count)) {
+        return 0;
+    }
+    const Window& w = _windows[window_id];
+    uint64_t entry_millis = (uint64_t)levelSamplesPerEntry(w.level)*_periodMillis;
+    uint64_t entries = 2*w.lengthMillis/entry_millis + 2;
+    size_t capacity = levelCapacity(w.level);
+    return (entries < capacity) ? entries : capacity;
+}
+
+bool SampleHistory::trackDistribution(SampleWindowID window_id, SampleDistribution& distribution)
+{
+    if ((window_id < 0) || (window_id >= _window_count)) {
+        return false;
+    }
+    Window& w = _windows[window_id];
+    w.distribution = &distribution;
+    distribution.clear();
+    for (uint32_t i = 0; i < w.count; i++) {
+        addToDistribution(w, w.tail + i);
+    }
+    return true;
+}
+
+SampleWindowSpread SampleHistory::windowSpread(SampleWindowID window_id) const
+{
+    SampleWindowSpread spread = {0, 0, 0, 0, 0, 0};
+    if ((window_id < 0) || (window_id >= _window_count) || (_windows[window_id].distribution == nullptr)) {
+        return spread;
+    }
+    const Window& w = _windows[window_id];
+    const SampleDistribution& distribution = *w.distribution;
+    bool has_extremes = distribution.hasExtremes();
+    spread.min = distribution.min();
+    spread.max = distribution.max();
+    // samples that are waiting to be rolled up into the window's level
+    for (uint8_t i = 0; i < w.level; i++) {
+        const SampleAggregate& pending = _tiers[i].pending;
+        if (pending.count == 0) {
+            continue;
+        }
+        if (!has_extremes || (pending.min < spread.min)) {
+            spread.min = pending.min;
+        }
+        if (!has_extremes || (pending.max > spread.max)) {
+            spread.max = pending.max;
+        }
+        has_extremes = true;
+    }
+    static const float PERCENTILES[] = {50, 95, 99};
+    uint16_t values[3];
+    distribution.percentiles(PERCENTILES, values, 3);
+    spread.p50 = values[0];
+    spread.p95 = values[1];
+    spread.p99 = values[2];
+    spread.samples = distribution.count();
+    return spread;
+}
@@ -0,0 +1,311 @@
+#ifndef __SampleHistory__
+#define __SampleHistory__
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "SampleTimeline.h"
+#include "SampleDistribution.h"
+
+// Maximum number of averaging windows that can be registered against a single history.
+#ifndef SAMPLE_HISTORY_MAX_WINDOWS
+#define SAMPLE_HISTORY_MAX_WINDOWS  8
+#endif
+
+// Maximum number of rollup tiers that can sit behind the full resolution samples.
+#ifndef SAMPLE_HISTORY_MAX_TIERS
+#define SAMPLE_HISTORY_MAX_TIERS    4
+#endif
+
+// Longest averaging window. Times are millis() values, so spans must stay well under the
+// 49 days after which they wrap.
+#define SAMPLE_HISTORY_MAX_WINDOW_MILLIS    (24UL*24*60*60*1000)
+
+typedef int8_t SampleWindowID;
+#define INVALID_SAMPLE_WINDOW   -1
+
+//
+// What an averaging window holds: the time weighted average of its samples, the time that the
+// samples cover, the time within the window that fell in gaps between samples, and the number
+// of samples. The covered and gap times only add up to the window's length once the history
+// is as old as the window.
+//
+struct SampleWindowStats {
+    float       average;
+    uint32_t    coveredMillis;
+    uint32_t    gapMillis;
+    uint32_t    samples;
+};
+
+//
+// The spread of the samples in an averaging window that tracks its distribution: the smallest
+// and largest sample and the 50th, 95th and 99th percentiles. samples is the number of samples
+// the percentiles are taken from.
+//
+struct SampleWindowSpread {
+    uint16_t    min;
+    uint16_t    max;
+    uint16_t    p50;
+    uint16_t    p95;
+    uint16_t    p99;
+    uint32_t    samples;
+};
+
+//
+// Summary of a run of consecutive samples. This is what the rollup tiers retain in
+// place of the samples themselves.
+//
+struct SampleAggregate {
+    uint32_t    sum;
+    uint16_t    min;
+    uint16_t    max;
+    uint16_t    count;
+
+    void clear(void);
+    void add(uint16_t value);
+    void merge(const SampleAggregate& other);
+    float mean(void) const          { return (count > 0) ? (float)sum/(float)count : 0; }
+};
+
+//
+// Describes one rollup tier. samples_per_bucket is the number of full resolution samples
+// summarized by each bucket, and must be a multiple of the prior tier's samples_per_bucket.
+// Tiers must be listed from finest to coarsest.
+//
+struct SampleHistoryTier {
+    uint32_t    samples_per_bucket;
+    size_t      capacity;
+};
+
+//
+// SampleHistory
+//
+// A multi-resolution history of uint16_t samples. The most recent samples are kept at full
+// resolution in a ring buffer. Behind that sit up to SAMPLE_HISTORY_MAX_TIERS rollup tiers, each
+// a ring buffer of SampleAggregate buckets that are filled in as the finer tier completes
+// a bucket's worth of samples. Coarse tiers need a tiny fraction of the memory per retained
+// day that full resolution samples do. Every entry of every level is stamped with the time of
+// its newest sample, which a SampleTimeline stores in a little over 2 bytes.
+//
+// The history levels are numbered from 0 (full resolution) to tierCount() (coarsest rollup).
+// Every entry of a level is also numbered, from 0 for the first one ever added to it, which
+// gives readers on another task a stable way to walk a level while it is being added to.
+//
+// Any number of averaging windows (up to SAMPLE_HISTORY_MAX_WINDOWS) can be registered. A
+// window spans a length of time ending at the newest sample, and is assigned to the finest
+// level that can hold it. It maintains running sums that are updated as entries enter the
+// level and as they fall out of the window's time span, so reading a window's average costs
+// O(1) regardless of how long the history is.
+//
+// Averages are weighted by time. A full resolution sample stands for the time since the sample
+// before it, so a sample that follows a missed one counts for both periods. An interval longer
+// than the max_interval_millis given to setSamplePeriod() is a gap: the sample after it only
+// counts for one sample period, and the rest of the interval is reported as gap time rather
+// than averaged over. Rollup buckets count for their sample period times the number of
+// samples in them, and the time between buckets beyond that is a gap if it is longer than the
+// max interval. Windows on a rollup level are accurate to that level's bucket size.
+//
+// A window can also track the distribution of its samples with a SampleDistribution, which
+// keeps the window's min, max and percentiles as entries enter and leave it. On a rollup level
+// the min and max are those of the buckets' samples, but the percentiles are of the bucket
+// means, each counted once for every sample in the bucket.
+//
+// This class does not allocate memory. The storage is provided by the owner through
+// setStorage(), which allows the owner to decide if the history lives in PSRAM or RAM.
+// It also has no Arduino dependencies so that it can be benchmarked on the host.
+//
+class SampleHistory {
+private:
+    struct Tier {
+        SampleAggregate*    storage;
+        size_t              capacity;
+        size_t              size;
+        size_t              insertion_idx;
+        uint32_t            samples_per_bucket;
+        uint32_t            inputs_per_bucket;  // entries of the next finer level per bucket
+        SampleAggregate     pending;            // the bucket currently being filled
+        uint32_t            pending_inputs;
+        std::atomic<uint32_t> pushed;           // buckets ever added
+    };
+
+    struct Window {
+        uint8_t     level;
+        uint32_t    lengthMillis;
+        uint32_t    tail;           // number of the oldest entry in the window
+        uint32_t    tailPrevTime;   // time of the entry before the tail, which bounds what the tail covers
+        uint32_t    count;          // number of entries currently in the window
+        uint64_t    sum;            // running sum of the entries' values times the time they cover
+        uint64_t    covered;        // time covered by the entries, in milliseconds
+        uint64_t    gap;            // time in gaps before the entries, in milliseconds
+        uint64_t    samples;        // number of samples in the entries
+        SampleDistribution* distribution;   // optional
+    };
+
+    // what an entry adds to a window
+    struct EntryWeight {
+        uint64_t    sum;
+        uint32_t    covered;
+        uint32_t    gap;
+        uint32_t    samples;
+    };
+
+    uint16_t*   _storage;
+    size_t      _capacity;
+    size_t      _size;
+    size_t      _insertion_idx;
+    std::atomic<uint32_t> _pushed;      // samples ever added
+
+    Tier        _tiers[SAMPLE_HISTORY_MAX_TIERS];
+    uint8_t     _tier_count;
+
+    // entry times of each level, level 0 first
+    SampleTimeline  _timelines[SAMPLE_HISTORY_MAX_TIERS + 1];
+    // Bumped before and after every timeline write, so it is odd while one is under way.
+    // Setting a time can rescale the offsets of the other entries in its block, so readers
+    // on another task retry if it changed while they read.
+    std::atomic<uint32_t> _timelineVersion;
+    uint32_t    _newestTime;            // time of the newest entry of any level
+    uint32_t    _periodMillis;
+    uint32_t    _maxIntervalMillis;
+
+    Window      _windows[SAMPLE_HISTORY_MAX_WINDOWS];
+    uint8_t     _window_count;
+
+    bool resolveWindow(uint32_t window_millis, uint8_t& level) const;
+    size_t levelCapacity(uint8_t level) const;
+    uint64_t entrySum(uint8_t level, size_t idx) const;
+    uint64_t entrySamples(uint8_t level, size_t idx) const;
+    EntryWeight entryWeight(uint8_t level, uint32_t number, uint32_t prev_time) const;
+    void pendingTotals(uint8_t level, uint64_t& sum, uint64_t& samples) const;
+    void addToWindow(Window& w, const EntryWeight& entry, uint32_t number, uint32_t prev_time);
+    void addToDistribution(Window& w, uint32_t number) const;
+    void evictFromWindow(Window& w);
+    void seedWindow(Window& w) const;
+    void windowStats(const Window& w, SampleWindowStats& stats) const;
+    void beginEntry(uint8_t level, uint32_t number);
+    void endEntry(uint8_t level, uint32_t number, uint32_t prev_time);
+    void expireWindows(void);
+    void pushAggregate(uint8_t tier_idx, const SampleAggregate& bucket, uint32_t time);
+    void setEntryTime(uint8_t level, size_t idx, uint32_t time);
+
+public:
+    SampleHistory();
+
+    // Returns the number of bytes of storage needed for the given configuration.
+    static size_t storageBytes(size_t sample_capacity, const SampleHistoryTier* tiers, uint8_t tier_count);
+
+    // Sets the backing storage for the history, which must be at least storageBytes() in size
+    // and aligned for SampleAggregate. Clears all samples and removes all registered windows.
+    // Returns false if the tier configuration is invalid, in which case no tiers are used.
+    bool setStorage(void* storage, size_t sample_capacity, const SampleHistoryTier* tiers, uint8_t tier_count);
+
+    // Sets the backing storage for a history that has only full resolution samples, which must
+    // be at least storageBytes(capacity, nullptr, 0) in size.
+    void setStorage(void* storage, size_t capacity)         { setStorage(storage, capacity, nullptr, 0); }
+
+    // Sets the period samples are expected to be pushed at, and the longest interval between
+    // samples that is not a gap, which must be at least the period. Windows should be registered
+    // after this is set. The defaults are 1 second and 3 seconds.
+    void setSamplePeriod(uint32_t period_millis, uint32_t max_interval_millis);
+
+    // full resolution samples
+    size_t size(void) const                 { return _size; }
+    size_t capacity(void) const             { return _capacity; }
+
+    // returns the full resolution sample at the given chronological position. 0 is the oldest.
+    uint16_t sample(size_t i) const;
+
+    // rollup tiers
+    uint8_t tierCount(void) const           { return _tier_count; }
+    size_t levelSize(uint8_t level) const;
+    uint32_t levelSamplesPerEntry(uint8_t level) const;
+
+    // returns the bucket at the given chronological position in a rollup level (1 to tierCount()).
+    // 0 is the oldest.
+    const SampleAggregate& aggregate(uint8_t level, size_t i) const;
+
+    // Returns the finest level that still has data covering the most recent span_samples and
+    // can return that span in no more than max_entries entries. If no level qualifies, the
+    // coarsest level is returned. Used to pick the level a history query should read.
+    uint8_t levelForSpan(size_t span_samples, size_t max_entries) const;
+
+    // number of full resolution sample periods covered by all levels of the history
+    size_t retainedSamples(void) const;
+
+    // Returns the number of entries ever added to the level. The retained entries are numbered
+    // from levelPushCount() - levelSize() to levelPushCount() - 1.
+    uint32_t levelPushCount(uint8_t level) const;
+
+    // Copies the entry with the given number from the level, as an aggregate of one sample for
+    // full resolution samples. Returns false if the entry is not retained, and also for the
+    // oldest entry of a full level, which is the next to be overwritten. This may be called
+    // from another task while the history is being pushed to, in which case it also returns
+    // false if the entry was overwritten while it was being copied.
+    bool readEntry(uint8_t level, uint32_t number, SampleAggregate& entry) const;
+
+    // Returns the time of the entry with the given number of a level, which must be retained.
+    // Only for the task that pushes to the history.
+    uint32_t entryTime(uint8_t level, uint32_t number) const;
+
+    // Copies the time of the entry with the given number of a level. Like readEntry(), this
+    // returns false if the entry is not retained, and may be called from another task while
+    // the history is being pushed to.
+    bool readEntryTime(uint8_t level, uint32_t number, uint32_t& time) const;
+
+    // the time of the newest entry of any level
+    uint32_t newestTime(void) const         { return _newestTime; }
+
+    // Adds a sample taken at the given millis() time to the history, overwriting the oldest
+    // sample if the history is full, rolls it up into the tiers and updates all registered
+    // windows. Times must not go backwards.
+    void push(uint16_t value, uint32_t time);
+
+    // Adds a bucket whose newest sample was taken at the given time to the finest rollup tier
+    // as if it had been rolled up from samples, which is how a tier is restored from a saved
+    // copy. The bucket must summarize that tier's samples_per_bucket samples, and buckets can
+    // only be restored before any sample has been pushed. The buckets roll up into the coarser
+    // tiers and update the windows on the rollup levels. Windows on the full resolution level
+    // are not affected. Returns false if the bucket could not be restored.
+    bool restoreAggregate(const SampleAggregate& bucket, uint32_t time);
+
+    // Registers an averaging window over the last window_millis and returns its ID, or
+    // INVALID_SAMPLE_WINDOW if no more windows can be registered. Windows are limited to
+    // SAMPLE_HISTORY_MAX_WINDOW_MILLIS, and a window longer than the history holds averages
+    // what the coarsest level retains. Registering a window length that is already registered
+    // returns the existing window's ID. Windows may be registered at any time; a window
+    // registered after samples have been pushed is seeded from the existing history.
+    SampleWindowID registerWindow(uint32_t window_millis);
+
+    // Returns the ID of the window with the given length, or INVALID_SAMPLE_WINDOW if there is none.
+    SampleWindowID findWindow(uint32_t window_millis) const;
+
+    // Returns the time weighted average of the samples currently in the window. Returns 0 if the
+    // window is empty or the ID is invalid.
+    float windowAverage(SampleWindowID window_id) const;
+
+    // Returns the number of samples that currently contribute to the window's average.
+    size_t windowSampleCount(SampleWindowID window_id) const;
+
+    // Returns the average, covered time and gap time of the window.
+    SampleWindowStats windowStats(SampleWindowID window_id) const;
+
+    // Returns the most entries the window can hold, assuming samples are never more than twice
+    // as frequent as the sample period. Used to size the storage of a SampleDistribution.
+    size_t windowEntryCapacity(SampleWindowID window_id) const;
+
+    // Keeps the distribution of the window's samples in distribution, which is seeded from the
+    // entries already in the window. The distribution must outlive the window. Returns false
+    // if the ID is invalid.
+    bool trackDistribution(SampleWindowID window_id, SampleDistribution& distribution);
+
+    // Returns the min, max and percentiles of a window that tracks its distribution. The min
+    // and max include samples not yet rolled up into a full bucket, but the percentiles do not.
+    // All are 0 if the window is empty or does not track its distribution.
+    SampleWindowSpread windowSpread(SampleWindowID window_id) const;
+
+    // Computes what a window over the last window_millis would hold by scanning the level that
+    // would hold such a window. Use registered windows for averages that are needed repeatedly.
+    SampleWindowStats scanWindow(uint32_t window_millis) const;
+    float scanAverage(uint32_t window_millis) const         { return scanWindow(window_millis).average; }
+};
+
+#endif // __SampleHistory__
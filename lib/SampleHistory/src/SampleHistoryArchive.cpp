@@ -0,0 +1,324 @@
+#include <Logger.h>
+#include "SampleHistoryArchive.h"
+
+#define SAMPLE_HISTORY_ARCHIVE_TASK_STACK       4096
+#define SAMPLE_HISTORY_ARCHIVE_TASK_PRIORITY    1
+
+// records read from flash at a time while restoring
+#define SAMPLE_HISTORY_ARCHIVE_READ_RECORDS     64
+
+// the rollup level that is archived
+#define ARCHIVE_LEVEL   1
+
+SampleHistoryArchive::SampleHistoryArchive()
+    :   _history(nullptr),
+        _secondsPerEntry(0),
+        _fs(nullptr),
+        _dir(),
+        _segments(),
+        _segmentCount(0),
+        _maxSegments(0),
+        _recordsPerSegment(0),
+        _newestSealed(false),
+        _batch(),
+        _batchSize(0),
+        _nextEntry(0),
+        _archivedCount(0),
+        _writeCount(0),
+        _failedWriteCount(0),
+        _restoredCount(0),
+        _restoreMillis(0),
+        _task(nullptr),
+        _pollSeconds(0)
+{
+}
+
+void SampleHistoryArchive::segmentPath(uint32_t first_time, char* path, size_t size) const
+{
+    snprintf(path, size, "%s/%08x.bin", _dir, first_time);
+}
+
+bool SampleHistoryArchive::begin(fs::FS& fs, const char* dir, SampleHistory& history, uint32_t seconds_per_sample,
+                                    uint8_t max_segments, uint16_t records_per_segment)
+{
+    if ((max_segments == 0) || (max_segments > SAMPLE_HISTORY_ARCHIVE_MAX_SEGMENTS)
+            || (records_per_segment < SAMPLE_HISTORY_ARCHIVE_BATCH_RECORDS)
+            || (strlen(dir) >= sizeof(_dir)) || (history.tierCount() == 0)) {
+        LOG_ERROR("ERROR - Invalid history archive configuration. History will not be saved to flash.");
+        return false;
+    }
+    fs.mkdir(dir);
+    strcpy(_dir, dir);
+    _fs = &fs;
+    _history = &history;
+    _secondsPerEntry = history.levelSamplesPerEntry(ARCHIVE_LEVEL)*seconds_per_sample;
+    _maxSegments = max_segments;
+    _recordsPerSegment = records_per_segment;
+    _batchSize = 0;
+    _nextEntry = history.levelPushCount(ARCHIVE_LEVEL);
+    loadSegments();
+    return true;
+}
+
+// Finds the segments left in the archive directory by previous runs.
+void SampleHistoryArchive::loadSegments(void)
+{
+    _segmentCount = 0;
+    _newestSealed = false;
+
+    File dir = _fs->open(_dir);
+    if (!dir || !dir.isDirectory()) {
+        return;
+    }
+    File file = dir.openNextFile();
+    while (file) {
+        // some file systems report the full path and some the file name
+        const char* name = strrchr(file.name(), '/');
+        name = (name != nullptr) ? name + 1 : file.name();
+        char* end = nullptr;
+        uint32_t first_time = strtoul(name, &end, 16);
+        bool is_segment = (end != name) && (strcmp(end, ".bin") == 0);
+        size_t size = file.size();
+        file.close();
+
+        if (is_segment) {
+            if (_segmentCount == _maxSegments) {
+                removeOldestSegment();
+            }
+            // keep the segments ordered oldest first
+            uint8_t idx = _segmentCount;
+            while ((idx > 0) && (first_time < _segments[idx - 1].firstTime)) {
+                _segments[idx] = _segments[idx - 1];
+                idx--;
+            }
+            _segments[idx].firstTime = first_time;
+            _segments[idx].count = size/sizeof(SampleHistoryArchiveRecord);
+            _segmentCount++;
+            // a write cut short by a restart leaves a partial record, and appending after it
+            // would misalign every record that follows
+            if (idx == _segmentCount - 1) {
+                _newestSealed = (size%sizeof(SampleHistoryArchiveRecord) != 0);
+            }
+        }
+        file = dir.openNextFile();
+    }
+    dir.close();
+}
+
+void SampleHistoryArchive::removeOldestSegment(void)
+{
+    if (_segmentCount == 0) {
+        return;
+    }
+    char path[SAMPLE_HISTORY_ARCHIVE_MAX_DIR_LENGTH + 16];
+    segmentPath(_segments[0].firstTime, path, sizeof(path));
+    _fs->remove(path);
+    _segmentCount--;
+    memmove(&_segments[0], &_segments[1], _segmentCount*sizeof(Segment));
+    if (_segmentCount == 0) {
+        _newestSealed = false;
+    }
+}
+
+size_t SampleHistoryArchive::restore(uint32_t now, uint32_t max_age_seconds)
+{
+    if ((_fs == nullptr) || (_segmentCount == 0)) {
+        return 0;
+    }
+    if ((now < SAMPLE_HISTORY_ARCHIVE_MIN_VALID_TIME) || (now < max_age_seconds)) {
+        LOG_WARN("NOTE - The time is not set. Archived history will not be restored.");
+        return 0;
+    }
+    uint32_t start_millis = millis();
+    uint32_t oldest_time = now - max_age_seconds;
+
+    // start from the newest segment that begins before the oldest time to restore
+    uint8_t first_segment = _segmentCount - 1;
+    while ((first_segment > 0) && (_segments[first_segment].firstTime > oldest_time)) {
+        first_segment--;
+    }
+
+    SampleHistoryArchiveRecord records[SAMPLE_HISTORY_ARCHIVE_READ_RECORDS];
+    uint32_t last_time = 0;
+    size_t restored = 0;
+    bool rejected = false;
+    for (uint8_t s = first_segment; (s < _segmentCount) && !rejected; s++) {
+        char path[SAMPLE_HISTORY_ARCHIVE_MAX_DIR_LENGTH + 16];
+        segmentPath(_segments[s].firstTime, path, sizeof(path));
+        File file = _fs->open(path, FILE_READ);
+        if (!file) {
+            LOG_ERROR("ERROR - Could not read history archive segment %s", path);
+            continue;
+        }
+        uint32_t remaining = _segments[s].count;
+        while ((remaining > 0) && !rejected) {
+            size_t count = (remaining < SAMPLE_HISTORY_ARCHIVE_READ_RECORDS) ? remaining : SAMPLE_HISTORY_ARCHIVE_READ_RECORDS;
+            size_t bytes = file.read((uint8_t*)records, count*sizeof(SampleHistoryArchiveRecord));
+            count = bytes/sizeof(SampleHistoryArchiveRecord);
+            if (count == 0) {
+                break;
+            }
+            remaining -= count;
+            for (size_t i = 0; i < count; i++) {
+                const SampleHistoryArchiveRecord& record = records[i];
+                // skip records outside the window, and any left out of order by a clock change
+                if ((record.time < oldest_time) || (record.time > now) || ((restored > 0) && (record.time <= last_time))) {
+                    continue;
+                }
+                SampleAggregate bucket;
+                bucket.sum = record.sum;
+                bucket.min = record.min;
+                bucket.max = record.max;
+                bucket.count = record.count;
+                // the history is stamped in millis(), so place the bucket's last sample as far
+                // before boot as it was taken before now
+                uint32_t end_time = record.time + _secondsPerEntry;
+                uint32_t age_millis = (end_time < now) ? (now - end_time)*1000 : 0;
+                if (!_history->restoreAggregate(bucket, start_millis - age_millis)) {
+                    // written with a different sample period, or samples were already pushed
+                    LOG_ERROR("ERROR - Archived history does not match the history configuration. Stopping the restore.");
+                    rejected = true;
+                    break;
+                }
+                last_time = record.time;
+                restored++;
+            }
+        }
+        file.close();
+    }
+
+    _nextEntry = _history->levelPushCount(ARCHIVE_LEVEL);
+    _restoredCount = restored;
+    _restoreMillis = millis() - start_millis;
+    LOG_INFO("Restored %u history buckets from %u archive segments in %u ms",
+                restored, _segmentCount - first_segment, _restoreMillis);
+    return restored;
+}
+
+bool SampleHistoryArchive::poll(uint32_t now)
+{
+    // buckets stamped before the time is set would be restored years out of place
+    if ((_fs == nullptr) || (now < SAMPLE_HISTORY_ARCHIVE_MIN_VALID_TIME)) {
+        return true;
+    }
+    uint32_t pushed = _history->levelPushCount(ARCHIVE_LEVEL);
+    while ((_batchSize < SAMPLE_HISTORY_ARCHIVE_BATCH_RECORDS) && (_nextEntry != pushed)) {
+        SampleAggregate bucket;
+        // buckets that are no longer retained by the time they are read are skipped
+        if (_history->readEntry(ARCHIVE_LEVEL, _nextEntry, bucket)) {
+            SampleHistoryArchiveRecord& record = _batch[_batchSize++];
+            record.time = now - (pushed - _nextEntry)*_secondsPerEntry;
+            record.sum = bucket.sum;
+            record.min = bucket.min;
+            record.max = bucket.max;
+            record.count = bucket.count;
+            record.reserved = 0;
+            _archivedCount++;
+        }
+        _nextEntry++;
+    }
+    if (_batchSize < SAMPLE_HISTORY_ARCHIVE_BATCH_RECORDS) {
+        return true;
+    }
+    return writeBatch();
+}
+
+bool SampleHistoryArchive::flush(void)
+{
+    if (_fs == nullptr) {
+        return true;
+    }
+    return writeBatch();
+}
+
+// Appends the batch to the newest segment, starting a new segment if it is full.
+bool SampleHistoryArchive::writeBatch(void)
+{
+    if (_batchSize == 0) {
+        return true;
+    }
+    bool new_segment = (_segmentCount == 0) || _newestSealed
+                        || (_segments[_segmentCount - 1].count + _batchSize > _recordsPerSegment);
+    if (new_segment) {
+        if (_segmentCount == _maxSegments) {
+            removeOldestSegment();
+        }
+        Segment& segment = _segments[_segmentCount++];
+        segment.firstTime = _batch[0].time;
+        segment.count = 0;
+        _newestSealed = false;
+    }
+    Segment& newest = _segments[_segmentCount - 1];
+    char path[SAMPLE_HISTORY_ARCHIVE_MAX_DIR_LENGTH + 16];
+    segmentPath(newest.firstTime, path, sizeof(path));
+
+    size_t bytes = _batchSize*sizeof(SampleHistoryArchiveRecord);
+    size_t written = 0;
+    File file = _fs->open(path, FILE_APPEND);
+    if (file) {
+        written = file.write((const uint8_t*)_batch, bytes);
+        file.close();
+    }
+    if (written != bytes) {
+        LOG_ERROR("ERROR - Could not write history archive segment %s", path);
+        _failedWriteCount++;
+        if (written > 0) {
+            // the segment now ends in a partial batch, so leave it be
+            newest.count += written/sizeof(SampleHistoryArchiveRecord);
+            _newestSealed = true;
+        } else if (newest.count == 0) {
+            _fs->remove(path);
+            _segmentCount--;
+        }
+        return false;
+    }
+    newest.count += _batchSize;
+    _batchSize = 0;
+    _writeCount++;
+    return true;
+}
+
+bool SampleHistoryArchive::startTask(int core, uint32_t poll_seconds)
+{
+#if defined(ESP32)
+    if (_fs == nullptr) {
+        return false;
+    }
+    _pollSeconds = (poll_seconds > 0) ? poll_seconds : 1;
+    TaskHandle_t task = nullptr;
+    BaseType_t result = xTaskCreatePinnedToCore(
+        SampleHistoryArchive::archiveTask,
+        "HistArchive",
+        SAMPLE_HISTORY_ARCHIVE_TASK_STACK,
+        this,
+        SAMPLE_HISTORY_ARCHIVE_TASK_PRIORITY,
+        &task,
+        core
+    );
+    if (result != pdPASS) {
+        LOG_ERROR("ERROR - Could not start the history archive task. History will be archived from the main loop.");
+        return false;
+    }
+    _task = task;
+    return true;
+#else
+    (void)core;
+    (void)poll_seconds;
+    return false;
+#endif
+}
+
+void SampleHistoryArchive::archiveTask(void* parameter)
+{
+#if defined(ESP32)
+    SampleHistoryArchive* archive = static_cast<SampleHistoryArchive*>(parameter);
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(archive->_pollSeconds*1000));
+        time_t now;
+        time(&now);
+        archive->poll(now);
+    }
+#else
+    (void)parameter;
+#endif
+}
@@ -0,0 +1,124 @@
+#ifndef __SampleHistoryArchive__
+#define __SampleHistoryArchive__
+#include <Arduino.h>
+#include <FS.h>
+#include "SampleHistory.h"
+
+// Most segment files the archive can track.
+#define SAMPLE_HISTORY_ARCHIVE_MAX_SEGMENTS     16
+#define SAMPLE_HISTORY_ARCHIVE_MAX_DIR_LENGTH   16
+
+// Buckets collected before they are appended to flash. 16 records fill one 256 byte SPIFFS page.
+#ifndef SAMPLE_HISTORY_ARCHIVE_BATCH_RECORDS
+#define SAMPLE_HISTORY_ARCHIVE_BATCH_RECORDS    16
+#endif
+
+// The clock counts from 1970 until NTP has answered, so any earlier time means it is not set yet.
+#define SAMPLE_HISTORY_ARCHIVE_MIN_VALID_TIME   1600000000
+
+//
+// An archived rollup bucket, stamped with the time of its first sample.
+//
+struct SampleHistoryArchiveRecord {
+    uint32_t    time;
+    uint32_t    sum;
+    uint16_t    min;
+    uint16_t    max;
+    uint16_t    count;
+    uint16_t    reserved;
+};
+
+//
+// SampleHistoryArchive
+//
+// Keeps a copy of the finest rollup tier of a SampleHistory on flash so that the history, and
+// the long averaging windows that are kept on its rollup levels, survive a restart. New
+// buckets are read from the history by their entry number, collected into batches of
+// SAMPLE_HISTORY_ARCHIVE_BATCH_RECORDS, and each batch is appended to the newest of a set of
+// append-only segment files. Once a segment holds records_per_segment records a new one is
+// started, and once there are max_segments segments the oldest is removed. Nothing is ever
+// rewritten in place, and writing whole pages at a time keeps the wear on the flash low. The
+// buckets of a batch that is not yet written when the device restarts are lost.
+//
+// restore() reads the newest segments back into the history at boot. Records are read in
+// blocks, which keeps restoring a full day of 1 minute buckets well under a second. Each
+// bucket is restored at the millis() time it would have had if the device had kept running,
+// so the time the device was down is a gap in the history rather than averaged over.
+//
+// Archiving runs on its own low priority task (see startTask()) so that flash writes never
+// hold up the sampling loop. Without the task, poll() must be called periodically instead.
+//
+class SampleHistoryArchive {
+private:
+    struct Segment {
+        uint32_t    firstTime;
+        uint32_t    count;
+    };
+
+    SampleHistory*  _history;
+    uint32_t        _secondsPerEntry;
+    fs::FS*         _fs;
+    char            _dir[SAMPLE_HISTORY_ARCHIVE_MAX_DIR_LENGTH];
+    Segment         _segments[SAMPLE_HISTORY_ARCHIVE_MAX_SEGMENTS];
+    uint8_t         _segmentCount;
+    uint8_t         _maxSegments;
+    uint16_t        _recordsPerSegment;
+    bool            _newestSealed;  // the newest segment ends in a partial record and is not appended to
+
+    SampleHistoryArchiveRecord  _batch[SAMPLE_HISTORY_ARCHIVE_BATCH_RECORDS];
+    uint8_t         _batchSize;
+    uint32_t        _nextEntry;     // number of the next rollup bucket to archive
+
+    uint32_t        _archivedCount;
+    uint32_t        _writeCount;
+    uint32_t        _failedWriteCount;
+    uint32_t        _restoredCount;
+    uint32_t        _restoreMillis;
+    void*           _task;
+    uint32_t        _pollSeconds;
+
+    void segmentPath(uint32_t first_time, char* path, size_t size) const;
+    void loadSegments(void);
+    void removeOldestSegment(void);
+    bool writeBatch(void);
+
+    static void archiveTask(void* parameter);
+
+public:
+    SampleHistoryArchive();
+
+    // Uses the segment files in the given directory as the archive of the history's finest
+    // rollup tier. seconds_per_sample is the history's sample period. Returns false if the
+    // configuration is invalid or the history has no rollup tiers.
+    bool begin(fs::FS& fs, const char* dir, SampleHistory& history, uint32_t seconds_per_sample,
+                uint8_t max_segments, uint16_t records_per_segment);
+    bool isEnabled(void) const              { return _fs != nullptr; }
+
+    // Restores the archived buckets from the max_age_seconds before now into the history. Must
+    // be called before any samples are pushed to the history. Returns the number of buckets
+    // restored, which is 0 if now is before SAMPLE_HISTORY_ARCHIVE_MIN_VALID_TIME.
+    size_t restore(uint32_t now, uint32_t max_age_seconds);
+
+    // Collects the buckets completed since the last call, stamping them relative to now, and
+    // appends a batch to flash once it is full. Returns false if a batch could not be written,
+    // in which case it is tried again on the next call. While now is before
+    // SAMPLE_HISTORY_ARCHIVE_MIN_VALID_TIME the buckets are left in the history, and collected
+    // once the time is set, as long as the history still retains them.
+    bool poll(uint32_t now);
+
+    // Appends the buckets collected so far to flash without waiting for a full batch.
+    bool flush(void);
+
+    // Starts a FreeRTOS task pinned to the given core that polls the archive every
+    // poll_seconds. Returns false if the task could not be started.
+    bool startTask(int core, uint32_t poll_seconds);
+    bool isTaskRunning(void) const          { return _task != nullptr; }
+
+    uint32_t archivedCount(void) const      { return _archivedCount; }
+    uint32_t writeCount(void) const         { return _writeCount; }
+    uint32_t failedWriteCount(void) const   { return _failedWriteCount; }
+    uint32_t restoredCount(void) const      { return _restoredCount; }
+    uint32_t restoreMillis(void) const      { return _restoreMillis; }
+};
+
+#endif // __SampleHistoryArchive__
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <string.h>
+#include "SampleHistoryStream.h"
+
+SampleHistoryStream::SampleHistoryStream(
+    const SampleHistory& history,
+    uint32_t sample_seconds,
+    time_t newest_time,
+    time_t from,
+    time_t to,
+    size_t max_entries
+)   :   _history(history),
+        _sampleSeconds((sample_seconds > 0) ? sample_seconds : 1),
+        _level(0),
+        _samplesPerEntry(1),
+        _anchorTime(newest_time),
+        _anchorMillis(0),
+        _nextEntry(0),
+        _endEntry(0),
+        _firstEntry(true),
+        _state(STATE_HEADER),
+        _pendingLength(0),
+        _pendingOffset(0)
+{
+    uint32_t sample_count = history.levelPushCount(0);
+    if ((sample_count == 0) || (to < from) || !history.readEntryTime(0, sample_count - 1, _anchorMillis)) {
+        return;
+    }
+
+    // the part of [from, to] that the history holds, which reaches back to the oldest entry
+    // retained by any level
+    time_t oldest = _anchorTime;
+    for (uint8_t level = 0; level <= history.tierCount(); level++) {
+        uint32_t level_count = history.levelPushCount(level);
+        size_t level_size = history.levelSize(level);
+        uint32_t entry = level_count - ((level_size < level_count) ? level_size : level_count);
+        time_t first_time;
+        time_t last_time;
+        // the oldest entry of a full level is not readable
+        if ((entryTimes(level, entry, first_time, last_time) || entryTimes(level, entry + 1, first_time, last_time))
+                && (first_time < oldest)) {
+            oldest = first_time;
+        }
+    }
+    if (from < oldest) {
+        from = oldest;
+    }
+    if (to > _anchorTime) {
+        to = _anchorTime;
+    }
+    if (to < from) {
+        return;
+    }
+
+    size_t span_samples = (to - from)/_sampleSeconds + 1;
+    _level = history.levelForSpan(span_samples, (max_entries > 0) ? max_entries : 1);
+    _samplesPerEntry = history.levelSamplesPerEntry(_level);
+
+    // The level's entries that hold samples within [from, to]. Only completed entries are
+    // streamed, and entries older than the level retains are skipped as they are read.
+    uint32_t level_count = history.levelPushCount(_level);
+    size_t level_size = history.levelSize(_level);
+    uint32_t oldest_entry = level_count - ((level_size < level_count) ? level_size : level_count);
+    _nextEntry = findEntry(oldest_entry, level_count, from, false);
+    _endEntry = findEntry(_nextEntry, level_count, to, true);
+    // never stream more than max_entries, keeping the newest ones
+    if ((max_entries > 0) && (_endEntry - _nextEntry > max_entries)) {
+        _nextEntry = _endEntry - max_entries;
+    }
+}
+
+// Gets the times of the first and newest samples of an entry. Returns false if the entry is
+// not retained.
+bool SampleHistoryStream::entryTimes(uint8_t level, uint32_t entry, time_t& first_time, time_t& last_time) const
+{
+    uint32_t entry_millis;
+    if (!_history.readEntryTime(level, entry, entry_millis)) {
+        return false;
+    }
+    // entries pushed after the stream was created are newer than the anchor
+    int64_t age_millis = (int32_t)(_anchorMillis - entry_millis);
+    last_time = _anchorTime - (time_t)((age_millis + 500)/1000);
+    first_time = last_time - (time_t)(_history.levelSamplesPerEntry(level) - 1)*(time_t)_sampleSeconds;
+    return true;
+}
+
+// Returns the first of the entries from first up to end whose newest sample is at or after
+// time, or with by_first_time, whose first sample is after time. Returns end if there is none.
+// Entry times never decrease, and entries that are no longer retained count as older than any.
+uint32_t SampleHistoryStream::findEntry(uint32_t first, uint32_t end, time_t time, bool by_first_time) const
+{
+    while (first < end) {
+        uint32_t middle = first + (end - first)/2;
+        time_t first_time;
+        time_t last_time;
+        bool found = entryTimes(_level, middle, first_time, last_time)
+                        && (by_first_time ? (first_time > time) : (last_time >= time));
+        if (found) {
+            end = middle;
+        } else {
+            first = middle + 1;
+        }
+    }
+    return first;
+}
+
+// Formats the next piece of the JSON into out, and returns its length.
+size_t SampleHistoryStream::formatNext(char* out, size_t capacity)
+{
+    int length = 0;
+    switch (_state) {
+        case STATE_HEADER:
+            if (_level == 0) {
+                length = snprintf(out, capacity, "{\"level\":0,\"step\":%u,\"fields\":[\"time\",\"value\"],\"data\":[",
+                    _sampleSeconds);
+            } else {
+                length = snprintf(out, capacity, "{\"level\":%u,\"step\":%u,\"fields\":[\"time\",\"mean\",\"min\",\"max\"],\"data\":[",
+                    _level, _samplesPerEntry*_sampleSeconds);
+            }
+            _state = STATE_ENTRIES;
+            break;
+        case STATE_ENTRIES:
+            while (_nextEntry < _endEntry) {
+                uint32_t entry_number = _nextEntry++;
+                SampleAggregate entry;
+                time_t first_time;
+                time_t last_time;
+                if (!entryTimes(_level, entry_number, first_time, last_time)
+                        || !_history.readEntry(_level, entry_number, entry)) {
+                    continue;
+                }
+                const char* separator = _firstEntry ? "" : ",";
+                _firstEntry = false;
+                if (_level == 0) {
+                    length = snprintf(out, capacity, "%s[%ld,%u]", separator, (long)first_time, entry.max);
+                } else {
+                    length = snprintf(out, capacity, "%s[%ld,%.2f,%u,%u]",
+                        separator, (long)first_time, entry.mean(), entry.min, entry.max);
+                }
+                return (length > 0) ? length : 0;
+            }
+            _state = STATE_FOOTER;
+            return formatNext(out, capacity);
+        case STATE_FOOTER:
+            length = snprintf(out, capacity, "]}");
+            _state = STATE_DONE;
+            break;
+        case STATE_DONE:
+            break;
+    }
+    return (length > 0) ? length : 0;
+}
+
+size_t SampleHistoryStream::read(uint8_t* buffer, size_t max_length)
+{
+    size_t length = 0;
+    while (length < max_length) {
+        if (_pendingOffset == _pendingLength) {
+            _pendingOffset = 0;
+            _pendingLength = formatNext(_pending, sizeof(_pending));
+            if (_pendingLength == 0) {
+                break;
+            }
+        }
+        size_t count = _pendingLength - _pendingOffset;
+        if (count > max_length - length) {
+            count = max_length - length;
+        }
+        memcpy(buffer + length, _pending + _pendingOffset, count);
+        _pendingOffset += count;
+        length += count;
+    }
+    return length;
+}
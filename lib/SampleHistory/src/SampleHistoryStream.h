@@ -0,0 +1,79 @@
+#ifndef __SampleHistoryStream__
+#define __SampleHistoryStream__
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "SampleHistory.h"
+
+//
+// SampleHistoryStream
+//
+// Streams the part of a SampleHistory between two times as JSON, a buffer at a time, so the
+// history can be sent without ever being held in memory as a whole. The output is:
+//
+//   {"level":1,"step":60,"fields":["time","mean","min","max"],"data":[[1600000000,12.5,10,15],...]}
+//
+// Full resolution samples (level 0) have the fields time and value. The level read is the
+// finest that covers the requested span in no more than max_entries entries. The entries are
+// in chronological order, and each is stamped with the time of its first sample.
+//
+// The entries to stream are found by the times the history recorded for them, which are
+// millis() values placed relative to the newest sample. Gaps, and buckets restored from before
+// a restart, mean an entry's number does not tell its time.
+//
+// Entries are read by their number in the level (see SampleHistory::levelPushCount()) rather
+// than their position, so the history may be pushed to while it is being streamed. Entries
+// that are overwritten before they are read are skipped.
+//
+class SampleHistoryStream {
+private:
+    enum State {
+        STATE_HEADER,
+        STATE_ENTRIES,
+        STATE_FOOTER,
+        STATE_DONE
+    };
+
+    const SampleHistory&    _history;
+    uint32_t                _sampleSeconds;
+    uint8_t                 _level;
+    uint32_t                _samplesPerEntry;
+
+    // the time of the newest sample when the stream was created, and its millis() time
+    time_t                  _anchorTime;
+    uint32_t                _anchorMillis;
+
+    uint32_t                _nextEntry;
+    uint32_t                _endEntry;      // one past the last entry to stream
+    bool                    _firstEntry;
+    State                   _state;
+
+    // output that did not fit in the last buffer
+    char                    _pending[96];
+    size_t                  _pendingLength;
+    size_t                  _pendingOffset;
+
+    bool entryTimes(uint8_t level, uint32_t entry, time_t& first_time, time_t& last_time) const;
+    uint32_t findEntry(uint32_t first, uint32_t end, time_t time, bool by_first_time) const;
+    size_t formatNext(char* out, size_t capacity);
+
+public:
+    // newest_time is the time the newest sample in the history was taken.
+    SampleHistoryStream(
+        const SampleHistory& history,
+        uint32_t sample_seconds,
+        time_t newest_time,
+        time_t from,
+        time_t to,
+        size_t max_entries
+    );
+
+    // Fills buffer with up to max_length bytes of the JSON and returns the number of bytes
+    // written. Returns 0 only once the whole JSON has been read.
+    size_t read(uint8_t* buffer, size_t max_length);
+
+    uint8_t level(void) const           { return _level; }
+    size_t entryCount(void) const       { return _endEntry - _nextEntry; }
+};
+
+#endif // __SampleHistoryStream__
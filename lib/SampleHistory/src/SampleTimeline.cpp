@@ -0,0 +1,75 @@
+#include "SampleTimeline.h"
+
+SampleTimeline::SampleTimeline()
+    :   _blocks(nullptr),
+        _offsets(nullptr),
+        _capacity(0),
+        _newestIdx(0)
+{
+    _overwritten.base = 0;
+    _overwritten.shift = 0;
+}
+
+size_t SampleTimeline::storageBytes(size_t capacity)
+{
+    size_t block_count = (capacity + SAMPLE_TIMELINE_BLOCK_ENTRIES - 1)/SAMPLE_TIMELINE_BLOCK_ENTRIES;
+    size_t offset_bytes = (capacity*sizeof(uint16_t) + 3) & ~(size_t)3;
+    return block_count*sizeof(Block) + offset_bytes;
+}
+
+void SampleTimeline::setStorage(void* storage, size_t capacity)
+{
+    if ((storage == nullptr) || (capacity == 0)) {
+        _blocks = nullptr;
+        _offsets = nullptr;
+        _capacity = 0;
+        return;
+    }
+    size_t block_count = (capacity + SAMPLE_TIMELINE_BLOCK_ENTRIES - 1)/SAMPLE_TIMELINE_BLOCK_ENTRIES;
+    _blocks = (Block*)storage;
+    _offsets = (uint16_t*)(_blocks + block_count);
+    _capacity = capacity;
+    _newestIdx = 0;
+    _overwritten.base = 0;
+    _overwritten.shift = 0;
+}
+
+void SampleTimeline::set(size_t idx, uint32_t time)
+{
+    if (idx >= _capacity) {
+        return;
+    }
+    size_t first_idx = idx - idx%SAMPLE_TIMELINE_BLOCK_ENTRIES;
+    Block& block = _blocks[idx/SAMPLE_TIMELINE_BLOCK_ENTRIES];
+    _newestIdx = idx;
+    if (idx == first_idx) {
+        _overwritten = block;
+        block.base = time;
+        block.shift = 0;
+        _offsets[idx] = 0;
+        return;
+    }
+
+    int32_t signed_delta = (int32_t)(time - block.base);
+    uint32_t delta = (signed_delta > 0) ? signed_delta : 0;
+    while ((delta >> block.shift) > UINT16_MAX) {
+        block.shift++;
+        for (size_t i = first_idx + 1; i < idx; i++) {
+            _offsets[i] >>= 1;
+        }
+    }
+    _offsets[idx] = delta >> block.shift;
+}
+
+uint32_t SampleTimeline::get(size_t idx) const
+{
+    if (idx >= _capacity) {
+        return 0;
+    }
+    const Block* block = &_blocks[idx/SAMPLE_TIMELINE_BLOCK_ENTRIES];
+    if ((idx > _newestIdx) && (idx/SAMPLE_TIMELINE_BLOCK_ENTRIES == _newestIdx/SAMPLE_TIMELINE_BLOCK_ENTRIES)) {
+        // not yet overwritten in this lap
+        block = &_overwritten;
+    }
+    return block->base + ((uint32_t)_offsets[idx] << block->shift);
+}
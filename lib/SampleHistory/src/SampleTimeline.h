@@ -0,0 +1,61 @@
+#ifndef __SampleTimeline__
+#define __SampleTimeline__
+#include <stdint.h>
+#include <stddef.h>
+
+// Entries per block of a timeline. Each block costs 8 bytes on top of the 2 bytes per entry.
+#ifndef SAMPLE_TIMELINE_BLOCK_ENTRIES
+#define SAMPLE_TIMELINE_BLOCK_ENTRIES   32
+#endif
+
+//
+// SampleTimeline
+//
+// Compact timestamps for the slots of a ring buffer, such as one level of a SampleHistory.
+// The slots are grouped into blocks of SAMPLE_TIMELINE_BLOCK_ENTRIES. Each block keeps the full
+// 32 bit time of the entry in its first slot, and every entry keeps its offset from that base
+// in 16 bits. Offsets are in units of 2^shift, where the block's shift starts at 0 and is only
+// raised if an offset does not fit, as happens when a long gap falls inside a block or the
+// entries are far apart. Raising the shift drops the low bits of the block's earlier offsets,
+// so a block's times are exact unless it spans more than 65535 units.
+//
+// Times are expected to be millis() values, which wrap about every 49 days. Only the
+// differences between times are meaningful.
+//
+// Slots must be set in ring order, and each entry's time must not be earlier than the one
+// before it. The block that the newest entry is in still holds the previous lap's entries in
+// the slots after it, so the previous lap's base of that block is kept until it is overwritten.
+//
+// This class does not allocate memory and has no Arduino dependencies.
+//
+class SampleTimeline {
+private:
+    struct Block {
+        uint32_t    base;
+        uint8_t     shift;
+    };
+
+    Block*      _blocks;
+    uint16_t*   _offsets;
+    size_t      _capacity;
+    size_t      _newestIdx;
+    Block       _overwritten;   // the previous lap's block that the newest entry's block replaced
+
+public:
+    SampleTimeline();
+
+    // Returns the number of bytes of storage needed for a timeline of capacity slots. This is
+    // a multiple of 4, so timelines can be placed one after another.
+    static size_t storageBytes(size_t capacity);
+
+    // Sets the backing storage, which must be at least storageBytes() in size and 4 byte aligned.
+    void setStorage(void* storage, size_t capacity);
+
+    // Sets the time of the entry in the slot idx, which must be the slot after the last one set.
+    void set(size_t idx, uint32_t time);
+
+    // Returns the time of the entry in the slot idx.
+    uint32_t get(size_t idx) const;
+};
+
+#endif // __SampleTimeline__
@@ -0,0 +1,80 @@
+#if defined(ESP32)
+#include <Logger.h>
+#include "StaticAssetHandler.h"
+
+StaticAssetHandler::StaticAssetHandler(const StaticAssetIndex& index, fs::FS& fs, uint32_t max_age_seconds)
+    :   _index(index),
+        _fs(fs),
+        _cacheControl(String("max-age=") + String(max_age_seconds)),
+        _servedCount(0),
+        _notModifiedCount(0),
+        _flashReadCount(0)
+{
+}
+
+bool StaticAssetHandler::canHandle(AsyncWebServerRequest *request)
+{
+    if (!(request->method() & (HTTP_GET | HTTP_HEAD))) {
+        return false;
+    }
+    if (_index.find(request->url().c_str()) == nullptr) {
+        return false;
+    }
+    // the server discards the request headers that no handler has asked for
+    request->addInterestingHeader("Accept-Encoding");
+    request->addInterestingHeader("If-None-Match");
+    return true;
+}
+
+void StaticAssetHandler::handleRequest(AsyncWebServerRequest *request)
+{
+    const StaticAsset* asset = _index.find(request->url().c_str());
+    if (asset == nullptr) {
+        request->send(404);
+        return;
+    }
+    AsyncWebHeader* accept_encoding = request->getHeader("Accept-Encoding");
+    bool gzip = (asset->gzipSize > 0) && ((asset->size == 0)
+        || ((accept_encoding != nullptr) && (accept_encoding->value().indexOf("gzip") >= 0)));
+
+    char etag[14];
+    StaticAssetIndex::formatETag(*asset, gzip, etag);
+    AsyncWebHeader* if_none_match = request->getHeader("If-None-Match");
+    AsyncWebServerResponse *response;
+    if ((if_none_match != nullptr) && (if_none_match->value().indexOf(etag) >= 0)) {
+        _notModifiedCount++;
+        response = request->beginResponse(304);
+    } else {
+        const uint8_t* data = gzip ? asset->gzipData : asset->data;
+        if (data != nullptr) {
+            response = request->beginResponse_P(200, asset->contentType, data, gzip ? asset->gzipSize : asset->size);
+            if (gzip) {
+                response->addHeader("Content-Encoding", "gzip");
+            }
+        } else {
+            // Open the file directly, as the path based response looks the file up again. The
+            // response adds the Content-Encoding itself when given a .gz file for another path.
+            String path(asset->path);
+            if (gzip) {
+                path += ".gz";
+            }
+            File file = _fs.open(path, FILE_READ);
+            if (!file) {
+                LOG_ERROR("ERROR - Could not open static asset %s", path.c_str());
+                request->send(500);
+                return;
+            }
+            _flashReadCount++;
+            response = request->beginResponse(file, String(asset->path), String(asset->contentType));
+        }
+    }
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", _cacheControl);
+    if (asset->gzipSize > 0) {
+        response->addHeader("Vary", "Accept-Encoding");
+    }
+    _servedCount++;
+    request->send(response);
+}
+
+#endif // ESP32
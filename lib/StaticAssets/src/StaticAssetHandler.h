@@ -0,0 +1,40 @@
+#ifndef __StaticAssetHandler__
+#define __StaticAssetHandler__
+#if defined(ESP32)
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "StaticAssetIndex.h"
+
+//
+// StaticAssetHandler
+//
+// Serves the files in a StaticAssetIndex. The compressed copy of a file is sent to clients that
+// accept gzip, and files held in memory are sent from there rather than from flash. Responses
+// carry an ETag, and requests whose If-None-Match names the current ETag are answered with a
+// bodiless 304.
+//
+class StaticAssetHandler : public AsyncWebHandler {
+private:
+    const StaticAssetIndex& _index;
+    fs::FS&                 _fs;
+    String                  _cacheControl;
+
+    uint32_t                _servedCount;
+    uint32_t                _notModifiedCount;
+    uint32_t                _flashReadCount;
+
+public:
+    // max_age_seconds is how long clients may use a file before checking that it is current.
+    StaticAssetHandler(const StaticAssetIndex& index, fs::FS& fs, uint32_t max_age_seconds);
+
+    virtual bool canHandle(AsyncWebServerRequest *request) override;
+    virtual void handleRequest(AsyncWebServerRequest *request) override;
+    virtual bool isRequestHandlerTrivial(void) override     { return false; }
+
+    uint32_t servedCount(void) const        { return _servedCount; }
+    uint32_t notModifiedCount(void) const   { return _notModifiedCount; }
+    uint32_t flashReadCount(void) const     { return _flashReadCount; }
+};
+
+#endif // ESP32
+#endif // __StaticAssetHandler__
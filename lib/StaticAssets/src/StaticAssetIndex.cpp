@@ -0,0 +1,288 @@
+#include <Logger.h>
+#include "StaticAssetIndex.h"
+
+#define GZIP_SUFFIX         ".gz"
+#define GZIP_SUFFIX_LENGTH  3
+
+struct ContentTypeEntry {
+    const char* extension;
+    const char* contentType;
+};
+
+static const ContentTypeEntry CONTENT_TYPES[] = {
+    {".htm", "text/html"},
+    {".html", "text/html"},
+    {".css", "text/css"},
+    {".js", "application/javascript"},
+    {".json", "application/json"},
+    {".png", "image/png"},
+    {".gif", "image/gif"},
+    {".jpg", "image/jpeg"},
+    {".svg", "image/svg+xml"},
+    {".ico", "image/x-icon"},
+    {".xml", "text/xml"},
+    {".pdf", "application/x-pdf"},
+    {".zip", "application/x-zip"},
+    {".gz", "application/x-gzip"},
+};
+
+static bool endsWith(const char* str, size_t length, const char* suffix, size_t suffix_length)
+{
+    return (length >= suffix_length) && (strcmp(str + length - suffix_length, suffix) == 0);
+}
+
+static void* allocateBuffer(size_t bytes)
+{
+    void* buffer = nullptr;
+    if (ESP.getPsramSize() > 0) {
+        buffer = ps_malloc(bytes);
+    }
+    if (buffer == nullptr) {
+        buffer = malloc(bytes);
+    }
+    return buffer;
+}
+
+static uint32_t hashBytes(uint32_t hash, const uint8_t* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i])*16777619UL;
+    }
+    return hash;
+}
+
+static const uint32_t HASH_SEED = 2166136261UL;
+
+StaticAssetIndex::StaticAssetIndex()
+    :   _assets(nullptr),
+        _count(0),
+        _cachedBytes(0),
+        _built(false)
+{
+}
+
+StaticAssetIndex::~StaticAssetIndex()
+{
+    clear();
+}
+
+void StaticAssetIndex::clear(void)
+{
+    for (size_t i = 0; i < _count; i++) {
+        free(_assets[i].data);
+        free(_assets[i].gzipData);
+    }
+    free(_assets);
+    _assets = nullptr;
+    _count = 0;
+    _cachedBytes = 0;
+    _built = false;
+}
+
+const char* StaticAssetIndex::contentType(const char* path)
+{
+    size_t length = strlen(path);
+    for (size_t i = 0; i < sizeof(CONTENT_TYPES)/sizeof(CONTENT_TYPES[0]); i++) {
+        const ContentTypeEntry& entry = CONTENT_TYPES[i];
+        if (endsWith(path, length, entry.extension, strlen(entry.extension))) {
+            return entry.contentType;
+        }
+    }
+    return "text/plain";
+}
+
+void StaticAssetIndex::formatETag(const StaticAsset& asset, bool gzip, char* out)
+{
+    snprintf(out, 14, gzip ? "\"%08x-gz\"" : "\"%08x\"", asset.hash);
+}
+
+StaticAsset* StaticAssetIndex::addAsset(const char* path, size_t& capacity)
+{
+    for (size_t i = 0; i < _count; i++) {
+        if (strcmp(_assets[i].path, path) == 0) {
+            return &_assets[i];
+        }
+    }
+    if (_count == capacity) {
+        size_t new_capacity = (capacity > 0) ? 2*capacity : 8;
+        StaticAsset* assets = (StaticAsset*)realloc(_assets, new_capacity*sizeof(StaticAsset));
+        if (assets == nullptr) {
+            return nullptr;
+        }
+        _assets = assets;
+        capacity = new_capacity;
+    }
+    StaticAsset& asset = _assets[_count++];
+    memset(&asset, 0, sizeof(asset));
+    strcpy(asset.path, path);
+    asset.contentType = contentType(path);
+    return &asset;
+}
+
+bool StaticAssetIndex::hashFile(fs::FS& fs, const char* path, uint32_t& hash)
+{
+    File file = fs.open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    uint8_t buffer[256];
+    size_t count;
+    hash = HASH_SEED;
+    while ((count = file.read(buffer, sizeof(buffer))) > 0) {
+        hash = hashBytes(hash, buffer, count);
+    }
+    file.close();
+    return true;
+}
+
+// Reads a file into memory if it fits in what is left of cache_bytes.
+uint8_t* StaticAssetIndex::cacheFile(fs::FS& fs, const char* path, size_t size, size_t& cache_bytes)
+{
+    if ((size == 0) || (size > cache_bytes)) {
+        return nullptr;
+    }
+    File file = fs.open(path, FILE_READ);
+    if (!file) {
+        return nullptr;
+    }
+    uint8_t* data = (uint8_t*)allocateBuffer(size);
+    if ((data != nullptr) && (file.read(data, size) != size)) {
+        free(data);
+        data = nullptr;
+    }
+    file.close();
+    if (data != nullptr) {
+        cache_bytes -= size;
+        _cachedBytes += size;
+    }
+    return data;
+}
+
+static int compareAssets(const void* a, const void* b)
+{
+    return strcmp(((const StaticAsset*)a)->path, ((const StaticAsset*)b)->path);
+}
+
+bool StaticAssetIndex::build(fs::FS& fs, const char* dir, const StaticAssetFilter& filter, size_t cache_bytes, size_t max_cached_file_bytes)
+{
+    clear();
+    File root = fs.open(dir, FILE_READ);
+    if (!root || !root.isDirectory()) {
+        LOG_ERROR("ERROR - Could not open static asset directory %s", dir);
+        return false;
+    }
+
+    // Collect the files, pairing each compressed copy with its file. Depending on the core
+    // version, file names are either full paths or relative to the directory.
+    size_t dir_length = strlen(dir);
+    bool dir_has_slash = (dir_length > 0) && (dir[dir_length - 1] == '/');
+    size_t capacity = 0;
+    bool ok = true;
+    File file;
+    while (ok && (file = root.openNextFile())) {
+        if (file.isDirectory()) {
+            file.close();
+            continue;
+        }
+        const char* name = file.name();
+        const char* base_name = strrchr(name, '/');
+        base_name = (base_name != nullptr) ? base_name + 1 : name;
+        char path[STATIC_ASSET_MAX_PATH_LENGTH + GZIP_SUFFIX_LENGTH];
+        int path_length = snprintf(path, sizeof(path), "%s%s%s", dir, dir_has_slash ? "" : "/", base_name);
+        size_t file_size = file.size();
+        file.close();
+
+        bool gzip = endsWith(path, path_length, GZIP_SUFFIX, GZIP_SUFFIX_LENGTH);
+        if (gzip) {
+            path_length -= GZIP_SUFFIX_LENGTH;
+            path[path_length] = '\0';
+        }
+        if ((path_length <= 0) || (path_length >= STATIC_ASSET_MAX_PATH_LENGTH) || !filter(path)) {
+            continue;
+        }
+        StaticAsset* asset = addAsset(path, capacity);
+        if (asset == nullptr) {
+            ok = false;
+        } else if (gzip) {
+            asset->gzipSize = file_size;
+        } else {
+            asset->size = file_size;
+        }
+    }
+    root.close();
+    if (!ok) {
+        LOG_ERROR("ERROR - Could not allocate memory for the static asset index");
+        clear();
+        return false;
+    }
+    qsort(_assets, _count, sizeof(StaticAsset), compareAssets);
+
+    // hash each file, preferring the uncompressed copy so both ETags derive from it
+    for (size_t i = 0; i < _count; i++) {
+        StaticAsset& asset = _assets[i];
+        char path[STATIC_ASSET_MAX_PATH_LENGTH + GZIP_SUFFIX_LENGTH];
+        snprintf(path, sizeof(path), "%s%s", asset.path, (asset.size > 0) ? "" : GZIP_SUFFIX);
+        if (!hashFile(fs, path, asset.hash)) {
+            LOG_ERROR("ERROR - Could not read static asset %s", path);
+        }
+    }
+
+    // Hold the small files in memory, smallest first so the budget covers as many as it can.
+    // Both copies of a file are candidates, as which one is sent depends on the client.
+    size_t min_size = 1;
+    while (cache_bytes > 0) {
+        StaticAsset* next = nullptr;
+        bool next_gzip = false;
+        size_t next_size = SIZE_MAX;
+        for (size_t i = 0; i < _count; i++) {
+            StaticAsset& asset = _assets[i];
+            if ((asset.data == nullptr) && (asset.size >= min_size) && (asset.size < next_size)) {
+                next = &asset;
+                next_gzip = false;
+                next_size = asset.size;
+            }
+            if ((asset.gzipData == nullptr) && (asset.gzipSize >= min_size) && (asset.gzipSize < next_size)) {
+                next = &asset;
+                next_gzip = true;
+                next_size = asset.gzipSize;
+            }
+        }
+        if ((next == nullptr) || (next_size > max_cached_file_bytes) || (next_size > cache_bytes)) {
+            break;
+        }
+        char path[STATIC_ASSET_MAX_PATH_LENGTH + GZIP_SUFFIX_LENGTH];
+        snprintf(path, sizeof(path), "%s%s", next->path, next_gzip ? GZIP_SUFFIX : "");
+        uint8_t* data = cacheFile(fs, path, next_size, cache_bytes);
+        if (data == nullptr) {
+            break;
+        }
+        if (next_gzip) {
+            next->gzipData = data;
+        } else {
+            next->data = data;
+        }
+        min_size = next_size;
+    }
+
+    _built = true;
+    LOG_INFO("Indexed %u static assets, %u bytes held in memory", _count, _cachedBytes);
+    return true;
+}
+
+const StaticAsset* StaticAssetIndex::find(const char* path) const
+{
+    size_t low = 0;
+    size_t high = _count;
+    while (low < high) {
+        size_t mid = (low + high)/2;
+        int order = strcmp(path, _assets[mid].path);
+        if (order == 0) {
+            return &_assets[mid];
+        } else if (order < 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return nullptr;
+}
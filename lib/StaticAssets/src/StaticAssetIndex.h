@@ -0,0 +1,75 @@
+#ifndef __StaticAssetIndex__
+#define __StaticAssetIndex__
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+
+#define STATIC_ASSET_MAX_PATH_LENGTH    64
+
+//
+// A file served as is from the file system. gzipSize is non-zero if there is also a
+// pre-compressed copy of it at the same path plus ".gz". Either copy may be held in memory, in
+// which case data or gzipData points to it.
+//
+struct StaticAsset {
+    char        path[STATIC_ASSET_MAX_PATH_LENGTH];
+    const char* contentType;
+    uint32_t    hash;           // FNV-1a of the file's contents, for its ETag
+    uint32_t    size;           // 0 if only the compressed copy exists
+    uint32_t    gzipSize;
+    uint8_t*    data;
+    uint8_t*    gzipData;
+};
+
+// Returns true if the file at path should be indexed.
+typedef std::function<bool(const char* path)> StaticAssetFilter;
+
+//
+// StaticAssetIndex
+//
+// An index of the static files in a file system directory, built once at boot so that serving
+// a file needs no file system lookups. Each file's content type and ETag hash are worked out
+// while the index is built, and files up to a size limit are read into a fixed budget of
+// memory, in PSRAM where there is some, so the hot small assets are never read from flash
+// again. Files named *.gz are the compressed copies of the files they are named after.
+//
+// The index does not change after build(), so it may be read from any task.
+//
+class StaticAssetIndex {
+private:
+    StaticAsset*    _assets;
+    size_t          _count;
+    size_t          _cachedBytes;
+    bool            _built;
+
+    void clear(void);
+    StaticAsset* addAsset(const char* path, size_t& capacity);
+    bool hashFile(fs::FS& fs, const char* path, uint32_t& hash);
+    uint8_t* cacheFile(fs::FS& fs, const char* path, size_t size, size_t& cache_bytes);
+
+public:
+    StaticAssetIndex();
+    virtual ~StaticAssetIndex();
+
+    // Indexes the files in dir that filter accepts, replacing any earlier index. Files of up
+    // to max_cached_file_bytes are held in memory, smallest first, until cache_bytes are used.
+    // Returns false if the directory could not be read or memory could not be allocated.
+    bool build(fs::FS& fs, const char* dir, const StaticAssetFilter& filter, size_t cache_bytes, size_t max_cached_file_bytes);
+
+    // Returns the asset at path, or nullptr if there is none. Compressed copies are not
+    // indexed by their own path.
+    const StaticAsset* find(const char* path) const;
+
+    bool isBuilt(void) const                { return _built; }
+    size_t size(void) const                 { return _count; }
+    size_t cachedBytes(void) const          { return _cachedBytes; }
+
+    // Returns the content type for a file name, based on its extension.
+    static const char* contentType(const char* path);
+
+    // Writes the asset's quoted ETag into out, which must hold at least 14 bytes. The compressed
+    // copy has its own ETag, as the two are different representations of the file.
+    static void formatETag(const StaticAsset& asset, bool gzip, char* out);
+};
+
+#endif // __StaticAssetIndex__
@@ -0,0 +1,390 @@
+#if defined(ESP32)
+#include <Logger.h>
+#include "AsyncTelemetryClient.h"
+
+#define TELEMETRY_CLIENT_TIMEOUT_MICROS     (TELEMETRY_CLIENT_RESPONSE_TIMEOUT_SECONDS*1000000UL)
+
+AsyncTelemetryClient::AsyncTelemetryClient()
+    :   _port(80),
+        _available(false),
+        _client(),
+        _lock(xSemaphoreCreateRecursiveMutex()),
+        _connecting(false),
+        _connected(false),
+        _serverClosing(false),
+        _timedOut(false),
+        _connectStartMicros(0),
+        _streamWritten(0),
+        _streamAcked(0),
+        _head(0),
+        _writeIdx(0),
+        _tail(0),
+        _parser(),
+        _connectLatency(),
+        _sendLatency(),
+        _responseLatency(),
+        _connectionCount(0),
+        _requestCount(0),
+        _failureCount(0)
+{
+    _host[0] = '\0';
+    _path[0] = '\0';
+    for (size_t i = 0; i < TELEMETRY_CLIENT_MAX_REQUESTS; i++) {
+        _requests[i].data = nullptr;
+        _requests[i].capacity = 0;
+        _requests[i].length = 0;
+    }
+
+    _client.onConnect([](void* arg, AsyncClient* client) {
+        static_cast<AsyncTelemetryClient*>(arg)->handleConnect();
+    }, this);
+    _client.onDisconnect([](void* arg, AsyncClient* client) {
+        static_cast<AsyncTelemetryClient*>(arg)->handleDisconnect();
+    }, this);
+    _client.onError([](void* arg, AsyncClient* client, int8_t error) {
+        static_cast<AsyncTelemetryClient*>(arg)->handleError(error);
+    }, this);
+    _client.onAck([](void* arg, AsyncClient* client, size_t length, uint32_t time) {
+        static_cast<AsyncTelemetryClient*>(arg)->handleAck(length);
+    }, this);
+    _client.onData([](void* arg, AsyncClient* client, void* data, size_t length) {
+        static_cast<AsyncTelemetryClient*>(arg)->handleData((const uint8_t*)data, length);
+    }, this);
+    _client.onPoll([](void* arg, AsyncClient* client) {
+        static_cast<AsyncTelemetryClient*>(arg)->handlePoll();
+    }, this);
+    _client.setNoDelay(true);
+}
+
+AsyncTelemetryClient::~AsyncTelemetryClient()
+{
+    _client.close(true);
+    for (size_t i = 0; i < TELEMETRY_CLIENT_MAX_REQUESTS; i++) {
+        free(_requests[i].data);
+    }
+    vSemaphoreDelete(_lock);
+}
+
+bool AsyncTelemetryClient::begin(const char* url)
+{
+    _available = false;
+    if ((url == nullptr) || (strncmp(url, "http://", 7) != 0)) {
+        return false;
+    }
+
+    // http://host[:port][/path]
+    const char* host = url + 7;
+    size_t host_length = strcspn(host, ":/");
+    if ((host_length == 0) || (host_length >= sizeof(_host))) {
+        return false;
+    }
+    memcpy(_host, host, host_length);
+    _host[host_length] = '\0';
+
+    const char* rest = host + host_length;
+    _port = 80;
+    if (*rest == ':') {
+        char* end = nullptr;
+        unsigned long port = strtoul(rest + 1, &end, 10);
+        if ((end == rest + 1) || (port == 0) || (port > 65535)) {
+            return false;
+        }
+        _port = port;
+        rest = end;
+    }
+    if (*rest == '\0') {
+        rest = "/";
+    }
+    if ((*rest != '/') || (strlen(rest) >= sizeof(_path))) {
+        return false;
+    }
+    strcpy(_path, rest);
+
+    _available = true;
+    return true;
+}
+
+bool AsyncTelemetryClient::post(const char* payload, size_t length, TelemetryCallback callback)
+{
+    if (!_available) {
+        return false;
+    }
+    lock();
+    if ((_tail - _head) >= TELEMETRY_CLIENT_MAX_REQUESTS) {
+        unlock();
+        return false;
+    }
+
+    char head[TELEMETRY_CLIENT_MAX_HOST_LENGTH + TELEMETRY_CLIENT_MAX_PATH_LENGTH + 128];
+    int head_length = snprintf(
+        head, sizeof(head),
+        "POST %s HTTP/1.1\r\nHost: %s:%u\r\nContent-Type: application/json\r\nContent-Length: %u\r\nConnection: keep-alive\r\n\r\n",
+        _path, _host, _port, length
+    );
+
+    Request& req = request(_tail);
+    size_t total_length = head_length + length;
+    if (total_length > req.capacity) {
+        // request buffers are kept for reuse, and only replaced when a larger request comes along
+        free(req.data);
+        req.data = (char*)((ESP.getPsramSize() > 0) ? ps_malloc(total_length) : malloc(total_length));
+        req.capacity = (req.data != nullptr) ? total_length : 0;
+        if (req.data == nullptr) {
+            LOG_ERROR("ERROR - Could not allocate the telemetry request.");
+            unlock();
+            return false;
+        }
+    }
+    memcpy(req.data, head, head_length);
+    memcpy(req.data + head_length, payload, length);
+    req.length = total_length;
+    req.written = 0;
+    req.streamEnd = 0;
+    req.postedMicros = micros();
+    req.firstWriteMicros = 0;
+    req.lastWriteMicros = 0;
+    req.sendRecorded = false;
+    req.callback = callback;
+    _tail++;
+    _requestCount++;
+
+    if (_connected) {
+        if (!_serverClosing) {
+            writePending();
+        }
+    } else if (!_connecting) {
+        connect();
+    }
+    unlock();
+    return true;
+}
+
+void AsyncTelemetryClient::loop(void)
+{
+    lock();
+    if (_connecting && ((micros() - _connectStartMicros) > TELEMETRY_CLIENT_TIMEOUT_MICROS)) {
+        LOG_ERROR("ERROR - Timed out connecting to the telemetry service.");
+        _client.close(true);
+    } else if (!_connected && !_connecting && (_writeIdx != _tail)) {
+        connect();
+    }
+    unlock();
+}
+
+void AsyncTelemetryClient::connect(void)
+{
+    _connecting = true;
+    _serverClosing = false;
+    _timedOut = false;
+    _streamWritten = 0;
+    _streamAcked = 0;
+    _parser.reset();
+    _connectStartMicros = micros();
+    if (!_client.connect(_host, _port)) {
+        LOG_ERROR("ERROR - Could not start connecting to the telemetry service at %s:%u", _host, _port);
+        _connecting = false;
+        failRequests(_tail, TELEMETRY_ERROR_CONNECT_FAILED);
+    }
+}
+
+void AsyncTelemetryClient::writePending(void)
+{
+    while (_writeIdx != _tail) {
+        Request& req = request(_writeIdx);
+        size_t space = _client.space();
+        if (space == 0) {
+            break;
+        }
+        size_t count = req.length - req.written;
+        if (count > space) {
+            count = space;
+        }
+        if (req.written == 0) {
+            req.firstWriteMicros = micros();
+        }
+        size_t added = _client.add(req.data + req.written, count);
+        if (added == 0) {
+            break;
+        }
+        req.written += added;
+        _streamWritten += added;
+        if (req.written < req.length) {
+            // the rest is written as the connection acknowledges what was sent
+            break;
+        }
+        req.lastWriteMicros = micros();
+        req.streamEnd = _streamWritten;
+        _writeIdx++;
+    }
+    _client.send();
+}
+
+void AsyncTelemetryClient::recordSend(Request& req, uint32_t now)
+{
+    if (!req.sendRecorded) {
+        _sendLatency.record(now - req.firstWriteMicros);
+        req.sendRecorded = true;
+    }
+}
+
+// Finishes the oldest written request and calls its callback.
+void AsyncTelemetryClient::completeHead(int status_code, const char* body)
+{
+    Request& req = request(_head);
+    uint32_t now = micros();
+    if (status_code > 0) {
+        recordSend(req, now);
+        _responseLatency.record(now - req.lastWriteMicros);
+    }
+    if ((status_code < 200) || (status_code >= 300)) {
+        _failureCount++;
+    }
+
+    TelemetryResult result;
+    result.statusCode = status_code;
+    result.elapsedMicros = now - req.postedMicros;
+    result.responseBody = (body != nullptr) ? body : "";
+    TelemetryCallback callback = std::move(req.callback);
+    req.callback = nullptr;
+    req.length = 0;
+    _head++;
+
+    // the request is removed first so the callback may post another
+    if (callback) {
+        callback(result);
+    }
+}
+
+// Fails every request from the oldest up to, but not including, end_idx.
+void AsyncTelemetryClient::failRequests(uint32_t end_idx, int status_code)
+{
+    while (_head != end_idx) {
+        if (_writeIdx == _head) {
+            _writeIdx++;
+        }
+        completeHead(status_code, nullptr);
+    }
+}
+
+void AsyncTelemetryClient::handleConnect(void)
+{
+    lock();
+    _connecting = false;
+    _connected = true;
+    _connectionCount++;
+    _connectLatency.record(micros() - _connectStartMicros);
+    writePending();
+    unlock();
+}
+
+void AsyncTelemetryClient::handleDisconnect(void)
+{
+    lock();
+    bool was_connected = _connected;
+    bool was_connecting = _connecting;
+    _connecting = false;
+    _connected = false;
+
+    if (!was_connected && !was_connecting) {
+        unlock();
+        return;
+    }
+    if (!was_connected) {
+        // the connection was never made
+        failRequests(_tail, TELEMETRY_ERROR_CONNECT_FAILED);
+        unlock();
+        return;
+    }
+
+    // a response whose body runs until the connection closes is now complete
+    _parser.connectionClosed();
+    if (_parser.isComplete() && (_head != _writeIdx)) {
+        completeHead(_parser.statusCode(), _parser.body());
+    }
+    _parser.reset();
+
+    // a partially written request never reached the server, so it is sent again in full
+    if (_writeIdx != _tail) {
+        request(_writeIdx).written = 0;
+    }
+    if (_serverClosing) {
+        // The server announced the close, so it did not process the requests pipelined
+        // behind its last response. They are sent again on the next connection.
+        for (uint32_t idx = _head; idx != _writeIdx; idx++) {
+            request(idx).written = 0;
+        }
+        _writeIdx = _head;
+    } else {
+        failRequests(_writeIdx, _timedOut ? TELEMETRY_ERROR_TIMEOUT : TELEMETRY_ERROR_CONNECTION_LOST);
+    }
+    unlock();
+}
+
+void AsyncTelemetryClient::handleError(int8_t error)
+{
+    LOG_ERROR("ERROR - Telemetry connection error: %s", _client.errorToString(error));
+}
+
+void AsyncTelemetryClient::handleAck(size_t length)
+{
+    lock();
+    _streamAcked += length;
+    uint32_t now = micros();
+    for (uint32_t idx = _head; idx != _writeIdx; idx++) {
+        Request& req = request(idx);
+        if ((int32_t)(_streamAcked - req.streamEnd) >= 0) {
+            recordSend(req, now);
+        }
+    }
+    if (!_serverClosing) {
+        writePending();
+    }
+    unlock();
+}
+
+void AsyncTelemetryClient::handleData(const uint8_t* data, size_t length)
+{
+    lock();
+    while ((length > 0) && _connected) {
+        size_t used = _parser.parse(data, length);
+        data += used;
+        length -= used;
+
+        if (_parser.hasFailed() || (_parser.isStarted() && (_head == _writeIdx))) {
+            // garbage, or a response to a request that was never sent
+            LOG_ERROR("ERROR - Bad response from the telemetry service. Closing the connection.");
+            if (_head != _writeIdx) {
+                completeHead(TELEMETRY_ERROR_BAD_RESPONSE, nullptr);
+            }
+            _client.close(true);
+            break;
+        }
+        if (!_parser.isComplete()) {
+            continue;
+        }
+
+        bool keep_alive = _parser.keepAlive();
+        completeHead(_parser.statusCode(), _parser.body());
+        _parser.reset();
+        if (!keep_alive) {
+            _serverClosing = true;
+            _client.close(true);
+            break;
+        }
+    }
+    unlock();
+}
+
+void AsyncTelemetryClient::handlePoll(void)
+{
+    lock();
+    if (_connected && (_head != _writeIdx)
+            && ((micros() - request(_head).lastWriteMicros) > TELEMETRY_CLIENT_TIMEOUT_MICROS)) {
+        LOG_ERROR("ERROR - Timed out waiting for the telemetry service to respond.");
+        _timedOut = true;
+        _client.close(true);
+    }
+    unlock();
+}
+
+#endif // ESP32
@@ -0,0 +1,144 @@
+#ifndef __AsyncTelemetryClient__
+#define __AsyncTelemetryClient__
+#if defined(ESP32)
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <AsyncTCP.h>
+#include <LatencyHistogram.h>
+#include "HTTPResponseParser.h"
+
+// Number of requests that can be queued or awaiting a response at once.
+#ifndef TELEMETRY_CLIENT_MAX_REQUESTS
+#define TELEMETRY_CLIENT_MAX_REQUESTS   4
+#endif
+
+// Seconds to wait for a response to a sent request before giving up on the connection.
+#ifndef TELEMETRY_CLIENT_RESPONSE_TIMEOUT_SECONDS
+#define TELEMETRY_CLIENT_RESPONSE_TIMEOUT_SECONDS   15
+#endif
+
+#define TELEMETRY_CLIENT_MAX_HOST_LENGTH    64
+#define TELEMETRY_CLIENT_MAX_PATH_LENGTH    128
+
+// TelemetryResult status codes for requests that did not get an HTTP response
+#define TELEMETRY_ERROR_CONNECT_FAILED      -1
+#define TELEMETRY_ERROR_CONNECTION_LOST     -2
+#define TELEMETRY_ERROR_TIMEOUT             -3
+#define TELEMETRY_ERROR_BAD_RESPONSE        -4
+
+struct TelemetryResult {
+    int         statusCode;     // the HTTP status code, or one of the TELEMETRY_ERROR_* codes
+    uint32_t    elapsedMicros;  // from post() to completion
+    const char* responseBody;   // the start of the response body. Only valid during the callback.
+};
+
+typedef std::function<void(const TelemetryResult& result)> TelemetryCallback;
+
+//
+// AsyncTelemetryClient
+//
+// Posts telemetry payloads to an http:// URL without blocking the caller. One HTTP/1.1
+// keep-alive connection is held open and reused, and requests posted while earlier ones are
+// still outstanding are pipelined on it. Each request's callback is called when its response
+// arrives or the request fails. Callbacks run on the AsyncTCP task, so they should be brief.
+//
+// The connect time of each connection, the send time of each request (first byte written to
+// last byte acknowledged) and the response time (last byte written to response received) are
+// tracked in latency histograms.
+//
+// https:// URLs are not supported. begin() returns false for them so the caller can fall back
+// to a blocking client.
+//
+class AsyncTelemetryClient {
+private:
+    struct Request {
+        char*               data;           // request head and body
+        size_t              capacity;
+        size_t              length;
+        size_t              written;        // bytes of data handed to the connection
+        uint32_t            streamEnd;      // stream position of the request's last byte
+        uint32_t            postedMicros;
+        uint32_t            firstWriteMicros;
+        uint32_t            lastWriteMicros;
+        bool                sendRecorded;
+        TelemetryCallback   callback;
+    };
+
+    char                _host[TELEMETRY_CLIENT_MAX_HOST_LENGTH];
+    char                _path[TELEMETRY_CLIENT_MAX_PATH_LENGTH];
+    uint16_t            _port;
+    bool                _available;
+
+    AsyncClient         _client;
+    SemaphoreHandle_t   _lock;
+    bool                _connecting;
+    bool                _connected;
+    bool                _serverClosing;     // the server said it will close after the last response
+    bool                _timedOut;
+    uint32_t            _connectStartMicros;
+    uint32_t            _streamWritten;     // bytes written on this connection
+    uint32_t            _streamAcked;       // bytes acknowledged on this connection
+
+    // requests are a ring. [_head, _writeIdx) are written and awaiting responses, and
+    // [_writeIdx, _tail) are waiting to be written. The indexes only ever increase.
+    Request             _requests[TELEMETRY_CLIENT_MAX_REQUESTS];
+    uint32_t            _head;
+    uint32_t            _writeIdx;
+    uint32_t            _tail;
+    HTTPResponseParser  _parser;
+
+    LatencyHistogram    _connectLatency;
+    LatencyHistogram    _sendLatency;
+    LatencyHistogram    _responseLatency;
+    std::atomic<uint32_t> _connectionCount;     // read from other tasks
+    uint32_t            _requestCount;
+    uint32_t            _failureCount;
+
+    Request& request(uint32_t idx)          { return _requests[idx%TELEMETRY_CLIENT_MAX_REQUESTS]; }
+    void lock(void)                         { xSemaphoreTakeRecursive(_lock, portMAX_DELAY); }
+    void unlock(void)                       { xSemaphoreGiveRecursive(_lock); }
+
+    void connect(void);
+    void writePending(void);
+    void recordSend(Request& req, uint32_t now);
+    void completeHead(int status_code, const char* body);
+    void failRequests(uint32_t end_idx, int status_code);
+
+    void handleConnect(void);
+    void handleDisconnect(void);
+    void handleError(int8_t error);
+    void handleAck(size_t length);
+    void handleData(const uint8_t* data, size_t length);
+    void handlePoll(void);
+
+public:
+    AsyncTelemetryClient();
+    virtual ~AsyncTelemetryClient();
+
+    // Sets the URL to post to. Returns false if the URL is not a supported http:// URL.
+    bool begin(const char* url);
+    bool isAvailable(void) const            { return _available; }
+
+    // Reconnects if requests are waiting and there is no connection, and abandons connection
+    // attempts that take too long. Call this regularly.
+    void loop(void);
+
+    // Queues the payload to be posted. The payload is copied, so it may be reused as soon as
+    // this returns. Returns false if TELEMETRY_CLIENT_MAX_REQUESTS requests are outstanding.
+    bool post(const char* payload, size_t length, TelemetryCallback callback);
+
+    // number of requests queued or awaiting a response
+    size_t outstandingCount(void) const     { return _tail - _head; }
+    bool isConnected(void) const            { return _connected; }
+
+    const LatencyHistogram& connectLatency(void) const  { return _connectLatency; }
+    const LatencyHistogram& sendLatency(void) const     { return _sendLatency; }
+    const LatencyHistogram& responseLatency(void) const { return _responseLatency; }
+    uint32_t connectionCount(void) const    { return _connectionCount.load(std::memory_order_relaxed); }
+    uint32_t requestCount(void) const       { return _requestCount; }
+    uint32_t failureCount(void) const       { return _failureCount; }
+};
+
+#endif // ESP32
+#endif // __AsyncTelemetryClient__
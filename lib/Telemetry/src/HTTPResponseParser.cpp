@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "HTTPResponseParser.h"
+
+// case insensitive search for token in a header value
+static bool headerValueContains(const char* value, const char* token)
+{
+    size_t token_length = strlen(token);
+    for (const char* p = value; *p != '\0'; p++) {
+        if (strncasecmp(p, token, token_length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+HTTPResponseParser::HTTPResponseParser()
+{
+    reset();
+}
+
+void HTTPResponseParser::reset(void)
+{
+    _state = STATUS_LINE;
+    _lineLength = 0;
+    _statusCode = 0;
+    _http11 = false;
+    _keepAlive = false;
+    _chunked = false;
+    _hasContentLength = false;
+    _remaining = 0;
+    _body[0] = '\0';
+    _bodyLength = 0;
+    _totalBodyLength = 0;
+}
+
+// Adds a character to the current line. Returns true when the line is complete, at which
+// point the line is null terminated with the line ending removed.
+bool HTTPResponseParser::appendToLine(char c)
+{
+    if (c == '\n') {
+        if ((_lineLength > 0) && (_line[_lineLength - 1] == '\r')) {
+            _lineLength--;
+        }
+        _line[_lineLength] = '\0';
+        return true;
+    }
+    if (_lineLength < HTTP_RESPONSE_MAX_LINE_LENGTH - 1) {
+        _line[_lineLength++] = c;
+    }
+    return false;
+}
+
+void HTTPResponseParser::handleStatusLine(void)
+{
+    // HTTP/1.1 200 OK
+    if ((strncmp(_line, "HTTP/1.", 7) != 0) || (_lineLength < 12) || (_line[8] != ' ')) {
+        _state = FAILED;
+        return;
+    }
+    _http11 = (_line[7] != '0');
+    _keepAlive = _http11;
+    _statusCode = atoi(_line + 9);
+    _state = HEADERS;
+}
+
+void HTTPResponseParser::handleHeaderLine(void)
+{
+    char* colon = strchr(_line, ':');
+    if (colon == nullptr) {
+        return;
+    }
+    *colon = '\0';
+    const char* value = colon + 1;
+    while (*value == ' ' || *value == '\t') {
+        value++;
+    }
+
+    if (strcasecmp(_line, "Content-Length") == 0) {
+        _hasContentLength = true;
+        _remaining = strtoul(value, nullptr, 10);
+    } else if (strcasecmp(_line, "Transfer-Encoding") == 0) {
+        _chunked = (headerValueContains(value, "chunked"));
+    } else if (strcasecmp(_line, "Connection") == 0) {
+        if (headerValueContains(value, "close")) {
+            _keepAlive = false;
+        } else if (headerValueContains(value, "keep-alive")) {
+            _keepAlive = true;
+        }
+    }
+}
+
+void HTTPResponseParser::handleHeadersEnd(void)
+{
+    if ((_statusCode >= 100) && (_statusCode < 200)) {
+        // an interim response. The real one follows.
+        reset();
+        return;
+    }
+    if ((_statusCode == 204) || (_statusCode == 304)) {
+        _state = COMPLETE;
+    } else if (_chunked) {
+        _state = CHUNK_SIZE;
+    } else if (_hasContentLength) {
+        _state = (_remaining > 0) ? BODY : COMPLETE;
+    } else {
+        // the body runs until the server closes the connection
+        _keepAlive = false;
+        _state = BODY_UNTIL_CLOSE;
+    }
+}
+
+void HTTPResponseParser::handleChunkSizeLine(void)
+{
+    char* end = nullptr;
+    _remaining = strtoul(_line, &end, 16);
+    if (end == _line) {
+        _state = FAILED;
+        return;
+    }
+    _state = (_remaining > 0) ? CHUNK_DATA : TRAILERS;
+}
+
+void HTTPResponseParser::appendBody(const uint8_t* data, size_t count)
+{
+    size_t keep = HTTP_RESPONSE_MAX_BODY_LENGTH - _bodyLength;
+    if (keep > count) {
+        keep = count;
+    }
+    memcpy(_body + _bodyLength, data, keep);
+    _bodyLength += keep;
+    _body[_bodyLength] = '\0';
+    _totalBodyLength += count;
+}
+
+size_t HTTPResponseParser::parse(const uint8_t* data, size_t count)
+{
+    size_t i = 0;
+    while ((i < count) && (_state != COMPLETE) && (_state != FAILED)) {
+        switch (_state) {
+            case BODY:
+            case CHUNK_DATA: {
+                size_t n = count - i;
+                if (n > _remaining) {
+                    n = _remaining;
+                }
+                appendBody(data + i, n);
+                i += n;
+                _remaining -= n;
+                if (_remaining == 0) {
+                    _state = (_state == BODY) ? COMPLETE : CHUNK_DATA_END;
+                }
+                break;
+            }
+            case BODY_UNTIL_CLOSE:
+                appendBody(data + i, count - i);
+                i = count;
+                break;
+            default: {
+                char c = (char)data[i++];
+                if (!appendToLine(c)) {
+                    break;
+                }
+                switch (_state) {
+                    case STATUS_LINE:
+                        // tolerate blank lines between responses
+                        if (_lineLength > 0) {
+                            handleStatusLine();
+                        }
+                        break;
+                    case HEADERS:
+                        if (_lineLength == 0) {
+                            handleHeadersEnd();
+                        } else {
+                            handleHeaderLine();
+                        }
+                        break;
+                    case CHUNK_SIZE:
+                        handleChunkSizeLine();
+                        break;
+                    case CHUNK_DATA_END:
+                        // chunk data must be followed by an empty line
+                        _state = (_lineLength == 0) ? CHUNK_SIZE : FAILED;
+                        break;
+                    case TRAILERS:
+                        if (_lineLength == 0) {
+                            _state = COMPLETE;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                _lineLength = 0;
+                break;
+            }
+        }
+    }
+    return i;
+}
+
+void HTTPResponseParser::connectionClosed(void)
+{
+    if (_state == BODY_UNTIL_CLOSE) {
+        _state = COMPLETE;
+    } else if (_state != COMPLETE) {
+        _state = FAILED;
+    }
+}
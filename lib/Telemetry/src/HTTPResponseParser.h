@@ -0,0 +1,88 @@
+#ifndef __HTTPResponseParser__
+#define __HTTPResponseParser__
+#include <stdint.h>
+#include <stddef.h>
+
+// Longest status or header line that is examined. Longer lines are truncated, which only
+// matters for headers the parser does not care about.
+#define HTTP_RESPONSE_MAX_LINE_LENGTH   128
+
+// Number of bytes of each response body that are kept so they can be logged.
+#define HTTP_RESPONSE_MAX_BODY_LENGTH   64
+
+//
+// HTTPResponseParser
+//
+// Incremental parser for the HTTP/1.x responses on a keep-alive connection. Bytes are fed
+// to parse() as they arrive, in pieces of any size. When a response is complete, parse()
+// stops at the end of it so that the caller can handle the response, call reset() and
+// continue with the remaining bytes, which belong to the next pipelined response.
+//
+// Bodies delimited by Content-Length, chunked transfer encoding or the closing of the
+// connection are supported. 1xx interim responses are skipped.
+//
+class HTTPResponseParser {
+public:
+    typedef enum {
+        STATUS_LINE,
+        HEADERS,
+        BODY,
+        BODY_UNTIL_CLOSE,
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        TRAILERS,
+        COMPLETE,
+        FAILED
+    } State;
+
+private:
+    State       _state;
+    char        _line[HTTP_RESPONSE_MAX_LINE_LENGTH];
+    size_t      _lineLength;
+    int         _statusCode;
+    bool        _http11;
+    bool        _keepAlive;
+    bool        _chunked;
+    bool        _hasContentLength;
+    size_t      _remaining;         // body or chunk bytes still expected
+    char        _body[HTTP_RESPONSE_MAX_BODY_LENGTH + 1];
+    size_t      _bodyLength;        // bytes kept in _body
+    size_t      _totalBodyLength;   // bytes of body received
+
+    bool appendToLine(char c);
+    void handleStatusLine(void);
+    void handleHeaderLine(void);
+    void handleHeadersEnd(void);
+    void handleChunkSizeLine(void);
+    void appendBody(const uint8_t* data, size_t count);
+
+public:
+    HTTPResponseParser();
+
+    // Prepares the parser for the next response.
+    void reset(void);
+
+    // Consumes bytes of the response stream and returns how many were used. Fewer than count
+    // are used only if the response completes or the stream can not be parsed.
+    size_t parse(const uint8_t* data, size_t count);
+
+    // Tells the parser the connection closed. Completes a response whose body runs until the
+    // connection closes, and fails any other response in progress.
+    void connectionClosed(void);
+
+    State state(void) const                 { return _state; }
+    bool isComplete(void) const             { return _state == COMPLETE; }
+    bool hasFailed(void) const              { return _state == FAILED; }
+    // true once any part of a response has been received
+    bool isStarted(void) const              { return (_state != STATUS_LINE) || (_lineLength > 0); }
+
+    int statusCode(void) const              { return _statusCode; }
+    // whether the server will keep the connection open after this response
+    bool keepAlive(void) const              { return _keepAlive; }
+    // the start of the body, null terminated
+    const char* body(void) const            { return _body; }
+    size_t bodyLength(void) const           { return _totalBodyLength; }
+};
+
+#endif // __HTTPResponseParser__
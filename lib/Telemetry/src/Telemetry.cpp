@@ -0,0 +1,272 @@
+#include "Telemetry.h"
+
+void buildTelemetryJSON(const TelemetryRecord& record, const char* sensor_id, JsonDocument& doc)
+{
+    doc["timestamp"] = record.timestamp;
+    doc["sensor_id"] = sensor_id;
+    doc["uptime"] = record.uptime;
+    doc["mass_density"]["pm1p0"] = record.pm1p0;
+    doc["mass_density"]["pm2p5"] = record.pm2p5;
+    doc["mass_density"]["pm10"] = record.pm10;
+    doc["particle_count"]["0p5um"] = record.particleCount0p5um;
+    doc["particle_count"]["1p0um"] = record.particleCount1p0um;
+    doc["particle_count"]["2p5um"] = record.particleCount2p5um;
+    doc["particle_count"]["5p0um"] = record.particleCount5p0um;
+    doc["particle_count"]["7p5um"] = record.particleCount7p5um;
+    doc["particle_count"]["10um"] = record.particleCount10um;
+    doc["sensor_status"]["partical_detector"] = record.statusParticleDetector;
+    doc["sensor_status"]["laser"] = record.statusLaser;
+    doc["sensor_status"]["fan"] = record.statusFan;
+    doc["air_quality_index"]["average_pm2p5_current"] = record.averagePM2p5Current;
+    doc["air_quality_index"]["average_pm2p5_10min"] = record.averagePM2p5TenMinute;
+    doc["air_quality_index"]["average_pm2p5_1hour"] = record.averagePM2p5OneHour;
+    doc["air_quality_index"]["average_pm2p5_24hour"] = record.averagePM2p5OneDay;
+    doc["air_quality_index"]["aqi_current"] = record.aqiCurrent;
+    doc["air_quality_index"]["aqi_10min"] = record.aqiTenMinute;
+    doc["air_quality_index"]["aqi_1hour"] = record.aqiOneHour;
+    doc["air_quality_index"]["aqi_24hour"] = record.aqiOneDay;
+    static const char* SPREAD_WINDOWS[TELEMETRY_SPREAD_WINDOW_COUNT] = {"10min", "1hour", "24hour"};
+    for (uint8_t i = 0; i < TELEMETRY_SPREAD_WINDOW_COUNT; i++) {
+        doc["pm2p5_spread"][SPREAD_WINDOWS[i]]["min"] = record.pm2p5Spread[i].min;
+        doc["pm2p5_spread"][SPREAD_WINDOWS[i]]["max"] = record.pm2p5Spread[i].max;
+        doc["pm2p5_spread"][SPREAD_WINDOWS[i]]["p50"] = record.pm2p5Spread[i].p50;
+        doc["pm2p5_spread"][SPREAD_WINDOWS[i]]["p95"] = record.pm2p5Spread[i].p95;
+        doc["pm2p5_spread"][SPREAD_WINDOWS[i]]["p99"] = record.pm2p5Spread[i].p99;
+    }
+    doc["environment"]["temperature"] = record.temperature;
+    doc["environment"]["pressure"] = record.pressure;
+    doc["environment"]["humidity"] = record.humidity;
+    doc["environment"]["gas_resistance"] = record.gasResistance;
+}
+
+//
+// Fixed layout telemetry writer
+//
+
+enum TelemetryFieldType {
+    TELEMETRY_FIELD_SENSOR_ID,
+    TELEMETRY_FIELD_TIME,
+    TELEMETRY_FIELD_UINT32,
+    TELEMETRY_FIELD_UINT16,
+    TELEMETRY_FIELD_UINT8,
+    TELEMETRY_FIELD_FLOAT
+};
+
+// A field of the telemetry JSON. prefix is everything written between the previous value and
+// this one, including the field's key and the punctuation of any objects opened or closed.
+struct TelemetryField {
+    const char* prefix;
+    uint8_t     prefixLength;
+    uint8_t     type;
+    uint8_t     decimals;       // for floats
+    uint8_t     offset;         // of the value in TelemetryRecord
+};
+
+#define TELEMETRY_FIELD(prefix, type, decimals, member) \
+    {prefix, sizeof(prefix) - 1, type, decimals, offsetof(TelemetryRecord, member)}
+
+static const TelemetryField TELEMETRY_FIELDS[] = {
+    TELEMETRY_FIELD("{\"timestamp\":", TELEMETRY_FIELD_TIME, 0, timestamp),
+    TELEMETRY_FIELD(",\"sensor_id\":", TELEMETRY_FIELD_SENSOR_ID, 0, timestamp),
+    TELEMETRY_FIELD(",\"uptime\":", TELEMETRY_FIELD_UINT32, 0, uptime),
+    TELEMETRY_FIELD(",\"mass_density\":{\"pm1p0\":", TELEMETRY_FIELD_UINT32, 0, pm1p0),
+    TELEMETRY_FIELD(",\"pm2p5\":", TELEMETRY_FIELD_UINT32, 0, pm2p5),
+    TELEMETRY_FIELD(",\"pm10\":", TELEMETRY_FIELD_UINT32, 0, pm10),
+    TELEMETRY_FIELD("},\"particle_count\":{\"0p5um\":", TELEMETRY_FIELD_UINT16, 0, particleCount0p5um),
+    TELEMETRY_FIELD(",\"1p0um\":", TELEMETRY_FIELD_UINT16, 0, particleCount1p0um),
+    TELEMETRY_FIELD(",\"2p5um\":", TELEMETRY_FIELD_UINT16, 0, particleCount2p5um),
+    TELEMETRY_FIELD(",\"5p0um\":", TELEMETRY_FIELD_UINT16, 0, particleCount5p0um),
+    TELEMETRY_FIELD(",\"7p5um\":", TELEMETRY_FIELD_UINT16, 0, particleCount7p5um),
+    TELEMETRY_FIELD(",\"10um\":", TELEMETRY_FIELD_UINT16, 0, particleCount10um),
+    TELEMETRY_FIELD("},\"sensor_status\":{\"partical_detector\":", TELEMETRY_FIELD_UINT8, 0, statusParticleDetector),
+    TELEMETRY_FIELD(",\"laser\":", TELEMETRY_FIELD_UINT8, 0, statusLaser),
+    TELEMETRY_FIELD(",\"fan\":", TELEMETRY_FIELD_UINT8, 0, statusFan),
+    TELEMETRY_FIELD("},\"air_quality_index\":{\"average_pm2p5_current\":", TELEMETRY_FIELD_FLOAT, 2, averagePM2p5Current),
+    TELEMETRY_FIELD(",\"average_pm2p5_10min\":", TELEMETRY_FIELD_FLOAT, 2, averagePM2p5TenMinute),
+    TELEMETRY_FIELD(",\"average_pm2p5_1hour\":", TELEMETRY_FIELD_FLOAT, 2, averagePM2p5OneHour),
+    TELEMETRY_FIELD(",\"average_pm2p5_24hour\":", TELEMETRY_FIELD_FLOAT, 2, averagePM2p5OneDay),
+    TELEMETRY_FIELD(",\"aqi_current\":", TELEMETRY_FIELD_FLOAT, 2, aqiCurrent),
+    TELEMETRY_FIELD(",\"aqi_10min\":", TELEMETRY_FIELD_FLOAT, 2, aqiTenMinute),
+    TELEMETRY_FIELD(",\"aqi_1hour\":", TELEMETRY_FIELD_FLOAT, 2, aqiOneHour),
+    TELEMETRY_FIELD(",\"aqi_24hour\":", TELEMETRY_FIELD_FLOAT, 2, aqiOneDay),
+    TELEMETRY_FIELD("},\"pm2p5_spread\":{\"10min\":{\"min\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[0].min),
+    TELEMETRY_FIELD(",\"max\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[0].max),
+    TELEMETRY_FIELD(",\"p50\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[0].p50),
+    TELEMETRY_FIELD(",\"p95\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[0].p95),
+    TELEMETRY_FIELD(",\"p99\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[0].p99),
+    TELEMETRY_FIELD("},\"1hour\":{\"min\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[1].min),
+    TELEMETRY_FIELD(",\"max\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[1].max),
+    TELEMETRY_FIELD(",\"p50\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[1].p50),
+    TELEMETRY_FIELD(",\"p95\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[1].p95),
+    TELEMETRY_FIELD(",\"p99\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[1].p99),
+    TELEMETRY_FIELD("},\"24hour\":{\"min\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[2].min),
+    TELEMETRY_FIELD(",\"max\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[2].max),
+    TELEMETRY_FIELD(",\"p50\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[2].p50),
+    TELEMETRY_FIELD(",\"p95\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[2].p95),
+    TELEMETRY_FIELD(",\"p99\":", TELEMETRY_FIELD_UINT16, 0, pm2p5Spread[2].p99),
+    TELEMETRY_FIELD("}},\"environment\":{\"temperature\":", TELEMETRY_FIELD_FLOAT, 2, temperature),
+    TELEMETRY_FIELD(",\"pressure\":", TELEMETRY_FIELD_FLOAT, 2, pressure),
+    TELEMETRY_FIELD(",\"humidity\":", TELEMETRY_FIELD_FLOAT, 2, humidity),
+    TELEMETRY_FIELD(",\"gas_resistance\":", TELEMETRY_FIELD_FLOAT, 0, gasResistance),
+};
+static const char TELEMETRY_JSON_SUFFIX[] = "}}";
+
+static const size_t TELEMETRY_FIELD_COUNT = sizeof(TELEMETRY_FIELDS)/sizeof(TELEMETRY_FIELDS[0]);
+
+// longest value of each field type. Floats of 1e15 or more are written as null.
+static const uint8_t TELEMETRY_FIELD_MAX_LENGTH[] = {2, 20, 10, 5, 3, 24};
+
+// Floats are written as a scaled integer, so values must stay well inside int64_t.
+static const double TELEMETRY_FLOAT_LIMIT = 1e15;
+
+static size_t computeFixedMaxLength(void)
+{
+    size_t length = sizeof(TELEMETRY_JSON_SUFFIX) - 1;
+    for (size_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        length += TELEMETRY_FIELDS[i].prefixLength + TELEMETRY_FIELD_MAX_LENGTH[TELEMETRY_FIELDS[i].type];
+    }
+    return length;
+}
+
+const size_t TELEMETRY_JSON_FIXED_MAX_LENGTH = computeFixedMaxLength();
+
+// Appends to a caller provided buffer. Once something does not fit, nothing more is written
+// and the writer is marked as overflowed.
+class FixedBufferWriter {
+private:
+    char*   _buffer;
+    size_t  _capacity;
+    size_t  _length;
+    bool    _overflowed;
+
+public:
+    FixedBufferWriter(char* buffer, size_t capacity)
+        :   _buffer(buffer), _capacity(capacity), _length(0), _overflowed(false)
+    {}
+
+    size_t length(void) const       { return _overflowed ? 0 : _length; }
+
+    void write(const char* data, size_t length)
+    {
+        if (_overflowed || (length > _capacity - _length)) {
+            _overflowed = true;
+            return;
+        }
+        memcpy(_buffer + _length, data, length);
+        _length += length;
+    }
+
+    void write(char c)              { write(&c, 1); }
+
+    void writeUnsigned(uint64_t value)
+    {
+        char digits[20];
+        size_t count = 0;
+        do {
+            digits[sizeof(digits) - ++count] = '0' + value%10;
+            value /= 10;
+        } while (value > 0);
+        write(digits + sizeof(digits) - count, count);
+    }
+
+    void writeSigned(int64_t value)
+    {
+        if (value < 0) {
+            write('-');
+            writeUnsigned(-(uint64_t)value);
+        } else {
+            writeUnsigned(value);
+        }
+    }
+
+    // Writes the value rounded to the given decimals, without trailing zeros.
+    void writeFloat(float value, uint8_t decimals)
+    {
+        double scaled = value;
+        if ((scaled != scaled) || (scaled >= TELEMETRY_FLOAT_LIMIT) || (scaled <= -TELEMETRY_FLOAT_LIMIT)) {
+            write("null", 4);
+            return;
+        }
+        uint64_t scale = 1;
+        for (uint8_t i = 0; i < decimals; i++) {
+            scale *= 10;
+        }
+        bool negative = (scaled < 0);
+        uint64_t fixed = (uint64_t)((negative ? -scaled : scaled)*scale + 0.5);
+        uint64_t fraction = fixed%scale;
+        if (negative && (fixed > 0)) {
+            write('-');
+        }
+        writeUnsigned(fixed/scale);
+        if (fraction == 0) {
+            return;
+        }
+        while ((fraction%10) == 0) {
+            fraction /= 10;
+            decimals--;
+        }
+        char digits[20];
+        for (uint8_t i = decimals; i > 0; i--) {
+            digits[i - 1] = '0' + fraction%10;
+            fraction /= 10;
+        }
+        write('.');
+        write(digits, decimals);
+    }
+
+    void writeString(const char* value)
+    {
+        static const char HEX_DIGITS[] = "0123456789abcdef";
+        write('"');
+        for (const char* c = value; *c != '\0'; c++) {
+            if ((*c == '"') || (*c == '\\')) {
+                write('\\');
+                write(*c);
+            } else if ((uint8_t)*c < 0x20) {
+                char escape[6] = {'\\', 'u', '0', '0', HEX_DIGITS[(uint8_t)*c >> 4], HEX_DIGITS[*c & 0x0F]};
+                write(escape, sizeof(escape));
+            } else {
+                write(*c);
+            }
+        }
+        write('"');
+    }
+};
+
+size_t writeTelemetryJSON(const TelemetryRecord& record, const char* sensor_id, char* buffer, size_t capacity)
+{
+    FixedBufferWriter writer(buffer, capacity);
+    const uint8_t* base = (const uint8_t*)&record;
+
+    for (size_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        const TelemetryField& field = TELEMETRY_FIELDS[i];
+        const uint8_t* value = base + field.offset;
+        writer.write(field.prefix, field.prefixLength);
+        switch (field.type) {
+            case TELEMETRY_FIELD_SENSOR_ID:
+                if (sensor_id != nullptr) {
+                    writer.writeString(sensor_id);
+                } else {
+                    writer.write("null", 4);
+                }
+                break;
+            case TELEMETRY_FIELD_TIME:
+                writer.writeSigned(*(const time_t*)value);
+                break;
+            case TELEMETRY_FIELD_UINT32:
+                writer.writeUnsigned(*(const uint32_t*)value);
+                break;
+            case TELEMETRY_FIELD_UINT16:
+                writer.writeUnsigned(*(const uint16_t*)value);
+                break;
+            case TELEMETRY_FIELD_UINT8:
+                writer.writeUnsigned(*(const uint8_t*)value);
+                break;
+            case TELEMETRY_FIELD_FLOAT:
+                writer.writeFloat(*(const float*)value, field.decimals);
+                break;
+        }
+    }
+    writer.write(TELEMETRY_JSON_SUFFIX, sizeof(TELEMETRY_JSON_SUFFIX) - 1);
+    return writer.length();
+}
@@ -0,0 +1,71 @@
+#ifndef __Telemetry__
+#define __Telemetry__
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Capacity of the JSON document used for one telemetry record.
+#define TELEMETRY_JSON_CAPACITY     1536
+
+// Spread of the PM2.5 samples over one of the averaging windows, in ug/m^3.
+struct TelemetryPM2p5Spread {
+    uint16_t    min;
+    uint16_t    max;
+    uint16_t    p50;
+    uint16_t    p95;
+    uint16_t    p99;
+};
+
+// the windows the PM2.5 spread is reported for: 10 minutes, 1 hour and 24 hours
+#define TELEMETRY_SPREAD_WINDOW_COUNT   3
+
+//
+// One telemetry measurement as posted to the TELEMETRY_URL.
+//
+struct TelemetryRecord {
+    time_t      timestamp;
+    uint32_t    uptime;
+
+    uint32_t    pm1p0;
+    uint32_t    pm2p5;
+    uint32_t    pm10;
+    uint16_t    particleCount0p5um;
+    uint16_t    particleCount1p0um;
+    uint16_t    particleCount2p5um;
+    uint16_t    particleCount5p0um;
+    uint16_t    particleCount7p5um;
+    uint16_t    particleCount10um;
+    uint8_t     statusParticleDetector;
+    uint8_t     statusLaser;
+    uint8_t     statusFan;
+
+    float       averagePM2p5Current;
+    float       averagePM2p5TenMinute;
+    float       averagePM2p5OneHour;
+    float       averagePM2p5OneDay;
+    float       aqiCurrent;
+    float       aqiTenMinute;
+    float       aqiOneHour;
+    float       aqiOneDay;
+
+    TelemetryPM2p5Spread    pm2p5Spread[TELEMETRY_SPREAD_WINDOW_COUNT];
+
+    float       temperature;    // °C
+    float       pressure;       // hPa
+    float       humidity;       // %
+    float       gasResistance;  // ohms
+};
+
+// Fills doc with the JSON form of the telemetry record.
+void buildTelemetryJSON(const TelemetryRecord& record, const char* sensor_id, JsonDocument& doc);
+
+// Longest JSON that writeTelemetryJSON() can write for a record, not counting the sensor ID.
+extern const size_t TELEMETRY_JSON_FIXED_MAX_LENGTH;
+
+// Writes the same JSON object as buildTelemetryJSON() straight into buffer, in one pass and
+// without allocating memory. The field layout is a table fixed at compile time. Floats are
+// written to a fixed number of decimals for each field, and as null if they are not finite.
+// The output is not terminated. Returns the number of bytes written, or 0 if the JSON does
+// not fit in capacity.
+size_t writeTelemetryJSON(const TelemetryRecord& record, const char* sensor_id, char* buffer, size_t capacity);
+
+#endif // __Telemetry__
@@ -0,0 +1,101 @@
+#include <Logger.h>
+#include "TelemetryBatch.h"
+
+static void* allocateBuffer(size_t bytes)
+{
+    void* buffer = nullptr;
+    if (ESP.getPsramSize() > 0) {
+        buffer = ps_malloc(bytes);
+    }
+    if (buffer == nullptr) {
+        buffer = malloc(bytes);
+    }
+    return buffer;
+}
+
+TelemetryBatch::TelemetryBatch(size_t capacity, uint32_t max_age_seconds, uint16_t sample_interval, size_t sensor_id_length)
+    :   _records(nullptr),
+        _payload(nullptr),
+        _capacity(0),
+        _payloadCapacity(0),
+        _size(0),
+        _maxAgeSeconds(max_age_seconds),
+        _sampleInterval((sample_interval > 0) ? sample_interval : 1),
+        _offeredSinceLastAdd(_sampleInterval - 1),
+        _droppedCount(0)
+{
+    if (capacity == 0) {
+        return;
+    }
+    // The payload is a JSON array: brackets, the records and the commas between them, and a
+    // terminator. Every character of the sensor ID may be escaped as \u00XX, and it is quoted.
+    size_t record_length = TELEMETRY_JSON_FIXED_MAX_LENGTH + 6*sensor_id_length + 2;
+    size_t payload_capacity = capacity*(record_length + 1) + 3;
+    _records = (TelemetryRecord*)allocateBuffer(capacity*sizeof(TelemetryRecord));
+    _payload = (char*)allocateBuffer(payload_capacity);
+    if ((_records == nullptr) || (_payload == nullptr)) {
+        LOG_ERROR("ERROR - Could not allocate the telemetry batch buffers. Telemetry will not be sent.");
+        free(_records);
+        free(_payload);
+        _records = nullptr;
+        _payload = nullptr;
+        return;
+    }
+    _capacity = capacity;
+    _payloadCapacity = payload_capacity;
+}
+
+TelemetryBatch::~TelemetryBatch()
+{
+    free(_records);
+    free(_payload);
+}
+
+bool TelemetryBatch::offer(const TelemetryRecord& record)
+{
+    if (++_offeredSinceLastAdd < _sampleInterval) {
+        return false;
+    }
+    if (_size >= _capacity) {
+        _droppedCount++;
+        return false;
+    }
+    _records[_size++] = record;
+    _offeredSinceLastAdd = 0;
+    return true;
+}
+
+bool TelemetryBatch::isReady(time_t now) const
+{
+    if (_size == 0) {
+        return false;
+    }
+    return (_size >= _capacity) || ((now - _records[0].timestamp) >= (time_t)_maxAgeSeconds);
+}
+
+size_t TelemetryBatch::serialize(const char* sensor_id)
+{
+    if (_size == 0) {
+        return 0;
+    }
+
+    // the records are written straight into the payload buffer, leaving room for the
+    // closing bracket and the terminator
+    size_t limit = _payloadCapacity - 2;
+    size_t length = 0;
+    _payload[length++] = '[';
+    for (size_t i = 0; i < _size; i++) {
+        if ((i > 0) && (length < limit)) {
+            _payload[length++] = ',';
+        }
+        size_t record_length = writeTelemetryJSON(_records[i], sensor_id, _payload + length, limit - length);
+        if (record_length == 0) {
+            LOG_ERROR("ERROR - telemetry record %d does not fit in the batch payload.", i);
+            return 0;
+        }
+        length += record_length;
+    }
+    _payload[length++] = ']';
+    _payload[length] = '\0';
+    return length;
+}
@@ -0,0 +1,62 @@
+#ifndef __TelemetryBatch__
+#define __TelemetryBatch__
+#include <Arduino.h>
+#include "Telemetry.h"
+
+//
+// TelemetryBatch
+//
+// Collects telemetry records so they can be sent to the telemetry service in a single POST.
+// Every sample_interval-th offered record is added to the batch, and the batch is ready to
+// be sent once it is full or its oldest record is max_age_seconds old.
+//
+// The batch is serialized as a JSON array whose elements are the same JSON objects that
+// buildTelemetryJSON() produces, so the collector gets each record back exactly as if it
+// had been posted on its own. Serializing writes straight into the payload buffer with
+// writeTelemetryJSON() and does not allocate.
+//
+// The record and payload buffers are allocated once, in PSRAM when the board has it. The
+// payload buffer holds a full batch of the longest records writeTelemetryJSON() can write for
+// a sensor ID of up to sensor_id_length characters.
+//
+class TelemetryBatch {
+private:
+    TelemetryRecord*    _records;
+    char*               _payload;
+    size_t              _capacity;
+    size_t              _payloadCapacity;
+    size_t              _size;
+    uint32_t            _maxAgeSeconds;
+    uint16_t            _sampleInterval;
+    uint16_t            _offeredSinceLastAdd;
+    uint32_t            _droppedCount;
+
+public:
+    TelemetryBatch(size_t capacity, uint32_t max_age_seconds, uint16_t sample_interval, size_t sensor_id_length);
+    virtual ~TelemetryBatch();
+
+    // Offers a record to the batch. Returns true if it was added, or false if it was skipped
+    // due to the sample interval or dropped because the batch is full.
+    bool offer(const TelemetryRecord& record);
+
+    // Returns true if the batch should be sent now.
+    bool isReady(time_t now) const;
+
+    // Serializes the batch into the payload buffer and returns the payload length, or 0 if
+    // the batch is empty or could not be serialized.
+    size_t serialize(const char* sensor_id);
+    // The payload from the last serialize(). It remains valid until the next serialize().
+    const char* payload(void) const             { return _payload; }
+
+    // Removes all records from the batch, normally after it has been sent.
+    void clear(void)                            { _size = 0; }
+
+    size_t size(void) const                     { return _size; }
+    size_t capacity(void) const                 { return _capacity; }
+    uint16_t sampleInterval(void) const         { return _sampleInterval; }
+    uint32_t maxAgeSeconds(void) const          { return _maxAgeSeconds; }
+    uint32_t droppedCount(void) const           { return _droppedCount; }
+    const TelemetryRecord& record(size_t i) const   { return _records[i]; }
+};
+
+#endif // __TelemetryBatch__
@@ -0,0 +1,392 @@
+#include <Logger.h>
+#include "TelemetryStore.h"
+
+static uint16_t packUnsigned(float value, float scale)
+{
+    float scaled = value*scale + 0.5;
+    if (scaled <= 0) {
+        return 0;
+    }
+    return (scaled >= 65535) ? 65535 : (uint16_t)scaled;
+}
+
+static int16_t packSigned(float value, float scale)
+{
+    float scaled = value*scale;
+    scaled += (scaled < 0) ? -0.5 : 0.5;
+    if (scaled <= -32768) {
+        return -32768;
+    }
+    return (scaled >= 32767) ? 32767 : (int16_t)scaled;
+}
+
+static uint16_t clampToUInt16(uint32_t value)
+{
+    return (value > 65535) ? 65535 : value;
+}
+
+void packTelemetryRecord(const TelemetryRecord& record, uint32_t sequence, PackedTelemetryRecord& packed)
+{
+    packed.sequence = sequence;
+    packed.timestamp = record.timestamp;
+    packed.uptime = record.uptime;
+    packed.gasResistance = (record.gasResistance > 0) ? (uint32_t)(record.gasResistance + 0.5) : 0;
+    packed.pm1p0 = clampToUInt16(record.pm1p0);
+    packed.pm2p5 = clampToUInt16(record.pm2p5);
+    packed.pm10 = clampToUInt16(record.pm10);
+    packed.particleCount[0] = record.particleCount0p5um;
+    packed.particleCount[1] = record.particleCount1p0um;
+    packed.particleCount[2] = record.particleCount2p5um;
+    packed.particleCount[3] = record.particleCount5p0um;
+    packed.particleCount[4] = record.particleCount7p5um;
+    packed.particleCount[5] = record.particleCount10um;
+    packed.averagePM2p5[0] = packUnsigned(record.averagePM2p5Current, 10);
+    packed.averagePM2p5[1] = packUnsigned(record.averagePM2p5TenMinute, 10);
+    packed.averagePM2p5[2] = packUnsigned(record.averagePM2p5OneHour, 10);
+    packed.averagePM2p5[3] = packUnsigned(record.averagePM2p5OneDay, 10);
+    packed.aqi[0] = packUnsigned(record.aqiCurrent, 10);
+    packed.aqi[1] = packUnsigned(record.aqiTenMinute, 10);
+    packed.aqi[2] = packUnsigned(record.aqiOneHour, 10);
+    packed.aqi[3] = packUnsigned(record.aqiOneDay, 10);
+    for (uint8_t i = 0; i < TELEMETRY_SPREAD_WINDOW_COUNT; i++) {
+        packed.pm2p5Spread[i][0] = record.pm2p5Spread[i].min;
+        packed.pm2p5Spread[i][1] = record.pm2p5Spread[i].max;
+        packed.pm2p5Spread[i][2] = record.pm2p5Spread[i].p50;
+        packed.pm2p5Spread[i][3] = record.pm2p5Spread[i].p95;
+        packed.pm2p5Spread[i][4] = record.pm2p5Spread[i].p99;
+    }
+    packed.temperature = packSigned(record.temperature, 100);
+    packed.pressure = packSigned(record.pressure, 10);
+    packed.humidity = packSigned(record.humidity, 100);
+    packed.status = (record.statusParticleDetector & 0x03)
+                    | ((record.statusLaser & 0x03) << 2)
+                    | ((record.statusFan & 0x03) << 4);
+    packed.reserved = 0;
+}
+
+void unpackTelemetryRecord(const PackedTelemetryRecord& packed, TelemetryRecord& record)
+{
+    record.timestamp = packed.timestamp;
+    record.uptime = packed.uptime;
+    record.pm1p0 = packed.pm1p0;
+    record.pm2p5 = packed.pm2p5;
+    record.pm10 = packed.pm10;
+    record.particleCount0p5um = packed.particleCount[0];
+    record.particleCount1p0um = packed.particleCount[1];
+    record.particleCount2p5um = packed.particleCount[2];
+    record.particleCount5p0um = packed.particleCount[3];
+    record.particleCount7p5um = packed.particleCount[4];
+    record.particleCount10um = packed.particleCount[5];
+    record.statusParticleDetector = packed.status & 0x03;
+    record.statusLaser = (packed.status >> 2) & 0x03;
+    record.statusFan = (packed.status >> 4) & 0x03;
+    record.averagePM2p5Current = packed.averagePM2p5[0]/10.0;
+    record.averagePM2p5TenMinute = packed.averagePM2p5[1]/10.0;
+    record.averagePM2p5OneHour = packed.averagePM2p5[2]/10.0;
+    record.averagePM2p5OneDay = packed.averagePM2p5[3]/10.0;
+    record.aqiCurrent = packed.aqi[0]/10.0;
+    record.aqiTenMinute = packed.aqi[1]/10.0;
+    record.aqiOneHour = packed.aqi[2]/10.0;
+    record.aqiOneDay = packed.aqi[3]/10.0;
+    for (uint8_t i = 0; i < TELEMETRY_SPREAD_WINDOW_COUNT; i++) {
+        record.pm2p5Spread[i].min = packed.pm2p5Spread[i][0];
+        record.pm2p5Spread[i].max = packed.pm2p5Spread[i][1];
+        record.pm2p5Spread[i].p50 = packed.pm2p5Spread[i][2];
+        record.pm2p5Spread[i].p95 = packed.pm2p5Spread[i][3];
+        record.pm2p5Spread[i].p99 = packed.pm2p5Spread[i][4];
+    }
+    record.temperature = packed.temperature/100.0;
+    record.pressure = packed.pressure/10.0;
+    record.humidity = packed.humidity/100.0;
+    record.gasResistance = packed.gasResistance;
+}
+
+//
+// TelemetryStore
+//
+
+TelemetryStore::TelemetryStore(size_t psram_capacity, size_t ram_capacity)
+    :   _records(nullptr),
+        _capacity(0),
+        _size(0),
+        _headIdx(0),
+        _nextSequence(1),
+        _spillFS(nullptr),
+        _segmentCount(0),
+        _maxSegments(0),
+        _recordsPerSegment(0),
+        _spilledSize(0),
+        _storedCount(0),
+        _droppedCount(0),
+        _spilledCount(0),
+        _deliveredCount(0)
+{
+    _spillDir[0] = '\0';
+    if ((ESP.getPsramSize() > 0) && (psram_capacity > 0)) {
+        _records = (PackedTelemetryRecord*)ps_malloc(psram_capacity*sizeof(PackedTelemetryRecord));
+        if (_records != nullptr) {
+            _capacity = psram_capacity;
+        }
+    }
+    if ((_records == nullptr) && (ram_capacity > 0)) {
+        _records = (PackedTelemetryRecord*)malloc(ram_capacity*sizeof(PackedTelemetryRecord));
+        if (_records != nullptr) {
+            _capacity = ram_capacity;
+        }
+    }
+    if (_records == nullptr) {
+        LOG_ERROR("ERROR - Could not allocate the telemetry store. Unsent telemetry will be dropped.");
+    }
+}
+
+TelemetryStore::~TelemetryStore()
+{
+    free(_records);
+}
+
+void TelemetryStore::segmentPath(uint32_t first_sequence, char* path, size_t size) const
+{
+    // the extension is the record size, so that segments of another record format are not misread
+    snprintf(path, size, "%s/%08x.r%u", _spillDir, first_sequence, (unsigned)sizeof(PackedTelemetryRecord));
+}
+
+bool TelemetryStore::enableSpill(fs::FS& fs, const char* dir, uint8_t max_segments, uint16_t records_per_segment)
+{
+    if ((max_segments == 0) || (max_segments > TELEMETRY_STORE_MAX_SPILL_SEGMENTS)
+            || (records_per_segment == 0) || (records_per_segment > _capacity)
+            || (strlen(dir) >= sizeof(_spillDir))) {
+        LOG_ERROR("ERROR - Invalid telemetry spill configuration. Telemetry will not be spilled to flash.");
+        return false;
+    }
+    fs.mkdir(dir);
+    strcpy(_spillDir, dir);
+    _spillFS = &fs;
+    _maxSegments = max_segments;
+    _recordsPerSegment = records_per_segment;
+    recoverSpill();
+    return true;
+}
+
+// Picks up the spill segments left in the spill directory by a previous run.
+void TelemetryStore::recoverSpill(void)
+{
+    _segmentCount = 0;
+    _spilledSize = 0;
+
+    File dir = _spillFS->open(_spillDir);
+    if (!dir || !dir.isDirectory()) {
+        return;
+    }
+    File file = dir.openNextFile();
+    while (file) {
+        // some file systems report the full path and some the file name
+        const char* name = strrchr(file.name(), '/');
+        name = (name != nullptr) ? name + 1 : file.name();
+        char* end = nullptr;
+        uint32_t first_sequence = strtoul(name, &end, 16);
+        size_t record_bytes = 0;
+        if (end == name) {
+            // not a segment
+        } else if (strcmp(end, ".bin") == 0) {
+            record_bytes = TELEMETRY_STORE_LEGACY_RECORD_BYTES;
+        } else if ((end[0] == '.') && (end[1] == 'r')) {
+            char* size_end = nullptr;
+            record_bytes = strtoul(end + 2, &size_end, 10);
+            if ((size_end == end + 2) || (*size_end != 0)) {
+                record_bytes = 0;
+            }
+        }
+        char path[TELEMETRY_STORE_MAX_SPILL_DIR_LENGTH + 16];
+        snprintf(path, sizeof(path), "%s/%s", _spillDir, name);
+        size_t file_size = file.size();
+        uint32_t count = file_size/sizeof(PackedTelemetryRecord);
+        file.close();
+
+        if ((record_bytes > 0) && ((record_bytes != sizeof(PackedTelemetryRecord)) || (file_size%record_bytes != 0))) {
+            // left by firmware with another record format, or cut short
+            uint32_t dropped = file_size/record_bytes;
+            LOG_WARN("WARNING - Telemetry spill segment %s is not of %u byte records. Dropping its %u records.",
+                path, (unsigned)sizeof(PackedTelemetryRecord), dropped);
+            _spillFS->remove(path);
+            _droppedCount += dropped;
+        } else if ((record_bytes > 0) && (count > 0)) {
+            if (_segmentCount == _maxSegments) {
+                // keep the newest segments
+                removeOldestSegment(false);
+            }
+            // keep the segments ordered oldest first
+            uint8_t idx = _segmentCount;
+            while ((idx > 0) && ((int32_t)(first_sequence - _segments[idx - 1].firstSequence) < 0)) {
+                _segments[idx] = _segments[idx - 1];
+                idx--;
+            }
+            _segments[idx].firstSequence = first_sequence;
+            _segments[idx].count = count;
+            _segments[idx].readCount = 0;
+            _segmentCount++;
+            _spilledSize += count;
+        }
+        file = dir.openNextFile();
+    }
+    dir.close();
+
+    if (_segmentCount > 0) {
+        const SpillSegment& newest = _segments[_segmentCount - 1];
+        _nextSequence = newest.firstSequence + newest.count;
+        LOG_INFO("Recovered %u unsent telemetry records from %u spill segments", _spilledSize, _segmentCount);
+    }
+}
+
+// Moves the oldest block of records from the ring to a new spill segment. Returns false if
+// the segment could not be written.
+bool TelemetryStore::spillOldest(void)
+{
+    if (_segmentCount == _maxSegments) {
+        removeOldestSegment(false);
+    }
+
+    size_t count = (_size < _recordsPerSegment) ? _size : _recordsPerSegment;
+    uint32_t first_sequence = _records[_headIdx].sequence;
+    char path[TELEMETRY_STORE_MAX_SPILL_DIR_LENGTH + 16];
+    segmentPath(first_sequence, path, sizeof(path));
+
+    File file = _spillFS->open(path, FILE_WRITE);
+    if (!file) {
+        LOG_ERROR("ERROR - Could not create telemetry spill segment %s", path);
+        return false;
+    }
+    // the block may wrap around the end of the ring
+    size_t first_span = _capacity - _headIdx;
+    if (first_span > count) {
+        first_span = count;
+    }
+    size_t written = file.write((const uint8_t*)&_records[_headIdx], first_span*sizeof(PackedTelemetryRecord));
+    if (first_span < count) {
+        written += file.write((const uint8_t*)&_records[0], (count - first_span)*sizeof(PackedTelemetryRecord));
+    }
+    file.close();
+    if (written != count*sizeof(PackedTelemetryRecord)) {
+        LOG_ERROR("ERROR - Could not write telemetry spill segment %s", path);
+        _spillFS->remove(path);
+        return false;
+    }
+
+    SpillSegment& segment = _segments[_segmentCount++];
+    segment.firstSequence = first_sequence;
+    segment.count = count;
+    segment.readCount = 0;
+    _spilledSize += count;
+    _spilledCount += count;
+    _headIdx = (_headIdx + count)%_capacity;
+    _size -= count;
+    return true;
+}
+
+void TelemetryStore::removeOldestSegment(bool delivered)
+{
+    if (_segmentCount == 0) {
+        return;
+    }
+    SpillSegment& oldest = _segments[0];
+    uint32_t remaining = oldest.count - oldest.readCount;
+    if (delivered) {
+        _deliveredCount += remaining;
+    } else {
+        _droppedCount += remaining;
+    }
+    _spilledSize -= remaining;
+
+    char path[TELEMETRY_STORE_MAX_SPILL_DIR_LENGTH + 16];
+    segmentPath(oldest.firstSequence, path, sizeof(path));
+    _spillFS->remove(path);
+
+    _segmentCount--;
+    memmove(&_segments[0], &_segments[1], _segmentCount*sizeof(SpillSegment));
+}
+
+void TelemetryStore::push(const TelemetryRecord& record)
+{
+    if (_capacity == 0) {
+        _droppedCount++;
+        return;
+    }
+    if (_size == _capacity) {
+        if ((_spillFS == nullptr) || !spillOldest()) {
+            // drop the oldest record to make room
+            _headIdx = (_headIdx + 1)%_capacity;
+            _size--;
+            _droppedCount++;
+        }
+    }
+    packTelemetryRecord(record, _nextSequence++, _records[(_headIdx + _size)%_capacity]);
+    _size++;
+    _storedCount++;
+}
+
+size_t TelemetryStore::peek(TelemetryBatch& batch, uint32_t& last_sequence)
+{
+    size_t added = 0;
+    TelemetryRecord record;
+
+    // spilled records are the oldest
+    while ((_segmentCount > 0) && (batch.size() < batch.capacity())) {
+        SpillSegment& segment = _segments[0];
+        char path[TELEMETRY_STORE_MAX_SPILL_DIR_LENGTH + 16];
+        segmentPath(segment.firstSequence, path, sizeof(path));
+        File file = _spillFS->open(path, FILE_READ);
+        if (!file || !file.seek(segment.readCount*sizeof(PackedTelemetryRecord))) {
+            LOG_ERROR("ERROR - Could not read telemetry spill segment %s. Dropping it.", path);
+            removeOldestSegment(false);
+            continue;
+        }
+        for (uint32_t i = segment.readCount; (i < segment.count) && (batch.size() < batch.capacity()); i++) {
+            PackedTelemetryRecord packed;
+            if (file.read((uint8_t*)&packed, sizeof(packed)) != sizeof(packed)) {
+                break;
+            }
+            unpackTelemetryRecord(packed, record);
+            batch.offer(record);
+            last_sequence = packed.sequence;
+            added++;
+        }
+        file.close();
+        // a batch only ever holds records from one segment, so that reading ahead is never needed
+        return added;
+    }
+
+    for (size_t i = 0; (i < _size) && (batch.size() < batch.capacity()); i++) {
+        const PackedTelemetryRecord& packed = _records[(_headIdx + i)%_capacity];
+        unpackTelemetryRecord(packed, record);
+        batch.offer(record);
+        last_sequence = packed.sequence;
+        added++;
+    }
+    return added;
+}
+
+void TelemetryStore::acknowledge(uint32_t last_sequence)
+{
+    while (_segmentCount > 0) {
+        SpillSegment& segment = _segments[0];
+        uint32_t delivered = last_sequence - segment.firstSequence + 1;
+        if ((int32_t)(last_sequence - segment.firstSequence) < 0) {
+            return;
+        }
+        if (delivered >= segment.count) {
+            removeOldestSegment(true);
+            continue;
+        }
+        if (delivered > segment.readCount) {
+            _deliveredCount += delivered - segment.readCount;
+            _spilledSize -= delivered - segment.readCount;
+            segment.readCount = delivered;
+        }
+        return;
+    }
+
+    while ((_size > 0) && ((int32_t)(last_sequence - _records[_headIdx].sequence) >= 0)) {
+        _headIdx = (_headIdx + 1)%_capacity;
+        _size--;
+        _deliveredCount++;
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef __TelemetryStore__
+#define __TelemetryStore__
+#include <Arduino.h>
+#include <FS.h>
+#include "Telemetry.h"
+#include "TelemetryBatch.h"
+
+// Most spill segment files the store can track.
+#define TELEMETRY_STORE_MAX_SPILL_SEGMENTS      32
+#define TELEMETRY_STORE_MAX_SPILL_DIR_LENGTH    16
+// Size of the records in the .bin spill segments of firmware from before segment names carried
+// their record size.
+#define TELEMETRY_STORE_LEGACY_RECORD_BYTES     60
+
+//
+// Compact form of a TelemetryRecord that is kept while it waits to be sent. Averages and AQIs
+// are kept to 0.1, environment readings to 0.01 (0.1 hPa for pressure), which is the precision
+// they are meaningful to. Values out of range are clamped.
+//
+struct PackedTelemetryRecord {
+    uint32_t    sequence;
+    uint32_t    timestamp;
+    uint32_t    uptime;
+    uint32_t    gasResistance;
+    uint16_t    pm1p0;
+    uint16_t    pm2p5;
+    uint16_t    pm10;
+    uint16_t    particleCount[6];   // 0.5, 1.0, 2.5, 5.0, 7.5 and 10 um
+    uint16_t    averagePM2p5[4];    // current, 10 minute, 1 hour and 24 hour, in 0.1 ug/m^3
+    uint16_t    aqi[4];             // current, 10 minute, 1 hour and 24 hour, in 0.1
+    uint16_t    pm2p5Spread[TELEMETRY_SPREAD_WINDOW_COUNT][5];  // min, max, p50, p95 and p99 of each window
+    int16_t     temperature;        // 0.01 °C
+    int16_t     pressure;           // 0.1 hPa
+    int16_t     humidity;           // 0.01 %
+    uint8_t     status;             // particle detector, laser and fan status in 2 bits each
+    uint8_t     reserved;
+};
+
+void packTelemetryRecord(const TelemetryRecord& record, uint32_t sequence, PackedTelemetryRecord& packed);
+void unpackTelemetryRecord(const PackedTelemetryRecord& packed, TelemetryRecord& record);
+
+//
+// TelemetryStore
+//
+// A bounded FIFO of telemetry records waiting to be sent, such as those measured while the
+// network was down. Records are kept packed in a ring buffer, in PSRAM when the board has it.
+// Each record is given a sequence number, and records are removed once the sender
+// acknowledges that everything up to a sequence number has been delivered.
+//
+// When the ring is full, the oldest records are dropped, unless spilling is enabled. Then
+// the oldest records are moved in blocks to segment files on flash, and only when the spill
+// segments run out is the oldest segment dropped. Spilled records are sent before the ones
+// still in the ring, so records are always sent oldest first. Spill segments left from before
+// a restart are picked up by enableSpill(), unless they were written with another record
+// format, in which case they are deleted and their records counted as dropped. Records whose
+// delivery was not yet acknowledged when the device restarted may be sent twice.
+//
+// This class is not thread safe. It should be used from a single task.
+//
+class TelemetryStore {
+private:
+    struct SpillSegment {
+        uint32_t    firstSequence;
+        uint32_t    count;
+        uint32_t    readCount;      // records at the start of the segment already delivered
+    };
+
+    PackedTelemetryRecord*  _records;
+    size_t                  _capacity;
+    size_t                  _size;
+    size_t                  _headIdx;       // oldest record in the ring
+    uint32_t                _nextSequence;
+
+    fs::FS*                 _spillFS;
+    char                    _spillDir[TELEMETRY_STORE_MAX_SPILL_DIR_LENGTH];
+    SpillSegment            _segments[TELEMETRY_STORE_MAX_SPILL_SEGMENTS];
+    uint8_t                 _segmentCount;
+    uint8_t                 _maxSegments;
+    uint16_t                _recordsPerSegment;
+    uint32_t                _spilledSize;   // undelivered records in the spill segments
+
+    uint32_t                _storedCount;
+    uint32_t                _droppedCount;
+    uint32_t                _spilledCount;
+    uint32_t                _deliveredCount;
+
+    void segmentPath(uint32_t first_sequence, char* path, size_t size) const;
+    bool spillOldest(void);
+    void removeOldestSegment(bool delivered);
+    void recoverSpill(void);
+
+public:
+    TelemetryStore(size_t psram_capacity, size_t ram_capacity);
+    virtual ~TelemetryStore();
+
+    // Enables moving records that overflow the ring to files in the given directory. Up to
+    // max_segments files of records_per_segment records each are used. Returns false if
+    // spilling could not be enabled.
+    bool enableSpill(fs::FS& fs, const char* dir, uint8_t max_segments, uint16_t records_per_segment);
+    bool isSpillEnabled(void) const         { return _spillFS != nullptr; }
+
+    void push(const TelemetryRecord& record);
+
+    // Adds the oldest records to the batch until it is full or the store runs out, without
+    // removing them from the store. Returns the number of records added, and sets
+    // last_sequence to the sequence number of the last of them.
+    size_t peek(TelemetryBatch& batch, uint32_t& last_sequence);
+
+    // Removes every record up to and including last_sequence.
+    void acknowledge(uint32_t last_sequence);
+
+    // number of records waiting to be sent, including those spilled to flash
+    size_t size(void) const                 { return _size + _spilledSize; }
+    bool empty(void) const                  { return size() == 0; }
+    size_t capacity(void) const             { return _capacity; }
+    size_t spilledSize(void) const          { return _spilledSize; }
+
+    uint32_t storedCount(void) const        { return _storedCount; }
+    uint32_t droppedCount(void) const       { return _droppedCount; }
+    uint32_t spilledCount(void) const       { return _spilledCount; }
+    uint32_t deliveredCount(void) const     { return _deliveredCount; }
+};
+
+#endif // __TelemetryStore__
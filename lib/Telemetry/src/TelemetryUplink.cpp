@@ -0,0 +1,170 @@
+#include <Logger.h>
+#include <StageTimer.h>
+#include "TelemetryUplink.h"
+
+TelemetryUplink::TelemetryUplink(
+    const char* sensor_id,
+    TelemetryBatch& live,
+    TelemetryStore& store,
+    size_t drain_batch_size,
+    uint32_t drain_interval_millis,
+    uint32_t max_backoff_millis,
+    TelemetryPostFunction post
+)   :   _sensorId(sensor_id),
+        _live(live),
+        _store(store),
+        _drain(drain_batch_size, 0, 1, strlen(sensor_id)),
+        _post(post),
+        _liveInFlight(nullptr),
+        _liveInFlightCount(0),
+        _liveSending(false),
+        _drainSending(false),
+        _drainLastSequence(0),
+        _drainIntervalMillis(drain_interval_millis),
+        _maxBackoffMillis((max_backoff_millis > drain_interval_millis) ? max_backoff_millis : drain_interval_millis),
+        _backoffMillis(drain_interval_millis),
+        _lastDrainMillis(0),
+        _results(),
+        _requestCount(0),
+        _failureCount(0),
+        _liveFailureCount(0),
+        _drainedCount(0),
+        _discardedCount(0),
+        _serializeLatency()
+{
+    if (_live.capacity() > 0) {
+        _liveInFlight = (TelemetryRecord*)malloc(_live.capacity()*sizeof(TelemetryRecord));
+    }
+}
+
+TelemetryUplink::~TelemetryUplink()
+{
+    free(_liveInFlight);
+}
+
+bool TelemetryUplink::offer(const TelemetryRecord& record, bool connected)
+{
+    _live.offer(record);
+    if (!_live.isReady(record.timestamp)) {
+        return false;
+    }
+    sendLive(connected);
+    return true;
+}
+
+void TelemetryUplink::sendLive(bool connected)
+{
+    // Only one live batch is in flight at a time, so that its records can be kept for the
+    // store. The next batch is stored if the last one has not finished.
+    if (!connected || _liveSending || (_liveInFlight == nullptr)) {
+        storeLive(&_live.record(0), _live.size());
+        _live.clear();
+        return;
+    }
+
+    uint32_t serialize_start = stageTimerStart();
+    size_t length = _live.serialize(_sensorId);
+    _serializeLatency.record(stageTimerElapsedMicros(serialize_start));
+    _liveInFlightCount = _live.size();
+    memcpy(_liveInFlight, &_live.record(0), _liveInFlightCount*sizeof(TelemetryRecord));
+    _live.clear();
+    if (length == 0) {
+        // the batch did not fit in its payload, so keep its records for the drain
+        storeLive(_liveInFlight, _liveInFlightCount);
+        return;
+    }
+    _liveSending = true;
+    if (!_post(_live.payload(), length, TELEMETRY_UPLINK_LIVE)) {
+        _liveSending = false;
+        storeLive(_liveInFlight, _liveInFlightCount);
+    }
+}
+
+void TelemetryUplink::storeLive(const TelemetryRecord* records, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        _store.push(records[i]);
+    }
+}
+
+void TelemetryUplink::sendDrain(uint32_t now_millis)
+{
+    _drain.clear();
+    size_t count = _store.peek(_drain, _drainLastSequence);
+    size_t length = 0;
+    if (count > 0) {
+        uint32_t serialize_start = stageTimerStart();
+        length = _drain.serialize(_sensorId);
+        _serializeLatency.record(stageTimerElapsedMicros(serialize_start));
+    }
+    _lastDrainMillis = now_millis;
+    if ((count > 0) && (length == 0)) {
+        // these records will never fit, so drop them rather than block the store behind them
+        LOG_ERROR("ERROR - Discarding %d stored telemetry records that could not be serialized.", count);
+        _store.acknowledge(_drainLastSequence);
+        _discardedCount += count;
+        _drain.clear();
+        return;
+    }
+    if (length == 0) {
+        return;
+    }
+    _drainSending = true;
+    if (!_post(_drain.payload(), length, TELEMETRY_UPLINK_DRAIN)) {
+        // the client is busy, which is backpressure rather than failure. Try again next interval.
+        _drainSending = false;
+    }
+}
+
+void TelemetryUplink::handleResult(const Result& result, uint32_t now_millis)
+{
+    _requestCount++;
+    if (!result.success) {
+        _failureCount++;
+    }
+    if (result.kind == TELEMETRY_UPLINK_LIVE) {
+        _liveSending = false;
+        if (!result.success) {
+            _liveFailureCount++;
+            storeLive(_liveInFlight, _liveInFlightCount);
+            // the network is likely unhealthy, so hold off on draining
+            _lastDrainMillis = now_millis;
+        }
+        _liveInFlightCount = 0;
+        return;
+    }
+
+    _drainSending = false;
+    _lastDrainMillis = now_millis;
+    if (result.success) {
+        _store.acknowledge(_drainLastSequence);
+        _drainedCount += _drain.size();
+        _backoffMillis = _drainIntervalMillis;
+    } else {
+        _backoffMillis = (_backoffMillis > _maxBackoffMillis/2) ? _maxBackoffMillis : 2*_backoffMillis;
+    }
+    _drain.clear();
+}
+
+void TelemetryUplink::loop(uint32_t now_millis, bool connected)
+{
+    Result result;
+    while (_results.pop(result)) {
+        handleResult(result, now_millis);
+    }
+
+    if (!connected || _store.empty() || _liveSending || _drainSending) {
+        return;
+    }
+    if ((now_millis - _lastDrainMillis) >= _backoffMillis) {
+        sendDrain(now_millis);
+    }
+}
+
+void TelemetryUplink::reportResult(uint8_t kind, bool success)
+{
+    Result result = {kind, success};
+    if (!_results.push(result)) {
+        LOG_ERROR("ERROR - Telemetry uplink result queue is full.");
+    }
+}
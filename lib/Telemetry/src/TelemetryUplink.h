@@ -0,0 +1,112 @@
+#ifndef __TelemetryUplink__
+#define __TelemetryUplink__
+#include <Arduino.h>
+#include <functional>
+#include <SPSCQueue.h>
+#include <LatencyHistogram.h>
+#include "Telemetry.h"
+#include "TelemetryBatch.h"
+#include "TelemetryStore.h"
+
+// the kinds of payload the uplink posts
+#define TELEMETRY_UPLINK_LIVE   0
+#define TELEMETRY_UPLINK_DRAIN  1
+
+// Posts a payload of the given kind. The payload only needs to remain valid during the call.
+// Returns false if the payload could not be queued, and otherwise the outcome must be passed to
+// TelemetryUplink::reportResult() once it is known.
+typedef std::function<bool(const char* payload, size_t length, uint8_t kind)> TelemetryPostFunction;
+
+//
+// TelemetryUplink
+//
+// Sends telemetry without losing it to network outages. Records are collected into the live
+// batch and sent as it fills. A batch that can not be sent, because the network is down or
+// its post failed, goes into the store instead, and the stored records are drained, oldest
+// first, once the network is back.
+//
+// Live batches always go first. The drain sends one batch of stored records at a time, and
+// only while no live batch is in flight, at most once every drain_interval_millis. A failed
+// drain backs off exponentially up to max_backoff_millis, so an unreachable server is not
+// hammered. Records that fail while live are stored behind any records already waiting, so
+// during recovery the order records are sent in can differ from the order they were measured.
+//
+// Everything but reportResult() must be called from one task. reportResult() may be called
+// from the task that completes the posts.
+//
+class TelemetryUplink {
+private:
+    struct Result {
+        uint8_t     kind;
+        bool        success;
+    };
+
+    const char*         _sensorId;
+    TelemetryBatch&     _live;
+    TelemetryStore&     _store;
+    TelemetryBatch      _drain;
+    TelemetryPostFunction _post;
+
+    // copies of the records in the live batch that is in flight, to store if it fails
+    TelemetryRecord*    _liveInFlight;
+    size_t              _liveInFlightCount;
+    bool                _liveSending;
+    bool                _drainSending;
+    uint32_t            _drainLastSequence;
+
+    uint32_t            _drainIntervalMillis;
+    uint32_t            _maxBackoffMillis;
+    uint32_t            _backoffMillis;
+    uint32_t            _lastDrainMillis;
+
+    SPSCQueue<Result, 8> _results;
+    uint32_t            _requestCount;
+    uint32_t            _failureCount;
+    uint32_t            _liveFailureCount;
+    uint32_t            _drainedCount;
+    uint32_t            _discardedCount;
+    LatencyHistogram    _serializeLatency;
+
+    void sendLive(bool connected);
+    void storeLive(const TelemetryRecord* records, size_t count);
+    void sendDrain(uint32_t now_millis);
+    void handleResult(const Result& result, uint32_t now_millis);
+
+public:
+    TelemetryUplink(
+        const char* sensor_id,
+        TelemetryBatch& live,
+        TelemetryStore& store,
+        size_t drain_batch_size,
+        uint32_t drain_interval_millis,
+        uint32_t max_backoff_millis,
+        TelemetryPostFunction post
+    );
+    virtual ~TelemetryUplink();
+
+    // Adds a record to the live batch, and sends or stores the batch if it is ready.
+    // Returns true if a batch was sent or stored.
+    bool offer(const TelemetryRecord& record, bool connected);
+
+    // Handles the outcomes of finished posts and drains the store. Call this regularly.
+    void loop(uint32_t now_millis, bool connected);
+
+    // Reports the outcome of a post accepted by the post function.
+    void reportResult(uint8_t kind, bool success);
+
+    bool isDraining(void) const             { return _drainSending; }
+    // true while a live or drain post is in flight
+    bool isSending(void) const              { return _liveSending || _drainSending; }
+    uint32_t backoffMillis(void) const      { return _backoffMillis; }
+    // posts whose outcome has been handled by loop(), and how many of them failed
+    uint32_t requestCount(void) const       { return _requestCount; }
+    uint32_t failureCount(void) const       { return _failureCount; }
+    uint32_t liveFailureCount(void) const   { return _liveFailureCount; }
+    uint32_t drainedCount(void) const       { return _drainedCount; }
+    // stored records dropped because they could not be serialized
+    uint32_t discardedCount(void) const     { return _discardedCount; }
+    // time taken to serialize each batch, live or drained, to JSON
+    const LatencyHistogram& serializeLatency(void) const    { return _serializeLatency; }
+};
+
+#endif // __TelemetryUplink__
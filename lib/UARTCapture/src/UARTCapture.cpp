@@ -0,0 +1,164 @@
+#include <Logger.h>
+#include "UARTCapture.h"
+
+UARTCapture::UARTCapture()
+    :   _fs(nullptr),
+        _baudRate(0),
+        _maxBytes(0),
+        _file(),
+        _stopMillis(0),
+        _fileBytes(0),
+        _captureCount(0),
+        _writeFailureCount(0),
+        _recording(false),
+        _request(REQUEST_NONE),
+        _requestSeconds(0),
+        _capturedByteCount(0),
+        _droppedByteCount(0),
+        _queue()
+{
+    _path[0] = 0;
+    _sensorName[0] = 0;
+}
+
+bool UARTCapture::begin(fs::FS& fs, const char* path, const char* sensor_name, uint32_t baud_rate, uint32_t max_bytes)
+{
+    if (strlen(path) >= sizeof(_path)) {
+        LOG_ERROR("ERROR - UART capture path %s is too long", path);
+        return false;
+    }
+    strcpy(_path, path);
+    strncpy(_sensorName, sensor_name, sizeof(_sensorName) - 1);
+    _sensorName[sizeof(_sensorName) - 1] = 0;
+    _baudRate = baud_rate;
+    _maxBytes = max_bytes;
+    _fs = &fs;
+    return true;
+}
+
+void UARTCapture::requestStart(uint32_t seconds)
+{
+    _requestSeconds.store(seconds, std::memory_order_relaxed);
+    _request.store(REQUEST_START, std::memory_order_release);
+}
+
+void UARTCapture::requestStop(void)
+{
+    _request.store(REQUEST_STOP, std::memory_order_release);
+}
+
+void UARTCapture::record(const uint8_t* bytes, size_t count, uint32_t receive_millis)
+{
+    if (!_recording.load(std::memory_order_acquire)) {
+        return;
+    }
+    while (count > 0) {
+        Chunk chunk;
+        chunk.receiveMillis = receive_millis;
+        chunk.length = (count < UART_CAPTURE_CHUNK_BYTES) ? count : UART_CAPTURE_CHUNK_BYTES;
+        memcpy(chunk.bytes, bytes, chunk.length);
+        if (_queue.push(chunk)) {
+            _capturedByteCount += chunk.length;
+        } else {
+            _droppedByteCount += chunk.length;
+        }
+        bytes += chunk.length;
+        count -= chunk.length;
+    }
+}
+
+void UARTCapture::poll(uint32_t now_millis)
+{
+    uint8_t request = _request.exchange(REQUEST_NONE, std::memory_order_acquire);
+    if ((request == REQUEST_START) && !isRecording()) {
+        start(now_millis, _requestSeconds.load(std::memory_order_relaxed));
+    } else if ((request == REQUEST_STOP) && isRecording()) {
+        stop("it was asked to stop");
+    }
+    if (!isRecording()) {
+        return;
+    }
+
+    Chunk chunk;
+    while (_queue.pop(chunk)) {
+        if (_fileBytes + sizeof(UARTCaptureChunkHeader) + chunk.length > _maxBytes) {
+            stop("the file is full");
+            return;
+        }
+        if (!writeChunk(chunk)) {
+            _writeFailureCount++;
+            LOG_ERROR("ERROR - Could not write to UART capture %s", _path);
+            stop("of a write failure");
+            return;
+        }
+    }
+    if ((int32_t)(now_millis - _stopMillis) >= 0) {
+        stop("its time is up");
+    }
+}
+
+bool UARTCapture::start(uint32_t now_millis, uint32_t seconds)
+{
+    if (_fs == nullptr) {
+        return false;
+    }
+    // chunks recorded as the previous capture was stopping are not part of this one
+    Chunk stale;
+    while (_queue.pop(stale)) {
+    }
+
+    _file = _fs->open(_path, FILE_WRITE);
+    if (!_file) {
+        LOG_ERROR("ERROR - Could not create UART capture %s", _path);
+        _writeFailureCount++;
+        return false;
+    }
+    UARTCaptureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = UART_CAPTURE_MAGIC;
+    header.version = UART_CAPTURE_VERSION;
+    header.headerBytes = sizeof(header);
+    header.baudRate = _baudRate;
+    header.startMillis = now_millis;
+    strcpy(header.sensorName, _sensorName);
+    if (_file.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+        LOG_ERROR("ERROR - Could not write to UART capture %s", _path);
+        _writeFailureCount++;
+        _file.close();
+        return false;
+    }
+    _fileBytes = sizeof(header);
+    _stopMillis = now_millis + seconds*1000;
+    _captureCount++;
+    _recording.store(true, std::memory_order_release);
+    LOG_INFO("Capturing the %s UART stream to %s for %u seconds", _sensorName, _path, seconds);
+    return true;
+}
+
+void UARTCapture::stop(const char* reason)
+{
+    _recording.store(false, std::memory_order_release);
+    // write what was recorded before the producer saw the capture stop
+    Chunk chunk;
+    while (_queue.pop(chunk)) {
+        if ((_fileBytes + sizeof(UARTCaptureChunkHeader) + chunk.length > _maxBytes) || !writeChunk(chunk)) {
+            break;
+        }
+    }
+    _file.close();
+    LOG_INFO("Stopped the UART capture because %s. It is %u bytes, and %u bytes have been dropped.", reason, _fileBytes, _droppedByteCount);
+}
+
+bool UARTCapture::writeChunk(const Chunk& chunk)
+{
+    UARTCaptureChunkHeader header;
+    header.receiveMillis = chunk.receiveMillis;
+    header.length = chunk.length;
+    header.reserved = 0;
+    if ((_file.write((const uint8_t*)&header, sizeof(header)) != sizeof(header))
+            || (_file.write(chunk.bytes, chunk.length) != chunk.length)) {
+        return false;
+    }
+    _fileBytes += sizeof(header) + chunk.length;
+    return true;
+}
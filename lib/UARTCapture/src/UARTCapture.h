@@ -0,0 +1,110 @@
+#ifndef __UARTCapture__
+#define __UARTCapture__
+#include <Arduino.h>
+#include <FS.h>
+#include <atomic>
+#include <SPSCQueue.h>
+#include "UARTCaptureReader.h"
+
+// Received bytes are handed to the writer in chunks of up to this many bytes. A 100 ms poll of
+// a sensor sending at 9600 baud drains at most 96 bytes.
+#ifndef UART_CAPTURE_CHUNK_BYTES
+#define UART_CAPTURE_CHUNK_BYTES        60
+#endif
+
+// number of chunks that can be waiting between the acquisition task and the writer
+#ifndef UART_CAPTURE_QUEUE_CHUNKS
+#define UART_CAPTURE_QUEUE_CHUNKS       32
+#endif
+
+#define UART_CAPTURE_MAX_PATH_LENGTH    32
+
+//
+// UARTCapture
+//
+// Records the raw byte stream a sensor sends on its UART, with the time each poll drained it,
+// to a capture file on flash, so that what the device received in the field can be replayed
+// through the frame decoder and the averages on the host (see CaptureReplay.h).
+//
+// record() is called by the acquisition task with the bytes of each poll, and only copies them
+// into a lock-free queue. poll() is called from the main loop, and writes the queued chunks to
+// the file, so flash writes never hold up the acquisition task. Bytes that find the queue full
+// are dropped and counted; a capture with dropped bytes will show corrupt frames the device
+// did not see.
+//
+// Captures are started and stopped with requestStart() and requestStop(), which can be called
+// from any task, such as a web handler, and are acted on by the next poll(). A capture stops
+// by itself after its duration, or once the file reaches the maximum size. Each capture
+// replaces the previous one.
+//
+class UARTCapture {
+private:
+    struct Chunk {
+        uint32_t    receiveMillis;
+        uint8_t     length;
+        uint8_t     bytes[UART_CAPTURE_CHUNK_BYTES];
+    };
+
+    enum Request : uint8_t {
+        REQUEST_NONE,
+        REQUEST_START,
+        REQUEST_STOP
+    };
+
+    fs::FS*         _fs;
+    char            _path[UART_CAPTURE_MAX_PATH_LENGTH];
+    char            _sensorName[UART_CAPTURE_SENSOR_NAME_LENGTH];
+    uint32_t        _baudRate;
+    uint32_t        _maxBytes;
+    File            _file;
+    uint32_t        _stopMillis;
+    uint32_t        _fileBytes;
+    uint32_t        _captureCount;
+    uint32_t        _writeFailureCount;
+
+    std::atomic<bool>       _recording;
+    std::atomic<uint8_t>    _request;
+    std::atomic<uint32_t>   _requestSeconds;
+
+    // producer side. Only touched by the task calling record().
+    uint32_t        _capturedByteCount;
+    uint32_t        _droppedByteCount;
+
+    SPSCQueue<Chunk, UART_CAPTURE_QUEUE_CHUNKS> _queue;
+
+    bool start(uint32_t now_millis, uint32_t seconds);
+    void stop(const char* reason);
+    bool writeChunk(const Chunk& chunk);
+
+public:
+    UARTCapture();
+
+    // Sets the file captures are written to, at most max_bytes long, and the sensor they are
+    // of, as its driver's name() and baud rate. Returns false if the path is too long.
+    bool begin(fs::FS& fs, const char* path, const char* sensor_name, uint32_t baud_rate, uint32_t max_bytes);
+    bool isEnabled(void) const              { return _fs != nullptr; }
+
+    // Asks for a capture of the next seconds to be started, or the one in progress to be
+    // stopped. Can be called from any task.
+    void requestStart(uint32_t seconds);
+    void requestStop(void);
+
+    // Producer only. Queues the bytes received by one poll of the UART if a capture is in progress.
+    void record(const uint8_t* bytes, size_t count, uint32_t receive_millis);
+
+    // Consumer only. Starts or stops a capture as requested, and writes the queued bytes to
+    // the capture file.
+    void poll(uint32_t now_millis);
+
+    bool isRecording(void) const            { return _recording.load(std::memory_order_relaxed); }
+    const char* path(void) const            { return _path; }
+
+    // size of the capture file being written, or of the last one written
+    uint32_t fileBytes(void) const          { return _fileBytes; }
+    uint32_t captureCount(void) const       { return _captureCount; }
+    uint32_t writeFailureCount(void) const  { return _writeFailureCount; }
+    uint32_t capturedByteCount(void) const  { return _capturedByteCount; }
+    uint32_t droppedByteCount(void) const   { return _droppedByteCount; }
+};
+
+#endif // __UARTCapture__
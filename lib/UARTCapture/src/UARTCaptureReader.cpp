@@ -0,0 +1,53 @@
+#include <string.h>
+#include "UARTCaptureReader.h"
+
+UARTCaptureReader::UARTCaptureReader(const uint8_t* data, size_t size)
+    :   _data(data),
+        _size(size),
+        _offset(0),
+        _firstChunkOffset(0),
+        _header(),
+        _valid(false),
+        _truncated(false)
+{
+    if ((_data == nullptr) || (_size < sizeof(UARTCaptureFileHeader))) {
+        return;
+    }
+    memcpy(&_header, _data, sizeof(_header));
+    if ((_header.magic != UART_CAPTURE_MAGIC) || (_header.version != UART_CAPTURE_VERSION)
+            || (_header.headerBytes < sizeof(UARTCaptureFileHeader)) || (_header.headerBytes > _size)) {
+        return;
+    }
+    _header.sensorName[UART_CAPTURE_SENSOR_NAME_LENGTH - 1] = 0;
+    _firstChunkOffset = _header.headerBytes;
+    _offset = _firstChunkOffset;
+    _valid = true;
+}
+
+bool UARTCaptureReader::next(UARTCaptureChunk& chunk)
+{
+    if (!_valid || (_offset >= _size)) {
+        return false;
+    }
+    UARTCaptureChunkHeader header;
+    if (_size - _offset < sizeof(header)) {
+        _truncated = true;
+        return false;
+    }
+    memcpy(&header, _data + _offset, sizeof(header));
+    if (_size - _offset - sizeof(header) < header.length) {
+        _truncated = true;
+        return false;
+    }
+    chunk.receiveMillis = header.receiveMillis;
+    chunk.bytes = _data + _offset + sizeof(header);
+    chunk.length = header.length;
+    _offset += sizeof(header) + header.length;
+    return true;
+}
+
+void UARTCaptureReader::rewind(void)
+{
+    _offset = _firstChunkOffset;
+    _truncated = false;
+}
@@ -0,0 +1,76 @@
+#ifndef __UARTCaptureReader__
+#define __UARTCaptureReader__
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// UART capture file format. A capture is a file header followed by chunks of received bytes,
+// each a chunk header followed by the bytes. Everything is little endian, as the ESP32 writes it.
+//
+#define UART_CAPTURE_MAGIC              0x50414355UL    // "UCAP"
+#define UART_CAPTURE_VERSION            1
+#define UART_CAPTURE_SENSOR_NAME_LENGTH 16
+
+struct UARTCaptureFileHeader {
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    headerBytes;        // size of this header, so later versions can extend it
+    uint32_t    baudRate;
+    uint32_t    startMillis;        // millis() time the capture was started
+    char        sensorName[UART_CAPTURE_SENSOR_NAME_LENGTH];    // the driver's name(), 0 terminated
+};
+
+struct UARTCaptureChunkHeader {
+    uint32_t    receiveMillis;      // millis() time the bytes were drained from the UART
+    uint16_t    length;
+    uint16_t    reserved;
+};
+
+// A chunk of a capture, pointing into the capture's data.
+struct UARTCaptureChunk {
+    uint32_t        receiveMillis;
+    const uint8_t*  bytes;
+    size_t          length;
+};
+
+//
+// UARTCaptureReader
+//
+// Reads the chunks of a capture held in memory, in the order they were received. A capture
+// that was cut off, such as by a restart while it was being written, ends in a partial chunk,
+// which is ignored.
+//
+// This class has no Arduino dependencies so that captures can be replayed on the host.
+//
+class UARTCaptureReader {
+private:
+    const uint8_t*          _data;
+    size_t                  _size;
+    size_t                  _offset;
+    size_t                  _firstChunkOffset;
+    UARTCaptureFileHeader   _header;
+    bool                    _valid;
+    bool                    _truncated;
+
+public:
+    // The data must outlive the reader.
+    UARTCaptureReader(const uint8_t* data, size_t size);
+
+    // false if the data does not start with a capture header this reader understands
+    bool isValid(void) const                { return _valid; }
+
+    const char* sensorName(void) const      { return _header.sensorName; }
+    uint32_t baudRate(void) const           { return _header.baudRate; }
+    uint32_t startMillis(void) const        { return _header.startMillis; }
+
+    // Reads the next chunk. Returns false at the end of the capture.
+    bool next(UARTCaptureChunk& chunk);
+
+    // true once next() has stopped at a partial chunk
+    bool isTruncated(void) const            { return _truncated; }
+
+    // Goes back to the first chunk.
+    void rewind(void);
+};
+
+#endif // __UARTCaptureReader__
@@ -0,0 +1,226 @@
+#include <chrono>
+#include "Arduino.h"
+
+//
+// time
+//
+
+static uint64_t simulatedMicros = 0;
+
+static uint64_t hostMicros(void)
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()
+            + simulatedMicros;
+}
+
+uint32_t millis(void)
+{
+    return (uint32_t)(hostMicros()/1000);
+}
+
+uint32_t micros(void)
+{
+    return (uint32_t)hostMicros();
+}
+
+// Newlib on the ESP32 reports an unset time zone as GMT. Match that so that formatted times
+// are the same on the host as on the device.
+static struct HostTimeZone {
+    HostTimeZone()  { setenv("TZ", "GMT0", 1); tzset(); }
+} hostTimeZone;
+
+void delay(uint32_t ms)
+{
+    simulatedMicros += (uint64_t)ms*1000;
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    simulatedMicros += us;
+}
+
+//
+// String
+//
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base)
+{
+    char buf[34];
+    if (base == HEX) {
+        snprintf(buf, sizeof(buf), "%lx", value);
+    } else {
+        snprintf(buf, sizeof(buf), "%ld", value);
+    }
+    _str = buf;
+}
+
+String::String(unsigned long value, unsigned char base)
+{
+    char buf[34];
+    snprintf(buf, sizeof(buf), (base == HEX) ? "%lx" : "%lu", value);
+    _str = buf;
+}
+
+String::String(float value, unsigned char decimal_places) : String((double)value, decimal_places) {}
+
+String::String(double value, unsigned char decimal_places)
+{
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", decimal_places, value);
+    _str = buf;
+}
+
+bool String::startsWith(const String& prefix) const
+{
+    return _str.compare(0, prefix._str.length(), prefix._str) == 0;
+}
+
+bool String::endsWith(const String& suffix) const
+{
+    return (_str.length() >= suffix._str.length())
+            && (_str.compare(_str.length() - suffix._str.length(), suffix._str.length(), suffix._str) == 0);
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    size_t idx = _str.find(c, from);
+    return (idx == std::string::npos) ? -1 : (int)idx;
+}
+
+int String::indexOf(const String& str, unsigned int from) const
+{
+    size_t idx = _str.find(str._str, from);
+    return (idx == std::string::npos) ? -1 : (int)idx;
+}
+
+String String::substring(unsigned int from) const
+{
+    return (from < _str.length()) ? String(_str.substr(from)) : String();
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+    if (from > to) {
+        unsigned int tmp = from;
+        from = to;
+        to = tmp;
+    }
+    return (from < _str.length()) ? String(_str.substr(from, to - from)) : String();
+}
+
+void String::trim(void)
+{
+    const char* whitespace = " \t\r\n";
+    size_t first = _str.find_first_not_of(whitespace);
+    if (first == std::string::npos) {
+        _str.clear();
+        return;
+    }
+    _str = _str.substr(first, _str.find_last_not_of(whitespace) - first + 1);
+}
+
+//
+// Print
+//
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--) {
+        n += write(*buffer++);
+    }
+    return n;
+}
+
+size_t Print::print(long value, int base)
+{
+    return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+    return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(double value, int digits)
+{
+    return print(String(value, (unsigned char)digits));
+}
+
+size_t Print::printf(const char* format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0) {
+        return 0;
+    }
+    return write((const uint8_t*)buf, ((size_t)len < sizeof(buf)) ? (size_t)len : sizeof(buf) - 1);
+}
+
+//
+// HardwareSerial
+//
+
+HardwareSerial Serial(stdout);
+HardwareSerial Serial1(stdout);
+
+HardwareSerial::HardwareSerial(FILE* output)
+    :   _rx(),
+        _outputEnabled(true),
+        _output(output)
+{
+}
+
+void HardwareSerial::begin(unsigned long, uint32_t, int8_t, int8_t)
+{
+}
+
+int HardwareSerial::read(void)
+{
+    if (_rx.empty()) {
+        return -1;
+    }
+    uint8_t c = _rx.front();
+    _rx.pop_front();
+    return c;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    if (_outputEnabled) {
+        fputc(c, _output);
+    }
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    if (_outputEnabled) {
+        fwrite(buffer, 1, size, _output);
+    }
+    return size;
+}
+
+void HardwareSerial::injectReceivedBytes(const uint8_t* bytes, size_t count)
+{
+    _rx.insert(_rx.end(), bytes, bytes + count);
+}
+
+//
+// ESP
+//
+
+EspClass ESP;
+
+uint32_t EspClass::getCycleCount(void)
+{
+    // pretend to be a 240 MHz core
+    return (uint32_t)(hostMicros()*240);
+}
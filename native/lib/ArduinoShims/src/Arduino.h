@@ -0,0 +1,121 @@
+#ifndef __ArduinoShims_Arduino__
+#define __ArduinoShims_Arduino__
+//
+// Minimal host (native) stand-in for the Arduino core on ESP32. It provides just enough of
+// Arduino.h, Serial and ESP.* for the project's libraries to compile and run on Linux for
+// unit tests and benchmarks. It is only on the include path of the native environments.
+//
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <deque>
+#include "WString.h"
+
+#define F(string_literal)   (string_literal)
+#define PROGMEM
+#define DEC     10
+#define HEX     16
+#define SERIAL_8N1  0x800001c
+#define SERIAL_8E1  0x800001e
+
+//
+// time. delay() advances a simulated clock instead of sleeping, so code that waits on hardware
+// runs at full speed on the host. millis() and micros() include the simulated time.
+//
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+//
+// Print and Serial. Output goes to stdout unless disabled with setOutputEnabled(false).
+//
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str)               { return write((const uint8_t*)str, strlen(str)); }
+
+    size_t print(const char* str)               { return write(str); }
+    size_t print(const String& str)             { return write(str.c_str()); }
+    size_t print(char c)                        { return write((uint8_t)c); }
+    size_t print(int value, int base = DEC)     { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC)    { return print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println(void)                        { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& value)              { size_t n = print(value); return n + println(); }
+    template <typename T>
+    size_t println(const T& value, int format)  { size_t n = print(value, format); return n + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HardwareSerial : public Print {
+private:
+    std::deque<uint8_t> _rx;
+    bool                _outputEnabled;
+    FILE*               _output;
+
+public:
+    HardwareSerial(FILE* output);
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rx_pin = -1, int8_t tx_pin = -1);
+    void end(void)                              {}
+    int available(void)                         { return (int)_rx.size(); }
+    int read(void);
+    int peek(void)                              { return _rx.empty() ? -1 : _rx.front(); }
+    void flush(void)                            {}
+
+    using Print::write;
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t* buffer, size_t size);
+
+    // host only: queue bytes to be returned by read(), as if received on the RX pin
+    void injectReceivedBytes(const uint8_t* bytes, size_t count);
+    // host only: enables or disables echoing output to the host
+    void setOutputEnabled(bool enabled)         { _outputEnabled = enabled; }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+//
+// ESP. Heap figures are fixed values representative of an ESP32. PSRAM can be enabled on the
+// host with setPsramSize() to exercise the PSRAM code paths.
+//
+class EspClass {
+private:
+    uint32_t _psramSize;
+
+public:
+    EspClass() : _psramSize(0) {}
+
+    uint32_t getHeapSize(void)                  { return 327680; }
+    uint32_t getFreeHeap(void)                  { return 262144; }
+    uint32_t getMinFreeHeap(void)               { return 229376; }
+    uint32_t getMaxAllocHeap(void)              { return 114688; }
+    uint32_t getPsramSize(void)                 { return _psramSize; }
+    uint32_t getFreePsram(void)                 { return _psramSize; }
+    uint32_t getMinFreePsram(void)              { return _psramSize; }
+    uint32_t getMaxAllocPsram(void)             { return _psramSize; }
+    uint32_t getCycleCount(void);
+
+    // host only
+    void setPsramSize(uint32_t size)            { _psramSize = size; }
+};
+
+extern EspClass ESP;
+
+inline void* ps_malloc(size_t size)             { return malloc(size); }
+
+#endif // __ArduinoShims_Arduino__
@@ -0,0 +1,208 @@
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "FS.h"
+
+namespace fs {
+
+class FileImpl {
+public:
+    FILE*                       file;
+    std::string                 path;       // path within the file system
+    std::string                 hostPath;
+    bool                        directory;
+    std::vector<std::string>    entries;    // for directories, the names of the files in it
+    size_t                      nextEntry;
+
+    FileImpl() : file(nullptr), directory(false), nextEntry(0) {}
+    ~FileImpl()     { if (file != nullptr) fclose(file); }
+};
+
+size_t File::write(const uint8_t* buffer, size_t size)
+{
+    if (!_impl || (_impl->file == nullptr)) {
+        return 0;
+    }
+    return fwrite(buffer, 1, size, _impl->file);
+}
+
+size_t File::read(uint8_t* buffer, size_t size)
+{
+    if (!_impl || (_impl->file == nullptr)) {
+        return 0;
+    }
+    return fread(buffer, 1, size, _impl->file);
+}
+
+int File::read(void)
+{
+    uint8_t c;
+    return (read(&c, 1) == 1) ? c : -1;
+}
+
+int File::available(void)
+{
+    if (!_impl || (_impl->file == nullptr)) {
+        return 0;
+    }
+    return (int)(size() - position());
+}
+
+void File::flush(void)
+{
+    if (_impl && (_impl->file != nullptr)) {
+        fflush(_impl->file);
+    }
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+    if (!_impl || (_impl->file == nullptr)) {
+        return false;
+    }
+    int whence = (mode == SeekSet) ? SEEK_SET : ((mode == SeekCur) ? SEEK_CUR : SEEK_END);
+    return fseek(_impl->file, pos, whence) == 0;
+}
+
+size_t File::position(void) const
+{
+    if (!_impl || (_impl->file == nullptr)) {
+        return 0;
+    }
+    return ftell(_impl->file);
+}
+
+size_t File::size(void) const
+{
+    if (!_impl || (_impl->file == nullptr)) {
+        return 0;
+    }
+    fflush(_impl->file);
+    struct stat st;
+    if (fstat(fileno(_impl->file), &st) != 0) {
+        return 0;
+    }
+    return st.st_size;
+}
+
+void File::close(void)
+{
+    _impl.reset();
+}
+
+File::operator bool() const
+{
+    return _impl && ((_impl->file != nullptr) || _impl->directory);
+}
+
+const char* File::name(void) const
+{
+    return _impl ? _impl->path.c_str() : "";
+}
+
+bool File::isDirectory(void) const
+{
+    return _impl && _impl->directory;
+}
+
+File File::openNextFile(const char* mode)
+{
+    if (!_impl || !_impl->directory || (_impl->nextEntry >= _impl->entries.size())) {
+        return File();
+    }
+    std::string path = _impl->path;
+    if (path.empty() || (path[path.length() - 1] != '/')) {
+        path += '/';
+    }
+    path += _impl->entries[_impl->nextEntry++];
+
+    FileImplPtr impl = std::make_shared<FileImpl>();
+    impl->path = path;
+    impl->hostPath = _impl->hostPath + "/" + _impl->entries[_impl->nextEntry - 1];
+    impl->file = fopen(impl->hostPath.c_str(), (mode[0] == 'r') ? "rb" : ((mode[0] == 'a') ? "ab" : "wb"));
+    return File(impl);
+}
+
+FS::FS(const char* root)
+    :   _root(root)
+{
+}
+
+std::string FS::hostPath(const char* path) const
+{
+    return _root + ((path[0] == '/') ? "" : "/") + path;
+}
+
+File FS::open(const char* path, const char* mode)
+{
+    FileImplPtr impl = std::make_shared<FileImpl>();
+    impl->path = path;
+    impl->hostPath = hostPath(path);
+
+    struct stat st;
+    if ((mode[0] == 'r') && (stat(impl->hostPath.c_str(), &st) == 0) && S_ISDIR(st.st_mode)) {
+        impl->directory = true;
+        DIR* dir = opendir(impl->hostPath.c_str());
+        if (dir != nullptr) {
+            struct dirent* entry;
+            while ((entry = readdir(dir)) != nullptr) {
+                if (entry->d_type == DT_REG) {
+                    impl->entries.push_back(entry->d_name);
+                }
+            }
+            closedir(dir);
+        }
+        std::sort(impl->entries.begin(), impl->entries.end());
+        return File(impl);
+    }
+
+    const char* host_mode = "rb";
+    if (mode[0] == 'w') {
+        host_mode = (mode[1] == '+') ? "w+b" : "wb";
+    } else if (mode[0] == 'a') {
+        host_mode = (mode[1] == '+') ? "a+b" : "ab";
+    } else if (mode[1] == '+') {
+        host_mode = "r+b";
+    }
+    impl->file = fopen(impl->hostPath.c_str(), host_mode);
+    if (impl->file == nullptr) {
+        return File();
+    }
+    return File(impl);
+}
+
+bool FS::exists(const char* path)
+{
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path)
+{
+    return ::unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to)
+{
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path)
+{
+    return (::mkdir(hostPath(path).c_str(), 0755) == 0) || exists(path);
+}
+
+bool FS::rmdir(const char* path)
+{
+    return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+HostFS::HostFS(const char* root)
+    :   FS(root)
+{
+    ::mkdir(root, 0755);
+}
+
+} // namespace fs
@@ -0,0 +1,83 @@
+#ifndef __ArduinoShims_FS__
+#define __ArduinoShims_FS__
+//
+// Host stand-in for the Arduino ESP32 file system API (FS.h), which SPIFFS and LittleFS
+// implement. HostFS maps the file system onto a directory of the host, so code written
+// against fs::FS can be tested on the host.
+//
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+#define FILE_READ       "r"
+#define FILE_WRITE      "w"
+#define FILE_APPEND     "a"
+
+namespace fs {
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+class FileImpl;
+typedef std::shared_ptr<FileImpl> FileImplPtr;
+
+class File : public Print {
+private:
+    FileImplPtr _impl;
+
+public:
+    File(FileImplPtr impl = FileImplPtr()) : _impl(impl) {}
+
+    using Print::write;
+    virtual size_t write(uint8_t c)                 { return write(&c, 1); }
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t read(uint8_t* buffer, size_t size);
+    int read(void);
+    int available(void);
+    void flush(void);
+    bool seek(uint32_t pos, SeekMode mode);
+    bool seek(uint32_t pos)                         { return seek(pos, SeekSet); }
+    size_t position(void) const;
+    size_t size(void) const;
+    void close(void);
+    operator bool() const;
+    const char* name(void) const;
+    bool isDirectory(void) const;
+    File openNextFile(const char* mode = FILE_READ);
+};
+
+class FS {
+private:
+    std::string _root;
+
+    std::string hostPath(const char* path) const;
+
+public:
+    FS(const char* root);
+
+    File open(const char* path, const char* mode = FILE_READ);
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool rename(const char* from, const char* to);
+    bool mkdir(const char* path);
+    bool rmdir(const char* path);
+};
+
+// host only: a file system rooted at a directory of the host, which is created if needed
+class HostFS : public FS {
+public:
+    HostFS(const char* root);
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif // __ArduinoShims_FS__
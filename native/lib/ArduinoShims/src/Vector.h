@@ -0,0 +1,64 @@
+#ifndef __ArduinoShims_Vector__
+#define __ArduinoShims_Vector__
+#include <stddef.h>
+
+//
+// Host stand-in for the Vector library (https://github.com/janelia-arduino/Vector). Like the
+// original, it does not allocate and operates on storage provided by the owner.
+//
+template <typename T>
+class Vector {
+private:
+    T*      _values;
+    size_t  _max_size;
+    size_t  _size;
+
+public:
+    Vector() : _values(nullptr), _max_size(0), _size(0) {}
+
+    template <size_t MAX_SIZE>
+    Vector(T (&values)[MAX_SIZE], size_t size = 0) : _values(values), _max_size(MAX_SIZE), _size(size) {}
+
+    template <size_t MAX_SIZE>
+    void setStorage(T (&values)[MAX_SIZE], size_t size = 0)
+    {
+        setStorage(values, MAX_SIZE, size);
+    }
+
+    void setStorage(T* values, size_t max_size, size_t size)
+    {
+        _values = values;
+        _max_size = max_size;
+        _size = size;
+    }
+
+    const T& operator[](size_t index) const     { return _values[index]; }
+    T& operator[](size_t index)                 { return _values[index]; }
+    const T& at(size_t index) const             { return _values[index]; }
+    T& at(size_t index)                         { return _values[index]; }
+    T& front(void)                              { return _values[0]; }
+    T& back(void)                               { return _values[_size - 1]; }
+
+    void clear(void)                            { _size = 0; }
+    void push_back(const T& value)
+    {
+        if (_size < _max_size) {
+            _values[_size++] = value;
+        }
+    }
+    void pop_back(void)
+    {
+        if (_size > 0) {
+            _size--;
+        }
+    }
+
+    size_t size(void) const                     { return _size; }
+    size_t max_size(void) const                 { return _max_size; }
+    bool empty(void) const                      { return _size == 0; }
+    bool full(void) const                       { return _size == _max_size; }
+    T* data(void)                               { return _values; }
+    const T* data(void) const                   { return _values; }
+};
+
+#endif // __ArduinoShims_Vector__
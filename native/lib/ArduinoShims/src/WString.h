@@ -0,0 +1,58 @@
+#ifndef __ArduinoShims_WString__
+#define __ArduinoShims_WString__
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+//
+// Host stand-in for the Arduino String class. Only the members this project uses are provided.
+//
+class String {
+private:
+    std::string _str;
+
+public:
+    String() {}
+    String(const char* str) : _str((str != nullptr) ? str : "") {}
+    String(const std::string& str) : _str(str) {}
+    String(char c) : _str(1, c) {}
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimal_places = 2);
+    explicit String(double value, unsigned char decimal_places = 2);
+
+    unsigned int length(void) const             { return _str.length(); }
+    const char* c_str(void) const               { return _str.c_str(); }
+    bool reserve(unsigned int size)             { _str.reserve(size); return true; }
+    char charAt(unsigned int index) const       { return (index < _str.length()) ? _str[index] : 0; }
+    char operator[](unsigned int index) const   { return charAt(index); }
+
+    bool equals(const String& other) const      { return _str == other._str; }
+    bool equals(const char* other) const        { return _str == other; }
+    bool operator==(const String& other) const  { return equals(other); }
+    bool operator==(const char* other) const    { return equals(other); }
+    bool operator!=(const String& other) const  { return !equals(other); }
+    bool operator!=(const char* other) const    { return !equals(other); }
+
+    bool startsWith(const String& prefix) const;
+    bool endsWith(const String& suffix) const;
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String& str, unsigned int from = 0) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+    void trim(void);
+
+    bool concat(const String& str)              { _str += str._str; return true; }
+    bool concat(const char* str)                { _str += str; return true; }
+    bool concat(char c)                         { _str += c; return true; }
+    String& operator+=(const String& str)       { concat(str); return *this; }
+    String& operator+=(const char* str)         { concat(str); return *this; }
+    String& operator+=(char c)                  { concat(c); return *this; }
+
+    friend String operator+(const String& lhs, const String& rhs)   { return String(lhs._str + rhs._str); }
+    friend String operator+(const String& lhs, const char* rhs)     { return String(lhs._str + rhs); }
+};
+
+#endif // __ArduinoShims_WString__
@@ -0,0 +1,214 @@
+//
+// Host replayer for UART captures taken on the device (see UARTCapture.h).
+//
+// Each capture is replayed through the frame decoder, the sample history and its averages as
+// fast as the host can decode it, and the samples and frame counters are checked against the
+// capture's golden output, which is kept beside it with the extension .golden. This makes the
+// captures a regression suite for the decoding and averaging code, driven by what sensors
+// really send in the field, and the throughput it reports a benchmark of the same.
+//
+// Build and run from the project root with:
+//   pio run -e native_replay && .pio/build/native_replay/program [options] capture.ucap ...
+//
+// Options:
+//   --update           write the golden output of each capture rather than checking it
+//   --sample-seconds N the sample period to replay with, which the golden output depends on.
+//                      Defaults to AIR_QUALITY_SENSOR_UPDATE_SECONDS's default of 2.
+//
+// Exits with 1 if any capture could not be replayed or did not match its golden output.
+//
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <CaptureReplay.h>
+
+static bool readFile(const std::string& path, std::string& contents)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    contents.clear();
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, length);
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+static bool writeFile(const std::string& path, const std::string& contents)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = (fwrite(contents.data(), 1, contents.size(), file) == contents.size());
+    return (fclose(file) == 0) && ok;
+}
+
+static std::string goldenPath(const std::string& capture_path)
+{
+    size_t dot = capture_path.rfind('.');
+    size_t slash = capture_path.rfind('/');
+    if ((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash))) {
+        return capture_path + ".golden";
+    }
+    return capture_path.substr(0, dot) + ".golden";
+}
+
+static void appendLine(std::string& output, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendLine(std::string& output, const char* format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    output += line;
+    output += '\n';
+}
+
+// Returns the 1 based number of the first line that differs, or 0 if there is none.
+static size_t firstDifferentLine(const std::string& a, const std::string& b)
+{
+    size_t line = 1;
+    for (size_t i = 0; (i < a.size()) || (i < b.size()); i++) {
+        if ((i >= a.size()) || (i >= b.size()) || (a[i] != b[i])) {
+            return line;
+        }
+        if (a[i] == '\n') {
+            line++;
+        }
+    }
+    return 0;
+}
+
+static std::string lineAt(const std::string& text, size_t line)
+{
+    size_t start = 0;
+    for (size_t i = 1; (i < line) && (start != std::string::npos); i++) {
+        start = text.find('\n', start);
+        if (start != std::string::npos) {
+            start++;
+        }
+    }
+    if ((start == std::string::npos) || (start >= text.size())) {
+        return "<end of output>";
+    }
+    size_t end = text.find('\n', start);
+    return text.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+}
+
+// Replays one capture. Returns false if it could not be replayed or did not match.
+static bool replayFile(const std::string& path, uint32_t sample_seconds, bool update)
+{
+    std::string data;
+    if (!readFile(path, data)) {
+        printf("%s: could not be read\n", path.c_str());
+        return false;
+    }
+    UARTCaptureReader capture((const uint8_t*)data.data(), data.size());
+    if (!capture.isValid()) {
+        printf("%s: not a UART capture\n", path.c_str());
+        return false;
+    }
+
+    // The output has a line per sample with the time of its frame on the device, the mass
+    // densities, the current, 10 minute, 1 hour and 24 hour PM2.5 averages, and the PM2.5
+    // min, max and percentiles of the 10 minute window.
+    std::string output;
+    appendLine(output, "# sensor %s, sampled every %u seconds", capture.sensorName(), sample_seconds);
+    output.reserve(data.size()*2);
+    CaptureReplayResult result;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool replayed = replayCapture(capture, sample_seconds, [&](const AirQualitySensor& sensor, uint32_t capture_millis) {
+        SampleWindowSpread spread = sensor.tenMinuteSpreadPM2p5();
+        appendLine(output, "%u %u %u %u %.2f %.2f %.2f %.2f %u %u %u %u %u",
+            capture_millis, sensor.PM1p0(), sensor.PM2p5(), sensor.PM10(),
+            sensor.currentAveragePM2p5(), sensor.tenMinuteAveragePM2p5(),
+            sensor.oneHourAveragePM2p5(), sensor.oneDayAveragePM2p5(),
+            spread.min, spread.max, spread.p50, spread.p95, spread.p99
+        );
+    }, result);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!replayed) {
+        printf("%s: no protocol for sensor %s\n", path.c_str(), capture.sensorName());
+        return false;
+    }
+    appendLine(output, "# frames valid %u corrupt %u dropped %u, bytes discarded %u, samples %u missed %u%s",
+        result.frames.valid, result.frames.corrupt, result.frames.dropped, result.frames.discarded,
+        result.sampleCount, result.missedSampleCount, capture.isTruncated() ? ", truncated" : ""
+    );
+
+    printf("%s: %s, %.1f minutes, %llu bytes, %u frames, %u samples in %.1f ms: %.0f frames/s, %.1f MB/s\n",
+        path.c_str(), capture.sensorName(), result.captureMillis/60000.0, (unsigned long long)result.byteCount,
+        result.frames.valid, result.sampleCount, seconds*1000,
+        (seconds > 0) ? result.frames.valid/seconds : 0, (seconds > 0) ? result.byteCount/seconds/1e6 : 0
+    );
+
+    std::string golden_path = goldenPath(path);
+    if (update) {
+        if (!writeFile(golden_path, output)) {
+            printf("%s: could not be written\n", golden_path.c_str());
+            return false;
+        }
+        printf("    wrote %s\n", golden_path.c_str());
+        return true;
+    }
+    std::string golden;
+    if (!readFile(golden_path, golden)) {
+        printf("    FAIL - %s could not be read. Write it with --update.\n", golden_path.c_str());
+        return false;
+    }
+    size_t line = firstDifferentLine(golden, output);
+    if (line > 0) {
+        printf("    FAIL - differs from %s at line %zu\n", golden_path.c_str(), line);
+        printf("    expected: %s\n", lineAt(golden, line).c_str());
+        printf("    actual:   %s\n", lineAt(output, line).c_str());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    bool update = false;
+    uint32_t sample_seconds = 2;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if ((strcmp(argv[i], "--sample-seconds") == 0) && (i + 1 < argc)) {
+            sample_seconds = strtoul(argv[++i], nullptr, 10);
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty() || (sample_seconds == 0)) {
+        printf("usage: %s [--update] [--sample-seconds N] capture.ucap ...\n", argv[0]);
+        return 1;
+    }
+
+    // the libraries log to Serial, which would otherwise interleave with the results
+    Serial.setOutputEnabled(false);
+
+    size_t failed = 0;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!replayFile(paths[i], sample_seconds, update)) {
+            failed++;
+        }
+    }
+    if (!update) {
+        printf("%zu of %zu captures match their golden output\n", paths.size() - failed, paths.size());
+    }
+    return (failed > 0) ? 1 : 0;
+}
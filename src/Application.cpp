@@ -3,9 +3,12 @@
 #include <ArduinoJson.h>
 #include <SPIFFS.h>
 #include <Wire.h>
+#include <esp_sleep.h>
+#include <esp_wifi.h>
 #include "time.h"
 #include "Application.h"
 #include "Utilities.h"
+#include "Logger.h"
 
 const char* ntpServer = "pool.ntp.org";
 const long  gmtOffset_sec = 0;
@@ -19,7 +22,13 @@ const char* password = WIFI_PASSWORD;
 const char* sensor_name = SENSOR_NAME;
 
 #define SEALEVELPRESSURE_HPA (1013.25)
-#define UNSET_ENVIRONMENT_VALUE -301.0
+
+static const PowerModel power_model = {
+  POWER_BASE_MILLIAMPS, POWER_ACTIVE_MILLIAMPS, POWER_SLEEP_MILLIAMPS, POWER_RADIO_MILLIAMPS, POWER_SUPPLY_VOLTS
+};
+
+// The clock counts from 1970 until NTP has answered, so any earlier time means it is not set yet.
+#define BOOT_MIN_VALID_TIME  1600000000
 
 //
 // Application
@@ -36,21 +45,115 @@ Application* Application::getInstance(void)
   return gApp;
 }
 Application::Application()
-  : _sensor(AIR_QUALITY_SENSOR_UPDATE_SECONDS),
+  : _sensorDriver(Serial1, PARTICULATE_SENSOR_RX_PIN, PARTICULATE_SENSOR_TX_PIN),
+    _sensor(_sensorDriver, AIR_QUALITY_SENSOR_UPDATE_SECONDS),
+    _uartCapture(),
+#if PARTICULATE_SENSOR2_TYPE != PARTICULATE_SENSOR_NONE
+    _sensor2Driver(Serial2, PARTICULATE_SENSOR2_RX_PIN, PARTICULATE_SENSOR2_TX_PIN),
+    _sensor2(_sensor2Driver, AIR_QUALITY_SENSOR_UPDATE_SECONDS),
+#endif
     _bme680(),
+    _bme680Device(_bme680),
+    _environment(_bme680Device, ENVIRONMENT_SAMPLE_SECONDS*1000UL, ENVIRONMENT_READING_TIMEOUT_MILLIS),
+    _environmentStorage(nullptr),
     _server(80),
+    _liveSocket("/live"),
+    _liveClients(),
+    _liveClientEvents(),
+    _staticAssets(),
+    _staticAssetHandler(_staticAssets, SPIFFS, STATIC_ASSET_MAX_AGE_SECONDS),
 #if MCU_BOARD_TYPE == MCU_TINYPICO
     _tinyPICO(),
 #endif
-    _loopCounter(0),
-    _rootPageViewCount(0),
+    _status(),
+    _pageRenderer(_sensor, _status),
+    _templateFormatter(std::bind(&PageRenderer::formatVariable, &_pageRenderer, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)),
+    _rootTemplate(),
+    _rootBME680Template(),
+    _statsTemplate(),
+    _telemetryBatch(TELEMETRY_BATCH_SIZE, TELEMETRY_BATCH_MAX_AGE_SECONDS, TELEMETRY_SAMPLE_INTERVAL, strlen(sensor_name)),
+    _telemetryStore(TELEMETRY_STORE_CAPACITY_PSRAM, TELEMETRY_STORE_CAPACITY_RAM),
+    _telemetryClient(),
+    _telemetryUplink(
+      sensor_name, _telemetryBatch, _telemetryStore,
+      TELEMETRY_DRAIN_BATCH_SIZE, TELEMETRY_DRAIN_INTERVAL_MILLIS, TELEMETRY_DRAIN_MAX_BACKOFF_MILLIS,
+      std::bind(&Application::postTelemetry, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)
+    ),
+    _historyArchive(),
+    _channelHistory(),
+    _channelHistoryStorage(nullptr),
+    _channelSums(),
+    _channelSampleCounts(),
+    _channelLastRowTime(0),
+    _dutyCycle(POWER_RADIO_INTERVAL_SECONDS*1000UL, POWER_RADIO_WINDOW_SECONDS*1000UL, POWER_MIN_SLEEP_MILLIS, power_model),
+    _radioEnabled(true),
+    _loopLatency(),
     _appSetup(false),
-    _hasBME680(false),
-    _latestTemperature(UNSET_ENVIRONMENT_VALUE),
-    _latestPressure(UNSET_ENVIRONMENT_VALUE),
-    _latestHumidity(UNSET_ENVIRONMENT_VALUE)
+    _wifiConnected(false),
+    _lastReconnectMillis(0)
 {
-
+  _status.sensorName = sensor_name;
+  _status.wifiSSID = ssid;
+  _status.telemetryURL = telemetry_url;
+  _status.bootTime = 0;
+  _status.lastUpdateTime = 0;
+  _status.lastTransmitTime = 0;
+  _status.measureSeconds = AIR_QUALITY_SENSOR_UPDATE_SECONDS;
+  _status.transmitSeconds = _telemetryBatch.maxAgeSeconds();
+  _status.telemetryBatchSize = 0;
+  _status.telemetryBatchCapacity = _telemetryBatch.capacity();
+  _status.telemetrySampleInterval = _telemetryBatch.sampleInterval();
+  _status.telemetryRequestCount = 0;
+  _status.telemetryFailureCount = 0;
+  _status.telemetryConnectionCount = 0;
+  _status.telemetryQueuedCount = 0;
+  _status.telemetrySpilledCount = 0;
+  _status.telemetryDroppedCount = 0;
+  _status.telemetryConnectLatency = nullptr;
+  _status.telemetrySendLatency = nullptr;
+  _status.telemetryResponseLatency = nullptr;
+  _status.hasBME680 = false;
+  _status.temperature = UNSET_ENVIRONMENT_VALUE;
+  _status.pressure = UNSET_ENVIRONMENT_VALUE;
+  _status.humidity = UNSET_ENVIRONMENT_VALUE;
+  _status.environment = nullptr;
+  _status.uartCapture = &_uartCapture;
+  _status.rootPageViewCount = 0;
+  _status.liveClientCount = 0;
+  _status.liveUpdateCount = 0;
+  _status.liveSkippedCount = 0;
+  _status.liveDroppedCount = 0;
+  _status.staticServedCount = 0;
+  _status.channelHistoryRows = 0;
+  _status.channelHistorySeconds = 0;
+  _status.channelHistoryBytes = 0;
+  _status.historyRestoredCount = 0;
+  _status.historyRestoreMillis = 0;
+  _status.historyRestoreSkipped = false;
+  _status.historyArchivedCount = 0;
+  _status.historyArchiveWriteCount = 0;
+  _status.historyArchiveFailedCount = 0;
+  _status.staticNotModifiedCount = 0;
+  _status.staticFlashReadCount = 0;
+  _status.bootPending = 0;
+  _status.bootCompleteMillis = 0;
+  _status.firstResponseMillis = 0;
+  for (uint8_t i = 0; i < LOOP_STAGE_COUNT; i++) {
+    _status.loopLatency[i] = &_loopLatency[i];
+  }
+  // the JSON is built inside the uplink
+  _status.loopLatency[LOOP_STAGE_JSON] = &_telemetryUplink.serializeLatency();
+  _status.heapSize = 0;
+  _status.heapMinFree = 0;
+  _status.psramSize = 0;
+  _status.psramMinFree = 0;
+  _status.powerProfile = POWER_PROFILE;
+  _status.dutyCycle = 1;
+  _status.wakeCount = 0;
+  _status.radioWakeCount = 0;
+  _status.averageMilliamps = 0;
+  _status.energyPerSampleMillijoules = 0;
+  _status.sampleEpoch = 0;
 }
 
 Application::~Application()
@@ -60,89 +163,304 @@ Application::~Application()
 
 void Application::setup(void)
 {
+  // from here on logs are printed by the log task rather than by whoever logs them
+  Log.startTask(LOG_TASK_CORE, LOG_TASK_POLL_MILLIS);
+
   // Initialize SPIFFS
   if(!SPIFFS.begin(true)){
-    Serial.println("ERROR: Could not mount SPIFFs");
+    LOG_ERROR("ERROR: Could not mount SPIFFs");
     return;
   }
   setupLED();
 
-  // start the WiFi
-  Serial.print(F("Starting Wifi connection to SSID = "));
-  Serial.print(ssid);
-  Serial.print(F(" "));
+  // Nothing here waits on the network or the sensor. The WiFi connection, the time and the
+  // sensor warm-up come up while the web server is already answering, and stepBoot() finishes
+  // each of them from the loop.
+  LOG_INFO("Starting Wifi connection to SSID = %s", ssid);
   WiFi.begin(ssid, password);
-  while (WiFi.status() != WL_CONNECTED) {
-      delay(500);
-      Serial.print(".");
+#if POWER_PROFILE == POWER_PROFILE_LOW_POWER
+  esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+#endif
+  _lastReconnectMillis = millis();
+  _status.bootPending = BOOT_ALL;
+  _dutyCycle.begin(millis());
+
+  setupWebserver();
+
+  // the capture is attached before the acquisition task starts reading the sensor
+  if (_uartCapture.begin(SPIFFS, UART_CAPTURE_PATH, _sensor.name(),
+                         ParticulateProtocolForType<PARTICULATE_SENSOR_TYPE>::Type::BAUD_RATE, UART_CAPTURE_MAX_BYTES)) {
+    _sensorDriver.setCapture(&_uartCapture);
   }
-  Serial.print(F("\nWiFi connected with ip address = "));
-  Serial.print(WiFi.localIP());
-  Serial.print(F("\n"));
 
-  configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-  printLocalTime();  
-  time(&_boot_time);
+  // start the sensors warming up and their acquisition tasks
+  _sensor.begin();
+  _sensor.startAcquisitionTask(SENSOR_ACQUISITION_CORE);
+#if PARTICULATE_SENSOR2_TYPE != PARTICULATE_SENSOR_NONE
+  _sensor2.begin();
+  _sensor2.startAcquisitionTask(SENSOR_ACQUISITION_CORE);
+#endif
 
   if (!_bme680.begin(BME680_SENSOR_I2C_ADDRESS)) {
-    Serial.println(F("NOTE - Could not find BME680 sensor. Will not create additional environment readings."));
+    LOG_WARN("NOTE - Could not find BME680 sensor. Will not create additional environment readings.");
   } else {
-    Serial.println(F("Found BME680 sensor"));
-    _hasBME680 = true;
+    LOG_INFO("Found BME680 sensor");
+    _status.hasBME680 = true;
     _bme680.setTemperatureOversampling(BME680_OS_8X);
     _bme680.setHumidityOversampling(BME680_OS_2X);
     _bme680.setPressureOversampling(BME680_OS_4X);
     _bme680.setIIRFilterSize(BME680_FILTER_SIZE_3);
     _bme680.setGasHeater(320, 150); // 320*C for 150 ms
+    setupEnvironmentHistory();
+    _environment.begin(millis());
+    _status.environment = &_environment;
   }
 
-  // start the sensor
-  _sensor.begin();
+  setupChannelHistory();
 
-  setupWebserver();
+#if HISTORY_ARCHIVE_SEGMENTS > 0
+  // the archive is restored by stepBoot() once the time is known
+  _historyArchive.begin(SPIFFS, "/ha", _sensor.history(), AIR_QUALITY_SENSOR_UPDATE_SECONDS,
+                        HISTORY_ARCHIVE_SEGMENTS, HISTORY_ARCHIVE_SEGMENT_RECORDS);
+#endif
 
+  if (telemetry_url != nullptr) {
+#if TELEMETRY_STORE_SPILL_SEGMENTS > 0
+    _telemetryStore.enableSpill(SPIFFS, "/tq", TELEMETRY_STORE_SPILL_SEGMENTS, TELEMETRY_STORE_SPILL_SEGMENT_RECORDS);
+    updateTelemetryStatus();
+#endif
+    if (_telemetryClient.begin(telemetry_url)) {
+      _status.telemetryConnectLatency = &_telemetryClient.connectLatency();
+      _status.telemetrySendLatency = &_telemetryClient.sendLatency();
+      _status.telemetryResponseLatency = &_telemetryClient.responseLatency();
+    } else {
+      LOG_WARN("NOTE - Telemetry URL is not http://. Telemetry will be posted with a blocking client.");
+    }
+  }
+
+  LOG_INFO("Setup finished in %u ms. The web server is up while the rest starts.", millis());
   _appSetup = true;
 }
+
+//
+// Boot state machine. Each subsystem in _status.bootPending is finished off as soon as what
+// it waits for has happened: NTP is started once WiFi is connected, the boot time is set once
+// NTP has answered, and the history is restored once the time is known. If the sensor is ready
+// to sample and HISTORY_ARCHIVE_TIME_WAIT_SECONDS have passed without the time, the restore is
+// skipped.
+//
+void Application::stepBoot(void)
+{
+  uint8_t pending = _status.bootPending;
+  if ((pending & BOOT_WIFI) && _wifiConnected) {
+    configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
+    pending &= ~BOOT_WIFI;
+  }
+  if ((pending & BOOT_TIME) && !(pending & BOOT_WIFI)) {
+    time_t now = time(nullptr);
+    if (now >= BOOT_MIN_VALID_TIME) {
+      _status.bootTime = now - millis()/1000;
+      printLocalTime();
+      pending &= ~BOOT_TIME;
+    }
+  }
+  if ((pending & BOOT_SENSOR) && !_sensor.isWarmingUp()) {
+    pending &= ~BOOT_SENSOR;
+  }
+  if ((pending & BOOT_HISTORY)
+        && (!(pending & BOOT_TIME) || !_historyArchive.isEnabled()
+            || (!(pending & BOOT_SENSOR) && (millis() >= HISTORY_ARCHIVE_TIME_WAIT_SECONDS*1000UL)))) {
+    restoreHistory();
+    pending &= ~BOOT_HISTORY;
+  }
+
+  if (pending != _status.bootPending) {
+    _status.bootPending = pending;
+    if (pending == 0) {
+      _status.bootCompleteMillis = millis();
+      LOG_INFO("All subsystems up after %u ms", _status.bootCompleteMillis);
+    }
+    // the pages show what is still starting up
+    _status.sampleEpoch++;
+  }
+}
+
+void Application::restoreHistory(void)
+{
+  if (!_historyArchive.isEnabled()) {
+    return;
+  }
+  if (time(nullptr) < BOOT_MIN_VALID_TIME) {
+    LOG_WARN("NOTE - The time was not set within %u seconds. Starting without the archived history.",
+             HISTORY_ARCHIVE_TIME_WAIT_SECONDS);
+    _status.historyRestoreSkipped = true;
+  } else {
+    if (_historyArchive.restore(time(nullptr), HISTORY_ARCHIVE_RESTORE_SECONDS) > 0) {
+      // the NowCast picks up from the restored rollups rather than waiting two hours for new ones
+      _sensor.restoreNowCast();
+    }
+    _status.historyRestoredCount = _historyArchive.restoredCount();
+    _status.historyRestoreMillis = _historyArchive.restoreMillis();
+  }
+  // until the time is set, the archive leaves new rollups in the history rather than stamping them
+  _historyArchive.startTask(HISTORY_ARCHIVE_CORE, HISTORY_ARCHIVE_POLL_SECONDS);
+}
+
+void Application::recordResponse(void)
+{
+  if (_status.firstResponseMillis == 0) {
+    _status.firstResponseMillis = millis();
+    LOG_INFO("First HTTP response %u ms after power up", _status.firstResponseMillis);
+  }
+}
 void Application::printLocalTime(void)
 {
   struct tm timeinfo;
   if(!getLocalTime(&timeinfo)){
-    Serial.println("Failed to obtain time");
+    LOG_WARN("NOTE - Failed to obtain time");
     return;
   }
-  Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S");
+  char time_string[64];
+  strftime(time_string, sizeof(time_string), "%A, %B %d %Y %H:%M:%S", &timeinfo);
+  LOG_INFO("%s", time_string);
 }
 
 void Application::setupWebserver(void)
 {
+  // the page templates are parsed once here rather than on every request
+  _rootTemplate.load(SPIFFS, "/index.html");
+  _rootBME680Template.load(SPIFFS, "/index_bme680.html");
+  _statsTemplate.load(SPIFFS, "/stats.html");
+
   _server.on("/", HTTP_GET, std::bind(&Application::handleRootPageRequest, this, std::placeholders::_1));
   _server.on("/index.html", HTTP_GET, std::bind(&Application::handleRootPageRequest, this, std::placeholders::_1));
   _server.on("/stats", HTTP_GET, std::bind(&Application::handleStatsPageRequest, this, std::placeholders::_1));
   _server.on("/stats.html", HTTP_GET, std::bind(&Application::handleStatsPageRequest, this, std::placeholders::_1));
+  _server.on("/api/current", HTTP_GET, std::bind(&Application::handleCurrentAPIRequest, this, std::placeholders::_1));
+  _server.on("/api/history", HTTP_GET, std::bind(&Application::handleHistoryAPIRequest, this, std::placeholders::_1));
+  _server.on("/metrics", HTTP_GET, std::bind(&Application::handleMetricsRequest, this, std::placeholders::_1));
+  _server.on("/capture/start", HTTP_POST, std::bind(&Application::handleCaptureStartRequest, this, std::placeholders::_1));
+  _server.on("/capture/stop", HTTP_POST, std::bind(&Application::handleCaptureStopRequest, this, std::placeholders::_1));
+  _server.on("/capture", HTTP_GET, std::bind(&Application::handleCaptureRequest, this, std::placeholders::_1));
+  _liveSocket.onEvent(std::bind(&Application::handleLiveSocketEvent, this,
+    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
+    std::placeholders::_4, std::placeholders::_5, std::placeholders::_6));
+  _server.addHandler(&_liveSocket);
+  // the page templates are only ever served rendered
+  _staticAssets.build(SPIFFS, "/", [](const char* path) {
+      return (strcmp(path, "/index.html") != 0) && (strcmp(path, "/index_bme680.html") != 0) && (strcmp(path, "/stats.html") != 0);
+    },
+    STATIC_ASSET_CACHE_BYTES, STATIC_ASSET_CACHE_MAX_FILE_BYTES
+  );
+  _server.addHandler(&_staticAssetHandler);
   _server.onNotFound(std::bind(&Application::handleUnassignedPath, this, std::placeholders::_1));
 
   _server.begin();
 }
 
-String Application::getContentType(String filename)
+// Asks the WiFi to reconnect every WIFI_RECONNECT_INTERVAL_MILLIS while it is down. This does
+// not wait for the connection, so sampling carries on and telemetry is queued meanwhile.
+void Application::maintainWiFi(void)
+{
+  if (!_radioEnabled) {
+    return;
+  }
+  bool connected = (WiFi.status() == WL_CONNECTED);
+  if (connected != _wifiConnected) {
+    _wifiConnected = connected;
+    if (connected) {
+      _status.ipAddress = WiFi.localIP().toString();
+      LOG_INFO("WiFi connected with IP address = %s", _status.ipAddress.c_str());
+    } else {
+      LOG_ERROR("ERROR - WiFi disconnected with status %d. Telemetry will be queued.", WiFi.status());
+      _lastReconnectMillis = millis();
+    }
+  }
+  if (!connected && (millis() - _lastReconnectMillis >= WIFI_RECONNECT_INTERVAL_MILLIS)) {
+    _lastReconnectMillis = millis();
+    LOG_INFO("Attempting to reconnect WiFi.");
+    WiFi.reconnect();
+  }
+}
+
+// Turns the radio on and off for the low power profile's radio windows. A window stays open
+// while the WiFi connects, the time is set, and queued telemetry is sent.
+void Application::updateRadio(void)
+{
+  bool busy = (_status.bootPending & (BOOT_WIFI | BOOT_TIME))
+              || !_wifiConnected
+              || _telemetryUplink.isSending()
+              || ((telemetry_url != nullptr) && (_telemetryStore.size() > 0));
+  bool radio_on = _dutyCycle.updateRadio(millis(), busy);
+  if (radio_on == _radioEnabled) {
+    return;
+  }
+  _radioEnabled = radio_on;
+  if (radio_on) {
+    LOG_DEBUG("Turning the radio on.");
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(ssid, password);
+    esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+    _lastReconnectMillis = millis();
+  } else {
+    LOG_DEBUG("Turning the radio off until %u.", _dutyCycle.nextRadioMillis());
+    // not a dropped connection, so maintainWiFi() has nothing to report
+    _wifiConnected = false;
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+  }
+}
+
+// Waits for the next pass of the loop. In the low power profile the CPU light sleeps until
+// the next sample or reading is due or the next radio window opens, if that is far enough off.
+void Application::idle(void)
 {
-  if(filename.endsWith(".htm")) return "text/html";
-  else if(filename.endsWith(".html")) return "text/html";
-  else if(filename.endsWith(".css")) return "text/css";
-  else if(filename.endsWith(".js")) return "application/javascript";
-  else if(filename.endsWith(".png")) return "image/png";
-  else if(filename.endsWith(".gif")) return "image/gif";
-  else if(filename.endsWith(".jpg")) return "image/jpeg";
-  else if(filename.endsWith(".ico")) return "image/x-icon";
-  else if(filename.endsWith(".xml")) return "text/xml";
-  else if(filename.endsWith(".pdf")) return "application/x-pdf";
-  else if(filename.endsWith(".zip")) return "application/x-zip";
-  else if(filename.endsWith(".gz")) return "application/x-gzip";
-  return "text/plain";
+#if POWER_PROFILE == POWER_PROFILE_LOW_POWER
+  if (_status.bootPending == 0) {
+    uint32_t now = millis();
+    _dutyCycle.wakeAt(_sensor.nextSampleMillis() - POWER_SAMPLE_WAKE_LEAD_MILLIS);
+#if PARTICULATE_SENSOR2_TYPE != PARTICULATE_SENSOR_NONE
+    _dutyCycle.wakeAt(_sensor2.nextSampleMillis() - POWER_SAMPLE_WAKE_LEAD_MILLIS);
+#endif
+    if (_status.hasBME680) {
+      _dutyCycle.wakeAt(_environment.nextDueMillis(now));
+    }
+    uint32_t sleep_millis = _dutyCycle.sleepMillis(now);
+    if (sleep_millis > 0) {
+      esp_sleep_enable_timer_wakeup((uint64_t)sleep_millis*1000);
+      esp_light_sleep_start();
+      _dutyCycle.slept(now, millis());
+      return;
+    }
+  }
+#endif
+  delay(10);
+}
+
+// Returns the particulate sensor with the given index, 0 being the first, or nullptr if there
+// is no such sensor.
+AirQualitySensor* Application::particulateSensor(long index)
+{
+  if (index == 0) {
+    return &_sensor;
+  }
+#if PARTICULATE_SENSOR2_TYPE != PARTICULATE_SENSOR_NONE
+  if (index == 1) {
+    return &_sensor2;
+  }
+#endif
+  return nullptr;
 }
 
 void Application::handleUnassignedPath(AsyncWebServerRequest *request)
 {
+  recordResponse();
+  // every static file is in the index, so there is no need to look in SPIFFS
+  if (_staticAssets.isBuilt()) {
+    LOG_INFO("WEB: %s - %s - UNKNOWN PATH", request->client()->remoteIP().toString().c_str(), request->url().c_str());
+    request->send(404, "text/plain", "Not found");
+    return;
+  }
   String path(request->url());
   if (path.endsWith("/")) path += "index.html";
 
@@ -150,152 +468,313 @@ void Application::handleUnassignedPath(AsyncWebServerRequest *request)
   if (path != "/index_bme680.html") {
     // now check to see if the URL is in the SPIFFS
     if (SPIFFS.exists(path)) {
-      Serial.printf("WEB: %s - %s\n", request->client()->remoteIP().toString().c_str(), path.c_str());
-      request->send(SPIFFS, path, getContentType(path));
+      LOG_INFO("WEB: %s - %s", request->client()->remoteIP().toString().c_str(), path.c_str());
+      request->send(SPIFFS, path, StaticAssetIndex::contentType(path.c_str()));
       return;
     }
   }
   // it is truely not found. Send a 404
-  Serial.printf("WEB: %s - %s - UNKNOWN PATH\n", request->client()->remoteIP().toString().c_str(), request->url().c_str());
+  LOG_INFO("WEB: %s - %s - UNKNOWN PATH", request->client()->remoteIP().toString().c_str(), request->url().c_str());
   request->send(404, "text/plain", "Not found");
 }
 
 bool Application::showEnvironmentRootPage(void) const
 {
-  return (_hasBME680 && (_latestTemperature != UNSET_ENVIRONMENT_VALUE));
+  return (_status.hasBME680 && (_status.temperature != UNSET_ENVIRONMENT_VALUE));
+}
+
+// Sends a page rendered from its template. The page is only rendered once per sensor sample,
+// and otherwise the cached page is sent. If the template could not be loaded at boot, the
+// page is rendered from SPIFFS by ESPAsyncWebServer instead.
+void Application::sendTemplatePage(AsyncWebServerRequest *request, PageTemplate& page, const String& path)
+{
+  recordResponse();
+  RenderedPagePtr rendered = page.render(_status.sampleEpoch, _templateFormatter);
+  if (!rendered) {
+    request->send(SPIFFS, path, StaticAssetIndex::contentType(path.c_str()), false, std::bind(&PageRenderer::processTemplateVariable, &_pageRenderer, std::placeholders::_1));
+    return;
+  }
+  // the response holds a reference to the rendered page, so it stays valid while it is sent
+  // even if the page is rendered again meanwhile
+  AsyncWebServerResponse *response = request->beginResponse(
+    StaticAssetIndex::contentType(path.c_str()), rendered->length,
+    [rendered](uint8_t *buffer, size_t max_length, size_t index) -> size_t {
+      size_t length = rendered->length - index;
+      if (length > max_length) {
+        length = max_length;
+      }
+      memcpy(buffer, rendered->data + index, length);
+      return length;
+    }
+  );
+  request->send(response);
 }
 
 void Application::handleRootPageRequest(AsyncWebServerRequest *request)
 {
-  String root_file = showEnvironmentRootPage() ? "/index_bme680.html" : "/index.html";
+  bool show_environment = showEnvironmentRootPage();
+  String root_file = show_environment ? "/index_bme680.html" : "/index.html";
 
-  Serial.printf("WEB: %s - %s\n", request->client()->remoteIP().toString().c_str(), request->url().c_str());
-  request->send(SPIFFS, root_file, getContentType(root_file), false, std::bind(&Application::processRootPageHTML, this, std::placeholders::_1));
-  _rootPageViewCount++;
+  LOG_INFO("WEB: %s - %s", request->client()->remoteIP().toString().c_str(), request->url().c_str());
+  sendTemplatePage(request, show_environment ? _rootBME680Template : _rootTemplate, root_file);
+  _status.rootPageViewCount++;
 }
 
 void Application::handleStatsPageRequest(AsyncWebServerRequest *request)
 {
   String stats_file = "/stats.html";
-  Serial.printf("WEB: %s - %s\n", request->client()->remoteIP().toString().c_str(), request->url().c_str());
-  request->send(SPIFFS, stats_file, getContentType(stats_file), false, std::bind(&Application::processStatsPageHTML, this, std::placeholders::_1));
+  LOG_INFO("WEB: %s - %s", request->client()->remoteIP().toString().c_str(), request->url().c_str());
+  sendTemplatePage(request, _statsTemplate, stats_file);
+}
+
+// Sends the current readings as the same JSON object that is posted as telemetry.
+void Application::handleCurrentAPIRequest(AsyncWebServerRequest *request)
+{
+  recordResponse();
+  LOG_INFO("WEB: %s - %s", request->client()->remoteIP().toString().c_str(), request->url().c_str());
+  if (_status.lastUpdateTime == 0) {
+    request->send(503, "application/json", "{\"error\":\"no sample yet\"}");
+    return;
+  }
+  TelemetryRecord record;
+  fillTelemetryRecord(_status.lastUpdateTime, record);
+
+  char json[TELEMETRY_JSON_FIXED_MAX_LENGTH + 64];
+  size_t length = writeTelemetryJSON(record, sensor_name, json, sizeof(json));
+  if (length == 0) {
+    request->send(500, "application/json", "{\"error\":\"sensor name too long\"}");
+    return;
+  }
+  AsyncResponseStream *response = request->beginResponseStream("application/json", length);
+  response->write((const uint8_t*)json, length);
+  request->send(response);
 }
 
-float Application::getAQIForHTMLTagTimeFragment(const String& fragment)
+// Sends the PM2.5 history between the from and to times (seconds since the epoch) as JSON.
+// from defaults to the oldest retained sample and to to now. The history is streamed from the
+// sample history a chunk at a time, so the response is never held in memory whole.
+void Application::handleHistoryAPIRequest(AsyncWebServerRequest *request)
 {
-  if (fragment == "CURRENT") {
-    return _sensor.currentAirQualityIndex();
-  } else if (fragment == "10MIN") {
-    return _sensor.tenMinuteAirQualityIndex();
-  } else if (fragment == "1HOUR") {
-    return _sensor.oneHourAirQualityIndex();
-  } else if (fragment == "24HOUR") {
-    return _sensor.oneDayAirQualityIndex();
+  recordResponse();
+  LOG_INFO("WEB: %s - %s", request->client()->remoteIP().toString().c_str(), request->url().c_str());
+  if (_status.lastUpdateTime == 0) {
+    request->send(503, "application/json", "{\"error\":\"no sample yet\"}");
+    return;
+  }
+  AirQualitySensor* sensor = &_sensor;
+  if (request->hasParam("sensor")) {
+    sensor = particulateSensor(request->getParam("sensor")->value().toInt());
+    if (sensor == nullptr) {
+      request->send(404, "application/json", "{\"error\":\"no such sensor\"}");
+      return;
+    }
+  }
+  time_t to = _status.lastUpdateTime;
+  time_t from = to - (time_t)sensor->getHistorySeconds();
+  size_t max_entries = API_HISTORY_MAX_ENTRIES;
+  if (request->hasParam("from")) {
+    from = request->getParam("from")->value().toInt();
+  }
+  if (request->hasParam("to")) {
+    to = request->getParam("to")->value().toInt();
+  }
+  if (request->hasParam("max")) {
+    long requested = request->getParam("max")->value().toInt();
+    if ((requested > 0) && ((size_t)requested < max_entries)) {
+      max_entries = requested;
+    }
+  }
+  if (to < from) {
+    request->send(400, "application/json", "{\"error\":\"from is after to\"}");
+    return;
   }
 
-  // should not get here. Return something obviously wrong.
-  return -1;
+  // the response owns the stream, which reads the history as the web server asks for chunks
+  std::shared_ptr<SampleHistoryStream> stream = std::make_shared<SampleHistoryStream>(
+    sensor->history(), AIR_QUALITY_SENSOR_UPDATE_SECONDS, _status.lastUpdateTime, from, to, max_entries
+  );
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+    "application/json",
+    [stream](uint8_t *buffer, size_t max_length, size_t index) -> size_t {
+      return stream->read(buffer, max_length);
+    }
+  );
+  request->send(response);
 }
 
-String Application::processRootPageHTML(const String& var)
+// Sends the pipeline counters, memory figures and stage latencies in the Prometheus text format.
+void Application::handleMetricsRequest(AsyncWebServerRequest *request)
 {
-  if(var.startsWith("AQI-")) {
-    return String(getAQIForHTMLTagTimeFragment(var.substring(4)), 1);
-  } else if (var.startsWith("COLOR-")) {
-    float aqi_value = getAQIForHTMLTagTimeFragment(var.substring(6));
+  recordResponse();
+  updateMemoryStatus();
+  updatePowerStatus();
+  AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4", METRICS_RESPONSE_BUFFER_BYTES);
+  _pageRenderer.writeMetrics(*response);
+  request->send(response);
+}
 
-    switch (AirQualitySensor::getAQIStatusColor(aqi_value)) {
-      case AQI_GREEN:
-        return String("aqi-green");
-        break;
-      case AQI_YELLOW:
-        return String("aqi-yellow");
-        break;
-      case AQI_ORANGE:
-        return String("aqi-orange");
-        break;
-      case AQI_RED:
-        return String("aqi-red");
-        break;
-      case AQI_PURPLE:
-        return String("aqi-purple");
-        break;
-      default:
-      case AQI_MAROON:
-        return String("aqi-maroon");
+// Sends the last finished UART capture for replaying on the host. The file is not sent while it
+// is still being written.
+void Application::handleCaptureRequest(AsyncWebServerRequest *request)
+{
+  recordResponse();
+  LOG_INFO("WEB: %s - %s", request->client()->remoteIP().toString().c_str(), request->url().c_str());
+  if (_uartCapture.isRecording()) {
+    request->send(409, "application/json", "{\"error\":\"capture in progress\"}");
+    return;
+  }
+  if (!SPIFFS.exists(_uartCapture.path())) {
+    request->send(404, "application/json", "{\"error\":\"no capture\"}");
+    return;
+  }
+  request->send(SPIFFS, _uartCapture.path(), "application/octet-stream", true);
+}
+
+// Starts capturing the sensor's UART for the given seconds. The capture is started by the loop.
+void Application::handleCaptureStartRequest(AsyncWebServerRequest *request)
+{
+  recordResponse();
+  LOG_INFO("WEB: %s - %s", request->client()->remoteIP().toString().c_str(), request->url().c_str());
+  if (!_uartCapture.isEnabled()) {
+    request->send(503, "application/json", "{\"error\":\"capture is not available\"}");
+    return;
+  }
+  long seconds = UART_CAPTURE_DEFAULT_SECONDS;
+  if (request->hasParam("seconds")) {
+    seconds = request->getParam("seconds")->value().toInt();
+  }
+  if (seconds <= 0) {
+    request->send(400, "application/json", "{\"error\":\"seconds must be positive\"}");
+    return;
+  }
+  _uartCapture.requestStart(seconds);
+  request->send(202, "application/json", "{\"status\":\"starting\"}");
+}
+
+void Application::handleCaptureStopRequest(AsyncWebServerRequest *request)
+{
+  recordResponse();
+  LOG_INFO("WEB: %s - %s", request->client()->remoteIP().toString().c_str(), request->url().c_str());
+  _uartCapture.requestStop();
+  request->send(202, "application/json", "{\"status\":\"stopping\"}");
+}
+
+// Runs on the web server's task, so connects and disconnects are only queued for the loop,
+// which owns the live dashboard clients.
+void Application::handleLiveSocketEvent(AsyncWebSocket *socket, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t length)
+{
+  if ((type != WS_EVT_CONNECT) && (type != WS_EVT_DISCONNECT)) {
+    return;
+  }
+  LiveClientEvent event = {client->id(), (type == WS_EVT_CONNECT)};
+  if (!_liveClientEvents.push(event)) {
+    LOG_ERROR("ERROR - Live dashboard event queue is full.");
+    if (type == WS_EVT_CONNECT) {
+      client->close();
+    }
+  }
+}
+
+// Keeps track of the live dashboard clients, and sends a newly connected one the current
+// readings so it doesn't wait for the next sample.
+void Application::handleLiveClientEvents(void)
+{
+  LiveClientEvent event;
+  while (_liveClientEvents.pop(event)) {
+    if (!event.connected) {
+      for (size_t i = 0; i < LIVE_UPDATE_MAX_CLIENTS; i++) {
+        if (_liveClients[i].id == event.id) {
+          _liveClients[i].id = 0;
+        }
+      }
+      continue;
+    }
+    AsyncWebSocketClient *client = _liveSocket.client(event.id);
+    if (client == nullptr) {
+      // it has already disconnected
+      continue;
+    }
+    LiveClient* slot = nullptr;
+    for (size_t i = 0; i < LIVE_UPDATE_MAX_CLIENTS; i++) {
+      if ((_liveClients[i].id == 0) || (_liveSocket.client(_liveClients[i].id) == nullptr)) {
+        slot = &_liveClients[i];
         break;
+      }
     }
-  } else if (var == "SENSORNAME") {
-    return String(sensor_name);
-  } else if (var == "TEMPERATURE") {
-    float degreesF = _latestTemperature*9.0/5.0 + 32.0;
-    return String(degreesF, 1);
-  } else if (var == "PRESSURE") {
-    return String(_latestPressure, 1);
-  } else if (var == "HUMIDITY") {
-    return String(_latestHumidity, 1);
-  }
-  return String();
-}
-
-String Application::processStatsPageHTML(const String& var)
-{
-  if (var == "PERCENT") {
-    return String("%");
-  } else if (var == "WIFISSID") {
-    return String(ssid);
-  } else if (var == "IPADDRESS") {
-    return WiFi.localIP().toString();
-  } else if (var == "BOOTTIME") {
-    return convertEpochToString(_boot_time);
-  } else if (var == "LASTMEASURETIME") {
-    if (_last_update_time == 0) {
-      return String("None");
+    if (slot == nullptr) {
+      LOG_INFO("WEB: %s - %s - too many live dashboards", client->remoteIP().toString().c_str(), _liveSocket.url());
+      client->close();
+      continue;
     }
-    return convertEpochToString(_last_update_time);
-  } else if (var == "LASTTRANSMIT") {
-    if (_last_transmit_time == 0) {
-      return String("None");
+    slot->skipped = 0;
+    slot->id = event.id;
+    LOG_INFO("WEB: %s - %s - live dashboard connected", client->remoteIP().toString().c_str(), _liveSocket.url());
+    if (_status.lastUpdateTime != 0) {
+      char json[LIVE_UPDATE_MAX_LENGTH];
+      size_t json_length = _pageRenderer.formatLiveUpdate(json, sizeof(json));
+      client->text(json, json_length);
     }
-    return convertEpochToString(_last_transmit_time);
-  } else if (var == "HISTORYSIZE") {
-    return String(_sensor.getHistoryCount());
-  } else if (var == "HASBME680") {
-    if (_hasBME680) {
-      return String("True");
-    } else {
-      return String("False");
+  }
+}
+
+// Pushes the readings to the live dashboards. The update is formatted once into a message
+// buffer that every client's queued message shares. Clients that are still behind on earlier
+// updates are skipped rather than queued more, and disconnected if they don't catch up.
+void Application::broadcastLiveUpdate(void)
+{
+  AsyncWebSocketClient *recipients[LIVE_UPDATE_MAX_CLIENTS];
+  size_t recipient_count = 0;
+  uint32_t client_count = 0;
+  for (size_t i = 0; i < LIVE_UPDATE_MAX_CLIENTS; i++) {
+    LiveClient& state = _liveClients[i];
+    AsyncWebSocketClient *client = (state.id != 0) ? _liveSocket.client(state.id) : nullptr;
+    if (client == nullptr) {
+      continue;
     }
-  } else if (var == "MEASURERATE") {
-    char s[32];
-    snprintf(s, sizeof(s), "%d seconds", AIR_QUALITY_SENSOR_UPDATE_SECONDS);
-    return String(s);
-  } else if (var == "TRANSMITRATE") {
-    char s[32];
-    snprintf(s, sizeof(s), "%d seconds", AIR_QUALITY_SENSOR_UPDATE_SECONDS*AIR_QUALITY_DATA_TRANSMIT_MULTIPLE);
-    return String(s);
-  } else if (var == "TRANSMITURL") {
-    if (telemetry_url == nullptr) {
-      return String("None");
-    } else {
-      return String(telemetry_url);
+    client_count++;
+    if (client->queueIsFull() || (client->queueLen() >= LIVE_UPDATE_MAX_QUEUED)) {
+      _status.liveSkippedCount++;
+      if (++state.skipped >= LIVE_UPDATE_MAX_SKIPPED) {
+        LOG_INFO("WEB: %s - disconnecting live dashboard that stopped reading updates", client->remoteIP().toString().c_str());
+        _status.liveDroppedCount++;
+        client->close();
+      }
+      continue;
     }
-  } else if (var == "PDSTATUS") {
-    return String(_sensor.statusParticleDetector());
-  } else if (var == "LASERSTATUS") {
-    return String(_sensor.statusLaser());
-  } else if (var == "FANSTATUS") {
-    return String(_sensor.statusFan());
-  } else if (var == "ROOTVIEWCOUNT") {
-    return String(_rootPageViewCount);
+    state.skipped = 0;
+    recipients[recipient_count++] = client;
   }
+  _status.liveClientCount = client_count;
 
-  return String();
+  if (recipient_count > 0) {
+    char json[LIVE_UPDATE_MAX_LENGTH];
+    size_t length = _pageRenderer.formatLiveUpdate(json, sizeof(json));
+    AsyncWebSocketMessageBuffer *buffer = _liveSocket.makeBuffer(length);
+    if (buffer != nullptr) {
+      memcpy(buffer->get(), json, length);
+      if (recipient_count == client_count) {
+        // textAll() also frees the socket's buffers that every client has finished sending
+        _liveSocket.textAll(buffer);
+      } else {
+        // held so that it isn't freed before every recipient has queued it
+        buffer->lock();
+        for (size_t i = 0; i < recipient_count; i++) {
+          recipients[i]->text(buffer);
+        }
+        buffer->unlock();
+      }
+      _status.liveUpdateCount += recipient_count;
+    }
+  }
+  // frees the clients that have disconnected, and closes the oldest beyond the limit
+  _liveSocket.cleanupClients(LIVE_UPDATE_MAX_CLIENTS);
 }
+
 void Application::setupLED(void)
 {
 #if MCU_BOARD_TYPE == MCU_TINYPICO
-  _tinyPICO.DotStar_SetPower(true);
+  // the LED is left off in the low power profile
+  _tinyPICO.DotStar_SetPower(POWER_PROFILE != POWER_PROFILE_LOW_POWER);
   _tinyPICO.DotStar_Clear();
   _tinyPICO.DotStar_SetBrightness(STATUS_LED_BRIGHTNESS);
 #elif MCU_BOARD_TYPE == MCU_EZSBC_IOT
@@ -362,129 +841,337 @@ void Application::setLEDColorForAQI(float aqi_value)
 #endif
 }
 
-void Application::loop(void)
+void Application::fillTelemetryRecord(time_t timestamp, TelemetryRecord& record)
 {
-  // slow down loop calls for the sensor
-  _loopCounter++;
-  if (_loopCounter%1000 != 0) {
+  float current_avg_pm2p5 = _sensor.currentAveragePM2p5();
+  float ten_minutes_avg_pm2p5 = _sensor.tenMinuteAveragePM2p5();
+  float one_hour_avg_pm2p5 = _sensor.oneHourAveragePM2p5();
+  float one_day_avg_pm2p5 = _sensor.oneDayAveragePM2p5();
+
+  record.timestamp = timestamp;
+  record.uptime = timestamp - _status.bootTime;
+  record.pm1p0 = _sensor.PM1p0();
+  record.pm2p5 = _sensor.PM2p5();
+  record.pm10 = _sensor.PM10();
+  record.particleCount0p5um = _sensor.particalCount0p5();
+  record.particleCount1p0um = _sensor.particalCount1p0();
+  record.particleCount2p5um = _sensor.particalCount2p5();
+  record.particleCount5p0um = _sensor.particalCount5p0();
+  record.particleCount7p5um = _sensor.particalCount7p5();
+  record.particleCount10um = _sensor.particalCount10();
+  record.statusParticleDetector = _sensor.statusParticleDetector();
+  record.statusLaser = _sensor.statusLaser();
+  record.statusFan = _sensor.statusFan();
+  record.averagePM2p5Current = current_avg_pm2p5;
+  record.averagePM2p5TenMinute = ten_minutes_avg_pm2p5;
+  record.averagePM2p5OneHour = one_hour_avg_pm2p5;
+  record.averagePM2p5OneDay = one_day_avg_pm2p5;
+  record.aqiCurrent = _sensor.airQualityIndex(current_avg_pm2p5);
+  record.aqiTenMinute = _sensor.airQualityIndex(ten_minutes_avg_pm2p5);
+  record.aqiOneHour = _sensor.airQualityIndex(one_hour_avg_pm2p5);
+  record.aqiOneDay = _sensor.airQualityIndex(one_day_avg_pm2p5);
+  SampleWindowSpread spreads[TELEMETRY_SPREAD_WINDOW_COUNT] = {
+    _sensor.tenMinuteSpreadPM2p5(),
+    _sensor.oneHourSpreadPM2p5(),
+    _sensor.oneDaySpreadPM2p5()
+  };
+  for (uint8_t i = 0; i < TELEMETRY_SPREAD_WINDOW_COUNT; i++) {
+    record.pm2p5Spread[i].min = spreads[i].min;
+    record.pm2p5Spread[i].max = spreads[i].max;
+    record.pm2p5Spread[i].p50 = spreads[i].p50;
+    record.pm2p5Spread[i].p95 = spreads[i].p95;
+    record.pm2p5Spread[i].p99 = spreads[i].p99;
+  }
+  record.temperature = _status.temperature;
+  record.pressure = _status.pressure;
+  record.humidity = _status.humidity;
+  record.gasResistance = _environment.hasReading() ? _environment.latestReading().gasResistance : 0;  // ohms
+}
+
+void Application::setupChannelHistory(void)
+{
+  size_t bytes = CHANNEL_HISTORY_BYTES_RAM;
+  if (ESP.getPsramSize() > 0) {
+    _channelHistoryStorage = ps_malloc(CHANNEL_HISTORY_BYTES_PSRAM);
+    bytes = CHANNEL_HISTORY_BYTES_PSRAM;
+  }
+  if (_channelHistoryStorage == nullptr) {
+    _channelHistoryStorage = malloc(CHANNEL_HISTORY_BYTES_RAM);
+    bytes = CHANNEL_HISTORY_BYTES_RAM;
+  }
+  if ((_channelHistoryStorage == nullptr) || !_channelHistory.setStorage(_channelHistoryStorage, bytes, HISTORY_CHANNEL_COUNT)) {
+    LOG_ERROR("ERROR - Could not allocate the channel history. Only PM2.5 history will be retained.");
     return;
   }
+  LOG_INFO("Channel history has %d blocks of %d bytes", _channelHistory.blockCount(), COLUMNAR_HISTORY_BLOCK_BYTES);
+}
 
-  time_t timestamp;
-  time(&timestamp);
+// Allocates the BME680 channel histories, which hold the longest environment averaging window.
+void Application::setupEnvironmentHistory(void)
+{
+  size_t sample_capacity = EnvironmentSensor::sampleCapacity(_environment.periodMillis());
+  size_t bytes = EnvironmentSensor::storageBytes(sample_capacity);
+  if (ESP.getPsramSize() > 0) {
+    _environmentStorage = ps_malloc(bytes);
+  }
+  if (_environmentStorage == nullptr) {
+    _environmentStorage = malloc(bytes);
+  }
+  if (_environmentStorage == nullptr) {
+    LOG_ERROR("ERROR - Could not allocate %d bytes for the environment history. Environment averages will not be kept.", bytes);
+    sample_capacity = 0;
+  }
+  _environment.setStorage(_environmentStorage, sample_capacity);
+  LOG_INFO("Environment history retains %d readings every %d seconds", sample_capacity, ENVIRONMENT_SAMPLE_SECONDS);
+}
 
-  if ((timestamp - _last_update_time) < AIR_QUALITY_SENSOR_UPDATE_SECONDS) {
+// Steps the BME680 reading, and updates the current environment readings once one finishes.
+void Application::updateEnvironment(void)
+{
+  uint32_t finished_count = _environment.readingCount() + _environment.failureCount();
+  _environment.poll(millis());
+  if (_environment.readingCount() + _environment.failureCount() == finished_count) {
     return;
   }
+  if (_environment.hasReading()) {
+    const EnvironmentReading& reading = _environment.latestReading();
+    _status.temperature = reading.temperature;
+    _status.pressure = reading.pressure;
+    _status.humidity = reading.humidity;
+  } else {
+    _status.temperature = UNSET_ENVIRONMENT_VALUE;
+    _status.pressure = UNSET_ENVIRONMENT_VALUE;
+    _status.humidity = UNSET_ENVIRONMENT_VALUE;
+  }
+}
 
-  Serial.println(F("Fetching current sensor data."));
-  _last_update_time = timestamp;
-
-  unsigned long bme680EndTime = 0;
-  if (_hasBME680) {
-    // Tell BME680 to begin measurement.
-    bme680EndTime = _bme680.beginReading();
-    if (bme680EndTime == 0) {
-      Serial.println(F("    ERROR - Failed to begin BME680 reading"));
+// Adds the current readings to the means for the next channel history row, and pushes the
+// row once CHANNEL_HISTORY_INTERVAL_SECONDS have passed.
+void Application::recordChannelHistory(time_t timestamp)
+{
+  if (_channelHistory.columnCount() == 0) {
+    return;
+  }
+  bool has_environment = _status.hasBME680 && _environment.hasReading();
+  const int32_t values[HISTORY_CHANNEL_COUNT] = {
+    (int32_t)_sensor.PM1p0(),
+    (int32_t)_sensor.PM2p5(),
+    (int32_t)_sensor.PM10(),
+    _sensor.particalCount0p5(),
+    _sensor.particalCount1p0(),
+    _sensor.particalCount2p5(),
+    _sensor.particalCount5p0(),
+    _sensor.particalCount7p5(),
+    _sensor.particalCount10(),
+    (_sensor.statusParticleDetector() << 4) | (_sensor.statusLaser() << 2) | _sensor.statusFan(),
+    has_environment ? (int32_t)lroundf(_status.temperature*100) : COLUMNAR_HISTORY_MISSING,
+    has_environment ? (int32_t)lroundf(_status.humidity*100) : COLUMNAR_HISTORY_MISSING,
+    has_environment ? (int32_t)lroundf(_status.pressure*10) : COLUMNAR_HISTORY_MISSING,
+    (has_environment && (_environment.latestReading().gasResistance > 0))
+      ? (int32_t)_environment.latestReading().gasResistance : COLUMNAR_HISTORY_MISSING,
+  };
+  for (uint8_t c = 0; c < HISTORY_CHANNEL_COUNT; c++) {
+    if (values[c] == COLUMNAR_HISTORY_MISSING) {
+      continue;
+    }
+    if (c == HISTORY_CHANNEL_SENSOR_STATUS) {
+      // status bits can't be averaged, so the row keeps the latest
+      _channelSums[c] = values[c];
+      _channelSampleCounts[c] = 1;
+    } else {
+      _channelSums[c] += values[c];
+      _channelSampleCounts[c]++;
     }
   }
-  if (!_sensor.updateSensorReading()) {
+  if (_channelLastRowTime == 0) {
+    _channelLastRowTime = timestamp;
+  }
+  if ((uint32_t)timestamp - _channelLastRowTime < CHANNEL_HISTORY_INTERVAL_SECONDS) {
     return;
   }
+  _channelLastRowTime = timestamp;
 
-  // check in on BME 680 
-  if (_hasBME680 && (bme680EndTime > 0)) {
-    if (_bme680.endReading()) {
-      _latestTemperature = _bme680.temperature;        // °C
-      _latestPressure = _bme680.pressure / 100.0;      // hPa
-      _latestHumidity = _bme680.humidity;              // %
-    } else {
-      Serial.println(F("    ERROR could not finish BME68 reaing."));
-      _latestTemperature = UNSET_ENVIRONMENT_VALUE;
-      _latestPressure = UNSET_ENVIRONMENT_VALUE;
-      _latestHumidity = UNSET_ENVIRONMENT_VALUE;
-    }
+  int32_t row[HISTORY_CHANNEL_COUNT];
+  for (uint8_t c = 0; c < HISTORY_CHANNEL_COUNT; c++) {
+    row[c] = (_channelSampleCounts[c] > 0) ? (int32_t)(_channelSums[c]/(int64_t)_channelSampleCounts[c]) : COLUMNAR_HISTORY_MISSING;
+    _channelSums[c] = 0;
+    _channelSampleCounts[c] = 0;
+  }
+  _channelHistory.push(row);
+  _status.channelHistoryRows = _channelHistory.size();
+  _status.channelHistorySeconds = _channelHistory.size()*CHANNEL_HISTORY_INTERVAL_SECONDS;
+  _status.channelHistoryBytes = _channelHistory.bytesInUse();
+}
+
+void Application::loop(void)
+{
+#if POWER_PROFILE == POWER_PROFILE_LOW_POWER
+  updateRadio();
+#endif
+  maintainWiFi();
+  if (_status.bootPending != 0) {
+    stepBoot();
+  }
+  _telemetryClient.loop();
+  handleLiveClientEvents();
+  // writes the bytes the acquisition task captured to flash
+  _uartCapture.poll(millis());
+  if (telemetry_url != nullptr) {
+    _telemetryUplink.loop(millis(), _wifiConnected);
+    updateTelemetryStatus();
+  }
+
+  // The BME680 is read on its own cadence. A reading is started when one is due and read out on
+  // a later pass once the sensor is done, so the loop never waits on the gas heater.
+  if (_status.hasBME680 && _environment.isDue(millis())) {
+    StageTimer timer(_loopLatency[LOOP_STAGE_BME680]);
+    updateEnvironment();
   }
-  float ten_minutes_avg_pm2p5 = _sensor.averagePM2p5(60*10);
-  float aqi_10min = _sensor.airQualityIndex(ten_minutes_avg_pm2p5);
-  setLEDColorForAQI(aqi_10min);
 
-  if (  (telemetry_url == nullptr)
-      ||(timestamp - _last_transmit_time) < AIR_QUALITY_SENSOR_UPDATE_SECONDS*AIR_QUALITY_DATA_TRANSMIT_MULTIPLE) 
+#if PARTICULATE_SENSOR2_TYPE != PARTICULATE_SENSOR_NONE
+  // the second sensor's samples only go into its own history
+  _sensor2.updateSensorReading();
+#endif
+
+  // Samples are acquired on their own task at the AIR_QUALITY_SENSOR_UPDATE_SECONDS cadence.
+  // Handle each one as it arrives, and otherwise yield so the loop doesn't spin. Samples wait
+  // in the queue until the history has been restored.
+  if ((_status.bootPending & BOOT_HISTORY) || !_sensor.updateSensorReading()) {
+    idle();
+    return;
+  }
+  _dutyCycle.countSample();
+
+  time_t timestamp;
+  time(&timestamp);
+  LOG_DEBUG("Processing new sensor sample.");
+  _status.lastUpdateTime = timestamp;
+
+#if POWER_PROFILE != POWER_PROFILE_LOW_POWER
+  {
+    StageTimer timer(_loopLatency[LOOP_STAGE_LED]);
+    float aqi_10min = _sensor.airQualityIndex(_sensor.tenMinuteAveragePM2p5());
+    setLEDColorForAQI(aqi_10min);
+  }
+#endif
+  {
+    StageTimer timer(_loopLatency[LOOP_STAGE_HISTORY]);
+    recordChannelHistory(timestamp);
+  }
+  if (_historyArchive.isEnabled() && !_historyArchive.isTaskRunning()) {
+    _historyArchive.poll(timestamp);
+  }
+  _status.historyArchivedCount = _historyArchive.archivedCount();
+  _status.historyArchiveWriteCount = _historyArchive.writeCount();
+  _status.historyArchiveFailedCount = _historyArchive.failedWriteCount();
+  _status.staticServedCount = _staticAssetHandler.servedCount();
+  _status.staticNotModifiedCount = _staticAssetHandler.notModifiedCount();
+  _status.staticFlashReadCount = _staticAssetHandler.flashReadCount();
+  // cached pages are rendered again on their next request
+  _status.sampleEpoch++;
   {
+    StageTimer timer(_loopLatency[LOOP_STAGE_LIVE]);
+    broadcastLiveUpdate();
+  }
+  updateMemoryStatus();
+  updatePowerStatus();
+
+  if (telemetry_url == nullptr) {
     return;
   }
 
-  _last_transmit_time = timestamp;
-  float current_avg_pm2p5 = _sensor.averagePM2p5(AIR_QUALITY_SENSOR_UPDATE_SECONDS);
-  float one_hour_avg_pm2p5 = _sensor.averagePM2p5(60*60);
-  float one_day_avg_pm2p5 = _sensor.averagePM2p5(60*60*24);
-
-  DynamicJsonDocument doc(1024);
-  doc["timestamp"] = timestamp;
-  doc["sensor_id"] = sensor_name;
-  doc["uptime"] = (timestamp - _boot_time);
-  doc["mass_density"]["pm1p0"] = _sensor.PM1p0();
-  doc["mass_density"]["pm2p5"] = _sensor.PM2p5();
-  doc["mass_density"]["pm10"] = _sensor.PM10();
-  doc["particle_count"]["0p5um"] = _sensor.particalCount0p5();
-  doc["particle_count"]["1p0um"] = _sensor.particalCount1p0();
-  doc["particle_count"]["2p5um"] = _sensor.particalCount2p5();
-  doc["particle_count"]["5p0um"] = _sensor.particalCount5p0();
-  doc["particle_count"]["7p5um"] = _sensor.particalCount7p5();
-  doc["particle_count"]["10um"] = _sensor.particalCount10();
-  doc["sensor_status"]["partical_detector"] = _sensor.statusParticleDetector();
-  doc["sensor_status"]["laser"] = _sensor.statusLaser();
-  doc["sensor_status"]["fan"] = _sensor.statusFan();
-  doc["air_quality_index"]["average_pm2p5_current"] = current_avg_pm2p5;
-  doc["air_quality_index"]["average_pm2p5_10min"] = ten_minutes_avg_pm2p5;
-  doc["air_quality_index"]["average_pm2p5_1hour"] = one_hour_avg_pm2p5;
-  doc["air_quality_index"]["average_pm2p5_24hour"] = one_day_avg_pm2p5;
-  doc["air_quality_index"]["aqi_current"] = _sensor.airQualityIndex(current_avg_pm2p5);
-  doc["air_quality_index"]["aqi_10min"] = aqi_10min;
-  doc["air_quality_index"]["aqi_1hour"] = _sensor.airQualityIndex(one_hour_avg_pm2p5);
-  doc["air_quality_index"]["aqi_24hour"] = _sensor.airQualityIndex(one_day_avg_pm2p5);
-  doc["environment"]["temperature"] = _latestTemperature;
-  doc["environment"]["pressure"] = _latestPressure;
-  doc["environment"]["humidity"] = _latestHumidity;
-  doc["environment"]["gas_resistance"] = _bme680.gas_resistance;  // ohms
-
-  Serial.print(F("    json payload = "));
-  serializeJson(doc, Serial);
+  TelemetryRecord record;
+  fillTelemetryRecord(timestamp, record);
+  if (_telemetryUplink.offer(record, _wifiConnected)) {
+    _status.lastTransmitTime = timestamp;
+  }
+  updateTelemetryStatus();
+}
+
+void Application::updateTelemetryStatus(void)
+{
+  _status.telemetryBatchSize = _telemetryBatch.size();
+  _status.telemetryQueuedCount = _telemetryStore.size();
+  _status.telemetrySpilledCount = _telemetryStore.spilledSize();
+  _status.telemetryDroppedCount = _telemetryStore.droppedCount();
+  _status.telemetryRequestCount = _telemetryUplink.requestCount();
+  _status.telemetryFailureCount = _telemetryUplink.failureCount();
+  _status.telemetryConnectionCount = _telemetryClient.connectionCount();
+}
+
+void Application::updatePowerStatus(void)
+{
+  DutyCycleStats stats = _dutyCycle.stats(millis());
+  _status.dutyCycle = stats.dutyCycle;
+  _status.wakeCount = stats.wakeCount;
+  _status.radioWakeCount = stats.radioWakeCount;
+  _status.averageMilliamps = stats.averageMilliamps;
+  _status.energyPerSampleMillijoules = stats.energyPerSampleMillijoules;
+}
+
+void Application::updateMemoryStatus(void)
+{
+  _status.heapSize = ESP.getHeapSize();
+  _status.heapMinFree = ESP.getMinFreeHeap();
+  _status.psramSize = ESP.getPsramSize();
+  _status.psramMinFree = ESP.getMinFreePsram();
+}
+
+// Posts a telemetry payload for the uplink. Returns false if the payload could not be queued.
+bool Application::postTelemetry(const char* payload, size_t length, uint8_t kind)
+{
+  LOG_INFO("    Sending %s telemetry batch of %d bytes", (kind == TELEMETRY_UPLINK_LIVE) ? "live" : "queued", length);
+#if TELEMETRY_ECHO_PAYLOAD
+  Serial.write((const uint8_t*)payload, length);
   Serial.print(F("\n"));
+#endif
+  if (_telemetryClient.isAvailable()) {
+    StageTimer timer(_loopLatency[LOOP_STAGE_POST]);
+    // the payload is copied by the client, so the batch can be refilled right away
+    return _telemetryClient.post(
+      payload, length,
+      std::bind(&Application::handleTelemetryResult, this, kind, std::placeholders::_1)
+    );
+  }
+  // a blocking post can outlast the cycle counter wrapping, so it is timed with micros()
+  uint32_t start_micros = micros();
+  int httpResponseCode = postTelemetrySynchronously(payload, length);
+  _loopLatency[LOOP_STAGE_POST].record(micros() - start_micros);
+  _telemetryUplink.reportResult(kind, (httpResponseCode >= 200) && (httpResponseCode < 300));
+  return true;
+}
 
+int Application::postTelemetrySynchronously(const char* payload, size_t length)
+{
+  HTTPClient http;
 
-  if (WiFi.status() == WL_CONNECTED) {
-    HTTPClient http;
-    String requestBody;
+  http.begin(telemetry_url);  
+  http.addHeader("Content-Type", "application/json");
 
-    http.begin(telemetry_url);  
-    http.addHeader("Content-Type", "application/json");
+  int httpResponseCode = http.POST((uint8_t*)payload, length);
+  if (httpResponseCode>0) {
+    // only the start of the response is logged, so read it into a small buffer rather than a String
+    char response[64];
+    int response_length = http.getStreamPtr()->read((uint8_t*)response, sizeof(response) - 1);
+    response[(response_length > 0) ? response_length : 0] = '\0';
 
-    serializeJson(doc, requestBody);
-    int httpResponseCode = http.POST(requestBody);
-    if (httpResponseCode>0) {
-      String response = http.getString();
-      response.trim();
+    LOG_INFO("    POSTED data to telemetry service with response code = %d and response = \"%s\"", httpResponseCode, response);
+  } else {
+    LOG_ERROR("    ERROR when posting JSON = %d", httpResponseCode);
+  }
+  return httpResponseCode;
+}
 
-      Serial.print(F("    POSTED data to telemetry service with response code = "));                
-      Serial.print(httpResponseCode);  
-      Serial.print(" and response = \"");
-      Serial.print(response);
-      Serial.print("\"\n");
-    } else {
-      Serial.printf("    ERROR when posting JSON = %d\n", httpResponseCode);
-    }
+// Called on the AsyncTCP task when a telemetry request finishes.
+void Application::handleTelemetryResult(uint8_t kind, const TelemetryResult& result)
+{
+  _telemetryUplink.reportResult(kind, (result.statusCode >= 200) && (result.statusCode < 300));
+  if (result.statusCode > 0) {
+    LOG_INFO(
+      "POSTED data to telemetry service with response code = %d in %u ms and response = \"%s\"",
+      result.statusCode, result.elapsedMicros/1000, result.responseBody
+    );
   } else {
-      Serial.print(F("    ERROR - WiFi status is "));
-      Serial.print(WiFi.status());
-      Serial.print(F(", attempting to reconnect."));
-      if (WiFi.reconnect()) {
-        Serial.print(F("    WiFi reconnected with IP address = "));
-        Serial.print(WiFi.localIP());
-        Serial.print(F("\n"));
-      } else {
-        Serial.println(F("    ERROR - failed to reconnect WiFi."));
-      }
+    LOG_ERROR("ERROR when posting telemetry = %d", result.statusCode);
   }
-}
\ No newline at end of file
+}
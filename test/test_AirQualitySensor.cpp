@@ -2,6 +2,9 @@
 #include <Arduino.h>
 #include <unity.h>
 #include "AirQualitySensor.h"
+#include "AQIScale.h"
+#include "NowCast.h"
+#include "ParticulateSensorDriver.h"
 #include "test_AirQualitySensor.h"
 
 void test_getAQIStatusColor( void ) {
@@ -19,4 +22,203 @@ void test_getAQIStatusColor( void ) {
     TEST_ASSERT_EQUAL_INT(AQI_MAROON, AirQualitySensor::getAQIStatusColor(500));
 }
 
-#endif
\ No newline at end of file
+void test_AQIScale_breakpoints( void ) {
+    const AQIScale& epa2012 = AQI_SCALES[AQI_SCALE_EPA_2012];
+    TEST_ASSERT_EQUAL_FLOAT(0, aqiFromConcentration(epa2012, 0));
+    TEST_ASSERT_EQUAL_FLOAT(25, aqiFromConcentration(epa2012, 6));
+    TEST_ASSERT_EQUAL_FLOAT(100, aqiFromConcentration(epa2012, 35.4));
+    TEST_ASSERT_EQUAL_FLOAT(175, aqiFromConcentration(epa2012, 102.9));
+    TEST_ASSERT_EQUAL_FLOAT(400, aqiFromConcentration(epa2012, 350.4));
+    // extrapolated from the last segment
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 566.84, aqiFromConcentration(epa2012, 600));
+
+    const AQIScale& epa2024 = AQI_SCALES[AQI_SCALE_EPA_2024];
+    TEST_ASSERT_EQUAL_FLOAT(50, aqiFromConcentration(epa2024, 9));
+    TEST_ASSERT_EQUAL_FLOAT(200, aqiFromConcentration(epa2024, 125.4));
+    TEST_ASSERT_EQUAL_FLOAT(400, aqiFromConcentration(epa2024, 275.4));
+
+    const AQIScale& pm10 = AQI_SCALES[AQI_SCALE_EPA_PM10];
+    TEST_ASSERT_EQUAL_FLOAT(50, aqiFromConcentration(pm10, 54));
+    TEST_ASSERT_EQUAL_FLOAT(125, aqiFromConcentration(pm10, 204));
+
+    const AQIScale& naqi = AQI_SCALES[AQI_SCALE_INDIA_NAQI_PM2P5];
+    TEST_ASSERT_EQUAL_FLOAT(150, aqiFromConcentration(naqi, 75));
+    TEST_ASSERT_EQUAL_INT(2, aqiCategory(naqi, 150));
+    TEST_ASSERT_EQUAL_INT(2, aqiCategory(naqi, 200));
+    TEST_ASSERT_EQUAL_INT(3, aqiCategory(naqi, 201));
+    TEST_ASSERT_EQUAL_INT(5, aqiCategory(naqi, 450));
+
+    UARTParticulateSensorDriver<SNGCJA5Protocol> driver(Serial1, 33, 32);
+
+    AirQualitySensor sensor(driver, 2);
+    TEST_ASSERT_EQUAL_FLOAT(aqiFromConcentration(PM2P5_AQI_SCALE, 20), sensor.airQualityIndex(20));
+    TEST_ASSERT_EQUAL_FLOAT(aqiFromConcentration(PM10_AQI_SCALE, 20), sensor.pm10AirQualityIndex(20));
+}
+
+// frame time of a sample in the given quarter of the given hour
+static uint32_t nowCastMillis(uint32_t hour, uint32_t quarter)
+{
+    return 1000 + hour*NOWCAST_HOUR_MILLIS + quarter*(NOWCAST_HOUR_MILLIS/4);
+}
+
+void test_NowCast_hourly( void ) {
+    NowCast nowcast;
+
+    // hour 0 averages 10 and hour 1 averages 20. Not valid until the second hour completes.
+    const uint32_t first_hours[] = {8, 12, 10, 10, 20, 20, 20, 20};
+    for (uint32_t i = 0; i < sizeof(first_hours)/sizeof(first_hours[0]); i++) {
+        nowcast.push(first_hours[i], nowCastMillis(i/4, i%4));
+        TEST_ASSERT_FALSE(nowcast.valid());
+    }
+    nowcast.push(100, nowCastMillis(2, 0));
+    TEST_ASSERT_TRUE(nowcast.valid());
+    TEST_ASSERT_EQUAL_INT(2, nowcast.hourCount());
+    TEST_ASSERT_EQUAL_FLOAT(20, nowcast.hourlyAverage(0));
+    TEST_ASSERT_EQUAL_FLOAT(10, nowcast.hourlyAverage(1));
+    // w = 10/20 = 0.5, so (20 + 0.5*10)/(1 + 0.5)
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 16.6667, nowcast.value());
+
+    // a partial hour does not change the NowCast
+    for (uint32_t i = 1; i < 4; i++) {
+        nowcast.push(100, nowCastMillis(2, i));
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 16.6667, nowcast.value());
+    nowcast.push(100, nowCastMillis(3, 0));
+    // w = 10/100 is clamped to 0.5, so (100 + 0.5*20 + 0.25*10)/(1 + 0.5 + 0.25)
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 64.2857, nowcast.value());
+
+    // an hour without samples is kept as an hour without data, and still ages the hours before it
+    nowcast.push(100, nowCastMillis(5, 0));
+    TEST_ASSERT_EQUAL_INT(5, nowcast.hourCount());
+    TEST_ASSERT_FALSE(nowcast.hasData(0));
+    TEST_ASSERT_TRUE(nowcast.hasData(1));
+    TEST_ASSERT_TRUE(nowcast.valid());
+    // (0.5*100 + 0.25*100 + 0.125*20 + 0.0625*10)/(0.5 + 0.25 + 0.125 + 0.0625)
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 83.3333, nowcast.value());
+
+    // fewer than two of the last three hours with data is not valid
+    nowcast.push(100, nowCastMillis(7, 0));
+    TEST_ASSERT_FALSE(nowcast.hasData(0));
+    TEST_ASSERT_TRUE(nowcast.hasData(1));
+    TEST_ASSERT_FALSE(nowcast.hasData(2));
+    TEST_ASSERT_FALSE(nowcast.valid());
+    TEST_ASSERT_EQUAL_FLOAT(0, nowcast.value());
+
+    // steady readings for longer than the NowCast window leave only those readings
+    for (uint32_t hour = 8; hour < 8 + NOWCAST_HOURS; hour++) {
+        for (uint32_t i = 0; i < 4; i++) {
+            nowcast.push(30, nowCastMillis(hour, i));
+        }
+    }
+    nowcast.push(30, nowCastMillis(8 + NOWCAST_HOURS, 0));
+    TEST_ASSERT_EQUAL_INT(NOWCAST_HOURS, nowcast.hourCount());
+    TEST_ASSERT_EQUAL_FLOAT(30, nowcast.value());
+
+    // a gap longer than the window leaves no hours with data
+    nowcast.push(30, nowCastMillis(8 + 3*NOWCAST_HOURS, 0));
+    TEST_ASSERT_FALSE(nowcast.valid());
+    for (size_t i = 0; i < NOWCAST_HOURS; i++) {
+        TEST_ASSERT_FALSE(nowcast.hasData(i));
+    }
+
+    nowcast.reset();
+    TEST_ASSERT_FALSE(nowcast.valid());
+    TEST_ASSERT_EQUAL_INT(0, nowcast.hourCount());
+}
+
+// A NowCast picks up from the history's restored 1 minute rollups.
+void test_AirQualitySensor_restoreNowCast( void ) {
+    UARTParticulateSensorDriver<SNGCJA5Protocol> driver(Serial1, 33, 32);
+    AirQualitySensor sensor(driver, 2);
+    SampleHistory& history = sensor.history();
+    const uint32_t samples_per_bucket = history.levelSamplesPerEntry(1);
+    TEST_ASSERT_EQUAL_UINT32(30, samples_per_bucket);
+
+    // three hours of 1 minute buckets ending now, averaging 10, 20 and then 40
+    uint32_t now = millis();
+    for (uint32_t minute = 0; minute < 180; minute++) {
+        uint16_t value = (minute < 60) ? 10 : ((minute < 120) ? 20 : 40);
+        SampleAggregate bucket;
+        bucket.sum = value*samples_per_bucket;
+        bucket.min = value;
+        bucket.max = value;
+        bucket.count = samples_per_bucket;
+        TEST_ASSERT_TRUE(history.restoreAggregate(bucket, now - (179 - minute)*60000));
+    }
+    TEST_ASSERT_FALSE(sensor.nowCastValid());
+
+    // Test 1 - the two complete hours make the NowCast valid, and the third is still being filled
+    TEST_ASSERT_EQUAL_INT(180, sensor.restoreNowCast());
+    TEST_ASSERT_TRUE(sensor.nowCastValid());
+    // w = 10/20 = 0.5, so (20 + 0.5*10)/(1 + 0.5)
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 16.6667, sensor.nowCastPM2p5());
+}
+
+// Two sensors of different types sampled at once, each into its own history.
+void test_AirQualitySensor_drivers( void ) {
+    HardwareSerial gcja5_port(stdout);
+    FILE* sps30_sent = tmpfile();
+    TEST_ASSERT_NOT_NULL(sps30_sent);
+    HardwareSerial sps30_port(sps30_sent);
+    UARTParticulateSensorDriver<SNGCJA5Protocol> gcja5_driver(gcja5_port, 33, 32);
+    UARTParticulateSensorDriver<SPS30Protocol> sps30_driver(sps30_port, 26, 25);
+    AirQualitySensor gcja5(gcja5_driver, 2);
+    AirQualitySensor sps30(sps30_driver, 2);
+    TEST_ASSERT_EQUAL_STRING("SN-GCJA5", gcja5.name());
+    TEST_ASSERT_EQUAL_STRING("SPS30", sps30.name());
+    gcja5.begin();
+    sps30.begin();
+    delay(SNGCJA5Protocol::WARMUP_MILLIS + 2000);
+
+    // an SN-GCJA5 frame with PM2.5 of 300, little endian
+    uint8_t gcja5_frame[SNGCJA5_FRAME_SIZE] = {0};
+    gcja5_frame[0] = SNGCJA5_FRAME_STX;
+    gcja5_frame[5] = 300 & 0xFF;
+    gcja5_frame[6] = 300 >> 8;
+    gcja5_frame[29] = 0x15;
+    for (uint8_t i = 1; i < SNGCJA5_FRAME_FCC_IDX; i++) {
+        gcja5_frame[SNGCJA5_FRAME_FCC_IDX] ^= gcja5_frame[i];
+    }
+    gcja5_frame[SNGCJA5_FRAME_SIZE - 1] = SNGCJA5_FRAME_ETX;
+
+    // an SPS30 answer with PM2.5 of 22.5 (0x41B40000) and no bytes that need escaping
+    uint8_t sps30_frame[SPS30Protocol::FRAME_SIZE] = {0x7E, 0x00, 0x03, 0x00, 40};
+    sps30_frame[9] = 0x41;
+    sps30_frame[10] = 0xB4;
+    uint8_t sum = 0;
+    for (uint8_t i = 1; i < 45; i++) {
+        sum += sps30_frame[i];
+    }
+    sps30_frame[45] = ~sum;
+    sps30_frame[46] = 0x7E;
+
+    // Test 1 - each sensor decodes its own protocol into its own readings and history
+    gcja5_port.injectReceivedBytes(gcja5_frame, sizeof(gcja5_frame));
+    sps30_port.injectReceivedBytes(sps30_frame, sizeof(sps30_frame));
+    TEST_ASSERT_TRUE(gcja5.updateSensorReading());
+    TEST_ASSERT_TRUE(sps30.updateSensorReading());
+    TEST_ASSERT_EQUAL_UINT32(300, gcja5.PM2p5());
+    TEST_ASSERT_EQUAL_UINT32(23, sps30.PM2p5());
+    TEST_ASSERT_EQUAL_UINT8(1, gcja5.statusParticleDetector());
+    TEST_ASSERT_EQUAL_UINT8(0, sps30.statusParticleDetector());
+    TEST_ASSERT_EQUAL_INT(1, gcja5.getHistoryCount());
+    TEST_ASSERT_EQUAL_INT(1, sps30.getHistoryCount());
+    TEST_ASSERT_EQUAL_FLOAT(300, gcja5.currentAveragePM2p5());
+    TEST_ASSERT_EQUAL_FLOAT(23, sps30.currentAveragePM2p5());
+    TEST_ASSERT_EQUAL_UINT32(1, gcja5.validFrameCount());
+    TEST_ASSERT_EQUAL_UINT32(1, sps30.validFrameCount());
+
+    // Test 2 - the SPS30 was told to start measuring and then asked for a reading
+    const uint8_t expected_sent[] = {
+        0x7E, 0x00, 0x00, 0x02, 0x01, 0x03, 0xF9, 0x7E,
+        0x7E, 0x00, 0x03, 0x00, 0xFC, 0x7E
+    };
+    uint8_t sent[sizeof(expected_sent)];
+    fflush(sps30_sent);
+    rewind(sps30_sent);
+    TEST_ASSERT_EQUAL_INT(sizeof(sent), fread(sent, 1, sizeof(sent), sps30_sent));
+    TEST_ASSERT_EQUAL_MEMORY(expected_sent, sent, sizeof(sent));
+    fclose(sps30_sent);
+}
+
+#endif
@@ -2,5 +2,9 @@
 #define __test_AirQualitySensor__
 
 void test_getAQIStatusColor( void );
+void test_AQIScale_breakpoints( void );
+void test_NowCast_hourly( void );
+void test_AirQualitySensor_restoreNowCast( void );
+void test_AirQualitySensor_drivers( void );
 
 #endif // __test_AirQualitySensor__
\ No newline at end of file
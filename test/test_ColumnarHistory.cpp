@@ -0,0 +1,91 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "ColumnarHistory.h"
+#include "test_ColumnarHistory.h"
+
+void test_ColumnarHistory_codec( void ) {
+    // Test 1 - zig-zag maps small magnitudes of either sign to small values
+    TEST_ASSERT_EQUAL_UINT32(0, zigzagEncode(0));
+    TEST_ASSERT_EQUAL_UINT32(1, zigzagEncode(-1));
+    TEST_ASSERT_EQUAL_UINT32(2, zigzagEncode(1));
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, zigzagEncode(INT32_MIN));
+    TEST_ASSERT_EQUAL_INT(INT32_MIN, zigzagDecode(zigzagEncode(INT32_MIN)));
+    TEST_ASSERT_EQUAL_INT(-12345, zigzagDecode(zigzagEncode(-12345)));
+
+    // Test 2 - varints take 1 byte up to 127 and 5 bytes for the largest values
+    uint8_t buffer[5];
+    uint32_t value;
+    TEST_ASSERT_EQUAL_INT(1, varintEncode(127, buffer));
+    TEST_ASSERT_EQUAL_INT(2, varintEncode(128, buffer));
+    TEST_ASSERT_EQUAL_INT(2, varintDecode(buffer, value));
+    TEST_ASSERT_EQUAL_UINT32(128, value);
+    TEST_ASSERT_EQUAL_INT(5, varintEncode(0xFFFFFFFF, buffer));
+    TEST_ASSERT_EQUAL_INT(5, varintDecode(buffer, value));
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, value);
+}
+
+void test_ColumnarHistory_columns( void ) {
+    uint32_t storage[COLUMNAR_HISTORY_BLOCK_BYTES*16/sizeof(uint32_t)];
+    ColumnarHistory history;
+    TEST_ASSERT_FALSE(history.setStorage(storage, COLUMNAR_HISTORY_BLOCK_BYTES*3, 2));
+    TEST_ASSERT_TRUE(history.setStorage(storage, sizeof(storage), 3));
+
+    // a slowly changing channel, a constant channel, and one that jumps to and from missing
+    for (int32_t row = 0; row < 300; row++) {
+        int32_t values[3] = { 1000 + row%7 - 3, 42, (row%50 == 0) ? COLUMNAR_HISTORY_MISSING : 2000 - row };
+        history.push(values);
+    }
+    TEST_ASSERT_EQUAL_INT(300, history.size());
+
+    // Test 1 - each column decodes back to what was pushed, across block boundaries
+    int32_t out[300];
+    TEST_ASSERT_EQUAL_INT(300, history.read(0, 0, out, 300));
+    TEST_ASSERT_EQUAL_INT(1000 - 3, out[0]);
+    TEST_ASSERT_EQUAL_INT(1000 + 299%7 - 3, out[299]);
+    TEST_ASSERT_EQUAL_INT(200, history.read(2, 100, out, 300));
+    TEST_ASSERT_EQUAL_INT(COLUMNAR_HISTORY_MISSING, out[0]);
+    TEST_ASSERT_EQUAL_INT(2000 - 101, out[1]);
+    TEST_ASSERT_EQUAL_INT(2000 - 299, out[199]);
+    TEST_ASSERT_EQUAL_INT(10, history.read(1, 290, out, 300));
+    TEST_ASSERT_EQUAL_INT(42, out[9]);
+
+    // Test 2 - small deltas take one byte, so the first two columns need few blocks
+    TEST_ASSERT_EQUAL_INT(3, history.columnBlocks(0));
+    TEST_ASSERT_EQUAL_INT(3, history.columnBlocks(1));
+    TEST_ASSERT_TRUE(history.columnBlocks(2) > history.columnBlocks(1));
+
+    // Test 3 - reads outside the retained rows return nothing
+    TEST_ASSERT_EQUAL_INT(0, history.read(0, 300, out, 10));
+    TEST_ASSERT_EQUAL_INT(0, history.read(3, 0, out, 10));
+}
+
+void test_ColumnarHistory_eviction( void ) {
+    // 6 blocks for 2 columns
+    uint32_t storage[COLUMNAR_HISTORY_BLOCK_BYTES*6/sizeof(uint32_t)];
+    ColumnarHistory history;
+    TEST_ASSERT_TRUE(history.setStorage(storage, sizeof(storage), 2));
+
+    // the second column needs 5 bytes per value, so it takes the most blocks
+    for (int32_t row = 0; row < 1000; row++) {
+        int32_t values[2] = { row, (row%2) ? INT32_MAX : INT32_MIN };
+        history.push(values);
+    }
+
+    // Test 1 - the oldest rows were dropped to make room, and every column covers the rest
+    TEST_ASSERT_TRUE(history.oldestRow() > 0);
+    TEST_ASSERT_EQUAL_INT(1000, history.nextRow());
+    TEST_ASSERT_EQUAL_INT(6, history.blocksInUse());
+    int32_t out[1000];
+    size_t count = history.read(0, history.oldestRow(), out, 1000);
+    TEST_ASSERT_EQUAL_INT(history.size(), count);
+    TEST_ASSERT_EQUAL_INT(history.oldestRow(), out[0]);
+    TEST_ASSERT_EQUAL_INT(999, out[count - 1]);
+    count = history.read(1, history.oldestRow(), out, 1000);
+    TEST_ASSERT_EQUAL_INT(history.size(), count);
+    TEST_ASSERT_EQUAL_INT(INT32_MAX, out[count - 1]);
+
+    // Test 2 - rows older than the oldest retained row can't be read
+    TEST_ASSERT_EQUAL_INT(0, history.read(0, history.oldestRow() - 1, out, 1000));
+}
+#endif
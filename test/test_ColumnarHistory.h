@@ -0,0 +1,8 @@
+#ifndef __test_ColumnarHistory__
+#define __test_ColumnarHistory__
+
+void test_ColumnarHistory_codec( void );
+void test_ColumnarHistory_columns( void );
+void test_ColumnarHistory_eviction( void );
+
+#endif // __test_ColumnarHistory__
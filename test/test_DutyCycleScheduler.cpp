@@ -0,0 +1,94 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "DutyCycleScheduler.h"
+#include "test_DutyCycleScheduler.h"
+
+static const PowerModel TEST_POWER_MODEL = {10, 40, 1, 30, 3.3};
+
+void test_DutyCycleScheduler_sleep( void ) {
+    DutyCycleScheduler scheduler(300000, 30000, 50, TEST_POWER_MODEL);
+    scheduler.begin(1000);
+
+    // Test 1 - the device does not sleep while the radio is on at boot
+    TEST_ASSERT_TRUE(scheduler.isRadioOn());
+    scheduler.wakeAt(60000);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.sleepMillis(2000));
+    TEST_ASSERT_TRUE(scheduler.updateRadio(4000, true));
+    TEST_ASSERT_FALSE(scheduler.updateRadio(5000, false));
+    TEST_ASSERT_EQUAL_UINT32(301000, scheduler.nextRadioMillis());
+
+    // Test 2 - it sleeps until the earliest wake time, and wake times only last one pass
+    scheduler.wakeAt(60000);
+    scheduler.wakeAt(20000);
+    TEST_ASSERT_EQUAL_UINT32(15000, scheduler.sleepMillis(5000));
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.sleepMillis(5000));
+
+    // Test 3 - sleeps that are too short or already overdue are skipped
+    scheduler.wakeAt(5040);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.sleepMillis(5000));
+    scheduler.wakeAt(4000);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.sleepMillis(5000));
+
+    // Test 4 - it wakes for the next radio window, which stays open no longer than its length
+    scheduler.wakeAt(400000);
+    TEST_ASSERT_EQUAL_UINT32(296000, scheduler.sleepMillis(5000));
+    scheduler.slept(5000, 301000);
+    TEST_ASSERT_TRUE(scheduler.updateRadio(301000, true));
+    TEST_ASSERT_TRUE(scheduler.updateRadio(330999, true));
+    TEST_ASSERT_FALSE(scheduler.updateRadio(331000, true));
+    TEST_ASSERT_EQUAL_UINT32(601000, scheduler.nextRadioMillis());
+
+    DutyCycleStats stats = scheduler.stats(331000);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.wakeCount);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.radioWakeCount);
+    TEST_ASSERT_EQUAL_UINT32(296000, (uint32_t)stats.sleepMillis);
+    TEST_ASSERT_EQUAL_UINT32(34000, (uint32_t)stats.awakeMillis);
+    TEST_ASSERT_EQUAL_UINT32(34000, (uint32_t)stats.radioMillis);
+    TEST_ASSERT_EQUAL_FLOAT(0, stats.energyPerSampleMillijoules);
+}
+
+void test_DutyCycleScheduler_simulatedHour( void ) {
+    // A device that samples every minute, wakes 1.5 s early for the sensor, and takes 5 s to
+    // connect and send its telemetry whenever the radio comes on.
+    const PowerModel model = {0, 100, 0, 0, 1};
+    DutyCycleScheduler scheduler(300000, 30000, 50, model);
+    uint32_t now = 0;
+    uint32_t next_sample = 60000;
+    uint32_t radio_on_millis = 0;
+    scheduler.begin(now);
+    while (now < 3600000) {
+        bool was_on = scheduler.isRadioOn();
+        bool radio_on = scheduler.updateRadio(now, now - radio_on_millis < 5000);
+        if (radio_on && !was_on) {
+            radio_on_millis = now;
+        }
+        if ((int32_t)(now - next_sample) >= 0) {
+            scheduler.countSample();
+            next_sample += 60000;
+        }
+        scheduler.wakeAt(next_sample - 1500);
+        uint32_t sleep_millis = scheduler.sleepMillis(now);
+        if (sleep_millis > 0) {
+            scheduler.slept(now, now + sleep_millis);
+            now += sleep_millis;
+        } else {
+            now += 10;
+        }
+    }
+
+    DutyCycleStats stats = scheduler.stats(now);
+    TEST_ASSERT_EQUAL_UINT32(59, stats.sampleCount);
+    // the boot window and one every 5 minutes after it
+    TEST_ASSERT_EQUAL_UINT32(12, stats.radioWakeCount);
+    TEST_ASSERT_EQUAL_UINT32(now, (uint32_t)(stats.awakeMillis + stats.sleepMillis));
+    // awake about 1.5 s per sample and 5 s per radio window
+    TEST_ASSERT_FLOAT_WITHIN(0.005, (59*1.5 + 12*5)/3600.0, stats.dutyCycle);
+    // the radio windows fall on sample wakeups, so they cost no wakeups of their own
+    TEST_ASSERT_EQUAL_UINT32(60, stats.wakeCount);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 100*stats.dutyCycle, stats.averageMilliamps);
+    TEST_ASSERT_FLOAT_WITHIN(1, stats.awakeMillis*0.1, stats.energyMillijoules);
+    TEST_ASSERT_FLOAT_WITHIN(0.1, stats.energyMillijoules/59, stats.energyPerSampleMillijoules);
+}
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef __test_DutyCycleScheduler__
+#define __test_DutyCycleScheduler__
+
+void test_DutyCycleScheduler_sleep( void );
+void test_DutyCycleScheduler_simulatedHour( void );
+
+#endif // __test_DutyCycleScheduler__
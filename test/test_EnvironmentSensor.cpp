@@ -0,0 +1,165 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "EnvironmentSensor.h"
+#include "test_EnvironmentSensor.h"
+
+// A device whose measurements take MEASURE_MILLIS of the test's clock.
+class TestEnvironmentDevice : public EnvironmentSensorDevice {
+public:
+    static const uint32_t MEASURE_MILLIS = 200;
+
+    uint32_t    now;
+    bool        measuring;
+    uint32_t    measureStart;
+    bool        failStart;
+    bool        hang;           // never finishes the measurement
+    uint32_t    starts;
+    uint32_t    finishes;
+    EnvironmentReading next;
+
+    TestEnvironmentDevice()
+        :   now(0), measuring(false), measureStart(0), failStart(false), hang(false), starts(0), finishes(0)
+    {
+        next.temperature = 21.5;
+        next.pressure = 1013.2;
+        next.humidity = 40.25;
+        next.gasResistance = 120000;
+        next.readingMillis = 0;
+    }
+
+    bool startReading(void) override
+    {
+        if (failStart) {
+            return false;
+        }
+        starts++;
+        measuring = true;
+        measureStart = now;
+        return true;
+    }
+
+    int32_t remainingReadingMillis(void) override
+    {
+        if (!measuring) {
+            return -1;
+        }
+        if (hang || (now - measureStart < MEASURE_MILLIS)) {
+            return hang ? 1 : MEASURE_MILLIS - (now - measureStart);
+        }
+        return 0;
+    }
+
+    bool finishReading(EnvironmentReading& reading) override
+    {
+        // like the Adafruit driver, this would block if the measurement were not done
+        TEST_ASSERT_EQUAL_INT(0, remainingReadingMillis());
+        finishes++;
+        measuring = false;
+        reading = next;
+        return true;
+    }
+};
+
+// runs the loop every 10 ms from the device's current time to end_millis
+static uint32_t runLoop(TestEnvironmentDevice& device, EnvironmentSensor& sensor, uint32_t end_millis)
+{
+    uint32_t readings = 0;
+    for (; device.now < end_millis; device.now += 10) {
+        if (sensor.isDue(device.now) && sensor.poll(device.now)) {
+            readings++;
+        }
+    }
+    return readings;
+}
+
+void test_EnvironmentSensor_nonBlocking( void ) {
+    TestEnvironmentDevice device;
+    EnvironmentSensor sensor(device, 5000, 1000);
+    sensor.setStorage(nullptr, 0);
+    TEST_ASSERT_FALSE(sensor.isDue(0));
+    sensor.begin(0);
+
+    // Test 1 - the first poll starts a measurement and returns, and a later one reads it out
+    TEST_ASSERT_TRUE(sensor.isDue(0));
+    TEST_ASSERT_FALSE(sensor.poll(0));
+    TEST_ASSERT_TRUE(sensor.isMeasuring());
+    TEST_ASSERT_EQUAL_UINT32(1, device.starts);
+    device.now = 100;
+    TEST_ASSERT_FALSE(sensor.isDue(device.now));
+    TEST_ASSERT_FALSE(sensor.poll(device.now));
+    device.now = 200;
+    TEST_ASSERT_TRUE(sensor.isDue(device.now));
+    TEST_ASSERT_TRUE(sensor.poll(device.now));
+    TEST_ASSERT_TRUE(sensor.hasReading());
+    TEST_ASSERT_EQUAL_FLOAT(21.5, sensor.latestReading().temperature);
+    TEST_ASSERT_EQUAL_UINT32(200, sensor.latestReading().readingMillis);
+    TEST_ASSERT_EQUAL_UINT32(1, sensor.readingCount());
+
+    // Test 2 - readings keep to their own cadence however often the loop polls
+    TEST_ASSERT_EQUAL_UINT32(11, runLoop(device, sensor, 60000));
+    TEST_ASSERT_EQUAL_UINT32(12, device.starts);
+    TEST_ASSERT_EQUAL_UINT32(12, sensor.readingCount());
+    TEST_ASSERT_EQUAL_UINT32(0, sensor.failureCount());
+
+    // Test 3 - a measurement that does not finish times out without being read out
+    device.hang = true;
+    uint32_t finishes = device.finishes;
+    runLoop(device, sensor, 61300);
+    TEST_ASSERT_EQUAL_UINT32(finishes, device.finishes);
+    TEST_ASSERT_EQUAL_UINT32(1, sensor.timeoutCount());
+    TEST_ASSERT_EQUAL_UINT32(1, sensor.failureCount());
+    TEST_ASSERT_FALSE(sensor.hasReading());
+    TEST_ASSERT_FALSE(sensor.isMeasuring());
+
+    // Test 4 - a measurement that could not be started is a failure, and the next is on cadence
+    device.hang = false;
+    device.failStart = true;
+    runLoop(device, sensor, 65010);
+    TEST_ASSERT_EQUAL_UINT32(2, sensor.failureCount());
+    device.failStart = false;
+    TEST_ASSERT_EQUAL_UINT32(1, runLoop(device, sensor, 70300));
+    TEST_ASSERT_TRUE(sensor.hasReading());
+    TEST_ASSERT_EQUAL_UINT32(13, sensor.readingCount());
+}
+
+void test_EnvironmentSensor_history( void ) {
+    // Test 1 - channel values round trip through their history samples
+    TEST_ASSERT_EQUAL_UINT16(6150, EnvironmentSensor::encodeSample(ENVIRONMENT_CHANNEL_TEMPERATURE, 21.5));
+    TEST_ASSERT_EQUAL_UINT16(0, EnvironmentSensor::encodeSample(ENVIRONMENT_CHANNEL_TEMPERATURE, -50));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, -12.34, EnvironmentSensor::decodeSample(ENVIRONMENT_CHANNEL_TEMPERATURE,
+        EnvironmentSensor::encodeSample(ENVIRONMENT_CHANNEL_TEMPERATURE, -12.34)));
+    TEST_ASSERT_EQUAL_UINT16(10132, EnvironmentSensor::encodeSample(ENVIRONMENT_CHANNEL_PRESSURE, 1013.2));
+    TEST_ASSERT_EQUAL_UINT16(1200, EnvironmentSensor::encodeSample(ENVIRONMENT_CHANNEL_GAS_RESISTANCE, 120000));
+    TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, EnvironmentSensor::encodeSample(ENVIRONMENT_CHANNEL_GAS_RESISTANCE, 10000000));
+
+    TestEnvironmentDevice device;
+    EnvironmentSensor sensor(device, 10000, 1000);
+    size_t capacity = EnvironmentSensor::sampleCapacity(10000);
+    TEST_ASSERT_EQUAL_INT(361, capacity);
+    void* storage = malloc(EnvironmentSensor::storageBytes(capacity));
+    sensor.setStorage(storage, capacity);
+    sensor.begin(0);
+    float average;
+    TEST_ASSERT_FALSE(sensor.windowAverage(ENVIRONMENT_CHANNEL_TEMPERATURE, ENVIRONMENT_WINDOW_10MIN, average));
+
+    // Test 2 - 50 minutes at 20 °C and 10 minutes at 26 °C, without gas readings in the last 10 minutes
+    device.next.temperature = 20;
+    runLoop(device, sensor, 50*60*1000UL);
+    device.next.temperature = 26;
+    device.next.gasResistance = 0;
+    runLoop(device, sensor, 60*60*1000UL);
+    TEST_ASSERT_EQUAL_UINT32(360, sensor.readingCount());
+    TEST_ASSERT_TRUE(sensor.windowAverage(ENVIRONMENT_CHANNEL_TEMPERATURE, ENVIRONMENT_WINDOW_10MIN, average));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 26, average);
+    TEST_ASSERT_TRUE(sensor.windowAverage(ENVIRONMENT_CHANNEL_TEMPERATURE, ENVIRONMENT_WINDOW_1HOUR, average));
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 21, average);
+    TEST_ASSERT_TRUE(sensor.windowAverage(ENVIRONMENT_CHANNEL_PRESSURE, ENVIRONMENT_WINDOW_1HOUR, average));
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 1013.2, average);
+    TEST_ASSERT_FALSE(sensor.windowAverage(ENVIRONMENT_CHANNEL_GAS_RESISTANCE, ENVIRONMENT_WINDOW_10MIN, average));
+    TEST_ASSERT_EQUAL_UINT32(5*60, sensor.history(ENVIRONMENT_CHANNEL_GAS_RESISTANCE).size());
+    TEST_ASSERT_EQUAL_UINT32(360, sensor.history(ENVIRONMENT_CHANNEL_TEMPERATURE).size());
+    free(storage);
+}
+
+#endif
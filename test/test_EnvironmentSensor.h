@@ -0,0 +1,7 @@
+#ifndef __test_EnvironmentSensor__
+#define __test_EnvironmentSensor__
+
+void test_EnvironmentSensor_nonBlocking( void );
+void test_EnvironmentSensor_history( void );
+
+#endif // __test_EnvironmentSensor__
@@ -0,0 +1,84 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "HTTPResponseParser.h"
+#include "test_HTTPResponseParser.h"
+
+static size_t parseString(HTTPResponseParser& parser, const char* str)
+{
+    return parser.parse((const uint8_t*)str, strlen(str));
+}
+
+void test_HTTPResponseParser_pipelined( void ) {
+    const char* stream =
+        "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 2\r\n\r\nOK"
+        "HTTP/1.1 201 Created\r\ncontent-length: 0\r\n\r\n"
+        "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nContent-Length: 4\r\n\r\nbusy";
+    size_t length = strlen(stream);
+    HTTPResponseParser parser;
+
+    // Test 1 - parsing stops at the end of the first response
+    size_t used = parser.parse((const uint8_t*)stream, length);
+    TEST_ASSERT_TRUE(parser.isComplete());
+    TEST_ASSERT_EQUAL_INT(200, parser.statusCode());
+    TEST_ASSERT_TRUE(parser.keepAlive());
+    TEST_ASSERT_EQUAL_STRING("OK", parser.body());
+
+    // Test 2 - the next response picks up where the first ended
+    parser.reset();
+    used += parser.parse((const uint8_t*)stream + used, length - used);
+    TEST_ASSERT_TRUE(parser.isComplete());
+    TEST_ASSERT_EQUAL_INT(201, parser.statusCode());
+    TEST_ASSERT_EQUAL_INT(0, parser.bodyLength());
+
+    // Test 3 - fed one byte at a time, and the server says it is closing the connection
+    parser.reset();
+    while ((used < length) && !parser.isComplete()) {
+        used += parser.parse((const uint8_t*)stream + used, 1);
+    }
+    TEST_ASSERT_TRUE(parser.isComplete());
+    TEST_ASSERT_EQUAL_INT(503, parser.statusCode());
+    TEST_ASSERT_FALSE(parser.keepAlive());
+    TEST_ASSERT_EQUAL_STRING("busy", parser.body());
+    TEST_ASSERT_EQUAL_INT(length, used);
+}
+
+void test_HTTPResponseParser_bodyFraming( void ) {
+    HTTPResponseParser parser;
+
+    // Test 1 - chunked body with a trailer, and an interim 100 response before it
+    parseString(parser, "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+    TEST_ASSERT_FALSE(parser.isComplete());
+    parseString(parser, "4\r\nsaved\r\n");
+    TEST_ASSERT_TRUE(parser.hasFailed());
+
+    parser.reset();
+    parseString(parser, "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+    size_t used = parseString(parser, "5\r\nsaved\r\n3;ext=1\r\n 30\r\n0\r\nX-Trailer: 1\r\n\r\nHTTP");
+    TEST_ASSERT_TRUE(parser.isComplete());
+    TEST_ASSERT_EQUAL_INT(200, parser.statusCode());
+    TEST_ASSERT_EQUAL_STRING("saved 30", parser.body());
+    TEST_ASSERT_EQUAL_INT(strlen("5\r\nsaved\r\n3;ext=1\r\n 30\r\n0\r\nX-Trailer: 1\r\n\r\n"), used);
+
+    // Test 2 - HTTP/1.0 body that runs until the connection closes
+    parser.reset();
+    parseString(parser, "HTTP/1.0 200 OK\r\n\r\nall of ");
+    parseString(parser, "this");
+    TEST_ASSERT_FALSE(parser.isComplete());
+    TEST_ASSERT_FALSE(parser.keepAlive());
+    parser.connectionClosed();
+    TEST_ASSERT_TRUE(parser.isComplete());
+    TEST_ASSERT_EQUAL_STRING("all of this", parser.body());
+
+    // Test 3 - a connection closed mid-response fails it
+    parser.reset();
+    parseString(parser, "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort");
+    parser.connectionClosed();
+    TEST_ASSERT_TRUE(parser.hasFailed());
+
+    // Test 4 - not HTTP
+    parser.reset();
+    parseString(parser, "SSH-2.0-OpenSSH\r\n");
+    TEST_ASSERT_TRUE(parser.hasFailed());
+}
+#endif
@@ -0,0 +1,7 @@
+#ifndef __test_HTTPResponseParser__
+#define __test_HTTPResponseParser__
+
+void test_HTTPResponseParser_pipelined( void );
+void test_HTTPResponseParser_bodyFraming( void );
+
+#endif // __test_HTTPResponseParser__
@@ -0,0 +1,45 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "LatencyHistogram.h"
+#include "test_LatencyHistogram.h"
+
+void test_LatencyHistogram_percentiles( void ) {
+    LatencyHistogram histogram;
+
+    // Test 1 - empty histogram
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.count());
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.percentileMicros(50));
+
+    // Test 2 - bucket boundaries
+    TEST_ASSERT_EQUAL_INT(0, LatencyHistogram::bucketForMicros(0));
+    TEST_ASSERT_EQUAL_INT(1, LatencyHistogram::bucketForMicros(1));
+    TEST_ASSERT_EQUAL_INT(2, LatencyHistogram::bucketForMicros(2));
+    TEST_ASSERT_EQUAL_INT(2, LatencyHistogram::bucketForMicros(3));
+    TEST_ASSERT_EQUAL_INT(10, LatencyHistogram::bucketForMicros(1000));
+    TEST_ASSERT_EQUAL_INT(32, LatencyHistogram::bucketForMicros(UINT32_MAX));
+    TEST_ASSERT_EQUAL_UINT32(1023, LatencyHistogram::bucketUpperBoundMicros(10));
+
+    // Test 3 - 90 fast values and 10 slow ones
+    for (uint32_t i = 0; i < 90; i++) {
+        histogram.record(1100 + i);
+    }
+    for (uint32_t i = 0; i < 10; i++) {
+        histogram.record(100000);
+    }
+    TEST_ASSERT_EQUAL_UINT32(100, histogram.count());
+    TEST_ASSERT_EQUAL_UINT32(1100, histogram.minMicros());
+    TEST_ASSERT_EQUAL_UINT32(100000, histogram.maxMicros());
+    TEST_ASSERT_EQUAL_UINT32(90, histogram.bucketCount(11));
+    // percentiles fall in the 1024 to 2047 us bucket, or are clamped to the max
+    TEST_ASSERT_EQUAL_UINT32(2047, histogram.percentileMicros(50));
+    TEST_ASSERT_EQUAL_UINT32(2047, histogram.percentileMicros(90));
+    TEST_ASSERT_EQUAL_UINT32(100000, histogram.percentileMicros(99));
+    TEST_ASSERT_EQUAL_FLOAT(11030.05, histogram.averageMicros());
+
+    // Test 4 - clear
+    histogram.clear();
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.count());
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.maxMicros());
+}
+#endif
@@ -0,0 +1,6 @@
+#ifndef __test_LatencyHistogram__
+#define __test_LatencyHistogram__
+
+void test_LatencyHistogram_percentiles( void );
+
+#endif // __test_LatencyHistogram__
@@ -0,0 +1,76 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "Logger.h"
+#include "test_helpers.h"
+#include "test_Logger.h"
+
+// builds a record the way Logger::log() does
+template <typename... Args>
+static LogRecord makeRecord(const char* format, const Args&... args)
+{
+    LogRecord record;
+    record.format = format;
+    record.millis = 0;
+    record.level = LOG_LEVEL_INFO;
+    record.argCount = 0;
+    record.stringsLength = 0;
+    int expand[] = {0, (record.addArg(args), 0)...};
+    (void)expand;
+    return record;
+}
+
+void test_Logger_format( void ) {
+    char line[LOG_LINE_MAX_LENGTH];
+
+    // Test 1 - each argument type, with flags, width and precision
+    size_t length = Logger::format(
+        makeRecord("%d %u %5.2f %s %03x %c", -7, 42u, 3.14159, "pm", 10u, 'Z'),
+        line, sizeof(line)
+    );
+    TEST_ASSERT_EQUAL_STRING("-7 42  3.14 pm 00a Z", line);
+    TEST_ASSERT_EQUAL_INT(strlen(line), length);
+
+    // Test 2 - length modifiers are taken from the captured type, 64 bit values are not cut, and %% is literal
+    Logger::format(
+        makeRecord("%ld %lu %lld %llu 100%%", -1L, 4000000000UL, -5000000000LL, 18000000000000000000ULL),
+        line, sizeof(line)
+    );
+    TEST_ASSERT_EQUAL_STRING("-1 4000000000 -5000000000 18000000000000000000 100%", line);
+
+    // Test 3 - strings are copied when logged, not when printed
+    char name[8] = "before";
+    LogRecord record = makeRecord("name = %s, path = %s", name, String("/index.html"));
+    strcpy(name, "after");
+    Logger::format(record, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("name = before, path = /index.html", line);
+
+    // Test 4 - missing arguments print as ?, and the line is truncated to the capacity
+    Logger::format(makeRecord("a = %d, b = %d", 1), line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("a = 1, b = ?", line);
+    length = Logger::format(makeRecord("abcdefghij"), line, 5);
+    TEST_ASSERT_EQUAL_STRING("abcd", line);
+    TEST_ASSERT_EQUAL_INT(4, length);
+
+    // Test 5 - a string longer than the record can hold is truncated
+    char long_string[LOG_STRING_BYTES + 20];
+    memset(long_string, 'x', sizeof(long_string) - 1);
+    long_string[sizeof(long_string) - 1] = '\0';
+    length = Logger::format(makeRecord("%s", long_string), line, sizeof(line));
+    TEST_ASSERT_EQUAL_INT(LOG_STRING_BYTES - 1, length);
+}
+
+void test_Logger_write( void ) {
+    // without a task the records are printed as they are logged, each on its own line
+    Logger logger;
+    CapturePrint out;
+    logger.setOutput(out);
+    TEST_ASSERT_FALSE(logger.isTaskRunning());
+    logger.log(LOG_LEVEL_INFO, "Indexed %u static assets", 3u);
+    logger.log(LOG_LEVEL_ERROR, "ERROR - Could not open %s", "/style.css");
+    TEST_ASSERT_EQUAL_STRING("Indexed 3 static assets\nERROR - Could not open /style.css\n", out.text);
+    TEST_ASSERT_EQUAL_INT(0, logger.queuedCount());
+    TEST_ASSERT_EQUAL_INT(0, logger.drain());
+    TEST_ASSERT_EQUAL_UINT32(0, logger.droppedCount());
+}
+#endif
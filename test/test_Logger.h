@@ -0,0 +1,7 @@
+#ifndef __test_Logger__
+#define __test_Logger__
+
+void test_Logger_format( void );
+void test_Logger_write( void );
+
+#endif // __test_Logger__
@@ -0,0 +1,134 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "PageRenderer.h"
+#include "PageTemplate.h"
+#include "test_PageRenderer.h"
+
+static String testProcessor(const String& var)
+{
+    if (var == "NAME") {
+        return String("diyaqi");
+    } else if (var == "AQI-10MIN") {
+        return String(42);
+    }
+    return String();
+}
+
+void test_PageRenderer_renderTemplate( void ) {
+    // Test 1 - variables are replaced, including at the start and end of the template
+    const char* html1 = "^NAME^ has an AQI of ^AQI-10MIN^";
+    String result1 = PageRenderer::renderTemplate(html1, strlen(html1), testProcessor);
+    TEST_ASSERT_EQUAL_STRING("diyaqi has an AQI of 42", result1.c_str());
+
+    // Test 2 - a doubled placeholder is an escaped placeholder character
+    const char* html2 = "x ^^ y";
+    String result2 = PageRenderer::renderTemplate(html2, strlen(html2), testProcessor);
+    TEST_ASSERT_EQUAL_STRING("x ^ y", result2.c_str());
+
+    // Test 3 - an unterminated placeholder is left as is
+    const char* html3 = "<p>^NAME</p>";
+    String result3 = PageRenderer::renderTemplate(html3, strlen(html3), testProcessor);
+    TEST_ASSERT_EQUAL_STRING("<p>^NAME</p>", result3.c_str());
+
+    // Test 4 - only the given length is rendered
+    String result4 = PageRenderer::renderTemplate(html1, 6, testProcessor);
+    TEST_ASSERT_EQUAL_STRING("diyaqi", result4.c_str());
+}
+
+static size_t testFormatter(TemplateVariableID id, char* out, size_t capacity)
+{
+    if (id == TEMPLATE_VARIABLE_SENSORNAME) {
+        return snprintf(out, capacity, "diyaqi");
+    } else if (id == TEMPLATE_VARIABLE_AQI_10MIN) {
+        return snprintf(out, capacity, "42");
+    }
+    return 0;
+}
+
+static String renderToString(const PageTemplate& page)
+{
+    char* buffer = (char*)malloc(page.maxRenderedLength() + 1);
+    size_t length = page.renderTo(testFormatter, buffer);
+    buffer[length] = '\0';
+    String result(buffer);
+    free(buffer);
+    return result;
+}
+
+void test_PageTemplate_render( void ) {
+    // Test 1 - variables are looked up by name once, when the template is parsed
+    TEST_ASSERT_EQUAL_INT(TEMPLATE_VARIABLE_AQI_10MIN, lookupTemplateVariable("AQI-10MIN", 9));
+    TEST_ASSERT_EQUAL_INT(TEMPLATE_VARIABLE_UNKNOWN, lookupTemplateVariable("AQI-10MI", 8));
+    TEST_ASSERT_EQUAL_INT(TEMPLATE_VARIABLE_UNKNOWN, lookupTemplateVariable("NAME", 4));
+
+    // Test 2 - renders the same as renderTemplate(), with unknown variables rendering as nothing
+    const char* html = "<p>^SENSORNAME^ has an AQI of ^AQI-10MIN^ ^^ ^NAME^</p><p>^SENSORNAME</p>";
+    PageTemplate page;
+    TEST_ASSERT_TRUE(page.parse(html, strlen(html)));
+    TEST_ASSERT_EQUAL_STRING("<p>diyaqi has an AQI of 42 ^ </p><p>^SENSORNAME</p>", renderToString(page).c_str());
+
+    // Test 3 - adjacent literal spans are merged into one token
+    TEST_ASSERT_EQUAL_INT(7, page.tokenCount());
+
+    // Test 4 - the rendered page is reused until the epoch changes
+    RenderedPagePtr first = page.render(1, testFormatter);
+    RenderedPagePtr again = page.render(1, testFormatter);
+    TEST_ASSERT_TRUE(first.get() == again.get());
+    TEST_ASSERT_EQUAL_UINT32(1, page.renderCount());
+
+    // Test 5 - a page still being sent is not overwritten by the next render
+    RenderedPagePtr second = page.render(2, testFormatter);
+    TEST_ASSERT_TRUE(first.get() != second.get());
+    TEST_ASSERT_EQUAL_UINT32(1, first->epoch);
+    TEST_ASSERT_EQUAL_INT(strlen("<p>diyaqi has an AQI of 42 ^ </p><p>^SENSORNAME</p>"), second->length);
+    TEST_ASSERT_EQUAL_UINT32(2, page.renderCount());
+}
+
+void test_PageRenderer_liveUpdate( void ) {
+    UARTParticulateSensorDriver<SNGCJA5Protocol> driver(Serial1, 33, 32);
+    AirQualitySensor sensor(driver, 2);
+    DeviceStatus status = DeviceStatus();
+    status.lastUpdateTime = 1600000000;
+    status.hasBME680 = true;
+    status.temperature = UNSET_ENVIRONMENT_VALUE;
+    PageRenderer renderer(sensor, status);
+    char out[LIVE_UPDATE_MAX_LENGTH];
+
+    // Test 1 - without an environment reading there is no env field
+    size_t length = renderer.formatLiveUpdate(out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("{\"t\":1600000000,\"aqi\":[0.0,0.0,0.0,0.0],\"color\":[0,0,0,0]}", out);
+    TEST_ASSERT_EQUAL_INT(strlen(out), length);
+
+    // Test 2 - the environment is shown in the same units as the root page
+    status.temperature = 20.0;
+    status.pressure = 1013.25;
+    status.humidity = 45.0;
+    renderer.formatLiveUpdate(out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("{\"t\":1600000000,\"aqi\":[0.0,0.0,0.0,0.0],\"color\":[0,0,0,0],\"env\":[68.0,1013.2,45.0]}", out);
+}
+
+void test_PageRenderer_bootStatus( void ) {
+    UARTParticulateSensorDriver<SNGCJA5Protocol> driver(Serial1, 33, 32);
+    AirQualitySensor sensor(driver, 2);
+    DeviceStatus status = DeviceStatus();
+    status.bootPending = BOOT_TIME | BOOT_SENSOR;
+    PageRenderer renderer(sensor, status);
+    char out[64];
+
+    // Test 1 - the subsystems still starting up are listed
+    size_t length = renderer.formatVariable(TEMPLATE_VARIABLE_BOOTSTATUS, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("Starting up: clock, sensor warm-up", out);
+    TEST_ASSERT_EQUAL_INT(strlen(out), length);
+    renderer.formatVariable(TEMPLATE_VARIABLE_STARTUP, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("Starting up: clock, sensor warm-up", out);
+
+    // Test 2 - once up, the root page shows nothing and the stats show how long it all took
+    status.bootPending = 0;
+    status.bootCompleteMillis = 31200;
+    status.firstResponseMillis = 1500;
+    TEST_ASSERT_EQUAL_INT(0, renderer.formatVariable(TEMPLATE_VARIABLE_BOOTSTATUS, out, sizeof(out)));
+    renderer.formatVariable(TEMPLATE_VARIABLE_STARTUP, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("Up in 31.2 s, first response in 1.5 s", out);
+}
+#endif
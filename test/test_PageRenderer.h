@@ -0,0 +1,9 @@
+#ifndef __test_PageRenderer__
+#define __test_PageRenderer__
+
+void test_PageRenderer_renderTemplate( void );
+void test_PageTemplate_render( void );
+void test_PageRenderer_liveUpdate( void );
+void test_PageRenderer_bootStatus( void );
+
+#endif // __test_PageRenderer__
@@ -0,0 +1,161 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "ParticulateFrameDecoder.h"
+#include "ParticulateProtocols.h"
+#include "test_ParticulateFrameDecoder.h"
+
+typedef ParticulateFrameDecoder<PMS5003Protocol> PMS5003FrameDecoder;
+typedef ParticulateFrameDecoder<SPS30Protocol> SPS30FrameDecoder;
+
+static void put_uint16_be(uint8_t* bytes, uint16_t value)
+{
+    bytes[0] = value >> 8;
+    bytes[1] = value & 0xFF;
+}
+
+static void put_float_be(uint8_t* bytes, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (uint8_t i = 0; i < 4; i++) {
+        bytes[i] = bits >> (24 - 8*i);
+    }
+}
+
+// builds a valid PMS5003 frame with the given atmospheric PM2.5
+static void build_pms5003_frame(uint8_t* frame, uint16_t pm2p5)
+{
+    memset(frame, 0, PMS5003Protocol::FRAME_SIZE);
+    frame[0] = 0x42;
+    frame[1] = 0x4D;
+    put_uint16_be(frame + 2, 28);
+    put_uint16_be(frame + 6, pm2p5 + 1);    // standard particle PM2.5, which is not used
+    put_uint16_be(frame + 10, 3);
+    put_uint16_be(frame + 12, pm2p5);
+    put_uint16_be(frame + 14, 2*pm2p5);
+    put_uint16_be(frame + 16, 2000);
+    put_uint16_be(frame + 18, 600);
+    put_uint16_be(frame + 26, 4);
+    uint16_t sum = 0;
+    for (uint8_t i = 0; i < 30; i++) {
+        sum += frame[i];
+    }
+    put_uint16_be(frame + 30, sum);
+}
+
+// builds a valid SPS30 Read Measured Values answer, before byte stuffing
+static void build_sps30_frame(uint8_t* frame, float pm2p5, float pm10, float count0p5)
+{
+    memset(frame, 0, SPS30Protocol::FRAME_SIZE);
+    frame[0] = 0x7E;
+    frame[2] = 0x03;
+    frame[4] = 40;
+    put_float_be(frame + 5, 1.2);
+    put_float_be(frame + 9, pm2p5);
+    put_float_be(frame + 17, pm10);
+    put_float_be(frame + 21, count0p5);
+    uint8_t sum = 0;
+    for (uint8_t i = 1; i < 45; i++) {
+        sum += frame[i];
+    }
+    frame[45] = ~sum;
+    frame[46] = 0x7E;
+}
+
+// applies SHDLC byte stuffing. Returns the stuffed length.
+static size_t stuff_sps30_frame(const uint8_t* frame, uint8_t* stuffed)
+{
+    size_t length = 0;
+    stuffed[length++] = frame[0];
+    for (uint8_t i = 1; i < SPS30Protocol::FRAME_SIZE - 1; i++) {
+        uint8_t byte = frame[i];
+        if ((byte == 0x7E) || (byte == 0x7D) || (byte == 0x11) || (byte == 0x13)) {
+            stuffed[length++] = 0x7D;
+            byte ^= 0x20;
+        }
+        stuffed[length++] = byte;
+    }
+    stuffed[length++] = frame[SPS30Protocol::FRAME_SIZE - 1];
+    return length;
+}
+
+void test_ParticulateFrameDecoder_PMS5003( void ) {
+    uint8_t good[PMS5003Protocol::FRAME_SIZE];
+    uint8_t bad[PMS5003Protocol::FRAME_SIZE];
+    build_pms5003_frame(good, 35);
+    build_pms5003_frame(bad, 36);
+    bad[20] ^= 0x01;
+    PMS5003FrameDecoder decoder;
+    PMS5003FrameDecoder::Frame frame;
+    ParticulateMeasurement measurement;
+
+    // Test 1 - the big endian atmospheric fields are read, and fields the sensor lacks are 0
+    TEST_ASSERT_EQUAL_INT(1, decoder.push(good, sizeof(good), 100));
+    TEST_ASSERT_TRUE(decoder.takeFrame(frame));
+    PMS5003FrameDecoder::decode(frame.bytes, measurement);
+    TEST_ASSERT_EQUAL_UINT32(3, measurement.pm1p0);
+    TEST_ASSERT_EQUAL_UINT32(35, measurement.pm2p5);
+    TEST_ASSERT_EQUAL_UINT32(70, measurement.pm10);
+    TEST_ASSERT_EQUAL_UINT16(600, measurement.particleCount0p5um);
+    TEST_ASSERT_EQUAL_UINT16(0, measurement.particleCount7p5um);
+    TEST_ASSERT_EQUAL_UINT16(4, measurement.particleCount10um);
+    TEST_ASSERT_EQUAL_UINT8(0, measurement.sensorStatus);
+
+    // Test 2 - a frame with a bad checksum is rejected and the following frame is still found
+    decoder.push(bad, sizeof(bad), 200);
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.corruptFrameCount());
+    TEST_ASSERT_EQUAL_INT(1, decoder.push(good, sizeof(good), 300));
+
+    // Test 3 - a start byte that is not followed by the rest of the header is dropped as soon
+    // as the header fails, without waiting for a full frame
+    const uint8_t false_start[] = {0x42, 0x4D, 0x00, 0x20, 0x42};
+    uint32_t discarded = decoder.discardedByteCount();
+    decoder.push(false_start, sizeof(false_start), 400);
+    TEST_ASSERT_EQUAL_UINT32(discarded + 4, decoder.discardedByteCount());
+    TEST_ASSERT_EQUAL_INT(1, decoder.push(good + 1, sizeof(good) - 1, 400));
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.corruptFrameCount());
+    TEST_ASSERT_FALSE(PMS5003FrameDecoder::isValidFrame(bad));
+}
+
+void test_ParticulateFrameDecoder_SPS30( void ) {
+    // 15.875 is 0x417E0000 and 63.25 is 0x427D0000, so both need escaping
+    uint8_t frame_bytes[SPS30Protocol::FRAME_SIZE];
+    build_sps30_frame(frame_bytes, 15.875, 63.25, 12.34);
+    TEST_ASSERT_TRUE(SPS30FrameDecoder::isValidFrame(frame_bytes));
+    uint8_t stuffed[2*SPS30Protocol::FRAME_SIZE];
+    size_t stuffed_length = stuff_sps30_frame(frame_bytes, stuffed);
+    TEST_ASSERT_TRUE(stuffed_length > SPS30Protocol::FRAME_SIZE);
+    SPS30FrameDecoder decoder;
+    SPS30FrameDecoder::Frame frame;
+    ParticulateMeasurement measurement;
+
+    // Test 1 - the answer to Start Measurement is skipped, and the escaped bytes are restored
+    const uint8_t start_answer[] = {0x7E, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x7E};
+    decoder.push(start_answer, sizeof(start_answer), 0);
+    TEST_ASSERT_EQUAL_INT(1, decoder.push(stuffed, stuffed_length, 1000));
+    TEST_ASSERT_TRUE(decoder.takeFrame(frame));
+    TEST_ASSERT_EQUAL_MEMORY(frame_bytes, frame.bytes, SPS30Protocol::FRAME_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(0, decoder.corruptFrameCount());
+
+    // Test 2 - floats are rounded, and counts are scaled from per cm^3 to per 0.1 L
+    SPS30FrameDecoder::decode(frame.bytes, measurement);
+    TEST_ASSERT_EQUAL_UINT32(1, measurement.pm1p0);
+    TEST_ASSERT_EQUAL_UINT32(16, measurement.pm2p5);
+    TEST_ASSERT_EQUAL_UINT32(63, measurement.pm10);
+    TEST_ASSERT_EQUAL_UINT16(1234, measurement.particleCount0p5um);
+    TEST_ASSERT_EQUAL_UINT16(0, measurement.particleCount5p0um);
+
+    // Test 3 - a frame cut short by the start of the next one is dropped without being counted
+    // as corrupt, since the unescaped start byte shows where the next frame begins
+    decoder.push(stuffed, 20, 2000);
+    TEST_ASSERT_EQUAL_INT(1, decoder.push(stuffed, stuffed_length, 2000));
+    TEST_ASSERT_EQUAL_UINT32(0, decoder.corruptFrameCount());
+    TEST_ASSERT_EQUAL_UINT32(2, decoder.validFrameCount());
+
+    // Test 4 - a bad checksum is caught after unstuffing
+    stuffed[stuffed_length - 2] ^= 0x01;
+    TEST_ASSERT_EQUAL_INT(0, decoder.push(stuffed, stuffed_length, 3000));
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.corruptFrameCount());
+}
+#endif
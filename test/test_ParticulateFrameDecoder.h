@@ -0,0 +1,7 @@
+#ifndef __test_ParticulateFrameDecoder__
+#define __test_ParticulateFrameDecoder__
+
+void test_ParticulateFrameDecoder_PMS5003( void );
+void test_ParticulateFrameDecoder_SPS30( void );
+
+#endif // __test_ParticulateFrameDecoder__
@@ -0,0 +1,46 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "PrometheusWriter.h"
+#include "test_helpers.h"
+#include "test_PrometheusWriter.h"
+
+void test_PrometheusWriter_format( void ) {
+    // Test 1 - counters and gauges are a family with one sample
+    CapturePrint out;
+    PrometheusWriter writer(out);
+    writer.counter("diyaqi_frames_total", "Frames seen.", 42);
+    writer.gauge("diyaqi_free_bytes", "Free bytes.", 1536);
+    TEST_ASSERT_EQUAL_STRING(
+        "# HELP diyaqi_frames_total Frames seen.\n"
+        "# TYPE diyaqi_frames_total counter\n"
+        "diyaqi_frames_total 42\n"
+        "# HELP diyaqi_free_bytes Free bytes.\n"
+        "# TYPE diyaqi_free_bytes gauge\n"
+        "diyaqi_free_bytes 1536\n",
+        out.text
+    );
+
+    // Test 2 - histogram buckets are cumulative, in seconds, on the exported bucket boundaries
+    LatencyHistogram histogram;
+    histogram.record(0);
+    histogram.record(2);
+    histogram.record(3);
+    histogram.record(900);
+    histogram.record(2500000);
+    histogram.record(40000000);     // past the largest exported boundary
+    CapturePrint hist_out;
+    PrometheusWriter hist_writer(hist_out);
+    hist_writer.histogram("lat_seconds", "stage", "read", histogram);
+    TEST_ASSERT_TRUE(strstr(hist_out.text, "lat_seconds_bucket{stage=\"read\",le=\"0.000000\"} 1\n") != nullptr);
+    TEST_ASSERT_TRUE(strstr(hist_out.text, "lat_seconds_bucket{stage=\"read\",le=\"0.000003\"} 3\n") != nullptr);
+    TEST_ASSERT_TRUE(strstr(hist_out.text, "lat_seconds_bucket{stage=\"read\",le=\"0.001023\"} 4\n") != nullptr);
+    TEST_ASSERT_TRUE(strstr(hist_out.text, "lat_seconds_bucket{stage=\"read\",le=\"4.194303\"} 5\n") != nullptr);
+    TEST_ASSERT_TRUE(strstr(hist_out.text, "lat_seconds_bucket{stage=\"read\",le=\"16.777215\"} 5\n") != nullptr);
+    TEST_ASSERT_TRUE(strstr(hist_out.text, "lat_seconds_bucket{stage=\"read\",le=\"+Inf\"} 6\n") != nullptr);
+    TEST_ASSERT_TRUE(strstr(hist_out.text, "lat_seconds_sum{stage=\"read\"} 42.500905\n") != nullptr);
+    TEST_ASSERT_TRUE(strstr(hist_out.text, "lat_seconds_count{stage=\"read\"} 6\n") != nullptr);
+    // odd buckets are folded into the next exported boundary
+    TEST_ASSERT_TRUE(strstr(hist_out.text, "le=\"0.000001\"") == nullptr);
+}
+#endif
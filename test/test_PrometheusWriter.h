@@ -0,0 +1,6 @@
+#ifndef __test_PrometheusWriter__
+#define __test_PrometheusWriter__
+
+void test_PrometheusWriter_format( void );
+
+#endif // __test_PrometheusWriter__
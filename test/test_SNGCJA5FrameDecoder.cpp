@@ -0,0 +1,65 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "SNGCJA5FrameDecoder.h"
+#include "test_helpers.h"
+#include "test_SNGCJA5FrameDecoder.h"
+
+void test_SNGCJA5FrameDecoder_validFrames( void ) {
+    uint8_t frame1[SNGCJA5_FRAME_SIZE];
+    uint8_t frame2[SNGCJA5_FRAME_SIZE];
+    makeSNGCJA5Frame(frame1, 0x11, 0x1111);
+    makeSNGCJA5Frame(frame2, 0x22, 0x2222);
+    SNGCJA5FrameDecoder decoder;
+    SNGCJA5Frame frame;
+
+    // Test 1 - a frame split across pushes is decoded once complete
+    TEST_ASSERT_EQUAL_INT(0, decoder.push(frame1, 10, 100));
+    TEST_ASSERT_FALSE(decoder.hasNewFrame());
+    TEST_ASSERT_EQUAL_INT(1, decoder.push(frame1 + 10, SNGCJA5_FRAME_SIZE - 10, 200));
+    TEST_ASSERT_TRUE(decoder.takeFrame(frame));
+    TEST_ASSERT_EQUAL_MEMORY(frame1, frame.bytes, SNGCJA5_FRAME_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(200, frame.receive_millis);
+    TEST_ASSERT_FALSE(decoder.takeFrame(frame));
+
+    // Test 2 - only the newest frame is kept, and the superseded one is counted
+    decoder.push(frame1, SNGCJA5_FRAME_SIZE, 300);
+    decoder.push(frame2, SNGCJA5_FRAME_SIZE, 400);
+    TEST_ASSERT_TRUE(decoder.takeFrame(frame));
+    TEST_ASSERT_EQUAL_MEMORY(frame2, frame.bytes, SNGCJA5_FRAME_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(3, decoder.validFrameCount());
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.droppedFrameCount());
+    TEST_ASSERT_EQUAL_UINT32(0, decoder.corruptFrameCount());
+}
+
+void test_SNGCJA5FrameDecoder_resync( void ) {
+    uint8_t good[SNGCJA5_FRAME_SIZE];
+    uint8_t bad[SNGCJA5_FRAME_SIZE];
+    makeSNGCJA5Frame(good, 0x33, 0x3333);
+    makeSNGCJA5Frame(bad, 0x44, 0x4444);
+    bad[7] ^= 0x01;     // corrupt one measurement byte so the FCC fails
+    SNGCJA5FrameDecoder decoder;
+    SNGCJA5Frame frame;
+
+    // Test 1 - leading garbage is skipped
+    const uint8_t garbage[] = {0x00, 0x03, 0xFF};
+    decoder.push(garbage, sizeof(garbage), 0);
+    TEST_ASSERT_EQUAL_UINT32(3, decoder.discardedByteCount());
+
+    // Test 2 - a frame with a bad FCC is rejected and the following frame is still found
+    decoder.push(bad, SNGCJA5_FRAME_SIZE, 0);
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.corruptFrameCount());
+    TEST_ASSERT_EQUAL_INT(1, decoder.push(good, SNGCJA5_FRAME_SIZE, 0));
+    TEST_ASSERT_TRUE(decoder.takeFrame(frame));
+    TEST_ASSERT_EQUAL_MEMORY(good, frame.bytes, SNGCJA5_FRAME_SIZE);
+
+    // Test 3 - a truncated frame followed by a full frame. The STX of the full frame sits
+    // inside the failed candidate, so the decoder must resynchronize to it.
+    decoder.push(good, 20, 0);
+    TEST_ASSERT_EQUAL_INT(1, decoder.push(good, SNGCJA5_FRAME_SIZE, 0));
+    TEST_ASSERT_TRUE(decoder.takeFrame(frame));
+    TEST_ASSERT_EQUAL_MEMORY(good, frame.bytes, SNGCJA5_FRAME_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(2, decoder.corruptFrameCount());
+    TEST_ASSERT_FALSE(SNGCJA5FrameDecoder::isValidFrame(bad));
+}
+#endif
@@ -0,0 +1,7 @@
+#ifndef __test_SNGCJA5FrameDecoder__
+#define __test_SNGCJA5FrameDecoder__
+
+void test_SNGCJA5FrameDecoder_validFrames( void );
+void test_SNGCJA5FrameDecoder_resync( void );
+
+#endif // __test_SNGCJA5FrameDecoder__
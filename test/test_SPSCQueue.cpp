@@ -0,0 +1,69 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "SPSCQueue.h"
+#include "MPSCQueue.h"
+#include "test_SPSCQueue.h"
+
+void test_SPSCQueue_pushPop( void ) {
+    SPSCQueue<uint32_t, 4> queue;
+    uint32_t value = 0;
+
+    // Test 1 - empty queue
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_FALSE(queue.pop(value));
+
+    // Test 2 - fill to capacity, overflow is counted
+    for (uint32_t i = 1; i <= 5; i++) {
+        queue.push(i);
+    }
+    TEST_ASSERT_EQUAL_INT(4, queue.size());
+    TEST_ASSERT_EQUAL_UINT32(4, queue.highWaterMark());
+    TEST_ASSERT_EQUAL_UINT32(1, queue.overflowCount());
+
+    // Test 3 - items come out in order and the ring wraps
+    TEST_ASSERT_TRUE(queue.pop(value));
+    TEST_ASSERT_EQUAL_UINT32(1, value);
+    TEST_ASSERT_TRUE(queue.push(6));
+    const uint32_t expected[] = {2, 3, 4, 6};   // 5 was dropped when the queue was full
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(queue.pop(value));
+        TEST_ASSERT_EQUAL_UINT32(expected[i], value);
+    }
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+void test_MPSCQueue_pushPop( void ) {
+    MPSCQueue<uint32_t, 4> queue;
+    uint32_t value = 0;
+
+    // Test 1 - empty queue
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_FALSE(queue.pop(value));
+
+    // Test 2 - fill to capacity, the item that does not fit is refused and counted
+    for (uint32_t i = 1; i <= 4; i++) {
+        TEST_ASSERT_TRUE(queue.push(i));
+    }
+    TEST_ASSERT_FALSE(queue.push(5));
+    TEST_ASSERT_EQUAL_INT(4, queue.size());
+    TEST_ASSERT_EQUAL_UINT32(1, queue.overflowCount());
+
+    // Test 3 - items come out in order over several laps of the ring
+    uint32_t next_push = 6;
+    uint32_t next_pop = 1;
+    for (uint8_t i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(queue.pop(value));
+        TEST_ASSERT_EQUAL_UINT32(next_pop, value);
+        next_pop = (next_pop == 4) ? 6 : next_pop + 1;
+        TEST_ASSERT_TRUE(queue.push(next_push++));
+    }
+    TEST_ASSERT_EQUAL_INT(4, queue.size());
+    while (queue.pop(value)) {
+        TEST_ASSERT_EQUAL_UINT32(next_pop++, value);
+    }
+    TEST_ASSERT_EQUAL_UINT32(next_push, next_pop);
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_EQUAL_UINT32(1, queue.overflowCount());
+}
+#endif
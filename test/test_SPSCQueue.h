@@ -0,0 +1,7 @@
+#ifndef __test_SPSCQueue__
+#define __test_SPSCQueue__
+
+void test_SPSCQueue_pushPop( void );
+void test_MPSCQueue_pushPop( void );
+
+#endif // __test_SPSCQueue__
@@ -0,0 +1,527 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "SampleHistory.h"
+#include "SampleHistoryStream.h"
+#include "SampleHistoryArchive.h"
+#include "test_helpers.h"
+#include "test_SampleHistory.h"
+
+void test_SampleHistory_windowAverages( void ) {
+    uint32_t storage[16];
+    SampleHistory history;
+    TEST_ASSERT_TRUE(sizeof(storage) >= SampleHistory::storageBytes(5, nullptr, 0));
+    history.setStorage(storage, 5);
+
+    // samples are pushed every second
+    SampleWindowID one = history.registerWindow(1000);
+    SampleWindowID three = history.registerWindow(3000);
+    SampleWindowID full = history.registerWindow(5000);     // longer than the 4 seconds between the 5 samples held
+    SampleWindowID clamped = history.registerWindow(SAMPLE_HISTORY_MAX_WINDOW_MILLIS + 1);
+
+    TEST_ASSERT_EQUAL_INT(clamped, history.findWindow(SAMPLE_HISTORY_MAX_WINDOW_MILLIS));
+    TEST_ASSERT_EQUAL_INT(three, history.registerWindow(3000));
+    TEST_ASSERT_EQUAL_FLOAT(0, history.windowAverage(three));
+
+    // Test 1 - windows that have not yet filled average what they have
+    history.push(2, 1000);
+    history.push(4, 2000);
+    TEST_ASSERT_EQUAL_FLOAT(4, history.windowAverage(one));
+    TEST_ASSERT_EQUAL_FLOAT(3, history.windowAverage(three));
+    TEST_ASSERT_EQUAL_FLOAT(3, history.windowAverage(full));
+    TEST_ASSERT_EQUAL_UINT32(2000, history.windowStats(full).coveredMillis);
+
+    // Test 2 - windows evict samples as they age out, including once the ring wraps
+    const uint16_t values[] = {6, 8, 10, 12, 14};
+    for (size_t i = 0; i < 5; i++) {
+        history.push(values[i], 3000 + i*1000);
+    }
+    TEST_ASSERT_EQUAL_INT(5, history.size());
+    TEST_ASSERT_EQUAL_UINT32(7000, history.newestTime());
+    TEST_ASSERT_EQUAL_FLOAT(14, history.windowAverage(one));
+    TEST_ASSERT_EQUAL_FLOAT(12, history.windowAverage(three));
+    TEST_ASSERT_EQUAL_FLOAT(10, history.windowAverage(full));
+    TEST_ASSERT_EQUAL_FLOAT(10, history.windowAverage(clamped));
+    TEST_ASSERT_EQUAL_INT(3, history.windowSampleCount(three));
+}
+
+void test_SampleHistory_lateRegisteredWindow( void ) {
+    uint32_t storage[16];
+    SampleHistory history;
+    history.setStorage(storage, 4);
+    for (uint16_t v = 1; v <= 6; v++) {
+        history.push(v, v*1000);
+    }
+
+    // a window registered after the fact is seeded from the newest samples
+    SampleWindowID two = history.registerWindow(2000);
+    TEST_ASSERT_EQUAL_FLOAT(5.5, history.windowAverage(two));
+    history.push(7, 7000);
+    TEST_ASSERT_EQUAL_FLOAT(6.5, history.windowAverage(two));
+    TEST_ASSERT_EQUAL_INT(INVALID_SAMPLE_WINDOW, history.findWindow(3000));
+}
+
+void test_SampleHistory_gaps( void ) {
+    uint32_t storage[16];
+    SampleHistory history;
+    history.setStorage(storage, 10);
+    history.setSamplePeriod(1000, 3000);
+    SampleWindowID ten = history.registerWindow(10000);
+
+    // Test 1 - a sample after a missed one counts for both periods
+    history.push(10, 1000);
+    history.push(10, 2000);
+    history.push(40, 4000);
+    history.push(20, 5000);
+    SampleWindowStats stats = history.windowStats(ten);
+    TEST_ASSERT_EQUAL_FLOAT(24, stats.average);
+    TEST_ASSERT_EQUAL_UINT32(5000, stats.coveredMillis);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.gapMillis);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.samples);
+
+    // Test 2 - a sample after more than the max interval only counts for one period, and the
+    // rest is a gap
+    history.push(30, 12000);
+    stats = history.windowStats(ten);
+    TEST_ASSERT_EQUAL_FLOAT(32.5, stats.average);
+    TEST_ASSERT_EQUAL_UINT32(4000, stats.coveredMillis);
+    TEST_ASSERT_EQUAL_UINT32(6000, stats.gapMillis);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.samples);
+
+    // Test 3 - only the part of the oldest sample's period that is inside the window counts
+    history.push(30, 13000);
+    stats = history.windowStats(ten);
+    TEST_ASSERT_EQUAL_FLOAT(30, stats.average);
+    TEST_ASSERT_EQUAL_UINT32(4000, stats.coveredMillis);
+    TEST_ASSERT_EQUAL_UINT32(6000, stats.gapMillis);
+    SampleWindowStats scanned = history.scanWindow(10000);
+    TEST_ASSERT_EQUAL_FLOAT(stats.average, scanned.average);
+    TEST_ASSERT_EQUAL_UINT32(stats.coveredMillis, scanned.coveredMillis);
+    TEST_ASSERT_EQUAL_UINT32(stats.gapMillis, scanned.gapMillis);
+
+    // Test 4 - a gap longer than the window leaves only the newest sample and the rest of the window as gap
+    history.push(50, 100000);
+    stats = history.windowStats(ten);
+    TEST_ASSERT_EQUAL_FLOAT(50, stats.average);
+    TEST_ASSERT_EQUAL_UINT32(1000, stats.coveredMillis);
+    TEST_ASSERT_EQUAL_UINT32(9000, stats.gapMillis);
+
+    // Test 5 - times are differences, so the millis() counter wrapping makes no difference
+    history.setStorage(storage, 10);
+    ten = history.registerWindow(10000);
+    history.push(10, 0xFFFFF000);
+    history.push(20, 0xFFFFF000 + 1000);
+    history.push(30, 0xFFFFF000 + 2000);
+    TEST_ASSERT_EQUAL_FLOAT(20, history.windowAverage(ten));
+    TEST_ASSERT_EQUAL_UINT32(3000, history.windowStats(ten).coveredMillis);
+}
+
+void test_SampleHistory_timeline( void ) {
+    uint32_t storage[32];
+    SampleTimeline timeline;
+    TEST_ASSERT_TRUE(sizeof(storage) >= SampleTimeline::storageBytes(40));
+    timeline.setStorage(storage, 40);
+
+    // Test 1 - times are exact while a block's offsets fit in 16 bits
+    for (size_t i = 0; i < 40; i++) {
+        timeline.set(i, 1000*i + 5);
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, timeline.get(0));
+    TEST_ASSERT_EQUAL_UINT32(31005, timeline.get(31));
+    TEST_ASSERT_EQUAL_UINT32(39005, timeline.get(39));
+
+    // Test 2 - starting the next lap keeps the rest of the block's times from the last lap
+    timeline.set(0, 100000);
+    TEST_ASSERT_EQUAL_UINT32(100000, timeline.get(0));
+    TEST_ASSERT_EQUAL_UINT32(1005, timeline.get(1));
+    TEST_ASSERT_EQUAL_UINT32(39005, timeline.get(39));
+
+    // Test 3 - an offset that does not fit coarsens the block's times
+    timeline.set(1, 170000);
+    TEST_ASSERT_EQUAL_UINT32(170000, timeline.get(1));
+    timeline.set(2, 300001);
+    TEST_ASSERT_EQUAL_UINT32(100000, timeline.get(0));
+    TEST_ASSERT_EQUAL_UINT32(170000, timeline.get(1));
+    TEST_ASSERT_EQUAL_UINT32(300000, timeline.get(2));
+    TEST_ASSERT_EQUAL_UINT32(3005, timeline.get(3));
+}
+
+void test_SampleHistory_distribution( void ) {
+    uint32_t storage[64];
+    uint32_t distribution_storage[64];
+
+    // Test 1 - bins are 1 wide below 100, 5 wide to 500 and 25 wide to 1000
+    TEST_ASSERT_EQUAL_UINT16(99, SampleDistribution::binForValue(99));
+    TEST_ASSERT_EQUAL_UINT16(100, SampleDistribution::binForValue(104));
+    TEST_ASSERT_EQUAL_UINT16(104, SampleDistribution::binUpperBound(100));
+    TEST_ASSERT_EQUAL_UINT16(524, SampleDistribution::binUpperBound(SampleDistribution::binForValue(500)));
+    TEST_ASSERT_EQUAL_UINT16(SAMPLE_DISTRIBUTION_BINS - 1, SampleDistribution::binForValue(1000));
+
+    // Test 2 - the min, max and percentiles of a full resolution window follow the samples in it
+    SampleHistory history;
+    history.setStorage(storage, 10);
+    SampleWindowID five = history.registerWindow(5000);
+    SampleDistribution distribution;
+    TEST_ASSERT_TRUE(sizeof(distribution_storage) >= SampleDistribution::storageBytes(history.windowEntryCapacity(five)));
+    distribution.setStorage(distribution_storage, history.windowEntryCapacity(five));
+    TEST_ASSERT_TRUE(history.trackDistribution(five, distribution));
+    const uint16_t values[] = {5, 1, 9, 3, 7};
+    for (size_t i = 0; i < 5; i++) {
+        history.push(values[i], 1000*(i + 1));
+    }
+    SampleWindowSpread spread = history.windowSpread(five);
+    TEST_ASSERT_EQUAL_UINT16(1, spread.min);
+    TEST_ASSERT_EQUAL_UINT16(9, spread.max);
+    TEST_ASSERT_EQUAL_UINT16(5, spread.p50);
+    TEST_ASSERT_EQUAL_UINT16(9, spread.p99);
+    TEST_ASSERT_EQUAL_UINT32(5, spread.samples);
+    for (uint32_t time = 6000; time <= 9000; time += 1000) {
+        history.push(2, time);
+    }
+    spread = history.windowSpread(five);
+    TEST_ASSERT_EQUAL_UINT16(2, spread.min);
+    TEST_ASSERT_EQUAL_UINT16(7, spread.max);
+    TEST_ASSERT_EQUAL_UINT16(2, spread.p50);
+    TEST_ASSERT_EQUAL_UINT16(7, spread.p99);
+
+    // Test 3 - on a rollup level the percentiles are of the bucket means, and a window tracked
+    // late is seeded from the buckets already in it
+    const SampleHistoryTier tiers[] = { {2, 8} };
+    history.setStorage(storage, 4, tiers, 1);
+    SampleWindowID eight = history.registerWindow(8000);
+    for (uint16_t v = 1; v <= 10; v++) {
+        history.push(v, v*1000);
+    }
+    TEST_ASSERT_EQUAL_INT(0, history.windowSpread(eight).samples);
+    distribution.setStorage(distribution_storage, history.windowEntryCapacity(eight));
+    history.trackDistribution(eight, distribution);
+    spread = history.windowSpread(eight);
+    TEST_ASSERT_EQUAL_UINT16(3, spread.min);
+    TEST_ASSERT_EQUAL_UINT16(10, spread.max);
+    TEST_ASSERT_EQUAL_UINT16(6, spread.p50);
+    TEST_ASSERT_EQUAL_UINT32(8, spread.samples);
+
+    // samples not yet rolled up count towards the min and max
+    history.push(11, 11000);
+    TEST_ASSERT_EQUAL_UINT16(11, history.windowSpread(eight).max);
+    history.push(12, 12000);
+    spread = history.windowSpread(eight);
+    TEST_ASSERT_EQUAL_UINT16(5, spread.min);
+    TEST_ASSERT_EQUAL_UINT16(12, spread.max);
+
+    // Test 4 - a full deque drops its oldest entry
+    distribution.setStorage(distribution_storage, 2);
+    distribution.add(0, 1, 1, 1, 1);
+    distribution.add(1, 2, 2, 2, 1);
+    distribution.add(2, 3, 3, 3, 1);
+    TEST_ASSERT_EQUAL_UINT16(2, distribution.min());
+    TEST_ASSERT_EQUAL_UINT16(3, distribution.max());
+    distribution.remove(1, 1, 2);
+    TEST_ASSERT_EQUAL_UINT16(3, distribution.min());
+    TEST_ASSERT_EQUAL_UINT32(2, distribution.count());
+}
+
+void test_SampleHistory_rollupTiers( void ) {
+    // 4 full resolution samples, 3 buckets of 2 samples, 2 buckets of 4 samples
+    const SampleHistoryTier tiers[] = { {2, 3}, {4, 2} };
+    uint32_t storage[64];
+    TEST_ASSERT_TRUE(sizeof(storage) >= SampleHistory::storageBytes(4, tiers, 2));
+
+    SampleHistory history;
+    TEST_ASSERT_TRUE(history.setStorage(storage, 4, tiers, 2));
+    for (uint16_t v = 1; v <= 10; v++) {
+        history.push(v, v*1000);
+    }
+
+    // Test 1 - full resolution samples in chronological order
+    TEST_ASSERT_EQUAL_INT(4, history.size());
+    TEST_ASSERT_EQUAL_INT(7, history.sample(0));
+    TEST_ASSERT_EQUAL_INT(10, history.sample(3));
+
+    // Test 2 - the first tier only keeps the newest 3 buckets, stamped with their newest sample's time
+    TEST_ASSERT_EQUAL_INT(3, history.levelSize(1));
+    const SampleAggregate& oldest = history.aggregate(1, 0);
+    TEST_ASSERT_EQUAL_INT(5, oldest.min);
+    TEST_ASSERT_EQUAL_INT(6, oldest.max);
+    TEST_ASSERT_EQUAL_INT(2, oldest.count);
+    TEST_ASSERT_EQUAL_FLOAT(9.5, history.aggregate(1, 2).mean());
+    TEST_ASSERT_EQUAL_UINT32(10000, history.entryTime(1, 4));
+
+    // Test 3 - the second tier rolls up whole buckets of the first tier
+    TEST_ASSERT_EQUAL_INT(2, history.levelSize(2));
+    TEST_ASSERT_EQUAL_INT(1, history.aggregate(2, 0).min);
+    TEST_ASSERT_EQUAL_INT(8, history.aggregate(2, 1).max);
+    TEST_ASSERT_EQUAL_INT(4, history.aggregate(2, 1).count);
+    TEST_ASSERT_EQUAL_INT(8, history.retainedSamples());
+    TEST_ASSERT_EQUAL_UINT32(8000, history.entryTime(2, 1));
+
+    // Test 4 - invalid tier configurations are rejected
+    const SampleHistoryTier bad_tiers[] = { {2, 3}, {3, 2} };
+    TEST_ASSERT_FALSE(history.setStorage(storage, 4, bad_tiers, 2));
+    TEST_ASSERT_EQUAL_INT(0, history.tierCount());
+}
+
+void test_SampleHistory_tierWindows( void ) {
+    // 4 full resolution samples, 4 buckets of 2 samples, 2 buckets of 4 samples
+    const SampleHistoryTier tiers[] = { {2, 4}, {4, 2} };
+    uint32_t storage[64];
+    SampleHistory history;
+    history.setStorage(storage, 4, tiers, 2);
+
+    SampleWindowID raw = history.registerWindow(3000);
+    SampleWindowID six = history.registerWindow(6000);     // 3 buckets on the first tier
+    SampleWindowID eight = history.registerWindow(8000);   // 2 buckets on the second tier
+
+    for (uint16_t v = 1; v <= 12; v++) {
+        history.push(v, v*1000);
+    }
+
+    // Test 1 - each level's windows hold the entries in their span
+    TEST_ASSERT_EQUAL_FLOAT(11, history.windowAverage(raw));
+    TEST_ASSERT_EQUAL_INT(6, history.windowSampleCount(six));
+    TEST_ASSERT_EQUAL_FLOAT(9.5, history.windowAverage(six));
+    TEST_ASSERT_EQUAL_INT(8, history.windowSampleCount(eight));
+    TEST_ASSERT_EQUAL_FLOAT(8.5, history.windowAverage(eight));
+
+    // Test 2 - the incremental windows include samples that are not yet rolled up into a full
+    // bucket, and are accurate to the bucket size
+    history.push(13, 13000);
+    TEST_ASSERT_EQUAL_INT(9, history.windowSampleCount(eight));
+    TEST_ASSERT_EQUAL_UINT32(8000, history.windowStats(eight).coveredMillis);
+    TEST_ASSERT_FLOAT_WITHIN(0.25, 9.5, history.windowAverage(eight));
+
+    // scanning gives the same results as the incremental windows
+    TEST_ASSERT_EQUAL_FLOAT(history.windowAverage(six), history.scanAverage(6000));
+    TEST_ASSERT_EQUAL_FLOAT(history.windowAverage(eight), history.scanAverage(8000));
+
+    // history queries pick the level that can return the span in the fewest entries allowed
+    TEST_ASSERT_EQUAL_INT(0, history.levelForSpan(4, 4));
+    TEST_ASSERT_EQUAL_INT(1, history.levelForSpan(6, 4));
+    TEST_ASSERT_EQUAL_INT(2, history.levelForSpan(8, 2));
+}
+
+static String readStream(SampleHistoryStream& stream, size_t buffer_size) {
+    String json;
+    uint8_t buffer[16];
+    size_t length;
+    while ((length = stream.read(buffer, buffer_size)) > 0) {
+        for (size_t i = 0; i < length; i++) {
+            json += (char)buffer[i];
+        }
+    }
+    return json;
+}
+
+void test_SampleHistory_stream( void ) {
+    // 4 full resolution samples, 3 buckets of 2 samples, 2 buckets of 4 samples
+    const SampleHistoryTier tiers[] = { {2, 3}, {4, 2} };
+    uint32_t storage[64];
+    SampleHistory history;
+    history.setStorage(storage, 4, tiers, 2);
+    for (uint16_t v = 1; v <= 10; v++) {
+        history.push(v, v*2000);
+    }
+
+    // Test 1 - entries are read by number, and the oldest entry of a full level is not readable
+    SampleAggregate entry;
+    TEST_ASSERT_EQUAL_INT(10, history.levelPushCount(0));
+    TEST_ASSERT_EQUAL_INT(5, history.levelPushCount(1));
+    TEST_ASSERT_TRUE(history.readEntry(0, 9, entry));
+    TEST_ASSERT_EQUAL_INT(10, entry.max);
+    TEST_ASSERT_FALSE(history.readEntry(0, 6, entry));
+    TEST_ASSERT_FALSE(history.readEntry(0, 10, entry));
+    TEST_ASSERT_TRUE(history.readEntry(1, 4, entry));
+    TEST_ASSERT_EQUAL_FLOAT(9.5, entry.mean());
+    uint32_t entry_time;
+    TEST_ASSERT_TRUE(history.readEntryTime(1, 4, entry_time));
+    TEST_ASSERT_EQUAL_UINT32(20000, entry_time);
+    TEST_ASSERT_FALSE(history.readEntryTime(0, 6, entry_time));
+
+    // Test 2 - full resolution samples, read through a buffer smaller than an entry.
+    // The newest sample was taken at 1000 and samples are 2 seconds apart.
+    SampleHistoryStream samples(history, 2, 1000, 994, 1000, 10);
+    TEST_ASSERT_EQUAL_INT(0, samples.level());
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"level\":0,\"step\":2,\"fields\":[\"time\",\"value\"],\"data\":[[996,8],[998,9],[1000,10]]}",
+        readStream(samples, 5).c_str()
+    );
+
+    // Test 3 - a span longer than max_entries allows is read from a rollup level
+    SampleHistoryStream rollup(history, 2, 1000, 0, 1000, 2);
+    TEST_ASSERT_EQUAL_INT(2, rollup.level());
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"level\":2,\"step\":8,\"fields\":[\"time\",\"mean\",\"min\",\"max\"],\"data\":[[990,6.50,5,8]]}",
+        readStream(rollup, 16).c_str()
+    );
+
+    // Test 4 - a span with no samples in it
+    SampleHistoryStream empty(history, 2, 1000, 2000, 3000, 10);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"level\":0,\"step\":2,\"fields\":[\"time\",\"value\"],\"data\":[]}",
+        readStream(empty, 16).c_str()
+    );
+
+    // Test 5 - restored buckets, then a gap while the device was down, then new samples.
+    // The entries are found and stamped by the times they were recorded at, not their numbers.
+    const SampleHistoryTier restored_tiers[] = { {3, 10} };
+    SampleHistory restored;
+    restored.setStorage(storage, 4, restored_tiers, 1);
+    restored.setSamplePeriod(2000, 6000);
+    for (uint16_t k = 0; k < 6; k++) {
+        SampleAggregate bucket;
+        bucket.clear();
+        for (int i = 0; i < 3; i++) {
+            bucket.add(k + 1);
+        }
+        TEST_ASSERT_TRUE(restored.restoreAggregate(bucket, 100000 + 6000*k));
+    }
+    for (uint16_t i = 0; i < 6; i++) {
+        restored.push(10 + i, 200000 + 2000*i);
+    }
+    SampleHistoryStream all(restored, 2, 1000000, 0, 1000000, 20);
+    TEST_ASSERT_EQUAL_INT(1, all.level());
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"level\":1,\"step\":6,\"fields\":[\"time\",\"mean\",\"min\",\"max\"],\"data\":["
+        "[999886,1.00,1,1],[999892,2.00,2,2],[999898,3.00,3,3],[999904,4.00,4,4],[999910,5.00,5,5],"
+        "[999916,6.00,6,6],[999990,11.00,10,12],[999996,14.00,13,15]]}",
+        readStream(all, 16).c_str()
+    );
+
+    // Test 6 - a span across the gap holds the entries on both sides of it
+    SampleHistoryStream across(restored, 2, 1000000, 999900, 999995, 20);
+    TEST_ASSERT_EQUAL_INT(5, across.entryCount());
+    String across_json = readStream(across, 16);
+    TEST_ASSERT_TRUE(across_json.indexOf("\"data\":[[999898,3.00,3,3],") > 0);
+    TEST_ASSERT_TRUE(across_json.endsWith("[999990,11.00,10,12]]}"));
+}
+
+void test_SampleHistory_archive( void ) {
+    fs::HostFS fs("/tmp/diyaqi_test_fs");
+    removeFiles(fs, "/ha");
+    const SampleHistoryTier tiers[] = {{3, 100}};
+    const uint32_t now = 1700000000;
+    uint32_t storage[512];
+    TEST_ASSERT_TRUE(sizeof(storage) >= SampleHistory::storageBytes(6, tiers, 1));
+    float saved_average;
+
+    {
+        SampleHistory history;
+        history.setStorage(storage, 6, tiers, 1);
+        SampleWindowID window = history.registerWindow(30000);
+        SampleHistoryArchive archive;
+        TEST_ASSERT_TRUE(archive.begin(fs, "/ha", history, 1, 2, 16));
+
+        // Test 1 - completed buckets are only written once a batch is full
+        for (uint16_t i = 0; i < 45; i++) {
+            history.push(i, 1000*(i + 1));
+        }
+        TEST_ASSERT_TRUE(archive.poll(now - 15));
+        TEST_ASSERT_EQUAL_UINT32(15, archive.archivedCount());
+        TEST_ASSERT_EQUAL_UINT32(0, archive.writeCount());
+        for (uint16_t i = 45; i < 60; i++) {
+            history.push(i, 1000*(i + 1));
+        }
+        TEST_ASSERT_TRUE(archive.poll(now));
+        TEST_ASSERT_EQUAL_UINT32(1, archive.writeCount());
+
+        // Test 2 - a flush writes the partial batch, which starts a new segment once the first is full
+        TEST_ASSERT_TRUE(archive.poll(now));
+        TEST_ASSERT_EQUAL_UINT32(20, archive.archivedCount());
+        TEST_ASSERT_TRUE(archive.flush());
+        TEST_ASSERT_EQUAL_UINT32(2, archive.writeCount());
+        saved_average = history.windowAverage(window);
+    }
+
+    // Test 3 - a new history is restored with the archived buckets, and its rollup windows with them
+    {
+        SampleHistory history;
+        history.setStorage(storage, 6, tiers, 1);
+        SampleWindowID window = history.registerWindow(30000);
+        SampleHistoryArchive archive;
+        TEST_ASSERT_TRUE(archive.begin(fs, "/ha", history, 1, 2, 16));
+        uint32_t boot_millis = millis();
+        TEST_ASSERT_EQUAL_INT(20, archive.restore(now + 60, 3600));
+        TEST_ASSERT_EQUAL_INT(20, history.levelSize(1));
+        TEST_ASSERT_EQUAL_FLOAT(saved_average, history.windowAverage(window));
+        TEST_ASSERT_EQUAL_UINT32(3000, history.entryTime(1, 19) - history.entryTime(1, 18));
+
+        // the restored buckets are placed as long before boot as they were archived before now
+        TEST_ASSERT_UINT32_WITHIN(1000, 60000, boot_millis - history.newestTime());
+        TEST_ASSERT_EQUAL_UINT16(57, history.aggregate(1, 19).min);
+        TEST_ASSERT_EQUAL_UINT16(59, history.aggregate(1, 19).max);
+
+        // Test 4 - restored buckets are not archived again, but new ones are
+        uint32_t restored_time = history.newestTime();
+        for (uint16_t i = 0; i < 3; i++) {
+            history.push(i, restored_time + 60000 + 1000*i);
+        }
+        TEST_ASSERT_FALSE(history.restoreAggregate(history.aggregate(1, 0), history.newestTime()));
+
+        // and the time the device was down is a gap in the restored windows
+        TEST_ASSERT_TRUE(history.windowStats(window).gapMillis > 0);
+        TEST_ASSERT_TRUE(archive.poll(now + 63));
+        TEST_ASSERT_EQUAL_UINT32(1, archive.archivedCount());
+
+        // Test 5 - the restored buckets are streamed at the times they were archived at,
+        // followed by the new bucket after the gap. The newest sample was taken at now + 62.
+        SampleHistoryStream stream(history, 1, now + 62, now - 3600, now + 62, 100);
+        TEST_ASSERT_EQUAL_INT(1, stream.level());
+        TEST_ASSERT_EQUAL_INT(21, stream.entryCount());
+        String json = readStream(stream, 16);
+        char expected[64];
+        snprintf(expected, sizeof(expected), "\"data\":[[%lu,1.00,0,2],", (unsigned long)(now - 59));
+        TEST_ASSERT_TRUE(json.indexOf(expected) > 0);
+        snprintf(expected, sizeof(expected), ",[%lu,58.00,57,59],[%lu,1.00,0,2]]}", (unsigned long)(now - 2), (unsigned long)(now + 60));
+        TEST_ASSERT_TRUE(json.endsWith(expected));
+    }
+
+    // Test 6 - only buckets within the restore window are restored
+    {
+        SampleHistory history;
+        history.setStorage(storage, 6, tiers, 1);
+        SampleHistoryArchive archive;
+        TEST_ASSERT_TRUE(archive.begin(fs, "/ha", history, 1, 2, 16));
+        TEST_ASSERT_EQUAL_INT(10, archive.restore(now, 30));
+        TEST_ASSERT_EQUAL_UINT16(30, history.aggregate(1, 0).min);
+    }
+
+    // Test 7 - buckets of a different size are not restored
+    {
+        const SampleHistoryTier other_tiers[] = {{5, 100}};
+        SampleHistory history;
+        history.setStorage(storage, 6, other_tiers, 1);
+        SampleHistoryArchive archive;
+        TEST_ASSERT_TRUE(archive.begin(fs, "/ha", history, 1, 2, 16));
+        TEST_ASSERT_EQUAL_INT(0, archive.restore(now, 3600));
+    }
+    removeFiles(fs, "/ha");
+
+    // Test 8 - nothing is restored or archived before the time is set, and the buckets
+    // completed meanwhile are archived once it is
+    {
+        SampleHistory history;
+        history.setStorage(storage, 6, tiers, 1);
+        SampleHistoryArchive archive;
+        TEST_ASSERT_TRUE(archive.begin(fs, "/ha", history, 1, 2, 16));
+        TEST_ASSERT_EQUAL_INT(0, archive.restore(60, 30));
+        for (uint16_t i = 0; i < 48; i++) {
+            history.push(i, 1000*(i + 1));
+        }
+        TEST_ASSERT_TRUE(archive.poll(48));
+        TEST_ASSERT_EQUAL_UINT32(0, archive.archivedCount());
+        TEST_ASSERT_TRUE(archive.poll(now));
+        TEST_ASSERT_EQUAL_UINT32(16, archive.archivedCount());
+        TEST_ASSERT_EQUAL_UINT32(1, archive.writeCount());
+    }
+    {
+        SampleHistory history;
+        history.setStorage(storage, 6, tiers, 1);
+        SampleHistoryArchive archive;
+        TEST_ASSERT_TRUE(archive.begin(fs, "/ha", history, 1, 2, 16));
+        TEST_ASSERT_EQUAL_INT(16, archive.restore(now, 3600));
+        TEST_ASSERT_EQUAL_UINT16(45, history.aggregate(1, 15).min);
+    }
+    removeFiles(fs, "/ha");
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef __test_SampleHistory__
+#define __test_SampleHistory__
+
+void test_SampleHistory_windowAverages( void );
+void test_SampleHistory_lateRegisteredWindow( void );
+void test_SampleHistory_gaps( void );
+void test_SampleHistory_timeline( void );
+void test_SampleHistory_distribution( void );
+void test_SampleHistory_rollupTiers( void );
+void test_SampleHistory_tierWindows( void );
+void test_SampleHistory_stream( void );
+void test_SampleHistory_archive( void );
+
+#endif // __test_SampleHistory__
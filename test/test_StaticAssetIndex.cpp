@@ -0,0 +1,71 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include <FS.h>
+#include "StaticAssetIndex.h"
+#include "test_StaticAssetIndex.h"
+
+static void writeFile(fs::FS& fs, const char* path, char fill, size_t size)
+{
+    File file = fs.open(path, FILE_WRITE);
+    for (size_t i = 0; i < size; i++) {
+        file.write((uint8_t)fill);
+    }
+    file.close();
+}
+
+void test_StaticAssetIndex_build( void ) {
+    fs::HostFS fs("/tmp/diyaqi_test_fs");
+    fs.mkdir("/assets");
+    writeFile(fs, "/assets/app.css", 'c', 40);
+    writeFile(fs, "/assets/app.css.gz", 'z', 10);
+    writeFile(fs, "/assets/big.js", 'j', 100);
+    writeFile(fs, "/assets/only.svg.gz", 's', 8);
+    writeFile(fs, "/assets/page.html", 'h', 20);
+
+    // 60 bytes of cache for files of up to 50 bytes
+    StaticAssetIndex index;
+    TEST_ASSERT_TRUE(index.build(fs, "/assets", [](const char* path) { return strcmp(path, "/assets/page.html") != 0; }, 60, 50));
+
+    // Test 1 - compressed copies are paired with their files, and filtered files are left out
+    TEST_ASSERT_EQUAL_INT(3, index.size());
+    TEST_ASSERT_TRUE(index.find("/assets/page.html") == nullptr);
+    TEST_ASSERT_TRUE(index.find("/assets/app.css.gz") == nullptr);
+    TEST_ASSERT_TRUE(index.find("/assets/missing.css") == nullptr);
+    const StaticAsset* css = index.find("/assets/app.css");
+    TEST_ASSERT_TRUE(css != nullptr);
+    TEST_ASSERT_EQUAL_STRING("text/css", css->contentType);
+    TEST_ASSERT_EQUAL_INT(40, css->size);
+    TEST_ASSERT_EQUAL_INT(10, css->gzipSize);
+    const StaticAsset* svg = index.find("/assets/only.svg");
+    TEST_ASSERT_TRUE(svg != nullptr);
+    TEST_ASSERT_EQUAL_INT(0, svg->size);
+    TEST_ASSERT_EQUAL_INT(8, svg->gzipSize);
+
+    // Test 2 - the smallest files are held in memory until the budget is used up
+    TEST_ASSERT_EQUAL_INT(58, index.cachedBytes());
+    TEST_ASSERT_TRUE(css->data != nullptr);
+    TEST_ASSERT_TRUE(css->gzipData != nullptr);
+    TEST_ASSERT_EQUAL_INT('z', css->gzipData[9]);
+    TEST_ASSERT_TRUE(svg->gzipData != nullptr);
+    const StaticAsset* js = index.find("/assets/big.js");
+    TEST_ASSERT_TRUE(js->data == nullptr);
+
+    // Test 3 - ETags follow the contents, and the compressed copy has its own
+    char etag[14];
+    char gzip_etag[14];
+    char js_etag[14];
+    StaticAssetIndex::formatETag(*css, false, etag);
+    StaticAssetIndex::formatETag(*css, true, gzip_etag);
+    StaticAssetIndex::formatETag(*js, false, js_etag);
+    TEST_ASSERT_EQUAL_INT(10, strlen(etag));
+    TEST_ASSERT_EQUAL_INT(0, strncmp(etag, gzip_etag, 9));
+    TEST_ASSERT_EQUAL_STRING("-gz\"", gzip_etag + 9);
+    TEST_ASSERT_TRUE(strcmp(etag, js_etag) != 0);
+
+    // Test 4 - content types
+    TEST_ASSERT_EQUAL_STRING("application/javascript", js->contentType);
+    TEST_ASSERT_EQUAL_STRING("text/html", StaticAssetIndex::contentType("/index.html"));
+    TEST_ASSERT_EQUAL_STRING("text/plain", StaticAssetIndex::contentType("/notes"));
+}
+#endif
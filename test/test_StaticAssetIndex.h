@@ -0,0 +1,6 @@
+#ifndef __test_StaticAssetIndex__
+#define __test_StaticAssetIndex__
+
+void test_StaticAssetIndex_build( void );
+
+#endif // __test_StaticAssetIndex__
@@ -0,0 +1,69 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "Telemetry.h"
+#include "test_Telemetry.h"
+
+void test_Telemetry_writeJSON( void ) {
+    TelemetryRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp = 1600000000;
+    record.uptime = 86400;
+    record.pm1p0 = 7;
+    record.pm2p5 = 12;
+    record.pm10 = 15;
+    record.particleCount0p5um = 320;
+    record.particleCount10um = 65535;
+    record.statusFan = 2;
+    record.averagePM2p5Current = 12.5;
+    record.averagePM2p5OneDay = 9.25;
+    record.aqiCurrent = 52.75;
+    record.pm2p5Spread[0].min = 3;
+    record.pm2p5Spread[0].p50 = 9;
+    record.pm2p5Spread[1].p95 = 42;
+    record.pm2p5Spread[2].max = 999;
+    record.temperature = -3.5;
+    record.pressure = 1013.25;
+    record.humidity = 45;
+    record.gasResistance = 120000;
+
+    // Test 1 - the JSON is identical to what buildTelemetryJSON() serializes to
+    char expected[TELEMETRY_JSON_CAPACITY];
+    DynamicJsonDocument doc(TELEMETRY_JSON_CAPACITY);
+    buildTelemetryJSON(record, "test", doc);
+    size_t expected_length = serializeJson(doc, expected, sizeof(expected));
+    char buffer[TELEMETRY_JSON_CAPACITY];
+    size_t length = writeTelemetryJSON(record, "test", buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_INT(expected_length, length);
+    buffer[length] = '\0';
+    TEST_ASSERT_EQUAL_STRING(expected, buffer);
+    TEST_ASSERT_TRUE(length <= TELEMETRY_JSON_FIXED_MAX_LENGTH + 6);
+
+    // Test 2 - floats are rounded to the field's decimals and non-finite floats are null
+    record.averagePM2p5TenMinute = 11.396;
+    record.aqiOneHour = -0.001;
+    record.humidity = NAN;
+    record.gasResistance = 123456.7;
+    length = writeTelemetryJSON(record, "test", buffer, sizeof(buffer));
+    buffer[length] = '\0';
+    String json(buffer);
+    TEST_ASSERT_TRUE(json.indexOf("\"average_pm2p5_10min\":11.4,") > 0);
+    TEST_ASSERT_TRUE(json.indexOf("\"aqi_1hour\":0,") > 0);
+    TEST_ASSERT_TRUE(json.indexOf("\"humidity\":null,") > 0);
+    TEST_ASSERT_TRUE(json.indexOf("\"gas_resistance\":123457}") > 0);
+    TEST_ASSERT_TRUE(json.indexOf("\"pm2p5_spread\":{\"10min\":{\"min\":3,\"max\":0,\"p50\":9,") > 0);
+    TEST_ASSERT_TRUE(json.indexOf("\"1hour\":{\"min\":0,\"max\":0,\"p50\":0,\"p95\":42,") > 0);
+    TEST_ASSERT_TRUE(json.indexOf("\"24hour\":{\"min\":0,\"max\":999,") > 0);
+
+    // Test 3 - the sensor ID is escaped
+    length = writeTelemetryJSON(record, "a\"b\\c\n", buffer, sizeof(buffer));
+    buffer[length] = '\0';
+    json = buffer;
+    TEST_ASSERT_TRUE(json.indexOf("\"sensor_id\":\"a\\\"b\\\\c\\u000a\",") > 0);
+
+    // Test 4 - nothing is written past the capacity
+    memset(buffer, 'x', sizeof(buffer));
+    TEST_ASSERT_EQUAL_INT(0, writeTelemetryJSON(record, "test", buffer, 100));
+    TEST_ASSERT_EQUAL_UINT8('x', buffer[100]);
+}
+#endif
@@ -0,0 +1,6 @@
+#ifndef __test_Telemetry__
+#define __test_Telemetry__
+
+void test_Telemetry_writeJSON( void );
+
+#endif // __test_Telemetry__
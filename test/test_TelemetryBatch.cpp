@@ -0,0 +1,89 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "TelemetryBatch.h"
+#include "test_helpers.h"
+#include "test_TelemetryBatch.h"
+
+void test_TelemetryBatch_offer( void ) {
+    // Test 1 - every record is taken and the batch is ready when full
+    TelemetryBatch batch1(3, 60, 1, 4);
+    TEST_ASSERT_FALSE(batch1.isReady(1000));
+    TEST_ASSERT_TRUE(batch1.offer(makeRecord(1000, 1)));
+    TEST_ASSERT_TRUE(batch1.offer(makeRecord(1002, 2)));
+    TEST_ASSERT_FALSE(batch1.isReady(1002));
+    TEST_ASSERT_TRUE(batch1.offer(makeRecord(1004, 3)));
+    TEST_ASSERT_TRUE(batch1.isReady(1004));
+    TEST_ASSERT_EQUAL_UINT32(2, batch1.record(1).pm2p5);
+
+    // Test 2 - records offered to a full batch are dropped and counted
+    TEST_ASSERT_FALSE(batch1.offer(makeRecord(1006, 4)));
+    TEST_ASSERT_EQUAL_UINT32(1, batch1.droppedCount());
+    batch1.clear();
+    TEST_ASSERT_EQUAL_INT(0, batch1.size());
+    TEST_ASSERT_FALSE(batch1.isReady(1006));
+
+    // Test 3 - the batch is ready once its oldest record reaches the max age
+    TelemetryBatch batch2(10, 60, 1, 4);
+    batch2.offer(makeRecord(1000, 1));
+    TEST_ASSERT_FALSE(batch2.isReady(1059));
+    TEST_ASSERT_TRUE(batch2.isReady(1060));
+
+    // Test 4 - only every 3rd record is taken, starting with the first
+    TelemetryBatch batch3(10, 60, 3, 4);
+    for (uint32_t i = 0; i < 7; i++) {
+        batch3.offer(makeRecord(1000 + 2*i, i));
+    }
+    TEST_ASSERT_EQUAL_INT(3, batch3.size());
+    TEST_ASSERT_EQUAL_UINT32(0, batch3.record(0).pm2p5);
+    TEST_ASSERT_EQUAL_UINT32(3, batch3.record(1).pm2p5);
+    TEST_ASSERT_EQUAL_UINT32(6, batch3.record(2).pm2p5);
+}
+
+void test_TelemetryBatch_serialize( void ) {
+    TelemetryBatch batch(4, 60, 1, 4);
+
+    // Test 1 - an empty batch has no payload
+    TEST_ASSERT_EQUAL_INT(0, batch.serialize("test"));
+
+    // Test 2 - the payload is a JSON array of one telemetry object per record
+    batch.offer(makeRecord(1000, 11));
+    batch.offer(makeRecord(1002, 12));
+    size_t length = batch.serialize("test");
+    String payload(batch.payload());
+    TEST_ASSERT_EQUAL_INT(length, payload.length());
+    TEST_ASSERT_TRUE(payload.startsWith("[{\"timestamp\":1000,\"sensor_id\":\"test\""));
+    TEST_ASSERT_TRUE(payload.indexOf("},{\"timestamp\":1002,") > 0);
+    TEST_ASSERT_TRUE(payload.endsWith("}}]"));
+}
+
+void test_TelemetryBatch_serializeWorstCase( void ) {
+    // Test 1 - a full batch of the longest records, with a sensor ID that is escaped
+    // character by character, fits in the payload
+    const char* sensor_id = "\x01\x02\x03\x04\x05\x06\x07\x08";
+    TelemetryBatch batch(4, 60, 1, strlen(sensor_id));
+    for (int i = 0; i < 4; i++) {
+        TelemetryRecord record = makeRecord(-0x7FFFFFFFFFFFFFFFLL, 0xFFFFFFFF);
+        record.uptime = record.pm1p0 = record.pm10 = 0xFFFFFFFF;
+        record.particleCount0p5um = record.particleCount1p0um = record.particleCount2p5um = 0xFFFF;
+        record.particleCount5p0um = record.particleCount7p5um = record.particleCount10um = 0xFFFF;
+        record.statusParticleDetector = record.statusLaser = record.statusFan = 0xFF;
+        record.averagePM2p5Current = record.averagePM2p5TenMinute = -999999999999999.0f;
+        record.averagePM2p5OneHour = record.averagePM2p5OneDay = -999999999999999.0f;
+        record.aqiCurrent = record.aqiTenMinute = record.aqiOneHour = record.aqiOneDay = -999999999999999.0f;
+        for (int w = 0; w < TELEMETRY_SPREAD_WINDOW_COUNT; w++) {
+            record.pm2p5Spread[w].min = record.pm2p5Spread[w].max = 0xFFFF;
+            record.pm2p5Spread[w].p50 = record.pm2p5Spread[w].p95 = record.pm2p5Spread[w].p99 = 0xFFFF;
+        }
+        record.temperature = record.pressure = record.humidity = -999999999999999.0f;
+        record.gasResistance = -999999999999999.0f;
+        TEST_ASSERT_TRUE(batch.offer(record));
+    }
+    size_t length = batch.serialize(sensor_id);
+    TEST_ASSERT_TRUE(length > 4*800);
+    String payload(batch.payload());
+    TEST_ASSERT_EQUAL_INT(length, payload.length());
+    TEST_ASSERT_TRUE(payload.indexOf("\"sensor_id\":\"\\u0001\\u0002") > 0);
+    TEST_ASSERT_TRUE(payload.endsWith("}}]"));
+}
+#endif
@@ -0,0 +1,8 @@
+#ifndef __test_TelemetryBatch__
+#define __test_TelemetryBatch__
+
+void test_TelemetryBatch_offer( void );
+void test_TelemetryBatch_serialize( void );
+void test_TelemetryBatch_serializeWorstCase( void );
+
+#endif // __test_TelemetryBatch__
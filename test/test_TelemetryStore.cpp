@@ -0,0 +1,194 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include <FS.h>
+#include "TelemetryStore.h"
+#include "test_helpers.h"
+#include "test_TelemetryStore.h"
+
+void test_TelemetryStore_packRecord( void ) {
+    TelemetryRecord record = makeRecord(1600000000, 35);
+    record.uptime = 3600;
+    record.particleCount2p5um = 1234;
+    record.statusParticleDetector = 1;
+    record.statusLaser = 2;
+    record.statusFan = 3;
+    record.averagePM2p5OneHour = 12.34;
+    record.aqiOneDay = 151.26;
+    record.temperature = -12.345;
+    record.pressure = 1013.25;
+    record.humidity = 45.678;
+    record.gasResistance = 123456.7;
+    record.pm2p5Spread[2].p95 = 87;
+    record.pm2p5Spread[2].max = 412;
+
+    PackedTelemetryRecord packed;
+    packTelemetryRecord(record, 42, packed);
+    TelemetryRecord unpacked;
+    unpackTelemetryRecord(packed, unpacked);
+
+    // Test 1 - values survive to the precision that is kept
+    TEST_ASSERT_EQUAL_UINT32(42, packed.sequence);
+    TEST_ASSERT_EQUAL_UINT32(1600000000, unpacked.timestamp);
+    TEST_ASSERT_EQUAL_UINT32(3600, unpacked.uptime);
+    TEST_ASSERT_EQUAL_UINT32(35, unpacked.pm2p5);
+    TEST_ASSERT_EQUAL_UINT16(1234, unpacked.particleCount2p5um);
+    TEST_ASSERT_EQUAL_UINT8(1, unpacked.statusParticleDetector);
+    TEST_ASSERT_EQUAL_UINT8(2, unpacked.statusLaser);
+    TEST_ASSERT_EQUAL_UINT8(3, unpacked.statusFan);
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 12.3, unpacked.averagePM2p5OneHour);
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 151.3, unpacked.aqiOneDay);
+    TEST_ASSERT_FLOAT_WITHIN(0.005, -12.35, unpacked.temperature);
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 1013.3, unpacked.pressure);
+    TEST_ASSERT_FLOAT_WITHIN(0.005, 45.68, unpacked.humidity);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 123457, unpacked.gasResistance);
+    TEST_ASSERT_EQUAL_UINT16(87, unpacked.pm2p5Spread[2].p95);
+    TEST_ASSERT_EQUAL_UINT16(412, unpacked.pm2p5Spread[2].max);
+
+    // Test 2 - out of range values are clamped
+    record.pm10 = 100000;
+    record.aqiCurrent = 9999;
+    record.temperature = -301.0;
+    packTelemetryRecord(record, 43, packed);
+    TEST_ASSERT_EQUAL_UINT16(65535, packed.pm10);
+    TEST_ASSERT_EQUAL_UINT16(65535, packed.aqi[0]);
+    TEST_ASSERT_EQUAL_INT(-30100, packed.temperature);
+}
+
+void test_TelemetryStore_ring( void ) {
+    TelemetryStore store(0, 5);
+    TelemetryBatch batch(3, 0, 1, 4);
+    uint32_t last_sequence = 0;
+
+    // Test 1 - records are peeked oldest first without being removed
+    for (uint32_t i = 0; i < 4; i++) {
+        store.push(makeRecord(1000 + i, i));
+    }
+    TEST_ASSERT_EQUAL_INT(4, store.size());
+    TEST_ASSERT_EQUAL_INT(3, store.peek(batch, last_sequence));
+    TEST_ASSERT_EQUAL_UINT32(0, batch.record(0).pm2p5);
+    TEST_ASSERT_EQUAL_UINT32(2, batch.record(2).pm2p5);
+    TEST_ASSERT_EQUAL_UINT32(3, last_sequence);
+    TEST_ASSERT_EQUAL_INT(4, store.size());
+
+    // Test 2 - acknowledging removes the records up to the sequence number
+    store.acknowledge(last_sequence);
+    TEST_ASSERT_EQUAL_INT(1, store.size());
+    TEST_ASSERT_EQUAL_UINT32(3, store.deliveredCount());
+    batch.clear();
+    TEST_ASSERT_EQUAL_INT(1, store.peek(batch, last_sequence));
+    TEST_ASSERT_EQUAL_UINT32(3, batch.record(0).pm2p5);
+
+    // Test 3 - a full ring drops its oldest records
+    for (uint32_t i = 4; i < 10; i++) {
+        store.push(makeRecord(1000 + i, i));
+    }
+    TEST_ASSERT_EQUAL_INT(5, store.size());
+    TEST_ASSERT_EQUAL_UINT32(2, store.droppedCount());
+    batch.clear();
+    store.peek(batch, last_sequence);
+    TEST_ASSERT_EQUAL_UINT32(5, batch.record(0).pm2p5);
+
+    // Test 4 - acknowledging records that were dropped meanwhile is harmless
+    store.acknowledge(4);
+    TEST_ASSERT_EQUAL_INT(5, store.size());
+    store.acknowledge(10);
+    TEST_ASSERT_TRUE(store.empty());
+}
+
+void test_TelemetryStore_spill( void ) {
+    fs::HostFS fs("/tmp/diyaqi_test_fs");
+    removeFiles(fs, "/tq");
+    TelemetryBatch batch(10, 0, 1, 4);
+    uint32_t last_sequence = 0;
+
+    {
+        TelemetryStore store(0, 4);
+        TEST_ASSERT_TRUE(store.enableSpill(fs, "/tq", 2, 2));
+
+        // Test 1 - records that overflow the ring are spilled in blocks rather than dropped
+        for (uint32_t i = 0; i < 8; i++) {
+            store.push(makeRecord(1000 + i, i));
+        }
+        TEST_ASSERT_EQUAL_INT(8, store.size());
+        TEST_ASSERT_EQUAL_INT(4, store.spilledSize());
+        TEST_ASSERT_EQUAL_UINT32(0, store.droppedCount());
+
+        // Test 2 - once the segments run out the oldest segment is dropped
+        store.push(makeRecord(1008, 8));
+        TEST_ASSERT_EQUAL_INT(7, store.size());
+        TEST_ASSERT_EQUAL_UINT32(2, store.droppedCount());
+
+        // Test 3 - spilled records are peeked first, one segment at a time
+        TEST_ASSERT_EQUAL_INT(2, store.peek(batch, last_sequence));
+        TEST_ASSERT_EQUAL_UINT32(2, batch.record(0).pm2p5);
+        TEST_ASSERT_EQUAL_UINT32(3, batch.record(1).pm2p5);
+
+        // Test 4 - a partial acknowledgement resumes from within the segment
+        store.acknowledge(last_sequence - 1);
+        TEST_ASSERT_EQUAL_INT(6, store.size());
+        batch.clear();
+        TEST_ASSERT_EQUAL_INT(1, store.peek(batch, last_sequence));
+        TEST_ASSERT_EQUAL_UINT32(3, batch.record(0).pm2p5);
+        store.acknowledge(last_sequence);
+        TEST_ASSERT_EQUAL_INT(5, store.size());
+    }
+
+    // Test 5 - spilled records are recovered after a restart
+    TelemetryStore store(0, 4);
+    TEST_ASSERT_TRUE(store.enableSpill(fs, "/tq", 2, 2));
+    TEST_ASSERT_EQUAL_INT(2, store.size());
+    batch.clear();
+    store.peek(batch, last_sequence);
+    TEST_ASSERT_EQUAL_UINT32(4, batch.record(0).pm2p5);
+    store.acknowledge(last_sequence);
+    TEST_ASSERT_TRUE(store.empty());
+
+    // Test 6 - new records are numbered after the recovered ones
+    store.push(makeRecord(2000, 100));
+    batch.clear();
+    store.peek(batch, last_sequence);
+    TEST_ASSERT_EQUAL_UINT32(7, last_sequence);
+    removeFiles(fs, "/tq");
+}
+
+void test_TelemetryStore_spillFormat( void ) {
+    fs::HostFS fs("/tmp/diyaqi_test_fs");
+    removeFiles(fs, "/tq");
+    fs.mkdir("/tq");
+
+    // a segment of 5 records in the format of older firmware, and one cut short
+    uint8_t legacy[TELEMETRY_STORE_LEGACY_RECORD_BYTES*5];
+    memset(legacy, 0, sizeof(legacy));
+    File file = fs.open("/tq/00000000.bin", FILE_WRITE);
+    file.write(legacy, sizeof(legacy));
+    file.close();
+    PackedTelemetryRecord packed[2];
+    memset(packed, 0, sizeof(packed));
+    char path[32];
+    snprintf(path, sizeof(path), "/tq/00000005.r%u", (unsigned)sizeof(PackedTelemetryRecord));
+    file = fs.open(path, FILE_WRITE);
+    file.write((const uint8_t*)packed, sizeof(packed) - 1);
+    file.close();
+
+    // Test 1 - neither is recovered, and their records are counted as dropped
+    TelemetryStore store(0, 4);
+    TEST_ASSERT_TRUE(store.enableSpill(fs, "/tq", 2, 2));
+    TEST_ASSERT_TRUE(store.empty());
+    TEST_ASSERT_EQUAL_UINT32(6, store.droppedCount());
+
+    // Test 2 - both are deleted
+    TEST_ASSERT_FALSE(fs.exists("/tq/00000000.bin"));
+    TEST_ASSERT_FALSE(fs.exists(path));
+
+    // Test 3 - segments spilled now are recovered
+    for (uint32_t i = 0; i < 6; i++) {
+        store.push(makeRecord(1000 + i, i));
+    }
+    TelemetryStore recovered(0, 4);
+    TEST_ASSERT_TRUE(recovered.enableSpill(fs, "/tq", 2, 2));
+    TEST_ASSERT_EQUAL_INT(2, recovered.size());
+    TEST_ASSERT_EQUAL_UINT32(0, recovered.droppedCount());
+    removeFiles(fs, "/tq");
+}
+#endif
@@ -0,0 +1,9 @@
+#ifndef __test_TelemetryStore__
+#define __test_TelemetryStore__
+
+void test_TelemetryStore_packRecord( void );
+void test_TelemetryStore_ring( void );
+void test_TelemetryStore_spill( void );
+void test_TelemetryStore_spillFormat( void );
+
+#endif // __test_TelemetryStore__
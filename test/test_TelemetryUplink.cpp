@@ -0,0 +1,133 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <unity.h>
+#include "TelemetryUplink.h"
+#include "test_helpers.h"
+#include "test_TelemetryUplink.h"
+
+struct FakePoster {
+    uint8_t     kinds[16];
+    String      payloads[16];
+    size_t      count;
+    bool        accept;
+
+    bool post(const char* payload, size_t /*length*/, uint8_t kind)
+    {
+        if (!accept || (count == 16)) {
+            return false;
+        }
+        kinds[count] = kind;
+        payloads[count] = String(payload);
+        count++;
+        return true;
+    }
+};
+
+void test_TelemetryUplink_outage( void ) {
+    FakePoster poster = {};
+    poster.accept = true;
+    TelemetryBatch live(2, 60, 1, 4);
+    TelemetryStore store(0, 100);
+    TelemetryUplink uplink(
+        "test", live, store, 3, 1000, 8000,
+        std::bind(&FakePoster::post, &poster, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)
+    );
+
+    // Test 1 - while disconnected, ready batches go into the store and nothing is posted
+    for (uint32_t i = 0; i < 4; i++) {
+        uplink.offer(makeRecord(1000 + i, i), false);
+    }
+    uplink.loop(0, false);
+    TEST_ASSERT_EQUAL_INT(0, poster.count);
+    TEST_ASSERT_EQUAL_INT(4, store.size());
+
+    // Test 2 - once connected, the store drains oldest first, one batch in flight at a time
+    uplink.loop(1000, true);
+    TEST_ASSERT_EQUAL_INT(1, poster.count);
+    TEST_ASSERT_EQUAL_UINT8(TELEMETRY_UPLINK_DRAIN, poster.kinds[0]);
+    TEST_ASSERT_TRUE(poster.payloads[0].indexOf("\"timestamp\":1000,") > 0);
+    TEST_ASSERT_TRUE(poster.payloads[0].indexOf("\"timestamp\":1002,") > 0);
+    uplink.loop(3000, true);
+    TEST_ASSERT_EQUAL_INT(1, poster.count);
+
+    // Test 3 - a live batch is sent even while a drain is in flight, and holds off the next drain
+    uplink.offer(makeRecord(1010, 10), true);
+    uplink.offer(makeRecord(1011, 11), true);
+    TEST_ASSERT_EQUAL_INT(2, poster.count);
+    TEST_ASSERT_EQUAL_UINT8(TELEMETRY_UPLINK_LIVE, poster.kinds[1]);
+    uplink.reportResult(TELEMETRY_UPLINK_DRAIN, true);
+    uplink.loop(3000, true);
+    TEST_ASSERT_EQUAL_INT(1, store.size());
+    uplink.loop(5000, true);
+    TEST_ASSERT_EQUAL_INT(2, poster.count);
+
+    // Test 4 - a failed live batch is stored, and a failed drain backs off
+    uplink.reportResult(TELEMETRY_UPLINK_LIVE, false);
+    uplink.loop(5000, true);
+    TEST_ASSERT_EQUAL_INT(3, store.size());
+    uplink.loop(6000, true);
+    TEST_ASSERT_EQUAL_INT(3, poster.count);
+    TEST_ASSERT_TRUE(poster.payloads[2].indexOf("\"timestamp\":1003,") > 0);
+    uplink.reportResult(TELEMETRY_UPLINK_DRAIN, false);
+    uplink.loop(6000, true);
+    TEST_ASSERT_EQUAL_UINT32(2000, uplink.backoffMillis());
+    uplink.loop(7999, true);
+    TEST_ASSERT_EQUAL_INT(3, poster.count);
+    uplink.loop(8000, true);
+    TEST_ASSERT_EQUAL_INT(4, poster.count);
+    uplink.reportResult(TELEMETRY_UPLINK_DRAIN, true);
+    uplink.loop(8000, true);
+    TEST_ASSERT_TRUE(store.empty());
+    TEST_ASSERT_EQUAL_UINT32(1000, uplink.backoffMillis());
+    TEST_ASSERT_EQUAL_UINT32(6, uplink.drainedCount());
+    TEST_ASSERT_EQUAL_UINT32(4, uplink.requestCount());
+    TEST_ASSERT_EQUAL_UINT32(2, uplink.failureCount());
+
+    // Test 5 - a live batch the poster can not take is stored
+    poster.accept = false;
+    uplink.offer(makeRecord(1020, 20), true);
+    uplink.offer(makeRecord(1021, 21), true);
+    TEST_ASSERT_EQUAL_INT(2, store.size());
+
+    // Test 6 - a live batch that can not be serialized is stored, and drained in a batch sized
+    // for the sensor ID
+    String long_id;
+    while (long_id.length() < 1000) {
+        long_id += "sensor-";
+    }
+    TelemetryBatch narrow(2, 60, 1, 0);
+    TelemetryStore narrow_store(0, 100);
+    TelemetryUplink narrow_uplink(
+        long_id.c_str(), narrow, narrow_store, 2, 1000, 8000,
+        std::bind(&FakePoster::post, &poster, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)
+    );
+    poster.accept = true;
+    poster.count = 0;
+    narrow_uplink.offer(makeRecord(1030, 30), true);
+    narrow_uplink.offer(makeRecord(1031, 31), true);
+    TEST_ASSERT_EQUAL_INT(0, poster.count);
+    TEST_ASSERT_EQUAL_INT(2, narrow_store.size());
+    narrow_uplink.loop(1000, true);
+    TEST_ASSERT_EQUAL_INT(1, poster.count);
+    TEST_ASSERT_EQUAL_UINT8(TELEMETRY_UPLINK_DRAIN, poster.kinds[0]);
+    TEST_ASSERT_TRUE(poster.payloads[0].indexOf("\"timestamp\":1031,") > 0);
+
+    // Test 7 - stored records that can not be serialized are discarded and counted, rather
+    // than blocking the store. The sensor ID grows after the drain batch was sized for it.
+    char grown_id[1100] = "";
+    TelemetryStore grown_store(0, 100);
+    TelemetryUplink grown_uplink(
+        grown_id, narrow, grown_store, 2, 1000, 8000,
+        std::bind(&FakePoster::post, &poster, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)
+    );
+    memset(grown_id, 'x', sizeof(grown_id) - 1);
+    poster.count = 0;
+    grown_uplink.offer(makeRecord(1040, 40), true);
+    grown_uplink.offer(makeRecord(1041, 41), true);
+    TEST_ASSERT_EQUAL_INT(2, grown_store.size());
+    grown_uplink.loop(1000, true);
+    TEST_ASSERT_EQUAL_INT(0, poster.count);
+    TEST_ASSERT_TRUE(grown_store.empty());
+    TEST_ASSERT_EQUAL_UINT32(2, grown_uplink.discardedCount());
+}
+#endif
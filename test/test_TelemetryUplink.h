@@ -0,0 +1,6 @@
+#ifndef __test_TelemetryUplink__
+#define __test_TelemetryUplink__
+
+void test_TelemetryUplink_outage( void );
+
+#endif // __test_TelemetryUplink__
@@ -0,0 +1,167 @@
+#ifdef UNIT_TEST
+#include <Arduino.h>
+#include <FS.h>
+#include <unity.h>
+#include <vector>
+#include "UARTCapture.h"
+#include "CaptureReplay.h"
+#include "SNGCJA5FrameDecoder.h"
+#include "test_helpers.h"
+#include "test_UARTCapture.h"
+
+static size_t readCapture(fs::FS& fs, const char* path, uint8_t* data, size_t size)
+{
+    File file = fs.open(path, FILE_READ);
+    if (!file) {
+        return 0;
+    }
+    size_t length = file.read(data, size);
+    file.close();
+    return length;
+}
+
+void test_UARTCapture_record( void ) {
+    fs::HostFS fs("/tmp/diyaqi_test_fs");
+    UARTCapture capture;
+    TEST_ASSERT_TRUE(capture.begin(fs, "/uart.ucap", "SN-GCJA5", 9600, 256));
+    uint8_t bytes[100];
+    for (uint8_t i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = i;
+    }
+
+    // Test 1 - nothing is recorded until a capture is started by a poll
+    capture.record(bytes, 10, 900);
+    capture.requestStart(60);
+    TEST_ASSERT_FALSE(capture.isRecording());
+    capture.poll(1000);
+    TEST_ASSERT_TRUE(capture.isRecording());
+    TEST_ASSERT_EQUAL_UINT32(0, capture.capturedByteCount());
+
+    // Test 2 - a poll's bytes are split into chunks, and written with their receive time
+    capture.record(bytes, 100, 1100);
+    capture.record(bytes + 50, 5, 1200);
+    capture.poll(1300);
+    capture.requestStop();
+    capture.poll(1400);
+    TEST_ASSERT_FALSE(capture.isRecording());
+    TEST_ASSERT_EQUAL_UINT32(105, capture.capturedByteCount());
+    uint32_t expected_size = sizeof(UARTCaptureFileHeader) + 3*sizeof(UARTCaptureChunkHeader) + 105;
+    TEST_ASSERT_EQUAL_UINT32(expected_size, capture.fileBytes());
+
+    uint8_t data[512];
+    size_t size = readCapture(fs, "/uart.ucap", data, sizeof(data));
+    TEST_ASSERT_EQUAL_UINT32(expected_size, size);
+    UARTCaptureReader reader(data, size);
+    TEST_ASSERT_TRUE(reader.isValid());
+    TEST_ASSERT_EQUAL_STRING("SN-GCJA5", reader.sensorName());
+    TEST_ASSERT_EQUAL_UINT32(9600, reader.baudRate());
+    TEST_ASSERT_EQUAL_UINT32(1000, reader.startMillis());
+    UARTCaptureChunk chunk;
+    TEST_ASSERT_TRUE(reader.next(chunk));
+    TEST_ASSERT_EQUAL_UINT32(1100, chunk.receiveMillis);
+    TEST_ASSERT_EQUAL_UINT32(UART_CAPTURE_CHUNK_BYTES, chunk.length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(bytes, chunk.bytes, chunk.length);
+    TEST_ASSERT_TRUE(reader.next(chunk));
+    TEST_ASSERT_EQUAL_UINT32(1100, chunk.receiveMillis);
+    TEST_ASSERT_EQUAL_UINT32(100 - UART_CAPTURE_CHUNK_BYTES, chunk.length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(bytes + UART_CAPTURE_CHUNK_BYTES, chunk.bytes, chunk.length);
+    TEST_ASSERT_TRUE(reader.next(chunk));
+    TEST_ASSERT_EQUAL_UINT32(1200, chunk.receiveMillis);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(bytes + 50, chunk.bytes, 5);
+    TEST_ASSERT_FALSE(reader.next(chunk));
+    TEST_ASSERT_FALSE(reader.isTruncated());
+
+    // Test 3 - a capture cut off in the middle of a chunk ends before it
+    UARTCaptureReader cut_off(data, size - 3);
+    TEST_ASSERT_TRUE(cut_off.next(chunk));
+    TEST_ASSERT_TRUE(cut_off.next(chunk));
+    TEST_ASSERT_FALSE(cut_off.next(chunk));
+    TEST_ASSERT_TRUE(cut_off.isTruncated());
+    TEST_ASSERT_FALSE(UARTCaptureReader(bytes, sizeof(bytes)).isValid());
+
+    // Test 4 - a capture stops by itself when its file is full or its time is up
+    capture.requestStart(60);
+    capture.poll(2000);
+    capture.record(bytes, 100, 2100);
+    capture.record(bytes, 100, 2200);
+    capture.record(bytes, 100, 2300);
+    capture.poll(2400);
+    TEST_ASSERT_FALSE(capture.isRecording());
+    TEST_ASSERT_TRUE(capture.fileBytes() <= 256);
+    TEST_ASSERT_EQUAL_UINT32(2, capture.captureCount());
+    capture.requestStart(1);
+    capture.poll(3000);
+    capture.poll(3999);
+    TEST_ASSERT_TRUE(capture.isRecording());
+    capture.poll(4000);
+    TEST_ASSERT_FALSE(capture.isRecording());
+}
+
+// appends a chunk to a capture being built in memory
+static void appendChunk(std::vector<uint8_t>& capture, uint32_t receive_millis, const uint8_t* bytes, size_t length)
+{
+    UARTCaptureChunkHeader header = {receive_millis, (uint16_t)length, 0};
+    capture.insert(capture.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+    capture.insert(capture.end(), bytes, bytes + length);
+}
+
+void test_CaptureReplay_frames( void ) {
+    // a frame a second for 10 seconds, with PM2.5 of 10 times the second
+    std::vector<uint8_t> data;
+    UARTCaptureFileHeader header = {UART_CAPTURE_MAGIC, UART_CAPTURE_VERSION, sizeof(UARTCaptureFileHeader), 9600, 5000, "SN-GCJA5"};
+    data.insert(data.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+    uint8_t frame[SNGCJA5_FRAME_SIZE];
+    for (uint16_t second = 1; second <= 10; second++) {
+        makeSNGCJA5Frame(frame, 0, 10*second);
+        uint32_t receive_millis = 5000 + second*1000;
+        if (second == 4) {
+            // a frame without a proper stop byte
+            frame[SNGCJA5_FRAME_SIZE - 1] = 0;
+        }
+        if (second == 6) {
+            // a frame split across two polls
+            appendChunk(data, receive_millis, frame, 20);
+            appendChunk(data, receive_millis + 100, frame + 20, SNGCJA5_FRAME_SIZE - 20);
+        } else {
+            appendChunk(data, receive_millis, frame, SNGCJA5_FRAME_SIZE);
+        }
+    }
+
+    // Test 1 - each sample takes the newest frame received by its time on the device's clock,
+    // including one received at the same time
+    UARTCaptureReader capture(data.data(), data.size());
+    std::vector<uint32_t> samples;
+    CaptureReplayResult result;
+    TEST_ASSERT_TRUE(replayCapture(capture, 2, [&](const AirQualitySensor& sensor, uint32_t capture_millis) {
+        samples.push_back(capture_millis);
+        samples.push_back(sensor.PM2p5());
+    }, result));
+    const uint32_t expected[] = {7000, 20, 8000, 30, 10000, 50, 13000, 80, 15000, 100};
+    TEST_ASSERT_EQUAL_UINT32(sizeof(expected)/sizeof(expected[0]), samples.size());
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, samples.data(), samples.size());
+    TEST_ASSERT_EQUAL_UINT32(11, result.chunkCount);
+    TEST_ASSERT_EQUAL_UINT32(10*SNGCJA5_FRAME_SIZE, result.byteCount);
+    TEST_ASSERT_EQUAL_UINT32(10100 - 100, result.captureMillis);
+    TEST_ASSERT_EQUAL_UINT32(5, result.sampleCount);
+    TEST_ASSERT_EQUAL_UINT32(9, result.frames.valid);
+    TEST_ASSERT_EQUAL_UINT32(1, result.frames.corrupt);
+    TEST_ASSERT_EQUAL_UINT32(4, result.frames.dropped);
+    // the sample after the last chunk has no frame left to take
+    TEST_ASSERT_EQUAL_UINT32(1, result.missedSampleCount);
+
+    // Test 2 - replaying again gives the same samples, however long the first replay took
+    std::vector<uint32_t> again;
+    TEST_ASSERT_TRUE(replayCapture(capture, 2, [&](const AirQualitySensor& sensor, uint32_t capture_millis) {
+        again.push_back(capture_millis);
+        again.push_back(sensor.PM2p5());
+    }, result));
+    TEST_ASSERT_EQUAL_UINT32(samples.size(), again.size());
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(samples.data(), again.data(), samples.size());
+
+    // Test 3 - captures of sensors without a protocol are not replayed
+    strcpy(((UARTCaptureFileHeader*)data.data())->sensorName, "XYZ");
+    UARTCaptureReader unknown(data.data(), data.size());
+    TEST_ASSERT_FALSE(replayCapture(unknown, 2, [](const AirQualitySensor&, uint32_t) {}, result));
+}
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef __test_UARTCapture__
+#define __test_UARTCapture__
+
+void test_UARTCapture_record( void );
+void test_CaptureReplay_frames( void );
+
+#endif // __test_UARTCapture__
@@ -0,0 +1,63 @@
+#ifdef UNIT_TEST
+#include "test_helpers.h"
+
+// files removed per pass over the directory
+#define REMOVE_FILES_BATCH  32
+
+TelemetryRecord makeRecord(time_t timestamp, uint32_t pm2p5)
+{
+    TelemetryRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp = timestamp;
+    record.pm2p5 = pm2p5;
+    return record;
+}
+
+void removeFiles(fs::FS& fs, const char* dir)
+{
+    // the paths are collected before removing any, so that the directory is not changed while
+    // it is being read
+    size_t count;
+    do {
+        File root = fs.open(dir);
+        if (!root) {
+            return;
+        }
+        String paths[REMOVE_FILES_BATCH];
+        count = 0;
+        File file = root.openNextFile();
+        while (file && (count < REMOVE_FILES_BATCH)) {
+            const char* name = strrchr(file.name(), '/');
+            paths[count++] = String(dir) + "/" + ((name != nullptr) ? name + 1 : file.name());
+            file = root.openNextFile();
+        }
+        root.close();
+        for (size_t i = 0; i < count; i++) {
+            fs.remove(paths[i].c_str());
+        }
+    } while (count == REMOVE_FILES_BATCH);
+}
+
+void makeSNGCJA5Frame(uint8_t* frame, uint8_t fill, uint16_t pm2p5)
+{
+    memset(frame, fill, SNGCJA5_FRAME_SIZE);
+    frame[0] = SNGCJA5_FRAME_STX;
+    frame[5] = pm2p5 & 0xFF;
+    frame[6] = pm2p5 >> 8;
+    frame[SNGCJA5_FRAME_FCC_IDX] = 0;
+    for (uint8_t i = 1; i < SNGCJA5_FRAME_FCC_IDX; i++) {
+        frame[SNGCJA5_FRAME_FCC_IDX] ^= frame[i];
+    }
+    frame[SNGCJA5_FRAME_SIZE - 1] = SNGCJA5_FRAME_ETX;
+}
+
+size_t CapturePrint::write(uint8_t c)
+{
+    if (length + 1 >= sizeof(text)) {
+        return 0;
+    }
+    text[length++] = c;
+    text[length] = '\0';
+    return 1;
+}
+#endif
@@ -0,0 +1,30 @@
+#ifndef __test_helpers__
+#define __test_helpers__
+#include <Arduino.h>
+#include <FS.h>
+#include "Telemetry.h"
+#include "ParticulateProtocols.h"
+
+// Fixtures shared by the tests.
+
+// a telemetry record with only the timestamp and PM2.5 set
+TelemetryRecord makeRecord(time_t timestamp, uint32_t pm2p5);
+
+// Removes the files a test left in dir, such as spill or archive segments.
+void removeFiles(fs::FS& fs, const char* dir);
+
+// Builds a valid SN-GCJA5 frame whose measurement bytes are all fill, except for the PM2.5
+// mass density, which is pm2p5.
+void makeSNGCJA5Frame(uint8_t* frame, uint8_t fill, uint16_t pm2p5);
+
+// collects what is printed to it, such as log lines or metrics
+class CapturePrint : public Print {
+public:
+    char    text[2048];
+    size_t  length;
+
+    CapturePrint() : length(0) { text[0] = '\0'; }
+    size_t write(uint8_t c) override;
+};
+
+#endif // __test_helpers__
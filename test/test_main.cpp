@@ -3,21 +3,97 @@
 #include <unity.h>
 #include "test_Utilities.h"
 #include "test_AirQualitySensor.h"
+#include "test_SampleHistory.h"
+#include "test_SNGCJA5FrameDecoder.h"
+#include "test_ParticulateFrameDecoder.h"
+#include "test_SPSCQueue.h"
+#include "test_PageRenderer.h"
+#include "test_Telemetry.h"
+#include "test_TelemetryBatch.h"
+#include "test_HTTPResponseParser.h"
+#include "test_LatencyHistogram.h"
+#include "test_PrometheusWriter.h"
+#include "test_TelemetryStore.h"
+#include "test_TelemetryUplink.h"
+#include "test_StaticAssetIndex.h"
+#include "test_ColumnarHistory.h"
+#include "test_Logger.h"
+#include "test_EnvironmentSensor.h"
+#include "test_DutyCycleScheduler.h"
+#include "test_UARTCapture.h"
 
 
+int runUnityTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_calculatePartialOrderedAverage);
+    RUN_TEST(test_convertEpochToString);
+    RUN_TEST(test_getAQIStatusColor);
+    RUN_TEST(test_AQIScale_breakpoints);
+    RUN_TEST(test_NowCast_hourly);
+    RUN_TEST(test_AirQualitySensor_restoreNowCast);
+    RUN_TEST(test_AirQualitySensor_drivers);
+    RUN_TEST(test_SampleHistory_windowAverages);
+    RUN_TEST(test_SampleHistory_lateRegisteredWindow);
+    RUN_TEST(test_SampleHistory_gaps);
+    RUN_TEST(test_SampleHistory_timeline);
+    RUN_TEST(test_SampleHistory_distribution);
+    RUN_TEST(test_SampleHistory_rollupTiers);
+    RUN_TEST(test_SampleHistory_tierWindows);
+    RUN_TEST(test_SampleHistory_stream);
+    RUN_TEST(test_SampleHistory_archive);
+    RUN_TEST(test_ColumnarHistory_codec);
+    RUN_TEST(test_ColumnarHistory_columns);
+    RUN_TEST(test_ColumnarHistory_eviction);
+    RUN_TEST(test_SNGCJA5FrameDecoder_validFrames);
+    RUN_TEST(test_SNGCJA5FrameDecoder_resync);
+    RUN_TEST(test_ParticulateFrameDecoder_PMS5003);
+    RUN_TEST(test_ParticulateFrameDecoder_SPS30);
+    RUN_TEST(test_SPSCQueue_pushPop);
+    RUN_TEST(test_MPSCQueue_pushPop);
+    RUN_TEST(test_PageRenderer_renderTemplate);
+    RUN_TEST(test_PageTemplate_render);
+    RUN_TEST(test_PageRenderer_liveUpdate);
+    RUN_TEST(test_PageRenderer_bootStatus);
+    RUN_TEST(test_Telemetry_writeJSON);
+    RUN_TEST(test_TelemetryBatch_offer);
+    RUN_TEST(test_TelemetryBatch_serialize);
+    RUN_TEST(test_TelemetryBatch_serializeWorstCase);
+    RUN_TEST(test_HTTPResponseParser_pipelined);
+    RUN_TEST(test_HTTPResponseParser_bodyFraming);
+    RUN_TEST(test_LatencyHistogram_percentiles);
+    RUN_TEST(test_PrometheusWriter_format);
+    RUN_TEST(test_TelemetryStore_packRecord);
+    RUN_TEST(test_TelemetryStore_ring);
+    RUN_TEST(test_TelemetryStore_spill);
+    RUN_TEST(test_TelemetryStore_spillFormat);
+    RUN_TEST(test_TelemetryUplink_outage);
+    RUN_TEST(test_StaticAssetIndex_build);
+    RUN_TEST(test_Logger_format);
+    RUN_TEST(test_Logger_write);
+    RUN_TEST(test_EnvironmentSensor_nonBlocking);
+    RUN_TEST(test_EnvironmentSensor_history);
+    RUN_TEST(test_DutyCycleScheduler_sleep);
+    RUN_TEST(test_DutyCycleScheduler_simulatedHour);
+    RUN_TEST(test_UARTCapture_record);
+    RUN_TEST(test_CaptureReplay_frames);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
 void setup() {
     // NOTE!!! Wait for >2 secs
     // if board doesn't support software reset via Serial.DTR/RTS
     delay(2000);
 
-    UNITY_BEGIN();
-    RUN_TEST(test_calculatePartialOrderedAverage);
-    RUN_TEST(test_convertEpochToString);
-    RUN_TEST(test_getAQIStatusColor);
-    UNITY_END();
+    runUnityTests();
 }
 
 void loop() {
 }
+#else
+int main(int /*argc*/, char ** /*argv*/) {
+    return runUnityTests();
+}
+#endif
 
 #endif
\ No newline at end of file
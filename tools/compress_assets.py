@@ -0,0 +1,42 @@
+"""
+PlatformIO extra script that writes a gzip compressed copy of each static asset in data/
+before the SPIFFS image is built, so the device can send the compressed copy to browsers
+that accept it. The HTML files are page templates rendered on the device, so they are left
+alone. A copy is only kept when it is meaningfully smaller than the original.
+
+Enabled for the device environments in platformio.ini with:
+    extra_scripts = pre:tools/compress_assets.py
+"""
+import gzip
+import os
+
+Import("env")  # noqa: F821 - provided by PlatformIO
+
+COMPRESSED_EXTENSIONS = (".css", ".js", ".json", ".svg", ".txt", ".xml")
+MIN_SAVING = 0.1
+
+
+def compress_assets(source, target, env):
+    data_dir = env.subst("$PROJECT_DATA_DIR")
+    for name in sorted(os.listdir(data_dir)):
+        path = os.path.join(data_dir, name)
+        gz_path = path + ".gz"
+        if not name.endswith(COMPRESSED_EXTENSIONS) or not os.path.isfile(path):
+            continue
+        if os.path.exists(gz_path) and os.path.getmtime(gz_path) >= os.path.getmtime(path):
+            continue
+        with open(path, "rb") as f:
+            contents = f.read()
+        # mtime=0 keeps the output, and so the device's ETag for it, stable between builds
+        compressed = gzip.compress(contents, compresslevel=9, mtime=0)
+        if len(compressed) > len(contents)*(1 - MIN_SAVING):
+            if os.path.exists(gz_path):
+                os.remove(gz_path)
+            print("Not compressing %s, which would only shrink to %d of %d bytes" % (name, len(compressed), len(contents)))
+            continue
+        with open(gz_path, "wb") as f:
+            f.write(compressed)
+        print("Compressed %s from %d to %d bytes" % (name, len(contents), len(compressed)))
+
+
+env.AddPreAction("$BUILD_DIR/spiffs.bin", compress_assets)  # noqa: F821
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""
+Stand-in for the telemetry service, for testing the device's telemetry client.
+
+Accepts the JSON POSTs the device sends, prints a summary of each, and answers with HTTP/1.1
+keep-alive responses, so connection reuse and pipelining can be watched from the device's
+stats page. The options simulate a slow or flaky service.
+
+Run with:
+    python3 tools/telemetry_server.py --port 8080
+
+and build the device with TELEMETRY_URL set to "http://<this computer's address>:8080/telemetry".
+"""
+import argparse
+import json
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class TelemetryHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_POST(self):
+        server = self.server
+        server.request_count += 1
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+
+        try:
+            payload = json.loads(body)
+            records = payload if isinstance(payload, list) else [payload]
+            summary = "{} record(s), first timestamp {}, last timestamp {}".format(
+                len(records), records[0].get("timestamp"), records[-1].get("timestamp"))
+        except (ValueError, IndexError, AttributeError) as e:
+            summary = "INVALID JSON ({}): {!r}".format(e, body[:80])
+
+        print("{} request {} on {}:{}: {} bytes, {}".format(
+            time.strftime("%H:%M:%S"), server.request_count, *self.client_address[:2], length, summary))
+
+        if server.args.delay > 0:
+            time.sleep(server.args.delay)
+
+        status = server.args.status
+        close = (server.args.close_every > 0) and (server.request_count % server.args.close_every == 0)
+        response = b"saved"
+        self.send_response(status)
+        self.send_header("Content-Type", "text/plain")
+        self.send_header("Content-Length", str(len(response)))
+        if close:
+            self.send_header("Connection", "close")
+            self.close_connection = True
+        self.end_headers()
+        self.wfile.write(response)
+
+    def log_message(self, format, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stand-in telemetry service for testing the device.")
+    parser.add_argument("--port", type=int, default=8080, help="port to listen on")
+    parser.add_argument("--delay", type=float, default=0, help="seconds to wait before each response")
+    parser.add_argument("--status", type=int, default=200, help="HTTP status code to respond with")
+    parser.add_argument("--close-every", type=int, default=0,
+                        help="close the connection after every Nth response. 0 keeps it open.")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("", args.port), TelemetryHandler)
+    server.args = args
+    server.request_count = 0
+    print("Listening for telemetry on port {}".format(args.port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()